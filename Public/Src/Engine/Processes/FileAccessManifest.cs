@@ -401,6 +401,95 @@ namespace BuildXL.Processes
             set => SetFlag(FileAccessManifestFlag.QBuildIntegrated, value);
         }
 
+        /// <summary>
+        /// On Linux, whether sandboxed processes send their access reports through a shared memory
+        /// ring buffer instead of a FIFO.
+        /// </summary>
+        /// <remarks>Note: this is only an option that is set programmatically. Not controlled by a command line option.</remarks>
+        public bool UseSharedMemoryReportTransport { get; set; }
+
+        /// <summary>
+        /// On Linux, whether each thread of a sandboxed process accumulates its access reports and sends
+        /// them in batches (only applies when reports are sent through a FIFO).
+        /// </summary>
+        /// <remarks>Note: this is only an option that is set programmatically. Not controlled by a command line option.</remarks>
+        public bool BatchAccessReports { get; set; }
+
+        /// <summary>
+        /// On Linux, whether the processes of a pip share a table of the accesses they have already reported,
+        /// so that an access is only reported when it is new to the pip.
+        /// </summary>
+        /// <remarks>Note: this is only an option that is set programmatically. Not controlled by a command line option.</remarks>
+        public bool DeduplicateAccessReports { get; set; }
+
+        /// <summary>
+        /// On Linux, whether the access reports of a pip are read by the native multi-pip report reader
+        /// instead of a dedicated managed thread (only applies when reports are sent through a FIFO).
+        /// </summary>
+        /// <remarks>Note: this is only an option that is set programmatically. Not controlled by a command line option.</remarks>
+        public bool UseNativeReportReader { get; set; }
+
+        /// <summary>
+        /// On Linux, whether the native report reader folds the file access reports of a pip into a set with one entry
+        /// per path, which is delivered once the pip's process tree has completed (only applies together with
+        /// <see cref="UseNativeReportReader"/>).
+        /// </summary>
+        /// <remarks>Note: this is only an option that is set programmatically. Not controlled by a command line option.</remarks>
+        public bool BuildAccessSetNatively { get; set; }
+
+        /// <summary>
+        /// On Linux, whether the processes of a pip keep track of each other in a shared table, which lets the host
+        /// tell when the last of them is gone (including processes killed by a signal, which never report their exit).
+        /// </summary>
+        /// <remarks>Note: this is only an option that is set programmatically. Not controlled by a command line option.</remarks>
+        public bool TrackProcessTreeInSharedMemory { get; set; }
+
+        /// <summary>
+        /// On Linux, whether each thread of a sandboxed process only sends the part of a reported path that differs
+        /// from the path it reported previously (the host reconstructs the full path).
+        /// </summary>
+        /// <remarks>Note: this is only an option that is set programmatically. Not controlled by a command line option.</remarks>
+        public bool FrontCodeReportPaths { get; set; }
+
+        /// <summary>
+        /// On Linux, whether a sandboxed process that finds its pip's FIFO full appends its access reports to an overflow
+        /// journal (read by the host once the FIFO is closed) instead of blocking until the host catches up.
+        /// </summary>
+        /// <remarks>Note: this is only an option that is set programmatically. Not controlled by a command line option.</remarks>
+        public bool SpillReportsToJournal { get; set; }
+
+        /// <summary>
+        /// On Linux, whether each sandboxed process compiles the policy tree of this manifest into a flat index when it loads
+        /// the manifest, which makes looking up paths cheaper at the cost of a pass over the whole tree per process.
+        /// </summary>
+        /// <remarks>Note: this is only an option that is set programmatically. Not controlled by a command line option.</remarks>
+        public bool CompilePolicyIndex { get; set; }
+
+        /// <summary>
+        /// On Linux, whether this manifest is handed to the sandboxed processes through a sealed memfd, which each of them
+        /// maps and parses in place, instead of through a file that each of them reads and copies (the file is still
+        /// written, for the processes that cannot open the memfd).
+        /// </summary>
+        /// <remarks>Note: this is only an option that is set programmatically. Not controlled by a command line option.</remarks>
+        public bool ShareManifestThroughMemfd { get; set; }
+
+        /// <summary>
+        /// On Linux, whether this manifest is serialized with the Linux-native layout (version 2) instead of the layout shared with
+        /// Windows: a table of sections that can each be reached directly, UTF-8 strings (deduplicated), and a policy tree laid out
+        /// as the index the sandboxed processes look paths up in (power-of-two bucket tables and a pool of partial paths), which they
+        /// use in place instead of parsing the manifest or compiling the index (<see cref="CompilePolicyIndex"/> is then moot).
+        /// </summary>
+        /// <remarks>Note: this is only an option that is set programmatically. Not controlled by a command line option.</remarks>
+        public bool UseLinuxNativeLayout { get; set; }
+
+        /// <summary>
+        /// On Linux, whether the sandboxed processes apply the <see cref="DirectoryTranslator"/> of this manifest to the paths of their
+        /// accesses before looking up their policies, in which case the reported paths are already translated (and are not translated
+        /// again when they are received).
+        /// </summary>
+        /// <remarks>Note: this is only an option that is set programmatically. Not controlled by a command line option.</remarks>
+        public bool TranslatePathsInSandbox { get; set; }
+
         /// <summary>
         /// A location for a file where Detours to log failure messages.
         /// </summary>
@@ -915,6 +1004,245 @@ namespace BuildXL.Processes
             }
         }
 
+        // CODESYNC: FileAccessManifestParser.hpp (Linux-native layout of a manifest)
+        private static class LinuxNativeLayout
+        {
+            public const uint Magic         = 0x324D4146; // "FAM2"
+            public const uint Version       = 2;
+
+            // Sections, in the order of the section table
+            public const int Globals            = 0;
+            public const int Strings            = 1;
+            public const int BreakawayProcesses = 2;
+            public const int TranslatePaths     = 3;
+            public const int PolicyNodes        = 4;
+            public const int PolicySlots        = 5;
+            public const int PolicyRecords      = 6;
+            public const int NumSections        = 7;
+
+            public const int SectionAlignment = 8;
+            public const int HeaderSize       = 4 * sizeof(uint) + NumSections * 2 * sizeof(uint);
+
+            /// <summary>
+            /// Same as PolicyIndex::HashComponent: folds the UTF-8 bytes of a partial path 8 at a time (little-endian).
+            /// </summary>
+            public static uint HashComponent(byte[] bytes, int length)
+            {
+                const ulong Multiplier = 0x9E3779B97F4A7C15;
+                unchecked
+                {
+                    ulong hash = (ulong)length;
+                    int i = 0;
+                    for (; i + sizeof(ulong) <= length; i += sizeof(ulong))
+                    {
+                        hash = (hash ^ BitConverter.ToUInt64(bytes, i)) * Multiplier;
+                        hash ^= hash >> 32;
+                    }
+
+                    if (i < length)
+                    {
+                        ulong word = 0;
+                        for (int k = 0; i + k < length; k++)
+                        {
+                            word |= (ulong)bytes[i + k] << (8 * k);
+                        }
+
+                        hash = (hash ^ word) * Multiplier;
+                        hash ^= hash >> 32;
+                    }
+
+                    return (uint)hash;
+                }
+            }
+
+            /// <summary>
+            /// Same as PolicyIndex::TableSize: the smallest power of 2 that is at least twice the number of entries.
+            /// </summary>
+            public static uint TableSize(int numEntries)
+            {
+                uint size = 1;
+                while (size < 2 * (uint)numEntries)
+                {
+                    size <<= 1;
+                }
+
+                return size;
+            }
+        }
+
+        /// <summary>
+        /// The strings of a manifest with the Linux-native layout: null-terminated, UTF-8, each stored once.
+        /// </summary>
+        private sealed class LinuxNativeStringPool
+        {
+            private readonly Dictionary<string, uint> m_offsets = new Dictionary<string, uint>();
+
+            public MemoryStream Stream { get; } = new MemoryStream();
+
+            public LinuxNativeStringPool()
+            {
+                Add(string.Empty);
+            }
+
+            /// <summary>
+            /// Offset of <paramref name="str"/> in the pool.
+            /// </summary>
+            public uint Add(string str)
+            {
+                str = str ?? string.Empty;
+                return Add(str, () => Encoding.UTF8.GetBytes(str + '\0'));
+            }
+
+            /// <summary>
+            /// Offset of the (already normalized and encoded) partial path <paramref name="fragment"/> in the pool.
+            /// </summary>
+            public uint Add(NormalizedPathString fragment)
+            {
+                return Add(Encoding.UTF8.GetString(fragment.Bytes, 0, fragment.Bytes.Length - 1), () => fragment.Bytes);
+            }
+
+            private uint Add(string key, Func<byte[]> getBytes)
+            {
+                if (!m_offsets.TryGetValue(key, out uint offset))
+                {
+                    offset = checked((uint)Stream.Length);
+                    byte[] bytes = getBytes();
+                    Stream.Write(bytes, 0, bytes.Length);
+                    m_offsets.Add(key, offset);
+                }
+
+                return offset;
+            }
+        }
+
+        /// <summary>
+        /// Writes what follows the magic number, version and debug flag of a manifest with the Linux-native layout: the rest of the header
+        /// (the section table) and the sections.
+        /// </summary>
+        private void WriteLinuxNativeSections(BinaryWriter writer, FileAccessSetup setup)
+        {
+            HydrateTreeNodeIfNeeded();
+            m_rootNode.FinalizePolicies();
+
+            var strings = new LinuxNativeStringPool();
+            var sections = new MemoryStream[LinuxNativeLayout.NumSections];
+            var writers = new BinaryWriter[LinuxNativeLayout.NumSections];
+            for (int i = 0; i < sections.Length; i++)
+            {
+                sections[i] = i == LinuxNativeLayout.Strings ? strings.Stream : new MemoryStream();
+                writers[i] = new BinaryWriter(sections[i], Encoding.UTF8, true);
+            }
+
+            // the root of the tree is the unix root sentinel (if any)
+            Node unixRoot = m_rootNode.ChildrenByFragment?.Values.SingleOrDefault() ?? m_rootNode;
+
+            // breadth-first: the children of a node are appended (and their slots filled in) when the node is visited
+            var nodes = new List<(Node node, uint hash, uint pathOffset)> { (unixRoot, 0, 0) };
+            var slots = new List<uint>();
+            for (int n = 0; n < nodes.Count; n++)
+            {
+                (Node node, uint hash, uint pathOffset) = nodes[n];
+                var children = node.ChildrenByFragment;
+                int childCount = children?.Count ?? 0;
+                uint numSlots = childCount == 0 ? 0 : LinuxNativeLayout.TableSize(childCount);
+                int firstSlot = slots.Count;
+
+                writers[LinuxNativeLayout.PolicyNodes].Write(hash);
+                writers[LinuxNativeLayout.PolicyNodes].Write(pathOffset);
+                writers[LinuxNativeLayout.PolicyNodes].Write((uint)firstSlot);
+                writers[LinuxNativeLayout.PolicyNodes].Write(numSlots);
+
+                // a record without buckets or partial path: see ManifestRecord and InternalSerialize
+                BinaryWriter records = writers[LinuxNativeLayout.PolicyRecords];
+#if DEBUG
+                records.Write((uint)0xF00DCAFE); // "food cafe"
+#endif
+                records.Write(hash);
+                records.Write((uint)node.ConePolicy);
+                records.Write((uint)node.NodePolicy);
+                records.Write((uint)node.PathId.Value.Value);
+                records.Write((ulong)node.ExpectedUsn.Value);
+                records.Write(0U);
+                records.Write(0U);
+
+                if (childCount == 0)
+                {
+                    continue;
+                }
+
+                slots.AddRange(Enumerable.Repeat(0U, (int)numSlots));
+                foreach (var child in children)
+                {
+                    byte[] bytes = child.Key.Bytes;
+                    uint childHash = LinuxNativeLayout.HashComponent(bytes, bytes.Length - 1);
+                    uint childNode = checked((uint)nodes.Count);
+                    nodes.Add((child.Value, childHash, strings.Add(child.Key)));
+
+                    uint slot = childHash & (numSlots - 1);
+                    while (slots[firstSlot + (int)slot] != 0)
+                    {
+                        slot = (slot + 1) & (numSlots - 1);
+                    }
+
+                    slots[firstSlot + (int)slot] = childNode;
+                }
+            }
+
+            foreach (uint slot in slots)
+            {
+                writers[LinuxNativeLayout.PolicySlots].Write(slot);
+            }
+
+            if (ChildProcessesToBreakawayFromSandbox != null)
+            {
+                foreach (string processName in ChildProcessesToBreakawayFromSandbox)
+                {
+                    writers[LinuxNativeLayout.BreakawayProcesses].Write(strings.Add(processName));
+                }
+            }
+
+            if (DirectoryTranslator != null)
+            {
+                foreach (DirectoryTranslator.Translation translation in DirectoryTranslator.Translations)
+                {
+                    writers[LinuxNativeLayout.TranslatePaths].Write(strings.Add(translation.SourcePath));
+                    writers[LinuxNativeLayout.TranslatePaths].Write(strings.Add(translation.TargetPath));
+                }
+            }
+
+            BinaryWriter globals = writers[LinuxNativeLayout.Globals];
+            globals.Write((uint)m_fileAccessManifestFlag);
+            globals.Write((uint)FileAccessManifestExtraFlag.None);
+            globals.Write(PipId);
+            globals.Write(strings.Add(setup.ReportPath));
+            globals.Write((uint)Encoding.UTF8.GetByteCount(setup.ReportPath ?? string.Empty));
+
+            // the section table, then the sections (each aligned)
+            writer.Write((uint)LinuxNativeLayout.NumSections);
+            long offset = LinuxNativeLayout.HeaderSize;
+            foreach (MemoryStream section in sections)
+            {
+                offset = Align(offset);
+                writer.Write(checked((uint)offset));
+                writer.Write(checked((uint)section.Length));
+                offset += section.Length;
+            }
+
+            for (int i = 0; i < sections.Length; i++)
+            {
+                while (writer.BaseStream.Position < Align(writer.BaseStream.Position))
+                {
+                    writer.Write((byte)0);
+                }
+
+                writers[i].Dispose();
+                sections[i].WriteTo(writer.BaseStream);
+                sections[i].Dispose();
+            }
+
+            long Align(long position) => (position + LinuxNativeLayout.SectionAlignment - 1) & ~(long)(LinuxNativeLayout.SectionAlignment - 1);
+        }
+
         /// <summary>
         /// Creates, as an Unicode encoded byte array, an expanded textual representation of the manifest, as consumed by the
         /// native detour implementation
@@ -927,6 +1255,13 @@ namespace BuildXL.Processes
             stream.Position = 0;
             using (var writer = new BinaryWriter(stream, Encoding.Unicode, true))
             {
+                bool linuxNativeLayout = UseLinuxNativeLayout && OperatingSystemHelper.IsLinuxOS;
+                if (linuxNativeLayout)
+                {
+                    writer.Write(LinuxNativeLayout.Magic);
+                    writer.Write(LinuxNativeLayout.Version);
+                }
+
                 WriteDebugFlagBlock(writer, ref debugFlagsMatch);
                 if (!debugFlagsMatch)
                 {
@@ -936,6 +1271,13 @@ namespace BuildXL.Processes
                 Tracing.Logger.Log.PipInvalidDetoursDebugFlag2(loggingContext);
 #endif
                 }
+
+                if (linuxNativeLayout)
+                {
+                    WriteLinuxNativeSections(writer, setup);
+                    return new ArraySegment<byte>(stream.GetBuffer(), 0, (int)stream.Position);
+                }
+
                 WriteInjectionTimeoutBlock(writer, timeoutMins);
                 WriteChildProcessesToBreakAwayFromSandbox(writer, ChildProcessesToBreakawayFromSandbox);
                 WriteTranslationPathStrings(writer, DirectoryTranslator);
@@ -1329,6 +1671,11 @@ namespace BuildXL.Processes
             /// </summary>
             internal IEnumerable<Node> Children => m_children?.Values;
 
+            /// <summary>
+            /// Returns children nodes, by their (normalized) partial paths.
+            /// </summary>
+            internal IReadOnlyDictionary<NormalizedPathString, Node> ChildrenByFragment => m_children;
+
             /// <summary>
             /// Releases all children nodes, allowing all that memory to be reclaimed by the garbage collector.
             /// </summary>
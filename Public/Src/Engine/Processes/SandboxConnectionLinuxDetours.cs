@@ -29,6 +29,42 @@ namespace BuildXL.Processes
     /// A separate FIFO is used for each pip.  The sandbox is injected into the pip
     /// by virtue of setting the LD_PRELOAD environment variable to point to a native
     /// dynamic library where all the system call interposing is implemented.
+    ///
+    /// When <see cref="FileAccessManifest.UseSharedMemoryReportTransport"/> is set for a pip, a shared
+    /// memory ring buffer (see <see cref="ReportRing"/>) is used for that pip instead of a FIFO.
+    ///
+    /// When <see cref="FileAccessManifest.DeduplicateAccessReports"/> is set for a pip, the processes of that
+    /// pip share a table of already reported accesses (see <see cref="AccessDedupTable"/>) and only send
+    /// the reports that would not be cache hits in <see cref="PathCacheRecord"/>.
+    ///
+    /// When <see cref="FileAccessManifest.UseNativeReportReader"/> is set for a pip that reports through a FIFO,
+    /// the FIFO is read by a native reader shared by all such pips (see <see cref="ReportReader"/>) instead of
+    /// by a dedicated thread.  With <see cref="FileAccessManifest.BuildAccessSetNatively"/>, the native reader
+    /// also folds the pip's file accesses into one report per path, delivered when the process tree completes.
+    ///
+    /// When <see cref="FileAccessManifest.TrackProcessTreeInSharedMemory"/> is set for a pip, the processes of that pip
+    /// keep track of each other in a shared table (see <see cref="ProcessTree"/>), which is watched by a native monitor
+    /// shared by all such pips; the host stops receiving the pip's reports as soon as the monitor finds the table empty,
+    /// even when some processes never report their exit (e.g., because they were killed).
+    ///
+    /// When <see cref="FileAccessManifest.FrontCodeReportPaths"/> is set for a pip, the reported paths are front-coded
+    /// (see <see cref="TryDecodeReport"/>), whichever way the reports are received.
+    ///
+    /// When <see cref="FileAccessManifest.SpillReportsToJournal"/> is set for a pip that reports through a FIFO, a process that
+    /// finds the FIFO full appends its file access reports to a journal file of its own instead of blocking (process start, exit
+    /// and breakaway reports still go through the FIFO); the journals are read once the FIFO has been closed, so spilled reports
+    /// are received after all the others (see <see cref="Info.ReportsJournalDirectory"/>).  The process exit and breakaway reports
+    /// are only passed on to the process once the journals have been received, so that no access of a process follows its exit.
+    ///
+    /// When <see cref="FileAccessManifest.ShareManifestThroughMemfd"/> is set for a pip, the manifest is also put in a
+    /// sealed memfd (see <see cref="ManifestMemfd"/>), which the processes of the pip map instead of reading the manifest's file.
+    ///
+    /// When <see cref="FileAccessManifest.TranslatePathsInSandbox"/> is set for a pip, the processes of the pip apply the manifest's
+    /// directory translations to the paths of their accesses, so the reports carry the translated paths.
+    ///
+    /// A child process whose program is named in <see cref="FileAccessManifest.ChildProcessesToBreakawayFromSandbox"/> runs
+    /// unmonitored, together with all its descendants: it is exec'd without LD_PRELOAD and only sends a
+    /// <see cref="FileOperation.OpProcessBreakaway"/> report, after which the host stops waiting for it.
     /// </summary>
     public sealed class SandboxConnectionLinuxDetours : ISandboxConnection
     {
@@ -73,6 +109,38 @@ namespace BuildXL.Processes
             internal string ReportsFifoPath { get; }
             internal string FamPath { get; }
 
+            /// <summary>Path to the shared memory report ring; null when reports are received through the FIFO</summary>
+            internal string ReportsRingPath { get; }
+
+            /// <summary>Whether the sandboxed processes batch their access reports</summary>
+            internal bool BatchAccessReports { get; set; }
+
+            /// <summary>Whether the sandboxed processes front-code the paths of their access reports</summary>
+            internal bool FrontCodeReportPaths { get; set; }
+
+            /// <summary>Whether the sandboxed processes compile the policy tree of the manifest into a flat index</summary>
+            internal bool CompilePolicyIndex { get; set; }
+
+            /// <summary>Whether the sandboxed processes translate the paths of their accesses (see <see cref="FileAccessManifest.TranslatePathsInSandbox"/>)</summary>
+            internal bool TranslatePaths { get; set; }
+
+            /// <summary>
+            /// Path through which the sandboxed processes open the memfd holding the manifest; null when they read the manifest's file
+            /// </summary>
+            internal string FamMemfdPath { get; private set; }
+
+            /// <summary>Path to the shared memory access dedup table; null when the sandboxed processes report every access</summary>
+            internal string DedupTablePath { get; private set; }
+
+            /// <summary>Path to the shared memory process tree; null when the sandboxed processes do not keep track of each other</summary>
+            internal string ProcessTreePath { get; private set; }
+
+            /// <summary>
+            /// Directory where the sandboxed processes spill their reports when the FIFO is full (one journal per process);
+            /// null when they block instead
+            /// </summary>
+            internal string ReportsJournalDirectory { get; private set; }
+
             internal static string GetDebugLogPath(string famPath) => Path.ChangeExtension(famPath, ".log");
             internal string DebugLogPath => GetDebugLogPath(FamPath);
 
@@ -81,13 +149,71 @@ namespace BuildXL.Processes
             private readonly HashSet<int> m_activeProcesses;
             private readonly Lazy<SafeFileHandle> m_lazyWriteHandle;
             private readonly Thread m_workerThread;
+            private readonly IntPtr m_ring;
+            private volatile bool m_stopRequested;
+            private IntPtr m_dedupTable;
+            private int m_famMemfd = -1;
+            private IntPtr m_reportReader;
+            private bool m_buildAccessSet;
+            private IntPtr m_processTree;
+            private IntPtr m_processTreeMonitor;
+            private bool m_disposed;
+            private readonly object m_disposeLock = new object();
+            private readonly ManualResetEventSlim m_reportReaderChannelClosed = new ManualResetEventSlim(initialState: false);
 
-            internal Info(Sandbox.ManagedFailureCallback failureCallback, SandboxedProcessUnix process, string reportsFifoPath, string famPath)
+            /// <summary>
+            /// Process exit and breakaway reports held back until the journals have been received (see <see cref="ReportsJournalDirectory"/>);
+            /// only touched by whichever thread processes the reports
+            /// </summary>
+            private readonly List<(AccessReport report, uint pathId)> m_heldExitReports = new List<(AccessReport report, uint pathId)>();
+
+            private const int ReportHeaderSize = 24;
+            private const byte ReportFormatVersion = 1;
+            private const byte ReportFlagReportExplicitly = 0x01;
+            private const byte ReportFlagFrontCoded = 0x02;
+            private const byte ReportFlagHasPathId = 0x04;
+            private const int FrontCodingSize = 8;
+            private const int PathIdSize = 4;
+            private const int FrontCodingNumSlots = 4;
+
+            private const int JournalEntryHeaderSize = 16;
+
+            private const uint FragmentFlag = 0x80000000;
+            private const int FragmentHeaderSize = 12;
+            private const ushort LastFragmentFlag = 0x01;
+
+            /// <summary>Front-coding slots (paths recently decoded from front-coded reports), keyed by the writer's pid and producer id</summary>
+            private readonly Dictionary<(int pid, uint producerId), byte[][]> m_frontCodingSlots = new Dictionary<(int pid, uint producerId), byte[][]>();
+
+            /// <summary>Reports received so far only in part, keyed by the writer's pid and the report's message id</summary>
+            private readonly Dictionary<(int pid, uint messageId), PendingRecord> m_pendingFragments = new Dictionary<(int pid, uint messageId), PendingRecord>();
+
+            /// <summary>How long a ring reader blocks waiting for a record before re-checking whether it should stop</summary>
+            private const int RingReadTimeoutMs = 100;
+
+            /// <summary>
+            /// How long a ring reader keeps waiting, once asked to stop, for records that have been reserved but not committed.
+            /// The record of a producer killed in the middle of writing it is normally dropped by <see cref="ReportRing.Read"/>;
+            /// only one killed right between reserving and stamping the record is left to this timeout
+            /// </summary>
+            private static readonly TimeSpan RingDrainTimeout = TimeSpan.FromSeconds(10);
+
+            /// <summary>
+            /// How long disposing waits for the native report reader to close the FIFO, which it only does once every process
+            /// holding a write end of it is gone (a process that escaped the pip's process tree may hold one indefinitely)
+            /// </summary>
+            private static readonly TimeSpan ReportReaderCloseTimeout = TimeSpan.FromSeconds(30);
+
+            internal Info(Sandbox.ManagedFailureCallback failureCallback, SandboxedProcessUnix process, string reportsFifoPath, string famPath, string reportsRingPath = null, IntPtr ring = default)
             {
+                Contract.Requires((reportsRingPath == null) == (ring == IntPtr.Zero));
+
                 m_failureCallback = failureCallback;
                 Process = process;
                 ReportsFifoPath = reportsFifoPath;
                 FamPath = famPath;
+                ReportsRingPath = reportsRingPath;
+                m_ring = ring;
 
                 m_pathCache = new Dictionary<string, PathCacheRecord>();
                 m_activeProcesses = new HashSet<int>
@@ -109,11 +235,88 @@ namespace BuildXL.Processes
                 m_workerThread.Priority = ThreadPriority.Highest;
             }
 
+            /// <summary>
+            /// Makes the sandboxed processes map the manifest from the memfd <paramref name="fd"/> of this process, which they open
+            /// through <paramref name="path"/>.  Must be called before the processes are started; the memfd is closed together with this object.
+            /// </summary>
+            internal void SetFamMemfd(string path, int fd)
+            {
+                Contract.Requires(fd >= 0);
+                FamMemfdPath = path;
+                m_famMemfd = fd;
+            }
+
+            /// <summary>
+            /// Makes the sandboxed processes use the access dedup table <paramref name="table"/> backed by <paramref name="path"/>.
+            /// Must be called before the processes are started; the table is disposed together with this object.
+            /// </summary>
+            internal void SetDedupTable(string path, IntPtr table)
+            {
+                Contract.Requires(table != IntPtr.Zero);
+                DedupTablePath = path;
+                m_dedupTable = table;
+            }
+
+            /// <summary>
+            /// Makes the sandboxed processes keep track of each other in the process tree <paramref name="tree"/> backed by
+            /// <paramref name="path"/>, which is to be watched by <paramref name="monitor"/> from <see cref="Start"/> on.
+            /// Must be called before the processes are started; the tree is disposed together with this object.
+            /// </summary>
+            internal void SetProcessTree(string path, IntPtr tree, IntPtr monitor)
+            {
+                Contract.Requires(tree != IntPtr.Zero);
+                Contract.Requires(monitor != IntPtr.Zero);
+                ProcessTreePath = path;
+                m_processTree = tree;
+                m_processTreeMonitor = monitor;
+            }
+
+            /// <summary>
+            /// Makes the sandboxed processes spill their reports to journals in <paramref name="directory"/> (which must exist)
+            /// when the FIFO is full.  Must be called before the processes are started; the directory is deleted together with this object.
+            /// </summary>
+            internal void SetReportsJournalDirectory(string directory)
+            {
+                Contract.Requires(m_ring == IntPtr.Zero);
+                ReportsJournalDirectory = directory;
+            }
+
+            /// <summary>
+            /// Makes this pip's FIFO be read by the native <paramref name="reader"/> instead of a dedicated thread
+            /// (see <see cref="ReportReader.AddChannel"/> for <paramref name="buildAccessSet"/>).
+            /// Must be called before <see cref="Start"/>.
+            /// </summary>
+            internal void SetReportReader(IntPtr reader, bool buildAccessSet)
+            {
+                Contract.Requires(reader != IntPtr.Zero);
+                Contract.Requires(m_ring == IntPtr.Zero);
+                m_reportReader = reader;
+                m_buildAccessSet = buildAccessSet;
+            }
+
             /// <summary>
             /// Starts receiving access reports
             /// </summary>
             internal void Start()
             {
+                if (m_processTreeMonitor != IntPtr.Zero && !ProcessTree.AddTree(m_processTreeMonitor, Process.PipId, m_processTree))
+                {
+                    LogDebug($"Adding process tree '{ProcessTreePath}' to the process tree monitor failed with errno {Marshal.GetLastWin32Error()}");
+                    m_processTreeMonitor = IntPtr.Zero;
+                }
+
+                if (m_reportReader != IntPtr.Zero)
+                {
+                    if (ReportReader.AddChannel(m_reportReader, Process.PipId, ReportsFifoPath, m_buildAccessSet, ReportsJournalDirectory))
+                    {
+                        LogDebug($"Reading from FIFO '{ReportsFifoPath}' with the native report reader (build access set: {m_buildAccessSet})");
+                        return;
+                    }
+
+                    LogDebug($"Adding FIFO '{ReportsFifoPath}' to the native report reader failed with errno {Marshal.GetLastWin32Error()}; reading it with a dedicated thread");
+                    m_reportReader = IntPtr.Zero;
+                }
+
                 m_workerThread.Start();
             }
 
@@ -123,11 +326,43 @@ namespace BuildXL.Processes
             /// </summary>
             internal void RequestStop()
             {
+                if (m_ring != IntPtr.Zero)
+                {
+                    LogDebug($"Requesting the reader of ring '{ReportsRingPath}' to stop");
+                    // the reader stops once it finds the ring drained
+                    m_stopRequested = true;
+                    ReportRing.WakeConsumer(m_ring);
+                    return;
+                }
+
+                if (m_reportReader != IntPtr.Zero)
+                {
+                    LogDebug($"Closing the native report reader's write handle for FIFO '{ReportsFifoPath}'");
+                    ReportReader.CloseChannelWriter(m_reportReader, Process.PipId);
+                    return;
+                }
+
                 LogDebug($"Closing the write handle for FIFO '{ReportsFifoPath}'");
                 // this will cause read() on the other end of the FIFO to return EOF once all native writers are done writing
                 m_lazyWriteHandle.Value.Dispose();
             }
 
+            /// <summary>
+            /// Called (on the process tree monitor's thread) once every process of this pip has exited.
+            /// </summary>
+            internal void OnProcessTreeCompleted()
+            {
+                // the monitor may call back while this object is being disposed
+                lock (m_disposeLock)
+                {
+                    if (!m_disposed)
+                    {
+                        LogDebug($"Process tree '{ProcessTreePath}' has completed");
+                        RequestStop();
+                    }
+                }
+            }
+
             /// <summary>Adds <paramref name="pid" /> to the set of active processes</summary>
             internal void AddPid(int pid)
             {
@@ -178,46 +413,176 @@ namespace BuildXL.Processes
             /// <nodoc />
             public void Dispose()
             {
+                lock (m_disposeLock)
+                {
+                    m_disposed = true;
+                }
+
                 RequestStop();
-                m_workerThread?.Join();
+                bool readerDone = true;
+                if (m_reportReader != IntPtr.Zero)
+                {
+                    readerDone = m_reportReaderChannelClosed.Wait(ReportReaderCloseTimeout);
+                    if (!readerDone)
+                    {
+                        LogError($"FIFO {ReportsFifoPath} was still open {ReportReaderCloseTimeout.TotalSeconds}s after all processes exited");
+                    }
+                }
+                else
+                {
+                    m_workerThread?.Join();
+                }
+
+                // the native reader still signals the event when it eventually closes the FIFO
+                if (readerDone)
+                {
+                    m_reportReaderChannelClosed.Dispose();
+                }
                 m_pathCache.Clear();
                 m_activeProcesses.Clear();
+                m_frontCodingSlots.Clear();
+                if (m_ring != IntPtr.Zero)
+                {
+                    ReportRing.Dispose(m_ring);
+                    Analysis.IgnoreResult(FileUtilities.TryDeleteFile(ReportsRingPath, waitUntilDeletionFinished: false));
+                }
+                if (m_famMemfd != -1)
+                {
+                    ManifestMemfd.Dispose(m_famMemfd);
+                    m_famMemfd = -1;
+                }
+                if (m_dedupTable != IntPtr.Zero)
+                {
+                    LogDebug($"Access dedup table '{DedupTablePath}' :: {AccessDedupTable.GetCounters(m_dedupTable)}");
+                    AccessDedupTable.Dispose(m_dedupTable);
+                    m_dedupTable = IntPtr.Zero;
+                    Analysis.IgnoreResult(FileUtilities.TryDeleteFile(DedupTablePath, waitUntilDeletionFinished: false));
+                }
+                if (m_processTree != IntPtr.Zero)
+                {
+                    if (m_processTreeMonitor != IntPtr.Zero)
+                    {
+                        ProcessTree.RemoveTree(m_processTreeMonitor, Process.PipId);
+                    }
+                    LogDebug($"Process tree '{ProcessTreePath}' :: {ProcessTree.GetCounters(m_processTree)}");
+                    ProcessTree.Dispose(m_processTree);
+                    m_processTree = IntPtr.Zero;
+                    Analysis.IgnoreResult(FileUtilities.TryDeleteFile(ProcessTreePath, waitUntilDeletionFinished: false));
+                }
+                if (ReportsJournalDirectory != null)
+                {
+                    try
+                    {
+                        FileUtilities.DeleteDirectoryContents(ReportsJournalDirectory, deleteRootDirectory: true);
+                    }
+                    catch (BuildXLException e)
+                    {
+                        LogDebug($"Deleting reports journal directory '{ReportsJournalDirectory}' failed: {e.Message}");
+                    }
+                }
                 Analysis.IgnoreResult(FileUtilities.TryDeleteFile(ReportsFifoPath, waitUntilDeletionFinished: false));
                 Analysis.IgnoreResult(FileUtilities.TryDeleteFile(FamPath, waitUntilDeletionFinished: false));
             }
 
             private void ProcessBytes(byte[] bytes)
             {
-                // Format:
-                //   "%s|%d|%d|%d|%d|%d|%d|%s\n", __progname, getpid(), access, status, explicitLogging, err, opcode, reportPath
-                string message = Encoding.GetString(bytes).TrimEnd('\n');
-                LogDebug($"Processing message: {message}");
+                if (!TryDecodeReport(bytes, out var report, out var path, out var pathId))
+                {
+                    LogError($"Received a malformed {bytes.Length}-byte access report");
+                    return;
+                }
 
-                // parse message and create AccessReport
-                string[] parts = message.Split(new[] { '|' });
-                Contract.Assert(parts.Length == 8);
-                RequestedAccess access = (RequestedAccess)AssertInt(parts[2]);
-                string path = parts[7];
-                var report = new AccessReport
+                ProcessReport(report, path, pathId);
+            }
+
+            /// <summary>
+            /// Processes a batch of reports decoded by the native report reader (called on one of its threads).
+            /// </summary>
+            internal unsafe void ProcessReportBatch(IntPtr entries, int numEntries)
+            {
+                LogDebug($"Received a batch of {numEntries} reports");
+
+                var entry = (ReportReader.ReportEntry*)entries;
+                for (int i = 0; i < numEntries; i++, entry++)
                 {
-                    Pid = (int)AssertInt(parts[1]),
-                    PipId = Process.PipId,
-                    RequestedAccess = (uint)access,
-                    Status = AssertInt(parts[3]),
-                    ExplicitLogging = AssertInt(parts[4]),
-                    Error = AssertInt(parts[5]),
-                    Operation = (FileOperation) AssertInt(parts[6]),
-                    PathOrPipStats = Encoding.GetBytes(path),
-                };
+                    // the native memory is only valid for the duration of the callback
+                    var pathBytes = new byte[entry->PathLength];
+                    Marshal.Copy(entry->Path, pathBytes, 0, pathBytes.Length);
+                    var report = new AccessReport
+                    {
+                        ExplicitLogging = (uint)(entry->Flags & ReportFlagReportExplicitly),
+                        Operation = (FileOperation)entry->Operation,
+                        Pid = entry->Pid,
+                        PipId = Process.PipId,
+                        RequestedAccess = entry->RequestedAccess,
+                        Status = entry->Status,
+                        Error = entry->Error,
+                        PathOrPipStats = pathBytes,
+                    };
+
+                    ProcessReport(report, Encoding.GetString(pathBytes), entry->PathId);
+                }
+            }
+
+            /// <summary>
+            /// Called (on one of the native report reader's threads) once the native report reader has closed this pip's FIFO.
+            /// </summary>
+            internal void OnReportReaderChannelClosed(int error, int numMalformed, int numIncomplete, int numSpilled)
+            {
+                try
+                {
+                    if (numSpilled > 0)
+                    {
+                        LogDebug($"Read {numSpilled} spilled write(s) from the journals in '{ReportsJournalDirectory}'");
+                    }
+
+                    if (error != 0)
+                    {
+                        LogError($"Read from FIFO {ReportsFifoPath} failed with errno {error}");
+                    }
+
+                    if (numMalformed > 0)
+                    {
+                        LogError($"Received {numMalformed} malformed access report(s) through FIFO {ReportsFifoPath}");
+                    }
+
+                    if (numIncomplete > 0)
+                    {
+                        LogError($"FIFO {ReportsFifoPath} was closed while {numIncomplete} report(s) were only partially received");
+                    }
+
+                    // the native reader delivers the journals' reports before closing the channel
+                    PostHeldExitReports();
+                    PostProcessTreeCompleted();
+                }
+                finally
+                {
+                    m_reportReaderChannelClosed.Set();
+                }
+            }
+
+            private void ProcessReport(AccessReport report, string path, uint pathId)
+            {
+                var access = (RequestedAccess)report.RequestedAccess;
+                var message = $"{report.Pid}|{report.RequestedAccess}|{report.Status}|{report.ExplicitLogging}|{report.Error}|{(int)report.Operation}|{path}";
+                LogDebug($"Processing message: {message}");
 
                 // update active processes
                 if (report.Operation == FileOperation.OpProcessStart)
                 {
                     AddPid(report.Pid);
                 }
-                else if (report.Operation == FileOperation.OpProcessExit)
+                else if (report.Operation == FileOperation.OpProcessExit || report.Operation == FileOperation.OpProcessBreakaway)
                 {
+                    // a process that broke away from the sandbox sends no more reports (nor does any of its descendants)
                     RemovePid(report.Pid);
+
+                    // reports the process spilled to its journal are only received once the FIFO has been closed (which this may cause)
+                    if (ReportsJournalDirectory != null)
+                    {
+                        m_heldExitReports.Add((report, pathId));
+                        return;
+                    }
                 }
                 else
                 {
@@ -230,20 +595,85 @@ namespace BuildXL.Processes
                 }
 
                 // post the AccessReport
-                Process.PostAccessReport(report);
+                Process.PostAccessReport(report, pathId);
             }
 
-            private uint AssertInt(string str)
+            /// <summary>
+            /// Decodes a binary access report record (the format is defined in Public/Src/Sandbox/Linux/ReportFormat.hpp).
+            /// </summary>
+            /// <remarks>
+            /// Layout (little-endian):
+            ///   u8 version | u8 flags | u16 operation | i32 pid | u32 access | u32 status | u32 error | u32 pathLength | path (UTF-8)
+            /// A front-coded report has 'u32 producerId | u16 prefixLength | u8 slot | u8 reserved' right before the path, which is then
+            /// only the suffix of the full path past the first prefixLength bytes of the path in the given slot of the same pid and producer;
+            /// the full path then replaces the path in that slot.
+            /// A report with a path id has 'u32 pathId' right before the path (after the front-coding fields, if any); the id is
+            /// returned through <paramref name="pathId"/> (0 if there is none).
+            /// Must be called on reports in the order in which they were received.
+            /// </remarks>
+            private bool TryDecodeReport(byte[] bytes, out AccessReport report, out string path, out uint pathId)
             {
-                if (uint.TryParse(str, out uint result))
+                report = default;
+                path = null;
+                pathId = 0;
+
+                if (bytes.Length < ReportHeaderSize || bytes[0] != ReportFormatVersion)
                 {
-                    return result;
+                    return false;
+                }
+
+                bool isFrontCoded = (bytes[1] & ReportFlagFrontCoded) != 0;
+                bool hasPathId = (bytes[1] & ReportFlagHasPathId) != 0;
+                int pathOffset = ReportHeaderSize + (isFrontCoded ? FrontCodingSize : 0) + (hasPathId ? PathIdSize : 0);
+                int pathLength = BitConverter.ToInt32(bytes, 20);
+                if (pathLength < 0 || bytes.Length < pathOffset || pathOffset + pathLength != bytes.Length)
+                {
+                    return false;
+                }
+
+                byte[] pathBytes;
+                if (isFrontCoded)
+                {
+                    var key = (pid: BitConverter.ToInt32(bytes, 4), producerId: BitConverter.ToUInt32(bytes, 24));
+                    int prefixLength = BitConverter.ToUInt16(bytes, 28);
+                    int slot = bytes[30];
+                    if (!m_frontCodingSlots.TryGetValue(key, out var slots))
+                    {
+                        slots = new byte[FrontCodingNumSlots][];
+                        m_frontCodingSlots.Add(key, slots);
+                    }
+
+                    if (slot >= FrontCodingNumSlots || prefixLength > (slots[slot]?.Length ?? 0))
+                    {
+                        return false;
+                    }
+
+                    pathBytes = new byte[prefixLength + pathLength];
+                    Array.Copy(slots[slot] ?? pathBytes, pathBytes, prefixLength);
+                    Array.Copy(bytes, pathOffset, pathBytes, prefixLength, pathLength);
+                    slots[slot] = pathBytes;
                 }
                 else
                 {
-                    LogError($"Could not parse int from '{str}'");
-                    return 0;
+                    pathBytes = new byte[pathLength];
+                    Array.Copy(bytes, pathOffset, pathBytes, 0, pathLength);
                 }
+
+                path = Encoding.GetString(pathBytes);
+                pathId = hasPathId ? BitConverter.ToUInt32(bytes, pathOffset - PathIdSize) : 0;
+                report = new AccessReport
+                {
+                    ExplicitLogging = (uint)(bytes[1] & ReportFlagReportExplicitly),
+                    Operation = (FileOperation)BitConverter.ToUInt16(bytes, 2),
+                    Pid = BitConverter.ToInt32(bytes, 4),
+                    PipId = Process.PipId,
+                    RequestedAccess = BitConverter.ToUInt32(bytes, 8),
+                    Status = BitConverter.ToUInt32(bytes, 12),
+                    Error = BitConverter.ToUInt32(bytes, 16),
+                    PathOrPipStats = pathBytes,
+                };
+
+                return true;
             }
 
             private static int Read(SafeFileHandle handle, byte[] buffer, int offset, int length)
@@ -265,6 +695,100 @@ namespace BuildXL.Processes
             }
 
             private void StartReceivingAccessReports()
+            {
+                // action block where parsing and processing of received bytes is offloaded (so that the read loop below is as tight as possible)
+                var actionBlock = new ActionBlock<byte[]>(ProcessBytes, new ExecutionDataflowBlockOptions
+                {
+                    BoundedCapacity = DataflowBlockOptions.Unbounded,
+                    MaxDegreeOfParallelism = 1,
+                    EnsureOrdered = true
+                });
+
+                if (m_ring != IntPtr.Zero)
+                {
+                    ReceiveFromRing(actionBlock);
+                }
+                else
+                {
+                    ReceiveFromFifo(actionBlock);
+                    ReceiveFromJournals(actionBlock);
+                }
+
+                // complete action block and wait for it to finish
+                actionBlock.Complete();
+                actionBlock.Completion.GetAwaiter().GetResult();
+
+                PostHeldExitReports();
+                PostProcessTreeCompleted();
+            }
+
+            /// <summary>
+            /// Posts the process exit and breakaway reports held back while the journals had not been received yet.
+            /// </summary>
+            private void PostHeldExitReports()
+            {
+                foreach (var (report, pathId) in m_heldExitReports)
+                {
+                    Process.PostAccessReport(report, pathId);
+                }
+
+                m_heldExitReports.Clear();
+            }
+
+            private void PostProcessTreeCompleted()
+            {
+                var report = new AccessReport
+                {
+                    Operation = FileOperation.OpProcessTreeCompleted,
+                    PathOrPipStats = AccessReport.EncodePath("")
+                };
+                Process.PostAccessReport(report);
+            }
+
+            private void ReceiveFromRing(ActionBlock<byte[]> actionBlock)
+            {
+                LogDebug($"Reading from ring '{ReportsRingPath}'");
+
+                var buffer = new byte[ReportRing.MaxRecordLength];
+                DateTime? drainDeadline = null;
+                while (true)
+                {
+                    var numRead = ReportRing.Read(m_ring, buffer, buffer.Length, RingReadTimeoutMs);
+                    if (numRead > 0)
+                    {
+                        LogDebug($"Received a {numRead}-byte message");
+                        var messageBytes = new byte[numRead];
+                        Array.Copy(buffer, messageBytes, numRead);
+                        actionBlock.Post(messageBytes);
+                        continue;
+                    }
+
+                    if (numRead < 0)
+                    {
+                        LogError($"Read from ring {ReportsRingPath} failed: record does not fit into a {buffer.Length}-byte buffer");
+                        continue;
+                    }
+
+                    if (!m_stopRequested)
+                    {
+                        continue;
+                    }
+
+                    if (ReportRing.IsDrained(m_ring))
+                    {
+                        break;
+                    }
+
+                    drainDeadline ??= DateTime.UtcNow + RingDrainTimeout;
+                    if (DateTime.UtcNow > drainDeadline)
+                    {
+                        LogError($"Ring {ReportsRingPath} still contains uncommitted records {RingDrainTimeout.TotalSeconds}s after all processes exited");
+                        break;
+                    }
+                }
+            }
+
+            private void ReceiveFromFifo(ActionBlock<byte[]> actionBlock)
             {
                 var fifoName = ReportsFifoPath;
 
@@ -280,14 +804,6 @@ namespace BuildXL.Processes
                 // make sure that m_lazyWriteHandle has been created
                 Analysis.IgnoreResult(m_lazyWriteHandle.Value);
 
-                // action block where parsing and processing of received bytes is offloaded (so that the read loop below is as tight as possible)
-                var actionBlock = new ActionBlock<byte[]>(ProcessBytes, new ExecutionDataflowBlockOptions
-                {
-                    BoundedCapacity = DataflowBlockOptions.Unbounded,
-                    MaxDegreeOfParallelism = 1,
-                    EnsureOrdered = true
-                });
-
                 while (true)
                 {
                     // read length
@@ -305,7 +821,8 @@ namespace BuildXL.Processes
                     }
 
                     // decode length
-                    int messageLength = BitConverter.ToInt32(messageLengthBytes, startIndex: 0);
+                    uint prefix = BitConverter.ToUInt32(messageLengthBytes, startIndex: 0);
+                    int messageLength = (int)(prefix & ~FragmentFlag);
 
                     // read a message of that length
                     byte[] messageBytes = new byte[messageLength];
@@ -318,21 +835,156 @@ namespace BuildXL.Processes
 
                     LogDebug($"Received a {numRead}-byte message");
 
+                    // a report that did not fit into one frame is received in fragments
+                    if ((prefix & FragmentFlag) != 0 && !TryAddFragment(messageBytes, out messageBytes))
+                    {
+                        continue;
+                    }
+
                     // Add message to processing queue
                     actionBlock.Post(messageBytes);
                 }
 
-                // complete action block and wait for it to finish
-                actionBlock.Complete();
-                actionBlock.Completion.GetAwaiter().GetResult();
+                // the rest of a report whose first fragments came through the FIFO may have been spilled to a journal
+                if (m_pendingFragments.Count > 0 && ReportsJournalDirectory == null)
+                {
+                    LogError($"FIFO {ReportsFifoPath} was closed while {m_pendingFragments.Count} report(s) were only partially received");
+                    m_pendingFragments.Clear();
+                }
+            }
 
-                // report process tree completed 
-                var report = new AccessReport
+            /// <summary>
+            /// Receives the reports that the sandboxed processes spilled to their journals (see ReportJournal in
+            /// Public/Src/Sandbox/Linux/ReportFormat.hpp).  Must be called once the FIFO has been closed, when every
+            /// journal is complete.
+            /// </summary>
+            /// <remarks>
+            /// Layout of a journal entry (little-endian): u64 sequence | u32 length | u32 reserved | frames (as written to the FIFO)
+            /// Entries are received in the order of their sequence numbers (entries of a journal are in that order already), after
+            /// everything received through the FIFO: the frames of the FIFO carry no sequence numbers to merge the two by.
+            /// The process exit and breakaway reports received through the FIFO are posted after these (see <see cref="PostHeldExitReports"/>).
+            /// </remarks>
+            private void ReceiveFromJournals(ActionBlock<byte[]> actionBlock)
+            {
+                if (ReportsJournalDirectory == null)
                 {
-                    Operation = FileOperation.OpProcessTreeCompleted,
-                    PathOrPipStats = AccessReport.EncodePath("")
-                };
-                Process.PostAccessReport(report);
+                    return;
+                }
+
+                var entries = new List<(ulong sequence, byte[] journal, int offset, int length)>();
+                var journalPaths = Directory.Exists(ReportsJournalDirectory)
+                    ? Directory.EnumerateFiles(ReportsJournalDirectory, "*.journal")
+                    : Enumerable.Empty<string>();
+                foreach (var journalPath in journalPaths)
+                {
+                    byte[] journal = File.ReadAllBytes(journalPath);
+                    int offset = 0;
+                    while (offset < journal.Length)
+                    {
+                        int length = journal.Length - offset >= JournalEntryHeaderSize ? BitConverter.ToInt32(journal, offset + 8) : -1;
+                        if (length < 0 || length > journal.Length - offset - JournalEntryHeaderSize)
+                        {
+                            LogError($"Journal {journalPath} ends with a malformed entry at offset {offset}");
+                            break;
+                        }
+
+                        entries.Add((BitConverter.ToUInt64(journal, offset), journal, offset + JournalEntryHeaderSize, length));
+                        offset += JournalEntryHeaderSize + length;
+                    }
+                }
+
+                LogDebug($"Received {entries.Count} spilled write(s) from the journals in '{ReportsJournalDirectory}'");
+
+                // OrderBy is a stable sort
+                foreach (var entry in entries.OrderBy(e => e.sequence))
+                {
+                    // an entry holds whole frames
+                    int offset = entry.offset;
+                    int end = entry.offset + entry.length;
+                    while (end - offset >= sizeof(uint))
+                    {
+                        uint prefix = BitConverter.ToUInt32(entry.journal, offset);
+                        int messageLength = (int)(prefix & ~FragmentFlag);
+                        if (messageLength > end - offset - sizeof(uint))
+                        {
+                            break;
+                        }
+
+                        byte[] messageBytes = new byte[messageLength];
+                        Array.Copy(entry.journal, offset + sizeof(uint), messageBytes, 0, messageLength);
+                        offset += sizeof(uint) + messageLength;
+
+                        if ((prefix & FragmentFlag) != 0 && !TryAddFragment(messageBytes, out messageBytes))
+                        {
+                            continue;
+                        }
+
+                        actionBlock.Post(messageBytes);
+                    }
+
+                    if (offset != end)
+                    {
+                        LogError($"Received a malformed {entry.length}-byte spilled write");
+                    }
+                }
+
+                if (m_pendingFragments.Count > 0)
+                {
+                    LogError($"Journals in {ReportsJournalDirectory} ended while {m_pendingFragments.Count} report(s) were only partially received");
+                    m_pendingFragments.Clear();
+                }
+            }
+
+            /// <summary>
+            /// Adds a fragment frame (see ReportFraming in Public/Src/Sandbox/Linux/ReportFormat.hpp) to the report it belongs to.
+            /// Returns true (and the reassembled report in <paramref name="record"/>) when this was the last fragment of the report.
+            /// </summary>
+            /// <remarks>
+            /// Layout of a fragment frame (little-endian): i32 pid | u32 messageId | u16 index | u16 flags | chunk
+            /// </remarks>
+            private bool TryAddFragment(byte[] frame, out byte[] record)
+            {
+                record = null;
+                if (frame.Length < FragmentHeaderSize)
+                {
+                    LogError($"Received a malformed {frame.Length}-byte report fragment");
+                    return false;
+                }
+
+                var key = (pid: BitConverter.ToInt32(frame, 0), messageId: BitConverter.ToUInt32(frame, 4));
+                ushort index = BitConverter.ToUInt16(frame, 8);
+                bool isLast = (BitConverter.ToUInt16(frame, 10) & LastFragmentFlag) != 0;
+
+                if (!m_pendingFragments.TryGetValue(key, out var pending))
+                {
+                    pending = new PendingRecord();
+                    m_pendingFragments.Add(key, pending);
+                }
+
+                // fragments of a report are written in order by a single thread, so they must arrive in order
+                if (index != pending.NextIndex)
+                {
+                    LogError($"Received fragment {index} of report {key.messageId} from process {key.pid}; expected fragment {pending.NextIndex}");
+                    m_pendingFragments.Remove(key);
+                    return false;
+                }
+
+                pending.NextIndex++;
+                pending.Bytes.Write(frame, FragmentHeaderSize, frame.Length - FragmentHeaderSize);
+
+                if (isLast)
+                {
+                    m_pendingFragments.Remove(key);
+                    record = pending.Bytes.ToArray();
+                }
+
+                return isLast;
+            }
+
+            private sealed class PendingRecord
+            {
+                internal ushort NextIndex { get; set; }
+                internal MemoryStream Bytes { get; } = new MemoryStream();
             }
         }
 
@@ -358,6 +1010,23 @@ namespace BuildXL.Processes
 
         private static readonly Encoding Encoding = Encoding.UTF8;
 
+        private const string SharedMemoryDirectory = "/dev/shm";
+
+        private static readonly int s_hostProcessId = System.Diagnostics.Process.GetCurrentProcess().Id;
+
+        /// <summary>Native reader shared by the pips that use it (created on first use)</summary>
+        private readonly Lazy<IntPtr> m_lazyReportReader;
+
+        // the native report reader calls back through these, so they must stay alive as long as the reader does
+        private readonly ReportReader.ReportBatchCallback m_reportBatchCallback;
+        private readonly ReportReader.ChannelClosedCallback m_channelClosedCallback;
+
+        /// <summary>Native process tree monitor shared by the pips that use it (created on first use)</summary>
+        private readonly Lazy<IntPtr> m_lazyProcessTreeMonitor;
+
+        // the native process tree monitor calls back through this, so it must stay alive as long as the monitor does
+        private readonly ProcessTree.TreeCompletedCallback m_treeCompletedCallback;
+
         /// <inheritdoc />
         /// <remarks>Unimportant</remarks>
         public TimeSpan CurrentDrought => TimeSpan.FromSeconds(0);
@@ -367,6 +1036,11 @@ namespace BuildXL.Processes
         {
             IsInTestMode = isInTestMode;
             m_failureCallback = failureCallback;
+            m_reportBatchCallback = OnReportBatch;
+            m_channelClosedCallback = OnChannelClosed;
+            m_lazyReportReader = new Lazy<IntPtr>(() => ReportReader.Create(numWorkers: 0, m_reportBatchCallback, m_channelClosedCallback));
+            m_treeCompletedCallback = OnProcessTreeCompleted;
+            m_lazyProcessTreeMonitor = new Lazy<IntPtr>(() => ProcessTree.CreateMonitor(m_treeCompletedCallback));
 
 #if DEBUG
             BuildXL.Native.Processes.ProcessUtilities.SetNativeConfiguration(true);
@@ -378,6 +1052,63 @@ namespace BuildXL.Processes
         /// <inheritdoc />
         public void ReleaseResources()
         {
+            if (m_lazyReportReader.IsValueCreated && m_lazyReportReader.Value != IntPtr.Zero)
+            {
+                ReportReader.Dispose(m_lazyReportReader.Value);
+            }
+
+            if (m_lazyProcessTreeMonitor.IsValueCreated && m_lazyProcessTreeMonitor.Value != IntPtr.Zero)
+            {
+                ProcessTree.DisposeMonitor(m_lazyProcessTreeMonitor.Value);
+            }
+        }
+
+        private void OnReportBatch(long pipId, IntPtr entries, int numEntries)
+        {
+            // this is called on a native thread, so no exception may escape
+            if (m_pipProcesses.TryGetValue(pipId, out var info))
+            {
+                try
+                {
+                    info.ProcessReportBatch(entries, numEntries);
+                }
+                catch (Exception e)
+                {
+                    info.LogError($"Processing a batch of {numEntries} access reports failed: {e}");
+                }
+            }
+        }
+
+        private void OnChannelClosed(long pipId, int error, int numMalformed, int numIncomplete, int numSpilled)
+        {
+            // this is called on a native thread, so no exception may escape
+            if (m_pipProcesses.TryGetValue(pipId, out var info))
+            {
+                try
+                {
+                    info.OnReportReaderChannelClosed(error, numMalformed, numIncomplete, numSpilled);
+                }
+                catch (Exception e)
+                {
+                    info.LogError($"Completing the processing of access reports failed: {e}");
+                }
+            }
+        }
+
+        private void OnProcessTreeCompleted(long pipId)
+        {
+            // this is called on a native thread, so no exception may escape
+            if (m_pipProcesses.TryGetValue(pipId, out var info))
+            {
+                try
+                {
+                    info.OnProcessTreeCompleted();
+                }
+                catch (Exception e)
+                {
+                    info.LogError($"Completing the process tree failed: {e}");
+                }
+            }
         }
 
         /// <summary>
@@ -407,6 +1138,42 @@ namespace BuildXL.Processes
             // TODO: the ROOT_PID env var is a temporary solution for breakway processes
             yield return ("__BUILDXL_ROOT_PID", info.Process.ProcessId.ToString());
             yield return ("__BUILDXL_FAM_PATH", info.FamPath);
+            if (info.FamMemfdPath != null)
+            {
+                yield return ("__BUILDXL_FAM_MEMFD_PATH", info.FamMemfdPath);
+            }
+            if (info.ReportsRingPath != null)
+            {
+                yield return ("__BUILDXL_REPORTS_RING_PATH", info.ReportsRingPath);
+            }
+            if (info.BatchAccessReports)
+            {
+                yield return ("__BUILDXL_BATCH_REPORTS", "1");
+            }
+            if (info.FrontCodeReportPaths)
+            {
+                yield return ("__BUILDXL_FRONT_CODE_PATHS", "1");
+            }
+            if (info.CompilePolicyIndex)
+            {
+                yield return ("__BUILDXL_COMPILE_POLICY_INDEX", "1");
+            }
+            if (info.TranslatePaths)
+            {
+                yield return ("__BUILDXL_TRANSLATE_PATHS", "1");
+            }
+            if (info.DedupTablePath != null)
+            {
+                yield return ("__BUILDXL_DEDUP_TABLE_PATH", info.DedupTablePath);
+            }
+            if (info.ProcessTreePath != null)
+            {
+                yield return ("__BUILDXL_PROCESS_TREE_PATH", info.ProcessTreePath);
+            }
+            if (info.ReportsJournalDirectory != null)
+            {
+                yield return ("__BUILDXL_REPORTS_JOURNAL_DIR", info.ReportsJournalDirectory);
+            }
             yield return ("LD_PRELOAD", DetoursLibFile);
             if (IsInTestMode)
             {
@@ -430,6 +1197,7 @@ namespace BuildXL.Processes
             }
 
             // serialize FAM
+            byte[] manifestPayload;
             using (var wrapper = Pools.MemoryStreamPool.GetInstance())
             {
                 var debugFlags = true;
@@ -441,11 +1209,26 @@ namespace BuildXL.Processes
                     debugFlagsMatch: ref debugFlags);
 
                 Contract.Assert(manifestBytes.Offset == 0);
-                File.WriteAllBytes(famPath, manifestBytes.ToArray());
+                manifestPayload = manifestBytes.ToArray();
+                File.WriteAllBytes(famPath, manifestPayload);
             }
 
             process.LogDebug($"Saved FAM to '{famPath}'");
 
+            // create a shared memory ring when requested (falling back to a FIFO if that fails)
+            if (fam.UseSharedMemoryReportTransport)
+            {
+                string ringPath = Path.Combine(SharedMemoryDirectory, $"bxl.Pip{process.PipSemiStableHash:X}.{process.ProcessId}.ring");
+                IntPtr ring = ReportRing.Create(ringPath, capacity: 0);
+                if (ring != IntPtr.Zero)
+                {
+                    process.LogDebug($"Created report ring at '{ringPath}'");
+                    return StartReceiving(new Info(m_failureCallback, process, fifoPath, famPath, ringPath, ring), fam, manifestPayload);
+                }
+
+                process.LogDebug($"Creating report ring at '{ringPath}' failed with errno {Marshal.GetLastWin32Error()}; falling back to a FIFO");
+            }
+
             // create a FIFO (named pipe)
             if (IO.MkFifo(fifoPath, IO.FilePermissions.S_IRWXU) != 0)
             {
@@ -455,19 +1238,110 @@ namespace BuildXL.Processes
 
             process.LogDebug($"Created FIFO at '{fifoPath}'");
 
-            // create and save info for this pip
-            var info = new Info(m_failureCallback, process, fifoPath, famPath);
-            if (!m_pipProcesses.TryAdd(process.PipId, info))
+            var info = new Info(m_failureCallback, process, fifoPath, famPath) { BatchAccessReports = fam.BatchAccessReports };
+
+            // create the directory for the overflow journals when requested (if that fails, the processes block on a full FIFO)
+            if (fam.SpillReportsToJournal)
             {
-                throw new BuildXLException($"Process with PidId {process.PipId} already exists");
+                string journalDirectory = Path.ChangeExtension(fifoPath, ".journal");
+                try
+                {
+                    Directory.CreateDirectory(journalDirectory);
+                    process.LogDebug($"Created reports journal directory at '{journalDirectory}'");
+                    info.SetReportsJournalDirectory(journalDirectory);
+                }
+                catch (Exception e) when (e is IOException || e is UnauthorizedAccessException)
+                {
+                    process.LogDebug($"Creating reports journal directory at '{journalDirectory}' failed: {e.Message}; blocking on a full FIFO");
+                }
+            }
+            if (fam.UseNativeReportReader)
+            {
+                if (m_lazyReportReader.Value != IntPtr.Zero)
+                {
+                    info.SetReportReader(m_lazyReportReader.Value, fam.BuildAccessSetNatively);
+                }
+                else
+                {
+                    process.LogDebug("Creating the native report reader failed; reading reports with a dedicated thread");
+                }
             }
 
-            info.Start();
-            return true;
+            return StartReceiving(info, fam, manifestPayload);
 
             AbsolutePath toAbsPath(string path) => AbsolutePath.Create(process.PathTable, path);
         }
 
+        private bool StartReceiving(Info info, FileAccessManifest fam, byte[] manifestPayload)
+        {
+            // put the manifest in a memfd when requested (if that fails, the sandboxed processes read the manifest's file)
+            if (fam.ShareManifestThroughMemfd)
+            {
+                var process = info.Process;
+                int fd = ManifestMemfd.Create($"bxl.Pip{process.PipSemiStableHash:X}.{process.ProcessId}.fam", manifestPayload, (ulong)manifestPayload.Length);
+                if (fd != -1)
+                {
+                    string memfdPath = $"/proc/{s_hostProcessId}/fd/{fd}";
+                    process.LogDebug($"Created manifest memfd at '{memfdPath}'");
+                    info.SetFamMemfd(memfdPath, fd);
+                }
+                else
+                {
+                    process.LogDebug($"Creating manifest memfd failed with errno {Marshal.GetLastWin32Error()}; the processes read '{info.FamPath}'");
+                }
+            }
+
+            // create a shared memory dedup table when requested (if that fails, every access is reported)
+            if (fam.DeduplicateAccessReports)
+            {
+                var process = info.Process;
+                string tablePath = Path.Combine(SharedMemoryDirectory, $"bxl.Pip{process.PipSemiStableHash:X}.{process.ProcessId}.dedup");
+                IntPtr table = AccessDedupTable.Create(tablePath, capacity: 0);
+                if (table != IntPtr.Zero)
+                {
+                    process.LogDebug($"Created access dedup table at '{tablePath}'");
+                    info.SetDedupTable(tablePath, table);
+                }
+                else
+                {
+                    process.LogDebug($"Creating access dedup table at '{tablePath}' failed with errno {Marshal.GetLastWin32Error()}; reporting every access");
+                }
+            }
+
+            // create a shared memory process tree when requested (if that fails, processes are only tracked through their reports);
+            // when child processes may break away, they are only tracked through their reports (a process that breaks away
+            // never marks itself exited in the table)
+            if (fam.TrackProcessTreeInSharedMemory && !fam.ProcessesCanBreakaway)
+            {
+                var process = info.Process;
+                string treePath = Path.Combine(SharedMemoryDirectory, $"bxl.Pip{process.PipSemiStableHash:X}.{process.ProcessId}.tree");
+                IntPtr monitor = m_lazyProcessTreeMonitor.Value;
+                IntPtr tree = monitor != IntPtr.Zero ? ProcessTree.Create(treePath, capacity: 0, process.ProcessId) : IntPtr.Zero;
+                if (tree != IntPtr.Zero)
+                {
+                    process.LogDebug($"Created process tree at '{treePath}'");
+                    info.SetProcessTree(treePath, tree, monitor);
+                }
+                else
+                {
+                    process.LogDebug($"Creating process tree at '{treePath}' failed (monitor created: {monitor != IntPtr.Zero}, errno: {Marshal.GetLastWin32Error()})");
+                }
+            }
+
+            info.FrontCodeReportPaths = fam.FrontCodeReportPaths;
+            info.CompilePolicyIndex = fam.CompilePolicyIndex;
+            info.TranslatePaths = fam.TranslatePathsInSandbox;
+
+            // save info for this pip
+            if (!m_pipProcesses.TryAdd(info.Process.PipId, info))
+            {
+                throw new BuildXLException($"Process with PidId {info.Process.PipId} already exists");
+            }
+
+            info.Start();
+            return true;
+        }
+
         /// <inheritdoc />
         public void NotifyPipProcessTerminated(long pipId, int processId)
         {
@@ -176,9 +176,14 @@ namespace BuildXL.Processes
         /// <summary>
         /// An alternative to <see cref="ReportLineReceived(string)"/> for reporting file accesses
         /// </summary>
-        public bool ReportFileAccess<T>(ref T accessReport, FileAccessReportProvider<T> parser)
+        /// <remarks>
+        /// <paramref name="manifestPathIsReportedPath"/> indicates that the sandbox found the manifest record of exactly the reported
+        /// path, in which case the manifest path returned by <paramref name="parser"/> is used as the path of the access without looking
+        /// the reported path up in the path table.
+        /// </remarks>
+        public bool ReportFileAccess<T>(ref T accessReport, FileAccessReportProvider<T> parser, bool manifestPathIsReportedPath = false)
         {
-            var result = FileAccessReportLineReceived(ref accessReport, parser, isAnAugmentedFileAccess: false, out var errorMessage);
+            var result = FileAccessReportLineReceived(ref accessReport, parser, isAnAugmentedFileAccess: false, manifestPathIsReportedPath, out var errorMessage);
             if (!result)
             {
                 MessageProcessingFailure = CreateMessageProcessingFailure(errorMessage);
@@ -249,7 +254,7 @@ namespace BuildXL.Processes
             switch (reportType)
             {
                 case ReportType.FileAccess:
-                if (!FileAccessReportLineReceived(ref data, FileAccessReportLine.TryParse, isAnAugmentedFileAccess: false, out errorMessage))
+                if (!FileAccessReportLineReceived(ref data, FileAccessReportLine.TryParse, isAnAugmentedFileAccess: false, manifestPathIsReportedPath: false, out errorMessage))
                 {
                     MessageProcessingFailure = CreateMessageProcessingFailure(data, errorMessage);
                     return false;
@@ -280,7 +285,7 @@ namespace BuildXL.Processes
                 }
                 break;
                 case ReportType.AugmentedFileAccess:
-                if (!FileAccessReportLineReceived(ref data, TryParseAugmentedFileAccess, isAnAugmentedFileAccess: true, out errorMessage))
+                if (!FileAccessReportLineReceived(ref data, TryParseAugmentedFileAccess, isAnAugmentedFileAccess: true, manifestPathIsReportedPath: false, out errorMessage))
                 {
                     MessageProcessingFailure = CreateMessageProcessingFailure(data, errorMessage);
                     return false;
@@ -612,7 +617,7 @@ namespace BuildXL.Processes
             return result;
         }
 
-        private bool FileAccessReportLineReceived<T>(ref T data, FileAccessReportProvider<T> parser, bool isAnAugmentedFileAccess, out string errorMessage)
+        private bool FileAccessReportLineReceived<T>(ref T data, FileAccessReportProvider<T> parser, bool isAnAugmentedFileAccess, bool manifestPathIsReportedPath, out string errorMessage)
         {
             Contract.Assume(!IsFrozen, "FileAccessReportLineReceived: !IsFrozen");
 
@@ -671,9 +676,13 @@ namespace BuildXL.Processes
                 return true;
             }
 
-            if (m_manifest.DirectoryTranslator != null)
+            // the Linux sandbox may have translated the path already (translating it again could move it further)
+            if (m_manifest.DirectoryTranslator != null && !(m_manifest.TranslatePathsInSandbox && OperatingSystemHelper.IsLinuxOS))
             {
                 path = m_manifest.DirectoryTranslator.Translate(path);
+
+                // the manifest record was found for the path before it was translated
+                manifestPathIsReportedPath = false;
             }
 
             // If we are getting a message for ChangedReadWriteToReadAccess operation,
@@ -729,7 +738,18 @@ namespace BuildXL.Processes
 
             // For exact matches (i.e., not a scope rule), the manifest path is the same as the full path.
             // In that case we don't want to keep carrying around the giant string.
-            if (AbsolutePath.TryGet(m_pathTable, path, out AbsolutePath finalPath) && finalPath == manifestPath)
+            AbsolutePath finalPath;
+            if (manifestPathIsReportedPath && manifestPath.IsValid)
+            {
+#if DEBUG
+                Contract.Assert(
+                    AbsolutePath.TryGet(m_pathTable, path, out AbsolutePath reportedPath) && reportedPath == manifestPath,
+                    I($"The manifest path '{manifestPath.ToString(m_pathTable)}' is not the reported path '{path}'"));
+#endif
+                finalPath = manifestPath;
+                path = null;
+            }
+            else if (AbsolutePath.TryGet(m_pathTable, path, out finalPath) && finalPath == manifestPath)
             {
                 path = null;
             }
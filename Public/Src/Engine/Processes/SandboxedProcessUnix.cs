@@ -49,7 +49,7 @@ namespace BuildXL.Processes
 
         private readonly SandboxedProcessReports m_reports;
 
-        private readonly ActionBlock<AccessReport> m_pendingReports;
+        private readonly ActionBlock<ReceivedAccessReport> m_pendingReports;
 
         private readonly CancellableTimedAction m_perfCollector;
         private readonly PerfAggregator m_perfAggregator;
@@ -166,7 +166,7 @@ namespace BuildXL.Processes
                 MaxDegreeOfParallelism = 1 // Must be one, otherwise SandboxedPipExecutor will fail asserting valid reports
             };
             
-            m_pendingReports = new ActionBlock<AccessReport>(HandleAccessReport, executionOptions);
+            m_pendingReports = new ActionBlock<ReceivedAccessReport>(HandleAccessReport, executionOptions);
 
             // install a 'ProcessStarted' handler that informs the sandbox of the newly started process
             ProcessStarted += (pid) => OnProcessStartedAsync(info).GetAwaiter().GetResult();
@@ -406,9 +406,33 @@ namespace BuildXL.Processes
         /// <summary>
         /// Must not be blocking and should return as soon as possible
         /// </summary>
-        internal void PostAccessReport(AccessReport report)
+        /// <remarks>
+        /// <paramref name="pathId"/> is the id of the manifest record (the value of its <see cref="AbsolutePath"/>) that matched the
+        /// reported path exactly, or 0 when the policy of the path came from a record of one of its ancestors (or the sandbox
+        /// does not send such ids).
+        /// </remarks>
+        internal void PostAccessReport(AccessReport report, uint pathId = 0)
         {
-            m_pendingReports.Post(report);
+            m_pendingReports.Post(new ReceivedAccessReport(report, pathId));
+        }
+
+        /// <summary>
+        /// An access report and the id of the manifest record that matched its path exactly (see <see cref="PostAccessReport"/>).
+        /// </summary>
+        /// <remarks>
+        /// Only the Linux sandbox sends path ids (in its own report format), so the id is not part of <see cref="AccessReport"/>,
+        /// whose layout the macOS sandboxes share.
+        /// </remarks>
+        private readonly struct ReceivedAccessReport
+        {
+            public readonly AccessReport Report;
+            public readonly uint PathId;
+
+            public ReceivedAccessReport(AccessReport report, uint pathId)
+            {
+                Report = report;
+                PathId = pathId;
+            }
         }
 
         private void NotifyPipTerminated(long pipId, IEnumerable<ReportedProcess> survivingChildProcesses)
@@ -616,8 +640,9 @@ namespace BuildXL.Processes
             }
         }
 
-        private void HandleAccessReport(AccessReport report)
+        private void HandleAccessReport(ReceivedAccessReport receivedReport)
         {
+            var report = receivedReport.Report;
             if (ShouldReportFileAccesses)
             {
                 LogProcessState("Access report received: " + AccessReportToString(report));
@@ -693,14 +718,19 @@ namespace BuildXL.Processes
                     }
                     m_pendingReports.Complete();
                 }
+                else if (report.Operation == FileOperation.OpProcessBreakaway)
+                {
+                    // nothing the process (or any of its descendants) accesses from now on is observed
+                    LogProcessState($"Process {report.Pid} broke away from the sandbox: {reportPath}");
+                }
                 else
                 {
-                    ReportFileAccess(ref report);
+                    ReportFileAccess(ref report, receivedReport.PathId);
                 }
             }
         }
 
-        private void ReportFileAccess(ref AccessReport report)
+        private void ReportFileAccess(ref AccessReport report, uint pathId = 0)
         {
             if (ReportsCompleted())
             {
@@ -714,7 +744,8 @@ namespace BuildXL.Processes
                 return;
             }
 
-            m_reports.ReportFileAccess(ref report, ReportProvider);
+            var receivedReport = new ReceivedAccessReport(report, pathId);
+            m_reports.ReportFileAccess(ref receivedReport, ReportProvider, manifestPathIsReportedPath: pathId != 0);
         }
 
         /// <summary>
@@ -764,11 +795,12 @@ namespace BuildXL.Processes
         private static readonly int s_maxRequestedAccess = Enum.GetValues(typeof(RequestedAccess)).Cast<RequestedAccess>().Max(e => (int)e);
 
         private bool ReportProvider(
-            ref AccessReport report, out uint processId, out ReportedFileOperation operation, out RequestedAccess requestedAccess, out FileAccessStatus status,
+            ref ReceivedAccessReport receivedReport, out uint processId, out ReportedFileOperation operation, out RequestedAccess requestedAccess, out FileAccessStatus status,
             out bool explicitlyReported, out uint error, out Usn usn, out DesiredAccess desiredAccess, out ShareMode shareMode, out CreationDisposition creationDisposition,
             out FlagsAndAttributes flagsAndAttributes, out AbsolutePath manifestPath, out string path, out string enumeratePattern, out string processArgs, out string errorMessage)
         {
             var errorMessages = new List<string>();
+            var report = receivedReport.Report;
             checked
             {
                 processId = (uint)report.Pid;
@@ -803,7 +835,16 @@ namespace BuildXL.Processes
                 enumeratePattern    = string.Empty;
                 processArgs         = string.Empty;
 
-                AbsolutePath.TryCreate(PathTable, path, out manifestPath);
+                // A path that matched a manifest record exactly comes with the id of that record, which saves parsing and
+                // interning the path; the id is only missing for paths whose policy comes from a record of an ancestor.
+                if (receivedReport.PathId != 0)
+                {
+                    manifestPath = new AbsolutePath(unchecked((int)receivedReport.PathId));
+                }
+                else
+                {
+                    AbsolutePath.TryCreate(PathTable, path, out manifestPath);
+                }
 
                 errorMessage = errorMessages.Any()
                     ? $"Illegal access report: '{AccessReportToString(report)}' :: {string.Join(";", errorMessages)}"
@@ -108,9 +108,6 @@ namespace Test.BuildXL.Processes
         [Fact]
         public void BreakawayProcessIsNotDetoured()
         {
-            // TODO: doesn't currently work on Linux
-            if (OperatingSystemHelper.IsLinuxOS) return;
-
             var fam = new FileAccessManifest(
                 Context.PathTable,
                 childProcessesToBreakawayFromSandbox: new[] { TestProcessToolName })
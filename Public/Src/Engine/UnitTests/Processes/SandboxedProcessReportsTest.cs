@@ -8,10 +8,14 @@ using BuildXL.Processes;
 using BuildXL.Native.IO;
 using BuildXL.Utilities;
 using System;
+using System.IO;
+using System.Linq;
+using System.Threading.Tasks;
+using Test.BuildXL.Executables.TestProcess;
 
 namespace Test.BuildXL.Processes
 {
-    public class SandboxedProcessReportsTest : XunitBuildXLTest
+    public class SandboxedProcessReportsTest : SandboxedProcessTestBase
     {
         public SandboxedProcessReportsTest(ITestOutputHelper output) : base(output)
         {
@@ -91,5 +95,211 @@ namespace Test.BuildXL.Processes
             XAssert.AreEqual("*", enumeratePattern);
             XAssert.AreEqual("some args\r\n", processArgs);
         }
+
+        [FactIfSupported(requiresUnixBasedOperatingSystem: true)]
+        public async Task SharedMemoryReportTransportReportsTheSameAccesses()
+        {
+            await AssertSameReportsAsync(fam => fam.UseSharedMemoryReportTransport = true);
+        }
+
+        [FactIfSupported(requiresUnixBasedOperatingSystem: true)]
+        public async Task BatchedAccessReportsReportTheSameAccesses()
+        {
+            await AssertSameReportsAsync(fam => fam.BatchAccessReports = true);
+        }
+
+        [FactIfSupported(requiresUnixBasedOperatingSystem: true)]
+        public async Task DeduplicatedAccessReportsReportTheSameAccesses()
+        {
+            await AssertSameReportsAsync(fam => fam.DeduplicateAccessReports = true);
+        }
+
+        [FactIfSupported(requiresUnixBasedOperatingSystem: true)]
+        public async Task NativeReportReaderReportsTheSameAccesses()
+        {
+            await AssertSameReportsAsync(fam => fam.UseNativeReportReader = true);
+        }
+
+        [FactIfSupported(requiresUnixBasedOperatingSystem: true)]
+        public async Task NativeAccessSetReportsTheSameAccesses()
+        {
+            await AssertSameReportsAsync(fam =>
+            {
+                fam.UseNativeReportReader = true;
+                fam.BuildAccessSetNatively = true;
+            });
+        }
+
+        [FactIfSupported(requiresUnixBasedOperatingSystem: true)]
+        public async Task SharedProcessTreeTableReportsTheSameAccesses()
+        {
+            await AssertSameReportsAsync(fam => fam.TrackProcessTreeInSharedMemory = true);
+        }
+
+        [FactIfSupported(requiresUnixBasedOperatingSystem: true)]
+        public async Task FrontCodedReportPathsReportTheSameAccesses()
+        {
+            await AssertSameReportsAsync(fam => fam.FrontCodeReportPaths = true);
+        }
+
+        [FactIfSupported(requiresUnixBasedOperatingSystem: true)]
+        public async Task ReportJournalReportsTheSameAccesses()
+        {
+            await AssertSameReportsAsync(fam => fam.SpillReportsToJournal = true);
+        }
+
+        [FactIfSupported(requiresUnixBasedOperatingSystem: true)]
+        public async Task PolicyIndexLooksUpTheSamePolicies()
+        {
+            // the accesses are under cone and node policies (see RunAndSummarizeAsync), whose statuses and explicit reporting must not change
+            await AssertSameReportsAsync(fam => fam.CompilePolicyIndex = true);
+        }
+
+        [FactIfSupported(requiresUnixBasedOperatingSystem: true)]
+        public async Task ManifestSharedThroughMemfdReportsTheSameAccesses()
+        {
+            await AssertSameReportsAsync(fam => fam.ShareManifestThroughMemfd = true);
+        }
+
+        [FactIfSupported(requiresUnixBasedOperatingSystem: true)]
+        public async Task LinuxNativeManifestLayoutReportsTheSameAccesses()
+        {
+            await AssertSameReportsAsync(fam => fam.UseLinuxNativeLayout = true);
+        }
+
+        [FactIfSupported(requiresUnixBasedOperatingSystem: true)]
+        public async Task PathsTranslatedInSandboxMatchTheHostsTranslation()
+        {
+            await AssertSameReportsAsync(fam => fam.TranslatePathsInSandbox = true, translateDirectories: true);
+        }
+
+        /// <summary>
+        /// Runs the same process tree with the default manifest and with a manifest <paramref name="enableOption"/> changed, and checks that
+        /// both runs report the same processes and, per path, the same accesses (see <see cref="RunAndSummarizeAsync"/>).
+        /// </summary>
+        /// <remarks>
+        /// When <paramref name="translateDirectories"/> is set, the manifests of both runs translate the directory the processes work in.
+        /// </remarks>
+        private async Task AssertSameReportsAsync(Action<FileAccessManifest> enableOption, bool translateDirectories = false)
+        {
+            var defaultRun = await RunAndSummarizeAsync(_ => { }, translateDirectories);
+            var optionRun = await RunAndSummarizeAsync(enableOption, translateDirectories);
+
+            XAssert.AreEqual(defaultRun.processes, optionRun.processes);
+            XAssert.AreEqual(defaultRun.accesses, optionRun.accesses);
+        }
+
+        /// <summary>
+        /// Runs a process (and a child of it) that reads, probes, enumerates and writes files under a fresh directory, and summarizes
+        /// what was reported: the names of the processes, and for each path under the directory (relative to it) the union of the
+        /// accesses reported for it, whether any of them was denied and whether any of them was explicitly reported.
+        /// </summary>
+        /// <remarks>
+        /// The union of the accesses is closed over the accesses they imply (a write implies a read, a read implies a probe), because
+        /// an option may legitimately drop the reports that add nothing to the ones sent before them (see <see cref="FileAccessManifest.DeduplicateAccessReports"/>).
+        /// The files are covered by a cone policy, a node policy and a scope that does not allow writes, so that the reports of all of
+        /// them go through a policy lookup; when the directories are translated, the same policies are set on both sides of the translation,
+        /// since the sandbox may look a path up either before or after translating it (see <see cref="FileAccessManifest.TranslatePathsInSandbox"/>).
+        /// </remarks>
+        private async Task<(string processes, string accesses)> RunAndSummarizeAsync(Action<FileAccessManifest> configure, bool translateDirectories)
+        {
+            AbsolutePath root = CreateUniqueDirectory(ObjectRoot, "reports");
+            AbsolutePath work = Combine(root, "work");
+            AbsolutePath translated = Combine(root, "translated");
+
+            var coneInput = FileArtifact.CreateSourceFile(Combine(work, "src", "cone-input"));
+            var nodeInput = FileArtifact.CreateSourceFile(Combine(work, "src", "node-input"));
+            var absentInput = FileArtifact.CreateSourceFile(Combine(work, "src", "absent-input"));
+            var output = FileArtifact.CreateOutputFile(Combine(work, "out", "output"));
+            var deniedOutput = FileArtifact.CreateOutputFile(Combine(work, "denied", "output"));
+            WriteSourceFile(coneInput);
+            WriteSourceFile(nodeInput);
+            Directory.CreateDirectory(Combine(work, "out").ToString(Context.PathTable));
+            Directory.CreateDirectory(Combine(work, "denied").ToString(Context.PathTable));
+
+            DirectoryTranslator translator = null;
+            if (translateDirectories)
+            {
+                translator = new DirectoryTranslator();
+                translator.AddTranslation(work.ToString(Context.PathTable), translated.ToString(Context.PathTable));
+                translator.Seal();
+            }
+
+            var fam = new FileAccessManifest(Context.PathTable, translator)
+            {
+                FailUnexpectedFileAccesses = false,
+                ReportUnexpectedFileAccesses = true,
+                ReportFileAccesses = true
+            };
+
+            foreach (AbsolutePath directory in translateDirectories ? new[] { work, translated } : new[] { work })
+            {
+                fam.AddScope(directory, FileAccessPolicy.MaskNothing, FileAccessPolicy.AllowRead | FileAccessPolicy.AllowReadIfNonexistent | FileAccessPolicy.ReportAccess);
+                fam.AddPath(Combine(directory, "src", "node-input"), values: FileAccessPolicy.AllowRead, mask: ~FileAccessPolicy.ReportAccess);
+                fam.AddScope(Combine(directory, "out"), FileAccessPolicy.MaskNothing, FileAccessPolicy.AllowAll | FileAccessPolicy.ReportAccess);
+                fam.AddScope(Combine(directory, "denied"), FileAccessPolicy.MaskAll, FileAccessPolicy.AllowRead | FileAccessPolicy.ReportAccess);
+            }
+
+            configure(fam);
+
+            var info = ToProcessInfo(
+                ToProcess(
+                    Operation.ReadFile(coneInput),
+                    Operation.Probe(absentInput),
+                    Operation.EnumerateDir(DirectoryArtifact.CreateWithZeroPartialSealId(Combine(work, "src"))),
+                    Operation.WriteFile(output),
+                    Operation.ReadFile(output),
+                    Operation.WriteFile(deniedOutput),
+                    Operation.Spawn(Context.PathTable, true, Operation.ReadFile(nodeInput), Operation.ReadFile(coneInput))),
+                fileAccessManifest: fam);
+
+            var result = await RunProcess(info);
+            if (result.ExitCode != 0)
+            {
+                XAssert.Fail(
+                    $"Process exited with exit code {result.ExitCode}." +
+                    $"\n\n=== stdout ===\n\n ${result.StandardOutput.ReadValueAsync().Result}" +
+                    $"\n\n=== stderr ===\n\n ${result.StandardError.ReadValueAsync().Result}");
+            }
+
+            XAssert.IsNotNull(result.FileAccesses);
+
+            string rootPrefix = root.ToString(Context.PathTable) + Path.DirectorySeparatorChar;
+            var accesses = result.FileAccesses
+                .Select(access => (path: access.GetPath(Context.PathTable), access))
+                .Where(reported => reported.path.StartsWith(rootPrefix, StringComparison.Ordinal))
+                .GroupBy(reported => reported.path.Substring(rootPrefix.Length), reported => reported.access, StringComparer.Ordinal)
+                .OrderBy(group => group.Key, StringComparer.Ordinal)
+                .Select(group =>
+                    $"{group.Key}: {WithImpliedAccesses(group.Aggregate(RequestedAccess.None, (union, access) => union | access.RequestedAccess))}" +
+                    $", denied: {group.Any(access => access.Status == FileAccessStatus.Denied)}" +
+                    $", explicit: {group.Any(access => access.ExplicitlyReported)}")
+                .ToList();
+
+            // two runs that reported nothing under the directory would compare equal
+            string outputPath = $"{(translateDirectories ? "translated" : "work")}{Path.DirectorySeparatorChar}out{Path.DirectorySeparatorChar}output: ";
+            XAssert.IsTrue(accesses.Any(access => access.StartsWith(outputPath, StringComparison.Ordinal)), string.Join(Environment.NewLine, accesses));
+
+            var processes = ExcludeInjectedOnes(result.Processes)
+                .Select(process => Path.GetFileName(process.Path))
+                .OrderBy(name => name, StringComparer.Ordinal);
+
+            return (string.Join(", ", processes), string.Join(Environment.NewLine, accesses));
+        }
+
+        private static RequestedAccess WithImpliedAccesses(RequestedAccess access)
+        {
+            if ((access & RequestedAccess.Write) != 0)
+            {
+                access |= RequestedAccess.Read;
+            }
+
+            if ((access & RequestedAccess.Read) != 0)
+            {
+                access |= RequestedAccess.Probe;
+            }
+
+            return access;
+        }
     }
 }
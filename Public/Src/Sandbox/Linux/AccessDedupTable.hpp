@@ -0,0 +1,366 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <atomic>
+
+#define BxlAccessDedupTableMagic   0x50444442 // 'BDDP'
+#define BxlAccessDedupTableVersion 2
+
+// Default number of slots of an access dedup table (must be a power of 2)
+#define BxlAccessDedupTableDefaultCapacity (1 << 16)
+
+// Bytes of path storage per slot (the storage is sparse, so only the part holding paths takes up memory)
+#define BxlAccessDedupTablePathBytesPerSlot 256
+
+// Number of counter stripes (must be a power of 2); spreads counter updates of different processes across cache lines
+#define BxlAccessDedupTableNumStripes 16
+
+/**
+ * Counters of an access dedup table.  Each stripe is updated by a subset of the processes
+ * of the pip; the host sums up all the stripes.
+ */
+struct AccessDedupCounters
+{
+    // lookups that found all of the requested accesses already recorded (i.e., the report was suppressed)
+    alignas(64) std::atomic<uint64_t> hits;
+
+    // lookups that did not (i.e., the report was sent)
+    std::atomic<uint64_t> misses;
+
+    // sent reports that could not be recorded because no slot or path storage was left
+    std::atomic<uint64_t> overflows;
+};
+
+/**
+ * Header of an access dedup table.  The header is placed at the beginning of a shared memory
+ * file (typically in /dev/shm) and is immediately followed by 'capacity' slots and then by
+ * 'pathsCapacity' bytes of path storage.
+ */
+struct AccessDedupTableHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+
+    // number of slots that may be claimed before the table is considered full
+    uint64_t maxEntries;
+
+    // size of the path storage
+    uint64_t pathsCapacity;
+
+    alignas(64) std::atomic<uint64_t> numEntries;
+
+    // bytes of the path storage handed out so far
+    std::atomic<uint64_t> pathsUsed;
+
+    AccessDedupCounters counters[BxlAccessDedupTableNumStripes];
+};
+
+/**
+ * A slot of an access dedup table.  'key' (the hash of the slot's path) is 0 while the slot is free;
+ * once claimed, a slot is never freed or reassigned to a different path.  'path' is 0 until the
+ * claiming process has copied the path into the path storage, after which it is the offset of the
+ * copy plus 1 (or 'kNoPath' if there was no room left for it).  'access' only ever gains bits.
+ */
+struct AccessDedupSlot
+{
+    static const uint32_t kNoPath = UINT32_MAX;
+
+    std::atomic<uint64_t> key;
+    std::atomic<uint32_t> access;
+    std::atomic<uint32_t> path;
+};
+
+/**
+ * A table of the accesses already reported by the processes of a pip, shared between all the
+ * processes of the pip's process tree and the BuildXL host (which creates the table and reads
+ * its counters).
+ *
+ * The table maps a path to what the host has accumulated for it from the reports sent so far, which,
+ * like PathCacheRecord in SandboxConnectionLinuxDetours.cs, is the union of the accesses implied by
+ * the reported accesses (but not those accesses themselves).  A process consults the table before
+ * sending a report and suppresses the report when all of its requested accesses are in there already,
+ * i.e., exactly when the host would drop the report as a cache hit; it records the report's accesses
+ * only once the report has been written to the report channel, so that a process killed while still
+ * holding a report back never makes other processes suppress it too.
+ *
+ * The table is lock-free: it uses open addressing with linear probing and slots are claimed with a CAS.
+ * Slots are found by the 64-bit hash of their path and then verified against the copy of the path in
+ * the path storage, so a hash collision never makes a report be suppressed.  The sizes are fixed, so when
+ * a path cannot be placed (the table is filled up to 'maxEntries', a path is not found within 'kMaxProbes'
+ * slots, or the path storage is used up) its reports are simply always sent.
+ */
+class AccessDedupTable final
+{
+private:
+
+    static const int kMaxProbes = 64;
+
+    AccessDedupTableHeader *header_;
+    AccessDedupSlot *slots_;
+    size_t mappedSize_;
+    uint64_t mask_;
+
+    AccessDedupTable(void *addr, size_t mappedSize)
+    {
+        header_     = (AccessDedupTableHeader*)addr;
+        slots_      = (AccessDedupSlot*)((char*)addr + SlotsOffset());
+        mappedSize_ = mappedSize;
+        mask_       = header_->capacity - 1;
+    }
+
+    static size_t SlotsOffset()
+    {
+        // keep the slots page-aligned
+        return (sizeof(AccessDedupTableHeader) + 4095) & ~(size_t)4095;
+    }
+
+    // Size of the file of a table with 'capacity' slots and 'pathsCapacity' bytes of path storage
+    static size_t TableSize(uint64_t capacity, uint64_t pathsCapacity)
+    {
+        return SlotsOffset() + capacity * sizeof(AccessDedupSlot) + pathsCapacity;
+    }
+
+    char* Paths() const
+    {
+        return (char*)(slots_ + header_->capacity);
+    }
+
+    // Whether 'slot' holds the copy of 'path' ('length' bytes long); false while the copy is not published yet
+    bool HasPath(const AccessDedupSlot *slot, const char *path, size_t length) const
+    {
+        uint32_t offset = slot->path.load(std::memory_order_acquire);
+        if (offset == 0 || offset == AccessDedupSlot::kNoPath)
+        {
+            return false;
+        }
+
+        const char *copy = Paths() + offset - 1;
+        uint32_t copyLength;
+        memcpy(&copyLength, copy, sizeof(copyLength));
+        return copyLength == length && memcmp(copy + sizeof(copyLength), path, length) == 0;
+    }
+
+    // Copies 'path' into the path storage and publishes the copy in 'slot' (just claimed by the caller)
+    bool PublishPath(AccessDedupSlot *slot, const char *path, size_t length)
+    {
+        uint64_t size = (sizeof(uint32_t) + length + 7) & ~(uint64_t)7;
+        uint64_t offset = header_->pathsUsed.fetch_add(size, std::memory_order_relaxed);
+        if (offset + size > header_->pathsCapacity || offset + 1 >= AccessDedupSlot::kNoPath)
+        {
+            slot->path.store(AccessDedupSlot::kNoPath, std::memory_order_release);
+            return false;
+        }
+
+        uint32_t copyLength = (uint32_t)length;
+        char *copy = Paths() + offset;
+        memcpy(copy, &copyLength, sizeof(copyLength));
+        memcpy(copy + sizeof(copyLength), path, length);
+        slot->path.store((uint32_t)offset + 1, std::memory_order_release);
+        return true;
+    }
+
+    static AccessDedupTable* Map(int fd, size_t size)
+    {
+        void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        return addr == MAP_FAILED ? NULL : new AccessDedupTable(addr, size);
+    }
+
+    /**
+     * FNV-1a hash of the path, mixed with its length.  Never returns 0 (which marks a free slot).
+     */
+    static uint64_t Hash(const char *path, size_t length)
+    {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (size_t i = 0; i < length; i++)
+        {
+            hash ^= (unsigned char)path[i];
+            hash *= 0x100000001b3ULL;
+        }
+
+        hash ^= (uint64_t)length << 48;
+        return hash == 0 ? 1 : hash;
+    }
+
+    /**
+     * Finds the slot of 'path', claiming a free slot for it if it is not in the table yet and 'claim' is true.
+     * Returns NULL if there is no such slot (which includes a slot that another process is still publishing
+     * the path of) or if the table is full.
+     */
+    AccessDedupSlot* Find(const char *path, size_t length, bool claim)
+    {
+        uint64_t key = Hash(path, length);
+        for (int i = 0; i < kMaxProbes; i++)
+        {
+            AccessDedupSlot *slot = &slots_[(key + i) & mask_];
+            uint64_t current = slot->key.load(std::memory_order_acquire);
+            if (current == 0)
+            {
+                if (!claim ||
+                    header_->numEntries.load(std::memory_order_relaxed) >= header_->maxEntries ||
+                    header_->pathsUsed.load(std::memory_order_relaxed) >= header_->pathsCapacity)
+                {
+                    return NULL;
+                }
+
+                if (slot->key.compare_exchange_strong(current, key, std::memory_order_acq_rel))
+                {
+                    header_->numEntries.fetch_add(1, std::memory_order_relaxed);
+                    return PublishPath(slot, path, length) ? slot : NULL;
+                }
+
+                // another process claimed this slot in the meantime, possibly for the same path
+            }
+
+            // a different path with the same hash moves on to the next slot, just like a different hash
+            if (current == key && HasPath(slot, path, length))
+            {
+                return slot;
+            }
+        }
+
+        return NULL;
+    }
+
+public:
+
+    ~AccessDedupTable()
+    {
+        munmap(header_, mappedSize_);
+    }
+
+    /**
+     * Creates a new table with 'capacity' slots at 'path'.  'capacity' must be a power of 2.
+     * Returns NULL (and sets errno) on error.
+     */
+    static AccessDedupTable* Create(const char *path, uint64_t capacity)
+    {
+        if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+        {
+            errno = EINVAL;
+            return NULL;
+        }
+
+        int fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR);
+        if (fd == -1)
+        {
+            return NULL;
+        }
+
+        uint64_t pathsCapacity = capacity * BxlAccessDedupTablePathBytesPerSlot;
+        size_t size = TableSize(capacity, pathsCapacity);
+        AccessDedupTable *table = ftruncate(fd, size) == 0 ? Map(fd, size) : NULL;
+        close(fd);
+
+        if (table == NULL)
+        {
+            unlink(path);
+            return NULL;
+        }
+
+        // a freshly truncated file is zero-filled, so only the constant part of the header needs to be set;
+        // the table is considered full at 75% occupancy to keep probe sequences short
+        table->header_->capacity   = capacity;
+        table->header_->maxEntries = capacity - capacity / 4;
+        table->header_->pathsCapacity = pathsCapacity;
+        table->header_->version    = BxlAccessDedupTableVersion;
+        table->mask_               = capacity - 1;
+        std::atomic_thread_fence(std::memory_order_release);
+        table->header_->magic      = BxlAccessDedupTableMagic;
+        return table;
+    }
+
+    /**
+     * Maps an existing table created by the host from 'fd' (a descriptor of the table's file opened
+     * for reading and writing, which the caller may close afterwards).  Returns NULL on error.
+     *
+     * Only system calls that the sandbox does not interpose are made here.
+     */
+    static AccessDedupTable* Attach(int fd)
+    {
+        off_t size = lseek(fd, 0, SEEK_END);
+        AccessDedupTable *table = size > (off_t)SlotsOffset()
+            ? Map(fd, size)
+            : NULL;
+
+        if (table != NULL &&
+            (table->header_->magic != BxlAccessDedupTableMagic ||
+             table->header_->version != BxlAccessDedupTableVersion ||
+             TableSize(table->header_->capacity, table->header_->pathsCapacity) != table->mappedSize_))
+        {
+            delete table;
+            errno = EINVAL;
+            return NULL;
+        }
+
+        return table;
+    }
+
+    /**
+     * Returns true if every access in 'access' has been recorded for 'path' already (i.e., the access
+     * need not be reported).  Reads the table only, so a repeated access does not make the slot bounce
+     * between processes.
+     *
+     * 'stripe' selects the counters to update; callers should pass a value that differs between processes.
+     */
+    bool Contains(const char *path, size_t length, uint32_t access, unsigned int stripe)
+    {
+        AccessDedupCounters *counters = &header_->counters[stripe & (BxlAccessDedupTableNumStripes - 1)];
+
+        AccessDedupSlot *slot = Find(path, length, /* claim */ false);
+        bool isHit = slot != NULL && (slot->access.load(std::memory_order_relaxed) & access) == access;
+        (isHit ? counters->hits : counters->misses).fetch_add(1, std::memory_order_relaxed);
+        return isHit;
+    }
+
+    /**
+     * Records 'accessClosure' (what the host accumulates for a reported access, see PathCacheRecord) for
+     * 'path'; to be called once the report has been written.  Several processes may have reported the same
+     * access concurrently by then, which the host deduplicates.
+     */
+    void Record(const char *path, size_t length, uint32_t accessClosure, unsigned int stripe)
+    {
+        if (accessClosure == 0)
+        {
+            return;
+        }
+
+        AccessDedupSlot *slot = Find(path, length, /* claim */ true);
+        if (slot == NULL)
+        {
+            header_->counters[stripe & (BxlAccessDedupTableNumStripes - 1)].overflows.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        if ((slot->access.load(std::memory_order_relaxed) & accessClosure) != accessClosure)
+        {
+            slot->access.fetch_or(accessClosure, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Sums up the counters of all the stripes.
+     */
+    void GetCounters(uint64_t *hits, uint64_t *misses, uint64_t *overflows, uint64_t *numEntries) const
+    {
+        *hits = *misses = *overflows = 0;
+        for (int i = 0; i < BxlAccessDedupTableNumStripes; i++)
+        {
+            *hits      += header_->counters[i].hits.load(std::memory_order_relaxed);
+            *misses    += header_->counters[i].misses.load(std::memory_order_relaxed);
+            *overflows += header_->counters[i].overflows.load(std::memory_order_relaxed);
+        }
+
+        *numEntries = header_->numEntries.load(std::memory_order_relaxed);
+    }
+};
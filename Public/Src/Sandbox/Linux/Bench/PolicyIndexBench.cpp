@@ -0,0 +1,228 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+// Microbenchmark of how the policy index splits a path into its components and hashes them (PolicyIndex's
+// PathTokenizer and HashComponent) against how FindFileAccessPolicyInTreeEx does it (GetPartialPathAndRemainder
+// and HashPath), on a distribution of path lengths typical of a build.
+//
+// usage: policyindexbench [file with one absolute path per line]
+//
+// Without a file, paths are generated: 3 to 14 components below a build root, most of them short directory names
+// and the last one a file name (see 'GeneratePaths').  Both ways of splitting a path must find the same components,
+// which is checked before anything is timed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "PolicyIndex.hpp"
+
+#define NumGeneratedPaths 100000
+#define NumRounds         20
+
+class PolicyIndexBenchmark final
+{
+public:
+
+    /*! Same as GetPartialPathAndRemainder (see PolicySearch.cpp), which is private to that file */
+    static size_t ScalarPartialPath(PCPathChar path, size_t length, size_t from, size_t *remainder)
+    {
+        size_t found = from;
+        while (IsDirectorySeparator(path[found]))
+        {
+            found++;
+        }
+
+        for (; found < length && !IsDirectorySeparator(path[found]); found++);
+        *remainder = found < length ? found + 1 : found;
+        return found - from;
+    }
+
+    /*! Splits 'path' the way FindFileAccessPolicyInTreeEx does, hashing every component with HashPath */
+    static uint64_t SplitAndHashScalar(const std::string &path)
+    {
+        uint64_t sum = 0;
+        for (size_t offset = 0; offset < path.length();)
+        {
+            size_t remainder;
+            size_t length = ScalarPartialPath(path.c_str(), path.length(), offset, &remainder);
+            sum += HashPath(path.c_str() + offset, length);
+            offset = remainder;
+        }
+
+        return sum;
+    }
+
+    /*! Splits 'path' the way PolicyIndex::Find does, hashing every component with HashComponent */
+    static uint64_t SplitAndHashIndex(const std::string &path)
+    {
+        uint64_t sum = 0;
+        PolicyIndex::PathTokenizer tokenizer(path.c_str(), path.length());
+        for (size_t offset = 0; offset < path.length();)
+        {
+            size_t remainder;
+            size_t length = tokenizer.GetPartialPathAndRemainder(offset, &remainder);
+            sum += PolicyIndex::HashComponent(path.c_str() + offset, length);
+            offset = remainder;
+        }
+
+        return sum;
+    }
+
+    /*! Whether the tokenizer finds the same components as GetPartialPathAndRemainder */
+    static bool SplitsTheSame(const std::string &path)
+    {
+        PolicyIndex::PathTokenizer tokenizer(path.c_str(), path.length());
+        for (size_t offset = 0; offset < path.length();)
+        {
+            size_t scalarRemainder, indexRemainder;
+            size_t scalarLength = ScalarPartialPath(path.c_str(), path.length(), offset, &scalarRemainder);
+            size_t indexLength = tokenizer.GetPartialPathAndRemainder(offset, &indexRemainder);
+            if (scalarLength != indexLength || scalarRemainder != indexRemainder)
+            {
+                return false;
+            }
+
+            offset = scalarRemainder;
+        }
+
+        return true;
+    }
+};
+
+static std::vector<std::string> GeneratePaths()
+{
+    static const char *directories[] =
+    {
+        "src", "obj", "out", "bin", "lib", "inc", "x64", "Debug", "Release", "include", "common", "internal",
+        "netcoreapp3.1", "Microsoft.Build.Tasks.Core", "BuildXL.Processes", "third_party", "node_modules", "runtimes",
+        "linux-x64", "native", "UnitTests", "generated", "System.Collections.Immutable", "ref", "v1", "detail",
+    };
+
+    static const char *extensions[] = { ".h", ".hpp", ".cpp", ".cs", ".dll", ".o", ".json", ".pdb", ".txt" };
+
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> depth(3, 14);
+    std::uniform_int_distribution<size_t> directory(0, sizeof(directories) / sizeof(directories[0]) - 1);
+    std::uniform_int_distribution<size_t> extension(0, sizeof(extensions) / sizeof(extensions[0]) - 1);
+    std::uniform_int_distribution<int> nameLength(3, 24);
+    std::uniform_int_distribution<int> letter('a', 'z');
+
+    std::vector<std::string> paths;
+    for (int i = 0; i < NumGeneratedPaths; i++)
+    {
+        std::string path = "/home/builder/repo";
+        for (int d = depth(random); d > 0; d--)
+        {
+            path += '/';
+            path += directories[directory(random)];
+        }
+
+        path += '/';
+        for (int n = nameLength(random); n > 0; n--)
+        {
+            path += (char)letter(random);
+        }
+
+        path += extensions[extension(random)];
+        paths.push_back(path);
+    }
+
+    return paths;
+}
+
+static std::vector<std::string> ReadPaths(const char *file)
+{
+    std::vector<std::string> paths;
+    FILE *f = fopen(file, "r");
+    if (f == NULL)
+    {
+        perror(file);
+        exit(1);
+    }
+
+    char line[PATH_MAX + 2];
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        size_t length = strcspn(line, "\n");
+        if (length > 0 && line[0] == '/')
+        {
+            paths.push_back(std::string(line, length));
+        }
+    }
+
+    fclose(f);
+    return paths;
+}
+
+static double NowNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+// best time per path of NumRounds passes over 'paths'
+template<typename TSplitAndHash>
+static double Measure(const std::vector<std::string> &paths, TSplitAndHash splitAndHash, uint64_t *sum)
+{
+    double best = 0;
+    for (int round = 0; round < NumRounds; round++)
+    {
+        double start = NowNs();
+        for (const std::string &path : paths)
+        {
+            *sum += splitAndHash(path);
+        }
+
+        double elapsed = (NowNs() - start) / paths.size();
+        best = round == 0 || elapsed < best ? elapsed : best;
+    }
+
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> paths = argc > 1 ? ReadPaths(argv[1]) : GeneratePaths();
+    if (paths.empty())
+    {
+        fprintf(stderr, "No paths\n");
+        return 1;
+    }
+
+    size_t totalLength = 0, totalComponents = 0;
+    for (const std::string &path : paths)
+    {
+        if (!PolicyIndexBenchmark::SplitsTheSame(path))
+        {
+            fprintf(stderr, "Path split differently: %s\n", path.c_str());
+            return 1;
+        }
+
+        totalLength += path.length();
+        for (char c : path)
+        {
+            totalComponents += IsDirectorySeparator(c) ? 1 : 0;
+        }
+    }
+
+    uint64_t sum = 0;
+    double scalar = Measure(paths, PolicyIndexBenchmark::SplitAndHashScalar, &sum);
+    double index = Measure(paths, PolicyIndexBenchmark::SplitAndHashIndex, &sum);
+
+    printf("%zu paths, %.1f bytes and %.1f components per path on average (checksum %llx)\n",
+        paths.size(), (double)totalLength / paths.size(), (double)totalComponents / paths.size(), (unsigned long long)sum);
+    printf("GetPartialPathAndRemainder + HashPath:  %7.1f ns per path\n", scalar);
+#if defined(__SSE2__)
+    printf("PathTokenizer (SSE2) + HashComponent:   %7.1f ns per path\n", index);
+#else
+    printf("PathTokenizer + HashComponent:          %7.1f ns per path\n", index);
+#endif
+    return 0;
+}
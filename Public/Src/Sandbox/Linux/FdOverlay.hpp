@@ -0,0 +1,341 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <atomic>
+#include <type_traits>
+
+#include "Sandbox.hpp"
+
+// Descriptors at or above this number are not tracked in an fd overlay
+#define BxlFdOverlayCapacity 4096
+
+// Number of kinds of descriptor operations whose access checks an fd overlay remembers
+#define BxlFdOverlayNumEventKinds 8
+
+// Size of an fd overlay entry; paths that do not fit are not tracked
+#define BxlFdOverlayEntrySize 1024
+
+/**
+ * An entry of an fd overlay.
+ *
+ * 'state' packs a version (high 32 bits), bumped by every change to the entry, and the generation of the
+ * overlay the entry was filled in (low 32 bits; 0 while the entry is empty).
+ */
+struct FdOverlayEntry
+{
+    std::atomic<uint32_t> lock;
+
+    // bit 'k' is set when 'checks[k]' holds the access check of an operation of kind 'k'
+    uint32_t checkedKinds;
+
+    std::atomic<uint64_t> state;
+    AccessCheckResult checks[BxlFdOverlayNumEventKinds];
+    uint32_t pathLength;
+
+    // what the descriptor refers to (an absolute path for a file, otherwise, e.g., "pipe:[1234]"); null-terminated
+    char path[1];
+};
+
+/**
+ * Per-descriptor data of a process (the Linux counterpart of HandleOverlay in the Windows sandbox): what each
+ * descriptor refers to and the access checks already made (and reported) for operations on it, so that repeated
+ * operations on a descriptor (e.g., a program writing a file a few KB at a time) need neither a 'readlink' of
+ * /proc/self/fd/N nor a policy lookup.
+ *
+ * An entry is filled in when the process opens or duplicates a descriptor through an interposed function (or
+ * the first time an operation on the descriptor is checked) and cleared when the process closes the descriptor
+ * through an interposed function ('close', 'fclose', 'closedir', or 'dup2', 'dup3', 'close_range' and 'closefrom',
+ * which close descriptors implicitly).  Entries are trusted without checking the descriptors again, so a descriptor
+ * closed without going through any of those (e.g., with a raw syscall) and then reused keeps a stale entry.
+ * Renaming a path invalidates every entry (the path of an open descriptor follows the file it refers to).
+ *
+ * Entries are written under a lock that is only ever tried (an operation that finds an entry locked is a miss),
+ * except for clearing an entry, which never takes the lock: it bumps the entry's version instead, which makes
+ * any concurrent update of the entry (e.g., by a thread racing the close with an operation on the descriptor)
+ * fail.  So the overlay never blocks and is safe to use from a signal handler.  Its memory is mapped on
+ * construction and only touched as descriptors are used.
+ */
+class FdOverlay final
+{
+private:
+
+    static_assert(std::is_trivially_copyable<AccessCheckResult>::value, "access checks are copied as bytes");
+
+    FdOverlayEntry *entries_;
+    std::atomic<uint32_t> generation_;
+
+    static const size_t kMaxPathLength = BxlFdOverlayEntrySize - offsetof(FdOverlayEntry, path) - 1;
+
+    static uint32_t Version(uint64_t state)    { return (uint32_t)(state >> 32); }
+    static uint32_t Generation(uint64_t state) { return (uint32_t)state; }
+    static uint64_t State(uint32_t version, uint32_t generation) { return ((uint64_t)version << 32) | generation; }
+
+    static FdOverlayEntry* MapEntries()
+    {
+        // anonymous memory is zero-filled, i.e., every entry starts out empty and unlocked
+        void *addr = mmap(NULL, (size_t)BxlFdOverlayCapacity * BxlFdOverlayEntrySize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return addr == MAP_FAILED ? NULL : (FdOverlayEntry*)addr;
+    }
+
+    FdOverlayEntry* GetEntry(int fd)
+    {
+        return entries_ != NULL && fd >= 0 && fd < BxlFdOverlayCapacity
+            ? (FdOverlayEntry*)((char*)entries_ + (size_t)fd * BxlFdOverlayEntrySize)
+            : NULL;
+    }
+
+    FdOverlayEntry* TryLock(int fd)
+    {
+        FdOverlayEntry *entry = GetEntry(fd);
+        return entry != NULL && entry->lock.exchange(1, std::memory_order_acquire) == 0 ? entry : NULL;
+    }
+
+    static void Unlock(FdOverlayEntry *entry)
+    {
+        entry->lock.store(0, std::memory_order_release);
+    }
+
+    bool IsCurrent(uint64_t state) const
+    {
+        return Generation(state) != 0 && Generation(state) == generation_.load(std::memory_order_acquire);
+    }
+
+    static void SetFile(FdOverlayEntry *entry, const char *path, size_t length)
+    {
+        memcpy(entry->path, path, length);
+        entry->path[length] = '\0';
+        entry->pathLength   = (uint32_t)length;
+        entry->checkedKinds = 0;
+    }
+
+    /**
+     * Publishes the changes made to a locked entry, unless the entry has changed since its version was 'version'.
+     */
+    bool Publish(FdOverlayEntry *entry, uint32_t version, uint32_t generation)
+    {
+        uint64_t expected = entry->state.load(std::memory_order_acquire);
+        return Version(expected) == version &&
+            entry->state.compare_exchange_strong(expected, State(version + 1, generation), std::memory_order_acq_rel);
+    }
+
+public:
+
+    FdOverlay() : entries_(MapEntries()), generation_(1)
+    {
+    }
+
+    FdOverlay(const FdOverlay&) = delete;
+    FdOverlay& operator = (const FdOverlay&) = delete;
+
+    /**
+     * Current version of the entry of 'fd', which must be read before finding out what the descriptor refers to
+     * and then passed to 'SetCheck' (so that what was found out is dropped if the descriptor is closed meanwhile).
+     */
+    uint32_t GetVersion(int fd)
+    {
+        FdOverlayEntry *entry = GetEntry(fd);
+        return entry != NULL ? Version(entry->state.load(std::memory_order_acquire)) : 0;
+    }
+
+    /**
+     * Copies what 'fd' refers to into 'path' (of 'size' bytes).  Returns the length of the path, or -1 if not known.
+     */
+    ssize_t TryGetPath(int fd, char *path, size_t size)
+    {
+        FdOverlayEntry *entry = TryLock(fd);
+        if (entry == NULL)
+        {
+            return -1;
+        }
+
+        ssize_t length = -1;
+        uint64_t state = entry->state.load(std::memory_order_acquire);
+        if (IsCurrent(state) && entry->pathLength < size)
+        {
+            memcpy(path, entry->path, entry->pathLength + 1);
+            length = entry->pathLength;
+        }
+
+        Unlock(entry);
+        return length;
+    }
+
+    /**
+     * Copies the access check of an operation of kind 'kind' on 'fd' into 'check'.  Returns false if there is none.
+     */
+    bool TryGetCheck(int fd, int kind, AccessCheckResult *check)
+    {
+        FdOverlayEntry *entry = TryLock(fd);
+        if (entry == NULL)
+        {
+            return false;
+        }
+
+        bool found = false;
+        uint64_t state = entry->state.load(std::memory_order_acquire);
+        if (IsCurrent(state) && (entry->checkedKinds & (1u << kind)) != 0)
+        {
+            memcpy((void*)check, &entry->checks[kind], sizeof(AccessCheckResult));
+
+            // an entry cleared concurrently is only ever cleared by bumping its version
+            found = entry->state.load(std::memory_order_acquire) == state;
+        }
+
+        Unlock(entry);
+        return found;
+    }
+
+    /**
+     * Records that 'fd' refers to 'path', forgetting any access checks made for the descriptor.
+     */
+    void Set(int fd, const char *path, size_t length)
+    {
+        if (length > kMaxPathLength)
+        {
+            Clear(fd);
+            return;
+        }
+
+        FdOverlayEntry *entry = TryLock(fd);
+        if (entry == NULL)
+        {
+            Clear(fd);
+            return;
+        }
+
+        uint32_t version = Version(entry->state.load(std::memory_order_acquire));
+        SetFile(entry, path, length);
+        Publish(entry, version, generation_.load(std::memory_order_acquire));
+        Unlock(entry);
+    }
+
+    /**
+     * Records the access check of an operation of kind 'kind' on 'fd', which refers to 'path'; 'version' is what
+     * 'GetVersion' returned before 'path' was found out.
+     */
+    void SetCheck(int fd, uint32_t version, const char *path, size_t length, int kind, const AccessCheckResult &check)
+    {
+        if (length > kMaxPathLength)
+        {
+            return;
+        }
+
+        FdOverlayEntry *entry = TryLock(fd);
+        if (entry == NULL)
+        {
+            return;
+        }
+
+        uint64_t state = entry->state.load(std::memory_order_acquire);
+        if (Version(state) == version)
+        {
+            if (!IsCurrent(state) || entry->pathLength != length || memcmp(entry->path, path, length) != 0)
+            {
+                SetFile(entry, path, length);
+            }
+
+            memcpy((void*)&entry->checks[kind], &check, sizeof(AccessCheckResult));
+            entry->checkedKinds |= 1u << kind;
+            Publish(entry, version, generation_.load(std::memory_order_acquire));
+        }
+
+        Unlock(entry);
+    }
+
+    /**
+     * Records that 'newfd' refers to what 'oldfd' refers to (including the access checks made for 'oldfd').
+     */
+    void Duplicate(int oldfd, int newfd)
+    {
+        if (oldfd == newfd)
+        {
+            return;
+        }
+
+        Clear(newfd);
+
+        FdOverlayEntry *oldEntry = TryLock(oldfd);
+        if (oldEntry == NULL)
+        {
+            return;
+        }
+
+        FdOverlayEntry *newEntry = TryLock(newfd);
+        if (newEntry != NULL)
+        {
+            uint64_t state = oldEntry->state.load(std::memory_order_acquire);
+            uint32_t version = Version(newEntry->state.load(std::memory_order_acquire));
+            if (IsCurrent(state))
+            {
+                size_t dataOffset = offsetof(FdOverlayEntry, checks);
+                memcpy((char*)newEntry + dataOffset, (char*)oldEntry + dataOffset, offsetof(FdOverlayEntry, path) + oldEntry->pathLength + 1 - dataOffset);
+                newEntry->checkedKinds = oldEntry->checkedKinds;
+                Publish(newEntry, version, Generation(state));
+            }
+
+            Unlock(newEntry);
+        }
+
+        Unlock(oldEntry);
+    }
+
+    /**
+     * Forgets what 'fd' refers to.
+     */
+    void Clear(int fd)
+    {
+        FdOverlayEntry *entry = GetEntry(fd);
+        if (entry == NULL)
+        {
+            return;
+        }
+
+        uint64_t state = entry->state.load(std::memory_order_acquire);
+        while (!entry->state.compare_exchange_weak(state, State(Version(state) + 1, 0), std::memory_order_acq_rel));
+    }
+
+    /**
+     * Forgets what descriptors 'first' through 'last' refer to.  Entries of descriptors never used are not touched,
+     * so closing all descriptors (e.g., with close_range) does not populate the whole overlay.
+     */
+    void ClearRange(unsigned int first, unsigned int last)
+    {
+        for (unsigned int fd = first; fd < BxlFdOverlayCapacity && fd <= last; fd++)
+        {
+            FdOverlayEntry *entry = GetEntry((int)fd);
+            if (entry != NULL && entry->state.load(std::memory_order_acquire) != 0)
+            {
+                Clear((int)fd);
+            }
+        }
+    }
+
+    /**
+     * Forgets what every descriptor refers to.
+     */
+    void Invalidate()
+    {
+        generation_.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    /**
+     * Must be called in a forked child.  Entries that other threads of the parent held locked would stay
+     * locked forever (those threads do not exist in the child), and the child's access checks must be
+     * reported under its own pid, so the child starts with a fresh overlay.
+     */
+    void OnForked()
+    {
+        if (entries_ != NULL)
+        {
+            munmap(entries_, (size_t)BxlFdOverlayCapacity * BxlFdOverlayEntrySize);
+        }
+
+        entries_ = MapEntries();
+    }
+};
@@ -0,0 +1,24 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "AccessDedupTable.hpp"
+
+// Host-side entry points of the access dedup table, called from managed code (see AccessDedupTable.cs)
+
+extern "C"
+{
+    AccessDedupTable* BxlAccessDedupTable_Create(const char *path, uint64_t capacity)
+    {
+        return AccessDedupTable::Create(path, capacity == 0 ? BxlAccessDedupTableDefaultCapacity : capacity);
+    }
+
+    void BxlAccessDedupTable_GetCounters(AccessDedupTable *table, uint64_t *hits, uint64_t *misses, uint64_t *overflows, uint64_t *numEntries)
+    {
+        table->GetCounters(hits, misses, overflows, numEntries);
+    }
+
+    void BxlAccessDedupTable_Dispose(AccessDedupTable *table)
+    {
+        delete table;
+    }
+}
@@ -0,0 +1,120 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ReportFormat.hpp"
+#include "ReportReader.hpp"
+
+/**
+ * Folds the file access reports of a pip into a set with one entry per path.
+ *
+ * For every path the set keeps:
+ *   - the union of the requested accesses;
+ *   - the pid of the process that accessed the path first;
+ *   - the path id of the first report that carried one;
+ *   - the operation of the last report that added a requested access (i.e., the report the host's
+ *     path cache would have let through last);
+ *   - a status other than Allowed if any report had one (e.g., Denied);
+ *   - whether any report was to be reported explicitly;
+ *   - the error of the first report, unless some report had none (i.e., whether the path was found to exist).
+ */
+class AccessSetBuilder final
+{
+private:
+
+    // CODESYNC: FileAccessStatus in Public/Src/Windows/DetoursServices/DataTypes.h
+    static const uint32_t kStatusAllowed = 1;
+
+    struct Access
+    {
+        uint16_t operation;
+        uint8_t  flags;
+        int32_t  pid;
+        uint32_t requestedAccess;
+        uint32_t status;
+        uint32_t error;
+        uint32_t pathId;
+    };
+
+    std::unordered_map<std::string, Access> accesses_;
+
+public:
+
+    size_t Size() const { return accesses_.size(); }
+
+    void Add(const ReportRecord &record)
+    {
+        auto result = accesses_.emplace(
+            std::string(record.path, record.pathLength),
+            Access { record.operation, record.flags, record.pid, record.requestedAccess, record.status, record.error, record.pathId });
+        if (result.second)
+        {
+            return;
+        }
+
+        Access &access = result.first->second;
+        if ((access.requestedAccess | record.requestedAccess) != access.requestedAccess)
+        {
+            access.operation = record.operation;
+            access.requestedAccess |= record.requestedAccess;
+        }
+
+        if (record.status != kStatusAllowed)
+        {
+            access.status = record.status;
+        }
+
+        if (record.error == 0)
+        {
+            access.error = 0;
+        }
+
+        if (access.pathId == 0)
+        {
+            access.pathId = record.pathId;
+        }
+
+        access.flags |= record.flags;
+    }
+
+    /**
+     * Appends the entries of the set, sorted by path, to 'entries'.  The paths of the entries
+     * point into this object, so they are valid as long as it is alive and not modified.
+     */
+    void Build(std::vector<ReportEntry> *entries) const
+    {
+        size_t start = entries->size();
+        for (const auto &it : accesses_)
+        {
+            const Access &access = it.second;
+            ReportEntry entry =
+            {
+                .operation       = access.operation,
+                .flags           = access.flags,
+                .reserved        = 0,
+                .pid             = access.pid,
+                .requestedAccess = access.requestedAccess,
+                .status          = access.status,
+                .error           = access.error,
+                .pathLength      = (uint32_t)it.first.size(),
+                .pathId          = access.pathId,
+                .path            = it.first.data(),
+            };
+            entries->push_back(entry);
+        }
+
+        std::sort(entries->begin() + start, entries->end(), [](const ReportEntry &lhs, const ReportEntry &rhs)
+        {
+            int result = memcmp(lhs.path, rhs.path, std::min(lhs.pathLength, rhs.pathLength));
+            return result != 0 ? result < 0 : lhs.pathLength < rhs.pathLength;
+        });
+    }
+};
@@ -0,0 +1,61 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Host-side entry points of the memfds that file access manifests are shared through, called from managed code (see ManifestMemfd.cs)
+
+extern "C"
+{
+    /**
+     * Creates a memfd holding the 'length' bytes of 'payload', sealed so that it can never change again (which is
+     * what the processes of a pip check before mapping it).  Returns the descriptor, or -1 on error (with errno set).
+     */
+    int BxlManifestMemfd_Create(const char *name, const char *payload, uint64_t length)
+    {
+        int fd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (fd == -1)
+        {
+            return -1;
+        }
+
+        uint64_t written = 0;
+        while (written < length)
+        {
+            ssize_t result = write(fd, payload + written, length - written);
+            if (result == -1 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if (result <= 0)
+            {
+                int error = result == -1 ? errno : EIO;
+                close(fd);
+                errno = error;
+                return -1;
+            }
+
+            written += result;
+        }
+
+        if (fcntl(fd, F_ADD_SEALS, F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1)
+        {
+            int error = errno;
+            close(fd);
+            errno = error;
+            return -1;
+        }
+
+        return fd;
+    }
+
+    void BxlManifestMemfd_Dispose(int fd)
+    {
+        close(fd);
+    }
+}
@@ -0,0 +1,59 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "ProcessTreeMonitor.hpp"
+
+// Host-side entry points of process trees and their monitor, called from managed code (see ProcessTree.cs)
+
+extern "C"
+{
+    /**
+     * Creates a tree of up to 'capacity' processes (0 means default) with 'rootPid' registered.  Returns NULL on error.
+     */
+    ProcessTree* BxlProcessTree_Create(const char *path, uint64_t capacity, pid_t rootPid)
+    {
+        return ProcessTree::Create(path, capacity == 0 ? BxlProcessTreeDefaultCapacity : capacity, rootPid);
+    }
+
+    void BxlProcessTree_GetCounters(ProcessTree *tree, int32_t *numActive, uint64_t *numSlots, bool *overflowed)
+    {
+        *numActive  = tree->NumActive();
+        *numSlots   = tree->NumSlots();
+        *overflowed = tree->Overflowed();
+    }
+
+    void BxlProcessTree_Dispose(ProcessTree *tree)
+    {
+        delete tree;
+    }
+
+    /**
+     * Creates a monitor (which starts its own thread).  Returns NULL on error.
+     */
+    ProcessTreeMonitor* BxlProcessTreeMonitor_Create(TreeCompletedCallback onCompleted)
+    {
+        ProcessTreeMonitor *monitor = new ProcessTreeMonitor(onCompleted);
+        if (!monitor->IsValid())
+        {
+            delete monitor;
+            return NULL;
+        }
+
+        return monitor;
+    }
+
+    bool BxlProcessTreeMonitor_AddTree(ProcessTreeMonitor *monitor, int64_t treeId, ProcessTree *tree)
+    {
+        return monitor->AddTree(treeId, tree);
+    }
+
+    bool BxlProcessTreeMonitor_RemoveTree(ProcessTreeMonitor *monitor, int64_t treeId)
+    {
+        return monitor->RemoveTree(treeId);
+    }
+
+    void BxlProcessTreeMonitor_Dispose(ProcessTreeMonitor *monitor)
+    {
+        delete monitor;
+    }
+}
@@ -0,0 +1,245 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
+
+#include "ProcessTreeMonitor.hpp"
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+static int pidfd_open(pid_t pid)
+{
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+}
+
+ProcessTreeMonitor::ProcessTreeMonitor(TreeCompletedCallback onCompleted)
+    : epollFd_(-1), shutdownFd_(-1), onCompleted_(onCompleted)
+{
+    epollFd_    = epoll_create1(EPOLL_CLOEXEC);
+    shutdownFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epollFd_ == -1 || shutdownFd_ == -1)
+    {
+        return;
+    }
+
+    struct epoll_event event = { EPOLLIN, { .ptr = NULL } };
+    if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, shutdownFd_, &event) != 0)
+    {
+        return;
+    }
+
+    thread_ = std::thread(&ProcessTreeMonitor::Run, this);
+}
+
+ProcessTreeMonitor::~ProcessTreeMonitor()
+{
+    if (thread_.joinable())
+    {
+        uint64_t one = 1;
+        ssize_t ignored = write(shutdownFd_, &one, sizeof(one));
+        (void)ignored;
+        thread_.join();
+    }
+
+    // trees that were never completed or removed are dropped without notifying the host
+    for (auto &entry : trees_)
+    {
+        DeleteTree(entry.second);
+    }
+
+    for (Watch *watch : retiredWatches_)
+    {
+        delete watch;
+    }
+
+    if (shutdownFd_ != -1) close(shutdownFd_);
+    if (epollFd_ != -1)    close(epollFd_);
+}
+
+bool ProcessTreeMonitor::AddTree(int64_t treeId, ProcessTree *tree)
+{
+    Tree *entry = new Tree();
+    entry->id       = treeId;
+    entry->tree     = tree;
+    entry->nextSlot = 0;
+
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!trees_.emplace(treeId, entry).second)
+    {
+        delete entry;
+        errno = EEXIST;
+        return false;
+    }
+
+    // the root process may be gone already, so its slot is looked at right away
+    Scan(entry);
+    return true;
+}
+
+bool ProcessTreeMonitor::RemoveTree(int64_t treeId)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    auto it = trees_.find(treeId);
+    if (it == trees_.end())
+    {
+        return false;
+    }
+
+    DeleteTree(it->second);
+    trees_.erase(it);
+    return true;
+}
+
+void ProcessTreeMonitor::Run()
+{
+    const int kMaxEvents = 64;
+    struct epoll_event events[kMaxEvents];
+    std::vector<int64_t> completed;
+
+    while (true)
+    {
+        int numEvents = epoll_wait(epollFd_, events, kMaxEvents, kScanIntervalMs);
+        if (numEvents == -1 && errno != EINTR)
+        {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            for (int i = 0; i < numEvents; i++)
+            {
+                Watch *watch = (Watch*)events[i].data.ptr;
+                if (watch == NULL)
+                {
+                    return;
+                }
+
+                if (watch->tree == NULL)
+                {
+                    continue;
+                }
+
+                // the process is gone; if it did not say so itself (e.g., it was killed), say it on its behalf
+                watch->tree->tree->MarkExited(watch->slot, watch->pid);
+                Unwatch(watch);
+            }
+
+            for (auto it = trees_.begin(); it != trees_.end();)
+            {
+                Tree *tree = it->second;
+                Scan(tree);
+                if (tree->tree->IsCompleted())
+                {
+                    completed.push_back(tree->id);
+                    DeleteTree(tree);
+                    it = trees_.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+
+            for (Watch *watch : retiredWatches_)
+            {
+                delete watch;
+            }
+
+            retiredWatches_.clear();
+        }
+
+        // the callbacks are made without holding the lock, so that they may call back into the monitor
+        for (int64_t treeId : completed)
+        {
+            onCompleted_(treeId);
+        }
+
+        completed.clear();
+    }
+}
+
+void ProcessTreeMonitor::Scan(Tree *tree)
+{
+    for (auto it = tree->unresolvedSlots.begin(); it != tree->unresolvedSlots.end();)
+    {
+        it = WatchSlot(tree, *it) ? tree->unresolvedSlots.erase(it) : it + 1;
+    }
+
+    uint64_t numSlots = tree->tree->NumSlots();
+    for (; tree->nextSlot < numSlots; tree->nextSlot++)
+    {
+        if (!WatchSlot(tree, (int)tree->nextSlot))
+        {
+            tree->unresolvedSlots.push_back((int)tree->nextSlot);
+        }
+    }
+}
+
+bool ProcessTreeMonitor::WatchSlot(Tree *tree, int slot)
+{
+    uint32_t state;
+    pid_t pid = tree->tree->GetProcess(slot, &state);
+    if (state == ProcessTreeSlot::kExited)
+    {
+        return true;
+    }
+
+    if (state == ProcessTreeSlot::kFree || pid == 0)
+    {
+        // the slot is being registered or the process is being forked; the rest is filled in shortly
+        return false;
+    }
+
+    int pidfd = pidfd_open(pid);
+    if (pidfd == -1)
+    {
+        // ESRCH: the process is gone already (ENOSYS, on kernels older than 5.3, leaves it to the process)
+        if (errno == ESRCH)
+        {
+            tree->tree->MarkExited(slot, pid);
+        }
+        return true;
+    }
+
+    Watch *watch = new Watch { tree, slot, pid, pidfd };
+    struct epoll_event event = { EPOLLIN, { .ptr = watch } };
+    if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, pidfd, &event) != 0)
+    {
+        close(pidfd);
+        delete watch;
+        return true;
+    }
+
+    tree->watches.push_back(watch);
+    return true;
+}
+
+void ProcessTreeMonitor::Unwatch(Watch *watch)
+{
+    std::vector<Watch*> &watches = watch->tree->watches;
+    watches.erase(std::remove(watches.begin(), watches.end(), watch), watches.end());
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, watch->pidfd, NULL);
+    close(watch->pidfd);
+    delete watch;
+}
+
+void ProcessTreeMonitor::DeleteTree(Tree *tree)
+{
+    for (Watch *watch : tree->watches)
+    {
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, watch->pidfd, NULL);
+        close(watch->pidfd);
+        watch->tree = NULL;
+        retiredWatches_.push_back(watch);
+    }
+
+    delete tree;
+}
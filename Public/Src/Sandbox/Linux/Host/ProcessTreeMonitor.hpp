@@ -0,0 +1,107 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "ProcessTree.hpp"
+
+/**
+ * Called once every process of a tree has exited.  No other call is made for the tree afterwards.
+ */
+typedef void (*TreeCompletedCallback)(int64_t treeId);
+
+/**
+ * Watches the process trees (see ProcessTree.hpp) of many pips with a single thread and reports
+ * each tree as soon as its last process has exited.
+ *
+ * Processes that exit normally mark themselves exited in their tree.  For every active process
+ * of a tree the monitor also holds a pidfd, which becomes readable when the process is gone, so
+ * that processes that exit without running any code of the sandbox (e.g., when killed by a signal)
+ * are marked exited too.  A pidfd of a process that exited normally also becomes readable, which is
+ * what wakes the monitor up promptly in the common case; processes registered since the last wake-up
+ * are picked up at least every 'kScanIntervalMs' milliseconds.
+ *
+ * A tree that has overflowed is never reported completed (the host falls back to its other ways of
+ * finding out that the pip's processes are done).
+ */
+class ProcessTreeMonitor final
+{
+public:
+
+    static const int kScanIntervalMs = 10;
+
+    ProcessTreeMonitor(TreeCompletedCallback onCompleted);
+    ~ProcessTreeMonitor();
+
+    ProcessTreeMonitor(const ProcessTreeMonitor&) = delete;
+    ProcessTreeMonitor& operator = (const ProcessTreeMonitor&) = delete;
+
+    /**
+     * Whether the monitor was initialized successfully.
+     */
+    bool IsValid() const { return epollFd_ != -1 && thread_.joinable(); }
+
+    /**
+     * Starts watching 'tree', which must stay mapped until the tree is reported completed or 'RemoveTree' is called.
+     * Returns false (and sets errno) on error.
+     */
+    bool AddTree(int64_t treeId, ProcessTree *tree);
+
+    /**
+     * Stops watching a tree.  No callback is made for the tree once this returns.  Returns false if there is no such tree.
+     */
+    bool RemoveTree(int64_t treeId);
+
+private:
+
+    struct Watch;
+
+    struct Tree
+    {
+        int64_t id;
+        ProcessTree *tree;
+
+        // first slot not looked at yet
+        uint64_t nextSlot;
+
+        // slots of processes whose pid was not known yet when they were looked at
+        std::vector<int> unresolvedSlots;
+
+        std::vector<Watch*> watches;
+    };
+
+    struct Watch
+    {
+        // NULL once the tree has been deleted
+        Tree *tree;
+        int slot;
+        pid_t pid;
+        int pidfd;
+    };
+
+    int epollFd_;
+    int shutdownFd_;
+    TreeCompletedCallback onCompleted_;
+    std::thread thread_;
+
+    // guards 'trees_' and everything reachable from it
+    std::mutex lock_;
+    std::unordered_map<int64_t, Tree*> trees_;
+
+    // watches of deleted trees; they are freed by the monitor's thread, which may have just received events for them
+    std::vector<Watch*> retiredWatches_;
+
+    void Run();
+    void Scan(Tree *tree);
+    bool WatchSlot(Tree *tree, int slot);
+    void Unwatch(Watch *watch);
+    void DeleteTree(Tree *tree);
+};
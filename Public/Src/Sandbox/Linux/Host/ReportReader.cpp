@@ -0,0 +1,537 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <algorithm>
+
+#include "AccessSetBuilder.hpp"
+#include "OpNames.hpp"
+#include "ReportReader.hpp"
+
+ReportReader::ReportReader(int numWorkers, ReportBatchCallback onBatch, ChannelClosedCallback onClosed)
+    : epollFd_(-1), shutdownFd_(-1), onBatch_(onBatch), onClosed_(onClosed)
+{
+    lfds711_freelist_init_valid_on_current_logical_core(&freeBuffers_, NULL, 0, NULL);
+
+    epollFd_    = epoll_create1(EPOLL_CLOEXEC);
+    shutdownFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epollFd_ == -1 || shutdownFd_ == -1)
+    {
+        return;
+    }
+
+    // the shutdown event is level-triggered (and never consumed), so that it wakes up every worker
+    struct epoll_event event = { EPOLLIN, { .ptr = NULL } };
+    if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, shutdownFd_, &event) != 0)
+    {
+        return;
+    }
+
+    if (numWorkers <= 0)
+    {
+        numWorkers = (int)std::min(4u, std::max(1u, std::thread::hardware_concurrency()));
+    }
+
+    for (int i = 0; i < numWorkers; i++)
+    {
+        Worker *worker = new Worker();
+        worker->thread = std::thread(&ReportReader::Run, this, worker);
+        workers_.push_back(worker);
+    }
+}
+
+ReportReader::~ReportReader()
+{
+    if (shutdownFd_ != -1)
+    {
+        uint64_t one = 1;
+        ssize_t ignored = write(shutdownFd_, &one, sizeof(one));
+        (void)ignored;
+    }
+
+    for (Worker *worker : workers_)
+    {
+        worker->thread.join();
+        delete worker;
+    }
+
+    // channels that were never closed are dropped without notifying the host
+    for (auto &entry : channels_)
+    {
+        Channel *channel = entry.second;
+        if (channel->writeFd != -1)
+        {
+            close(channel->writeFd);
+        }
+        close(channel->readFd);
+        delete channel->accessSet;
+        delete channel;
+    }
+
+    if (shutdownFd_ != -1) close(shutdownFd_);
+    if (epollFd_ != -1)    close(epollFd_);
+
+    LFDS711_MISC_MAKE_VALID_ON_CURRENT_LOGICAL_CORE_INITS_COMPLETED_BEFORE_NOW_ON_ANY_OTHER_LOGICAL_CORE;
+    lfds711_freelist_cleanup(&freeBuffers_, [](lfds711_freelist_state *, lfds711_freelist_element *elem)
+    {
+        delete (ReadBuffer*)LFDS711_FREELIST_GET_VALUE_FROM_ELEMENT(*elem);
+    });
+}
+
+ReportReader::ReadBuffer* ReportReader::AcquireBuffer()
+{
+    lfds711_freelist_element *elem;
+    if (lfds711_freelist_pop(&freeBuffers_, &elem, NULL))
+    {
+        return (ReadBuffer*)LFDS711_FREELIST_GET_VALUE_FROM_ELEMENT(*elem);
+    }
+
+    ReadBuffer *buffer = new ReadBuffer();
+    LFDS711_FREELIST_SET_VALUE_IN_ELEMENT(buffer->freeListElem, buffer);
+    return buffer;
+}
+
+void ReportReader::ReleaseBuffer(ReadBuffer *buffer)
+{
+    lfds711_freelist_push(&freeBuffers_, &buffer->freeListElem, NULL);
+}
+
+bool ReportReader::AddChannel(int64_t channelId, const char *fifoPath, bool buildAccessSet, const char *journalDir)
+{
+    // opening the read end first makes the non-blocking open of the write end succeed
+    int readFd = open(fifoPath, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (readFd == -1)
+    {
+        return false;
+    }
+
+    int writeFd = open(fifoPath, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if (writeFd == -1)
+    {
+        close(readFd);
+        return false;
+    }
+
+    Channel *channel = new Channel();
+    channel->id           = channelId;
+    channel->readFd       = readFd;
+    channel->writeFd      = writeFd;
+    channel->journalDir   = journalDir != NULL ? journalDir : "";
+    channel->accessSet    = buildAccessSet ? new AccessSetBuilder() : NULL;
+    channel->numMalformed = 0;
+
+    {
+        std::lock_guard<std::mutex> guard(channelsLock_);
+        if (!channels_.emplace(channelId, channel).second)
+        {
+            close(writeFd);
+            close(readFd);
+            delete channel->accessSet;
+            delete channel;
+            errno = EEXIST;
+            return false;
+        }
+    }
+
+    struct epoll_event event = { EPOLLIN | EPOLLONESHOT, { .ptr = channel } };
+    if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, readFd, &event) != 0)
+    {
+        int error = errno;
+        {
+            std::lock_guard<std::mutex> guard(channelsLock_);
+            channels_.erase(channelId);
+        }
+        close(writeFd);
+        close(readFd);
+        delete channel->accessSet;
+        delete channel;
+        errno = error;
+        return false;
+    }
+
+    return true;
+}
+
+bool ReportReader::CloseChannelWriter(int64_t channelId)
+{
+    std::lock_guard<std::mutex> guard(channelsLock_);
+    auto it = channels_.find(channelId);
+    if (it == channels_.end())
+    {
+        return false;
+    }
+
+    Channel *channel = it->second;
+    if (channel->writeFd != -1)
+    {
+        close(channel->writeFd);
+        channel->writeFd = -1;
+    }
+
+    return true;
+}
+
+void ReportReader::Run(Worker *worker)
+{
+    LFDS711_MISC_MAKE_VALID_ON_CURRENT_LOGICAL_CORE_INITS_COMPLETED_BEFORE_NOW_ON_ANY_OTHER_LOGICAL_CORE;
+
+    while (true)
+    {
+        // one event at a time, so that ready channels are spread across all the workers
+        struct epoll_event event;
+        int numEvents = epoll_wait(epollFd_, &event, 1, -1);
+        if (numEvents <= 0)
+        {
+            if (numEvents == -1 && errno != EINTR)
+            {
+                return;
+            }
+            continue;
+        }
+
+        Channel *channel = (Channel*)event.data.ptr;
+        if (channel == NULL)
+        {
+            return;
+        }
+
+        int error = 0;
+        if (Drain(worker, channel, &error))
+        {
+            CloseChannel(worker, channel, error);
+            continue;
+        }
+
+        struct epoll_event rearm = { EPOLLIN | EPOLLONESHOT, { .ptr = channel } };
+        if (epoll_ctl(epollFd_, EPOLL_CTL_MOD, channel->readFd, &rearm) != 0)
+        {
+            CloseChannel(worker, channel, errno);
+        }
+    }
+}
+
+bool ReportReader::Drain(Worker *worker, Channel *channel, int *error)
+{
+    ReadBuffer *readBuffer = AcquireBuffer();
+    char *buffer = readBuffer->data;
+    bool isClosed = false;
+    for (int i = 0; i < kMaxReadsPerDrain; i++)
+    {
+        // an incomplete frame left over from the previous read goes first (it is always shorter than PIPE_BUF)
+        size_t offset = channel->pending.size();
+        if (offset > 0)
+        {
+            memcpy(buffer, channel->pending.data(), offset);
+            channel->pending.clear();
+        }
+
+        ssize_t numRead = read(channel->readFd, buffer + offset, kReadBufferSize - offset);
+        if (numRead <= 0)
+        {
+            channel->pending.assign(buffer, buffer + offset);
+            if (numRead == -1 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if (numRead == -1 && errno == EAGAIN)
+            {
+                break;
+            }
+
+            // EOF (every writer is gone) or a read error
+            *error = numRead == 0 ? 0 : errno;
+            isClosed = true;
+            break;
+        }
+
+        size_t length = offset + numRead;
+        size_t consumed = ParseFrames(worker, channel, buffer, length);
+        channel->pending.assign(buffer + consumed, buffer + length);
+
+        if (!worker->entries.empty())
+        {
+            onBatch_(channel->id, worker->entries.data(), (int)worker->entries.size());
+        }
+
+        worker->entries.clear();
+        worker->records.clear();
+    }
+
+    // the entries handed over point into the buffer, so it is only released once they have been consumed
+    ReleaseBuffer(readBuffer);
+    return isClosed;
+}
+
+size_t ReportReader::ParseFrames(Worker *worker, Channel *channel, const char *data, size_t length)
+{
+    size_t position = 0;
+    while (length - position >= ReportFraming::PrefixSize)
+    {
+        uint32_t prefix;
+        memcpy(&prefix, data + position, ReportFraming::PrefixSize);
+
+        size_t frameLength = prefix & ~ReportFraming::kFragmentFlag;
+        if (frameLength > PIPE_BUF)
+        {
+            // frames are never longer than PIPE_BUF, so the stream is corrupt and cannot be resynchronized
+            channel->numMalformed++;
+            return length;
+        }
+
+        if (length - position - ReportFraming::PrefixSize < frameLength)
+        {
+            break;
+        }
+
+        const char *frame = data + position + ReportFraming::PrefixSize;
+        if ((prefix & ReportFraming::kFragmentFlag) != 0)
+        {
+            AddFragment(worker, channel, frame, frameLength);
+        }
+        else
+        {
+            AddRecord(worker, channel, frame, frameLength);
+        }
+
+        position += ReportFraming::PrefixSize + frameLength;
+    }
+
+    return position;
+}
+
+void ReportReader::AddRecord(Worker *worker, Channel *channel, const char *record, size_t length)
+{
+    ReportRecord decoded;
+    if (!ReportFormat::Decode(record, length, &decoded))
+    {
+        channel->numMalformed++;
+        return;
+    }
+
+    const std::string *fullPath = NULL;
+    if (decoded.IsFrontCoded())
+    {
+        std::string &slot = channel->frontCodingSlots[std::make_pair(decoded.pid, decoded.producerId)][decoded.slot];
+        if (decoded.prefixLength > slot.size())
+        {
+            channel->numMalformed++;
+            return;
+        }
+
+        slot.resize(decoded.prefixLength);
+        slot.append(decoded.path, decoded.pathLength);
+        fullPath = &slot;
+        decoded.path = slot.data();
+        decoded.pathLength = (uint32_t)slot.size();
+        decoded.flags &= ~ReportRecord::kFlagFrontCoded;
+    }
+
+    // the path id has a field of its own in the entry
+    decoded.flags &= ~ReportRecord::kFlagHasPathId;
+
+    if (channel->accessSet != NULL &&
+        decoded.operation != FileOperation::kOpProcessStart &&
+        decoded.operation != FileOperation::kOpProcessExit &&
+        decoded.operation != FileOperation::kOpProcessBreakaway)
+    {
+        channel->accessSet->Add(decoded);
+        return;
+    }
+
+    // the producer's slot changes with its next record, which may be decoded from this same read
+    if (fullPath != NULL)
+    {
+        worker->records.push_back(*fullPath);
+        decoded.path = worker->records.back().data();
+    }
+
+    ReportEntry entry =
+    {
+        .operation       = decoded.operation,
+        .flags           = decoded.flags,
+        .reserved        = 0,
+        .pid             = decoded.pid,
+        .requestedAccess = decoded.requestedAccess,
+        .status          = decoded.status,
+        .error           = decoded.error,
+        .pathLength      = decoded.pathLength,
+        .pathId          = decoded.pathId,
+        .path            = decoded.path,
+    };
+
+    worker->entries.push_back(entry);
+}
+
+void ReportReader::AddFragment(Worker *worker, Channel *channel, const char *frame, size_t length)
+{
+    FragmentHeader header;
+    if (length < sizeof(header))
+    {
+        channel->numMalformed++;
+        return;
+    }
+
+    memcpy(&header, frame, sizeof(header));
+    auto key = std::make_pair(header.pid, header.messageId);
+    auto it = channel->fragments.find(key);
+    if (it == channel->fragments.end())
+    {
+        it = channel->fragments.emplace(key, PendingRecord { 0, std::string() }).first;
+    }
+
+    // fragments of a record are written in order by a single thread, so a gap means a fragment was lost
+    if (header.index != it->second.nextIndex)
+    {
+        channel->numMalformed++;
+        channel->fragments.erase(it);
+        return;
+    }
+
+    it->second.nextIndex++;
+    it->second.data.append(frame + sizeof(header), length - sizeof(header));
+    if ((header.flags & FragmentHeader::kFlagLastFragment) == 0)
+    {
+        return;
+    }
+
+    // the record must outlive this read, as the entry that is handed to the host points into it
+    worker->records.push_back(std::move(it->second.data));
+    channel->fragments.erase(it);
+
+    const std::string &record = worker->records.back();
+    AddRecord(worker, channel, record.data(), record.size());
+}
+
+int ReportReader::DrainJournals(Worker *worker, Channel *channel)
+{
+    DIR *dir = channel->journalDir.empty() ? NULL : opendir(channel->journalDir.c_str());
+    if (dir == NULL)
+    {
+        return 0;
+    }
+
+    // the journals are read whole; the entries handed over point into them
+    struct dirent *dirEntry;
+    while ((dirEntry = readdir(dir)) != NULL)
+    {
+        const char *suffix = strrchr(dirEntry->d_name, '.');
+        if (suffix == NULL || strcmp(suffix, ".journal") != 0)
+        {
+            continue;
+        }
+
+        std::string path = channel->journalDir + "/" + dirEntry->d_name;
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            continue;
+        }
+
+        std::string contents;
+        ReadBuffer *buffer = AcquireBuffer();
+        ssize_t numRead;
+        while ((numRead = read(fd, buffer->data, sizeof(buffer->data))) > 0 || (numRead == -1 && errno == EINTR))
+        {
+            contents.append(buffer->data, numRead > 0 ? numRead : 0);
+        }
+
+        ReleaseBuffer(buffer);
+        close(fd);
+        worker->records.push_back(std::move(contents));
+    }
+
+    closedir(dir);
+
+    struct Spilled
+    {
+        uint64_t sequence;
+        const char *payload;
+        uint32_t length;
+    };
+
+    std::vector<Spilled> spilled;
+    for (const std::string &journal : worker->records)
+    {
+        size_t position = 0;
+        while (position < journal.size())
+        {
+            JournalEntryHeader header;
+            size_t entrySize = ReportJournal::DecodeEntry(journal.data() + position, journal.size() - position, &header);
+            if (entrySize == 0)
+            {
+                channel->numMalformed++;
+                break;
+            }
+
+            spilled.push_back({ header.sequence, journal.data() + position + ReportJournal::EntryHeaderSize, header.length });
+            position += entrySize;
+        }
+    }
+
+    std::stable_sort(spilled.begin(), spilled.end(), [](const Spilled &lhs, const Spilled &rhs)
+    {
+        return lhs.sequence < rhs.sequence;
+    });
+
+    for (const Spilled &entry : spilled)
+    {
+        // an entry holds whole frames
+        if (ParseFrames(worker, channel, entry.payload, entry.length) != entry.length)
+        {
+            channel->numMalformed++;
+        }
+    }
+
+    if (!worker->entries.empty())
+    {
+        onBatch_(channel->id, worker->entries.data(), (int)worker->entries.size());
+    }
+
+    worker->entries.clear();
+    worker->records.clear();
+    return (int)spilled.size();
+}
+
+void ReportReader::CloseChannel(Worker *worker, Channel *channel, int error)
+{
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, channel->readFd, NULL);
+
+    {
+        std::lock_guard<std::mutex> guard(channelsLock_);
+        channels_.erase(channel->id);
+        if (channel->writeFd != -1)
+        {
+            close(channel->writeFd);
+        }
+    }
+
+    close(channel->readFd);
+
+    // every process is done writing, so the journals are complete (unless reading the FIFO failed)
+    int numSpilled = DrainJournals(worker, channel);
+
+    if (channel->accessSet != NULL)
+    {
+        std::vector<ReportEntry> entries;
+        entries.reserve(channel->accessSet->Size());
+        channel->accessSet->Build(&entries);
+        if (!entries.empty())
+        {
+            onBatch_(channel->id, entries.data(), (int)entries.size());
+        }
+        delete channel->accessSet;
+    }
+
+    // a frame cut short by the last writer going away is not a complete record either
+    int numMalformed = channel->numMalformed + (channel->pending.empty() ? 0 : 1);
+    onClosed_(channel->id, error, numMalformed, (int)channel->fragments.size(), numSpilled);
+    delete channel;
+}
@@ -0,0 +1,197 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <array>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "ReportFormat.hpp"
+
+// liblfds is C and its header does not declare C linkage itself
+extern "C"
+{
+#include "liblfds711.h"
+}
+
+class AccessSetBuilder;
+
+/**
+ * A decoded access report handed to the host.  'path' points into memory owned by the
+ * reader and is only valid for the duration of the callback; it is NOT 0-terminated.
+ *
+ * CODESYNC: ReportReader.ReportEntry in Public/Src/Utilities/Interop/MacOS/ReportReader.cs
+ */
+struct ReportEntry
+{
+    uint16_t operation;
+    uint8_t  flags;
+    uint8_t  reserved;
+    int32_t  pid;
+    uint32_t requestedAccess;
+    uint32_t status;
+    uint32_t error;
+    uint32_t pathLength;
+    // id of the manifest record matching the path exactly, or 0 (see ReportRecord)
+    uint32_t pathId;
+    const char *path;
+};
+
+static_assert(sizeof(ReportEntry) == 40, "ReportEntry is shared with managed code");
+
+/**
+ * Called with the reports decoded from one read from a channel.  Calls for the same channel
+ * are never made concurrently and are made in the order in which the reports were read.
+ */
+typedef void (*ReportBatchCallback)(int64_t channelId, const ReportEntry *entries, int numEntries);
+
+/**
+ * Called once a channel has been closed, i.e., after the host has closed its write end (see
+ * 'CloseChannelWriter') and every sandboxed process has closed its own.  No batch callback
+ * is made for the channel afterwards.
+ *
+ * 'error' is 0 or the errno of a failed read, 'numMalformed' is the number of records that could
+ * not be decoded, 'numIncomplete' is the number of records of which only some fragments arrived,
+ * and 'numSpilled' is the number of writes that were read from overflow journals (see ReportJournal).
+ */
+typedef void (*ChannelClosedCallback)(int64_t channelId, int error, int numMalformed, int numIncomplete, int numSpilled);
+
+/**
+ * Reads the access reports of many pips, each received through its own FIFO (a "channel"),
+ * with a small pool of worker threads multiplexing all the channels with epoll.
+ *
+ * A worker reads whatever is available from a channel in reads of up to 'kReadBufferSize' bytes
+ * into a buffer taken from a lock-free free list (see AcquireBuffer), decodes the frames (see ReportFraming) and reassembles fragmented records,
+ * and hands all the reports decoded from one read to 'ReportBatchCallback' at once.  Channels are
+ * registered with EPOLLONESHOT, so a channel is only ever read by one worker at a time and is re-armed
+ * after it has been drained.
+ *
+ * Front-coded records (see ReportFormat) are expanded to full paths before they are handed over.
+ *
+ * A channel may also be set up to fold its file access reports into a set with one entry per path
+ * (see AccessSetBuilder), which is handed to 'ReportBatchCallback' as the last batch of the channel,
+ * right before the channel is reported closed.  Process start and exit reports are still handed over
+ * as they are read, because the host tracks the processes of the pip with them.
+ *
+ * The reports that sandboxed processes spilled to overflow journals (see ReportJournal) are read once
+ * the FIFO of their channel has been closed, and are handed over (or folded into the access set) before
+ * the channel is reported closed.
+ */
+class ReportReader final
+{
+public:
+
+    static const size_t kReadBufferSize = 64 * 1024;
+
+    // Maximum number of reads from one channel before a worker moves on to another ready channel
+    static const int kMaxReadsPerDrain = 16;
+
+    ReportReader(int numWorkers, ReportBatchCallback onBatch, ChannelClosedCallback onClosed);
+    ~ReportReader();
+
+    ReportReader(const ReportReader&) = delete;
+    ReportReader& operator = (const ReportReader&) = delete;
+
+    /**
+     * Whether the reader was initialized successfully.
+     */
+    bool IsValid() const { return epollFd_ != -1 && !workers_.empty(); }
+
+    /**
+     * Starts reading from the FIFO at 'fifoPath' (which must already exist).  The host keeps a write end
+     * of the FIFO open until 'CloseChannelWriter' is called, so the channel is not closed before then even
+     * if no sandboxed process has opened the FIFO yet.  When 'buildAccessSet' is set, file access reports
+     * are folded into an access set delivered when the channel is closed.  'journalDir' is the directory of the
+     * overflow journals of the channel, or NULL if the sandboxed processes do not spill.  Returns false (and sets
+     * errno) on error.
+     */
+    bool AddChannel(int64_t channelId, const char *fifoPath, bool buildAccessSet, const char *journalDir);
+
+    /**
+     * Closes the host's write end of a channel; the channel is closed once all the other writers are gone.
+     * Returns false if there is no such channel.
+     */
+    bool CloseChannelWriter(int64_t channelId);
+
+private:
+
+    struct PendingRecord
+    {
+        uint16_t nextIndex;
+        std::string data;
+    };
+
+    struct Channel
+    {
+        int64_t id;
+        int readFd;
+
+        // the host's write end (-1 once closed); guarded by 'channelsLock_'
+        int writeFd;
+
+        // directory of the overflow journals (empty when there are none)
+        std::string journalDir;
+
+        // bytes of an incomplete frame left over from the previous read
+        std::vector<char> pending;
+
+        // records received only in part, keyed by the writer's pid and the record's message id
+        std::map<std::pair<int32_t, uint32_t>, PendingRecord> fragments;
+
+        // front-coding slots (see ReportFormat), keyed by the writer's pid and producer id
+        std::map<std::pair<int32_t, uint32_t>, std::array<std::string, BxlFrontCodingNumSlots>> frontCodingSlots;
+
+        // file accesses folded so far (NULL when reports are handed over as they are read)
+        AccessSetBuilder *accessSet;
+
+        int numMalformed;
+    };
+
+    // A read buffer, recycled through 'freeBuffers_'
+    struct ReadBuffer
+    {
+        lfds711_freelist_element freeListElem;
+        char data[kReadBufferSize];
+    };
+
+    struct Worker
+    {
+        std::thread thread;
+        std::vector<ReportEntry> entries;
+
+        // reassembled records and expanded paths referenced by 'entries'
+        std::deque<std::string> records;
+    };
+
+    int epollFd_;
+    int shutdownFd_;
+    ReportBatchCallback onBatch_;
+    ChannelClosedCallback onClosed_;
+    std::vector<Worker*> workers_;
+
+    // read buffers not in use by any worker; a worker takes one for as long as it drains a channel, so there
+    // are only ever as many buffers as channels drained at the same time
+    lfds711_freelist_state freeBuffers_;
+
+    std::mutex channelsLock_;
+    std::unordered_map<int64_t, Channel*> channels_;
+
+    ReadBuffer* AcquireBuffer();
+    void ReleaseBuffer(ReadBuffer *buffer);
+    void Run(Worker *worker);
+    bool Drain(Worker *worker, Channel *channel, int *error);
+    size_t ParseFrames(Worker *worker, Channel *channel, const char *data, size_t length);
+    void AddRecord(Worker *worker, Channel *channel, const char *record, size_t length);
+    void AddFragment(Worker *worker, Channel *channel, const char *frame, size_t length);
+    int DrainJournals(Worker *worker, Channel *channel);
+    void CloseChannel(Worker *worker, Channel *channel, int error);
+};
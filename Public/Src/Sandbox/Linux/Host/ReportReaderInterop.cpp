@@ -0,0 +1,39 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "ReportReader.hpp"
+
+// Entry points of the multi-pip report reader, called from managed code (see ReportReader.cs)
+
+extern "C"
+{
+    /**
+     * Creates a reader with 'numWorkers' worker threads (0 means default).  Returns NULL on error.
+     */
+    ReportReader* BxlReportReader_Create(int numWorkers, ReportBatchCallback onBatch, ChannelClosedCallback onClosed)
+    {
+        ReportReader *reader = new ReportReader(numWorkers, onBatch, onClosed);
+        if (!reader->IsValid())
+        {
+            delete reader;
+            return NULL;
+        }
+
+        return reader;
+    }
+
+    bool BxlReportReader_AddChannel(ReportReader *reader, int64_t channelId, const char *fifoPath, bool buildAccessSet, const char *journalDir)
+    {
+        return reader->AddChannel(channelId, fifoPath, buildAccessSet, journalDir);
+    }
+
+    bool BxlReportReader_CloseChannelWriter(ReportReader *reader, int64_t channelId)
+    {
+        return reader->CloseChannelWriter(channelId);
+    }
+
+    void BxlReportReader_Dispose(ReportReader *reader)
+    {
+        delete reader;
+    }
+}
@@ -0,0 +1,46 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "ReportRing.hpp"
+
+// Consumer-side entry points of the report ring, called from managed code (see ReportRing.cs)
+
+extern "C"
+{
+    ReportRing* BxlReportRing_Create(const char *path, uint64_t capacity)
+    {
+        return ReportRing::Create(path, capacity == 0 ? BxlReportRingDefaultCapacity : capacity);
+    }
+
+    /**
+     * Reads the next record into 'buffer', waiting for at most 'timeoutMs' milliseconds
+     * for one to be committed.  Returns the length of the record, 0 if none was available,
+     * or -1 if the record did not fit into 'bufferSize' bytes.  A record left uncommitted by
+     * a producer that died is dropped rather than waited for.
+     */
+    int BxlReportRing_Read(ReportRing *ring, char *buffer, int bufferSize, int timeoutMs)
+    {
+        int result = ring->Read(buffer, bufferSize);
+        if (result == 0 && (ring->WaitForData(timeoutMs) || ring->SkipAbandonedRecord()))
+        {
+            result = ring->Read(buffer, bufferSize);
+        }
+
+        return result;
+    }
+
+    bool BxlReportRing_IsDrained(ReportRing *ring)
+    {
+        return ring->IsDrained();
+    }
+
+    void BxlReportRing_WakeConsumer(ReportRing *ring)
+    {
+        ring->WakeConsumer();
+    }
+
+    void BxlReportRing_Dispose(ReportRing *ring)
+    {
+        delete ring;
+    }
+}
@@ -0,0 +1,185 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#include <string>
+#include <vector>
+
+/**
+ * The directory translations of a pip (see DirectoryTranslator.cs), which map the paths of the accesses of the pip's
+ * processes to the paths the pip is specified in terms of (e.g., from a substituted build root to the real one).
+ *
+ * A path in (or equal to) a 'from' directory is moved to the matching 'to' directory, the longest 'from' directory that
+ * applies winning, and the result is translated again until no translation applies (the way DirectoryTranslator.Translate
+ * does); paths are compared component by component, ignoring (ASCII) case like the OrdinalIgnoreCase comparisons of
+ * DirectoryTranslator.
+ *
+ * The 'from' directories are kept in a trie of path components, so translating a path walks (a prefix of) its components
+ * once per translation applied; a path that no translation applies to, i.e., almost every path, usually stops at its first
+ * component.  The trie is built before the process starts any thread and never changes afterwards, so it is read without locks.
+ */
+class PathTranslator final
+{
+private:
+
+    struct Node
+    {
+        // component leading to this node from its parent (empty for the root, i.e., '/')
+        std::string component;
+
+        // index of the translation whose 'from' directory ends at this node (-1 if none)
+        int translation;
+
+        // children of this node (typically a handful, so they are just scanned)
+        std::vector<uint32_t> children;
+    };
+
+    std::vector<Node> nodes_;
+
+    // 'to' directory of every translation (without a trailing slash, i.e., empty for '/')
+    std::vector<std::string> targets_;
+
+    int FindChild(uint32_t node, const char *component, size_t length) const
+    {
+        for (uint32_t child : nodes_[node].children)
+        {
+            const std::string &name = nodes_[child].component;
+            if (name.length() == length && strncasecmp(name.data(), component, length) == 0)
+            {
+                return (int)child;
+            }
+        }
+
+        return -1;
+    }
+
+    // 'path' without its trailing slashes (other than the one of '/')
+    static size_t TrimmedLength(const char *path)
+    {
+        size_t length = strlen(path);
+        while (length > 1 && path[length - 1] == '/')
+        {
+            length--;
+        }
+
+        return length;
+    }
+
+public:
+
+    PathTranslator()
+    {
+        nodes_.push_back({ std::string(), -1, {} });
+    }
+
+    PathTranslator(const PathTranslator&) = delete;
+    PathTranslator& operator = (const PathTranslator&) = delete;
+
+    /** Whether there is no translation at all (in which case 'Translate' never changes a path) */
+    bool IsEmpty() const { return targets_.empty(); }
+
+    /**
+     * Adds the translation of directory 'from' to directory 'to' (both absolute, with or without a trailing slash); returns
+     * false if either is not absolute.  Of several translations of the same directory, the first one added is kept.
+     */
+    bool Add(const char *from, const char *to)
+    {
+        if (from[0] != '/' || to[0] != '/')
+        {
+            return false;
+        }
+
+        uint32_t node = 0;
+        size_t fromLength = TrimmedLength(from);
+        for (size_t start = 1; start < fromLength;)
+        {
+            const char *end = (const char *)memchr(from + start, '/', fromLength - start);
+            size_t componentLength = (end != NULL ? end - from : fromLength) - start;
+            if (componentLength > 0)
+            {
+                int child = FindChild(node, from + start, componentLength);
+                if (child == -1)
+                {
+                    child = (int)nodes_.size();
+                    nodes_.push_back({ std::string(from + start, componentLength), -1, {} });
+                    nodes_[node].children.push_back((uint32_t)child);
+                }
+
+                node = (uint32_t)child;
+            }
+
+            start += componentLength + 1;
+        }
+
+        if (nodes_[node].translation == -1)
+        {
+            size_t toLength = TrimmedLength(to);
+            nodes_[node].translation = (int)targets_.size();
+            targets_.push_back(toLength > 1 ? std::string(to, toLength) : std::string());
+        }
+
+        return true;
+    }
+
+    /** Translates 'path' (an absolute, normalized path) in place; returns whether any translation applied */
+    bool Translate(std::string &path) const
+    {
+        if (IsEmpty() || path.empty() || path[0] != '/')
+        {
+            return false;
+        }
+
+        // a chain of translations longer than the number of translations can only be a cycle
+        bool translated = false;
+        for (size_t round = 0; round < targets_.size(); round++)
+        {
+            uint32_t node = 0;
+            int translation = nodes_[0].translation;
+            size_t translationEnd = 0;
+            for (size_t start = 1; start < path.length();)
+            {
+                size_t end = path.find('/', start);
+                if (end == std::string::npos)
+                {
+                    end = path.length();
+                }
+
+                int child = FindChild(node, path.data() + start, end - start);
+                if (child == -1)
+                {
+                    break;
+                }
+
+                node = (uint32_t)child;
+                if (nodes_[node].translation != -1)
+                {
+                    translation = nodes_[node].translation;
+                    translationEnd = end;
+                }
+
+                start = end + 1;
+            }
+
+            if (translation == -1)
+            {
+                break;
+            }
+
+            // '/' itself is replaced as a whole
+            path.replace(0, translationEnd == 0 && path.length() == 1 ? 1 : translationEnd, targets_[translation]);
+            if (path.empty())
+            {
+                path = "/";
+            }
+
+            translated = true;
+        }
+
+        return translated;
+    }
+};
@@ -0,0 +1,271 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <atomic>
+
+#define BxlProcessTreeMagic   0x45525442 // 'BTRE'
+#define BxlProcessTreeVersion 1
+
+// Default maximum number of processes of a process tree
+#define BxlProcessTreeDefaultCapacity 4096
+
+/**
+ * Header of a process tree.  The header is placed at the beginning of a shared memory
+ * file (typically in /dev/shm) and is immediately followed by 'capacity' slots.
+ */
+struct ProcessTreeHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+
+    // number of processes that have been registered and have not exited yet
+    alignas(64) std::atomic<int32_t> numActive;
+
+    // number of slots handed out so far (slots are never reused)
+    alignas(64) std::atomic<uint64_t> numSlots;
+
+    // set when a process could not be registered because all the slots were taken, in which case
+    // 'numActive' no longer accounts for every process of the tree
+    std::atomic<uint32_t> overflowed;
+};
+
+/**
+ * A slot of a process tree.  'pid' is 0 until it is known (a slot is claimed right before 'fork'
+ * and the pid is filled in right after by both the parent and the child).
+ */
+struct ProcessTreeSlot
+{
+    static const uint32_t kFree   = 0;
+    static const uint32_t kActive = 1;
+    static const uint32_t kExited = 2;
+
+    std::atomic<int32_t>  pid;
+    std::atomic<uint32_t> state;
+};
+
+/**
+ * The processes of a pip's process tree, shared between all those processes and the BuildXL host.
+ *
+ * The host creates the tree with the root process registered.  A process registers its child
+ * right before forking (so that the count never drops to 0 while a child is being created), and
+ * marks itself exited when it exits.  A process that was not created through an interposed 'fork'
+ * (e.g., with 'vfork' or 'posix_spawn') registers itself when the sandbox initializes in it.
+ *
+ * A process killed by a signal never marks itself exited; the host does that on its behalf once it
+ * learns that the process is gone (see ProcessTreeMonitor).  Marking a slot exited is a CAS, so a
+ * process is accounted for exactly once whichever side gets there first.
+ */
+class ProcessTree final
+{
+private:
+
+    ProcessTreeHeader *header_;
+    ProcessTreeSlot *slots_;
+    size_t mappedSize_;
+
+    ProcessTree(void *addr, size_t mappedSize)
+    {
+        header_     = (ProcessTreeHeader*)addr;
+        slots_      = (ProcessTreeSlot*)((char*)addr + SlotsOffset());
+        mappedSize_ = mappedSize;
+    }
+
+    static size_t SlotsOffset()
+    {
+        return (sizeof(ProcessTreeHeader) + 63) & ~(size_t)63;
+    }
+
+    static ProcessTree* Map(int fd, size_t size)
+    {
+        void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        return addr == MAP_FAILED ? NULL : new ProcessTree(addr, size);
+    }
+
+public:
+
+    ~ProcessTree()
+    {
+        munmap(header_, mappedSize_);
+    }
+
+    /**
+     * Creates a new tree at 'path' that can hold up to 'capacity' processes, with 'rootPid'
+     * registered in slot 0.  Returns NULL (and sets errno) on error.
+     */
+    static ProcessTree* Create(const char *path, uint64_t capacity, pid_t rootPid)
+    {
+        if (capacity == 0)
+        {
+            errno = EINVAL;
+            return NULL;
+        }
+
+        int fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR);
+        if (fd == -1)
+        {
+            return NULL;
+        }
+
+        size_t size = SlotsOffset() + capacity * sizeof(ProcessTreeSlot);
+        ProcessTree *tree = ftruncate(fd, size) == 0 ? Map(fd, size) : NULL;
+        close(fd);
+
+        if (tree == NULL)
+        {
+            unlink(path);
+            return NULL;
+        }
+
+        // a freshly truncated file is zero-filled
+        tree->header_->capacity  = capacity;
+        tree->header_->version   = BxlProcessTreeVersion;
+        tree->slots_[0].pid      = rootPid;
+        tree->slots_[0].state    = ProcessTreeSlot::kActive;
+        tree->header_->numSlots  = 1;
+        tree->header_->numActive = 1;
+        std::atomic_thread_fence(std::memory_order_release);
+        tree->header_->magic     = BxlProcessTreeMagic;
+        return tree;
+    }
+
+    /**
+     * Maps an existing tree created by the host from 'fd' (a descriptor of the tree's file opened
+     * for reading and writing, which the caller may close afterwards).  Returns NULL on error.
+     *
+     * Only system calls that the sandbox does not interpose are made here.
+     */
+    static ProcessTree* Attach(int fd)
+    {
+        off_t size = lseek(fd, 0, SEEK_END);
+        ProcessTree *tree = size > (off_t)SlotsOffset()
+            ? Map(fd, size)
+            : NULL;
+
+        if (tree != NULL &&
+            (tree->header_->magic != BxlProcessTreeMagic ||
+             tree->header_->version != BxlProcessTreeVersion ||
+             SlotsOffset() + tree->header_->capacity * sizeof(ProcessTreeSlot) != tree->mappedSize_))
+        {
+            delete tree;
+            errno = EINVAL;
+            return NULL;
+        }
+
+        return tree;
+    }
+
+    /**
+     * Number of slots handed out so far.
+     */
+    uint64_t NumSlots() const
+    {
+        uint64_t numSlots = header_->numSlots.load();
+        return numSlots < header_->capacity ? numSlots : header_->capacity;
+    }
+
+    // ---------------------------------------------------------------------------------
+    // Sandbox side
+    // ---------------------------------------------------------------------------------
+
+    /**
+     * Registers a process whose pid is not known yet (i.e., a child about to be forked) or, when 'pid'
+     * is not 0, a process with that pid.  Returns the slot of the process or -1 if the tree is full.
+     */
+    int Register(pid_t pid)
+    {
+        uint64_t slot = header_->numSlots.fetch_add(1);
+        if (slot >= header_->capacity)
+        {
+            header_->overflowed = 1;
+            return -1;
+        }
+
+        header_->numActive.fetch_add(1);
+        slots_[slot].pid   = pid;
+        slots_[slot].state = ProcessTreeSlot::kActive;
+        return (int)slot;
+    }
+
+    /**
+     * Sets the pid of a process registered without one.
+     */
+    void SetPid(int slot, pid_t pid)
+    {
+        if (slot >= 0)
+        {
+            slots_[slot].pid = pid;
+        }
+    }
+
+    /**
+     * Returns the slot of the active process 'pid', registering it if it is not registered yet.
+     * Returns -1 if the tree is full.
+     */
+    int FindOrRegister(pid_t pid)
+    {
+        uint64_t numSlots = NumSlots();
+        for (uint64_t i = 0; i < numSlots; i++)
+        {
+            if (slots_[i].pid.load() == pid && slots_[i].state.load() == ProcessTreeSlot::kActive)
+            {
+                return (int)i;
+            }
+        }
+
+        return Register(pid);
+    }
+
+    /**
+     * Marks the process in 'slot' exited, unless it has already been.  Returns true if this call did it.
+     * When 'pid' is not 0, the slot is only marked if it belongs to that pid.
+     */
+    bool MarkExited(int slot, pid_t pid = 0)
+    {
+        if (slot < 0 || (uint64_t)slot >= header_->capacity || (pid != 0 && slots_[slot].pid.load() != pid))
+        {
+            return false;
+        }
+
+        uint32_t expected = ProcessTreeSlot::kActive;
+        if (!slots_[slot].state.compare_exchange_strong(expected, ProcessTreeSlot::kExited))
+        {
+            return false;
+        }
+
+        header_->numActive.fetch_sub(1);
+        return true;
+    }
+
+    // ---------------------------------------------------------------------------------
+    // Host side
+    // ---------------------------------------------------------------------------------
+
+    int32_t NumActive() const { return header_->numActive.load(); }
+
+    bool Overflowed() const { return header_->overflowed.load() != 0; }
+
+    /**
+     * Whether every registered process has exited (only meaningful if the tree has not overflowed).
+     */
+    bool IsCompleted() const { return !Overflowed() && NumActive() <= 0; }
+
+    /**
+     * Returns the pid of the process in 'slot' (0 if not known yet) and the state of the slot.  A slot
+     * counted by 'NumSlots' may still be 'kFree' for a moment, while the process claiming it fills it in.
+     */
+    pid_t GetProcess(int slot, uint32_t *state) const
+    {
+        *state = slots_[slot].state.load();
+        return slots_[slot].pid.load();
+    }
+};
@@ -0,0 +1,506 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+
+#define BxlReportFormatVersion 1
+
+// Number of recent paths of a producer that a front-coded path may be coded against
+#define BxlFrontCodingNumSlots 4
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The access report wire format is little-endian; add byte swapping before building for a big-endian target"
+#endif
+
+/**
+ * Decoded view of an access report record.  'path' points into the buffer the record
+ * was decoded from and is NOT 0-terminated.
+ */
+struct ReportRecord
+{
+    uint8_t  version;
+    uint8_t  flags;
+    uint16_t operation;
+    int32_t  pid;
+    uint32_t requestedAccess;
+    uint32_t status;
+    uint32_t error;
+    uint32_t pathLength;
+    const char *path;
+
+    // only set for front-coded records, in which case 'path' is just the suffix of the full path (see ReportFormat)
+    uint32_t producerId;
+    uint16_t prefixLength;
+    uint8_t  slot;
+
+    // id of the manifest record matching the path exactly, or 0 if the record does not carry one
+    uint32_t pathId;
+
+    static constexpr uint8_t kFlagReportExplicitly = 0x01;
+    static constexpr uint8_t kFlagFrontCoded       = 0x02;
+    static constexpr uint8_t kFlagHasPathId        = 0x04;
+
+    bool ReportExplicitly() const { return (flags & kFlagReportExplicitly) != 0; }
+    bool IsFrontCoded() const     { return (flags & kFlagFrontCoded) != 0; }
+    bool HasPathId() const        { return (flags & kFlagHasPathId) != 0; }
+};
+
+/**
+ * Binary wire format of access reports sent from the sandbox to the host.
+ *
+ * A record is a fixed 24-byte little-endian header followed by the path (UTF-8, not 0-terminated):
+ *
+ *    offset  size  field
+ *         0     1  version (BxlReportFormatVersion)
+ *         1     1  flags (bit 0: report explicitly)
+ *         2     2  operation (FileOperation)
+ *         4     4  pid
+ *         8     4  requested access (RequestedAccess)
+ *        12     4  status (FileAccessStatus)
+ *        16     4  error
+ *        20     4  path length (in bytes)
+ *        24     *  path
+ *
+ * A record may be front-coded (flag bit 1), in which case the header is followed by more fields and
+ * only the part of the path that differs from a recent path of the same producer is sent:
+ *
+ *        24     4  producer id (unique within the process with the given pid)
+ *        28     2  prefix length (number of leading bytes shared with the path in the slot)
+ *        30     1  slot (0 to BxlFrontCodingNumSlots - 1)
+ *        31     1  reserved
+ *        32     *  path suffix ('path length' bytes)
+ *
+ * Each producer (i.e., a thread of a sandboxed process) has BxlFrontCodingNumSlots slots holding recent
+ * paths (so that, e.g., reads from a source tree interleaved with writes to one output file both share
+ * long prefixes).  A front-coded path is coded against the path in the given slot and then replaces it.
+ * A producer only front-codes its records while it knows that they reach the host in the order it encodes
+ * them (see FrontCodingEncoder).  The host keeps the same slots for every pid and producer id to reconstruct
+ * full paths; records that are not front-coded neither use nor change the slots.
+ *
+ * A record may carry a path id (flag bit 2), in which case a 4-byte field follows the header and the
+ * front-coding fields (if any) and precedes the path.  The path id is the id the FileAccessManifest gave to
+ * the manifest record that the path matched exactly (i.e., the search for the path's policy was not
+ * truncated at an ancestor), which the host can resolve without parsing the path.
+ *
+ * The framing of records is up to the transport (see 'ReportFraming' for the FIFO framing).
+ * This header is shared by the sandbox (encoder) and the host library (decoder); the managed
+ * decoder in SandboxConnectionLinuxDetours must be kept in sync with it.
+ */
+class ReportFormat final
+{
+private:
+
+    template<typename T>
+    static inline char* Put(char *dst, T value)
+    {
+        memcpy(dst, &value, sizeof(T));
+        return dst + sizeof(T);
+    }
+
+    template<typename T>
+    static inline const char* Get(const char *src, T *value)
+    {
+        memcpy(value, src, sizeof(T));
+        return src + sizeof(T);
+    }
+
+public:
+
+    static constexpr size_t HeaderSize = 24;
+
+    static constexpr size_t FrontCodingSize = 8;
+
+    static constexpr size_t PathIdSize = 4;
+
+    static constexpr size_t MaxFrontCodedPathLength = UINT16_MAX;
+
+    static constexpr size_t EncodedSize(size_t pathLength, bool frontCoded = false, bool hasPathId = false)
+    {
+        return HeaderSize + (frontCoded ? FrontCodingSize : 0) + (hasPathId ? PathIdSize : 0) + pathLength;
+    }
+
+    /**
+     * Encodes a record into 'buffer' ('pathId' is only included when not 0).  Returns the number
+     * of bytes written, or 0 if 'bufferSize' is smaller than 'EncodedSize(pathLength, false, pathId != 0)'.
+     */
+    static size_t Encode(
+        char *buffer, size_t bufferSize,
+        uint16_t operation, int32_t pid, uint32_t requestedAccess, uint32_t status,
+        bool reportExplicitly, uint32_t error, const char *path, size_t pathLength, uint32_t pathId = 0)
+    {
+        size_t size = EncodedSize(pathLength, /* frontCoded */ false, pathId != 0);
+        if (bufferSize < size)
+        {
+            return 0;
+        }
+
+        uint8_t flags = (reportExplicitly ? ReportRecord::kFlagReportExplicitly : 0) | (pathId != 0 ? ReportRecord::kFlagHasPathId : 0);
+
+        char *pos = buffer;
+        pos = Put<uint8_t>(pos, BxlReportFormatVersion);
+        pos = Put<uint8_t>(pos, flags);
+        pos = Put<uint16_t>(pos, operation);
+        pos = Put<int32_t>(pos, pid);
+        pos = Put<uint32_t>(pos, requestedAccess);
+        pos = Put<uint32_t>(pos, status);
+        pos = Put<uint32_t>(pos, error);
+        pos = Put<uint32_t>(pos, (uint32_t)pathLength);
+        if (pathId != 0)
+        {
+            pos = Put<uint32_t>(pos, pathId);
+        }
+        memcpy(pos, path, pathLength);
+        return size;
+    }
+
+    /**
+     * Encodes a front-coded record into 'buffer', which only carries the bytes of 'path' past 'prefixLength'
+     * (see FrontCodingEncoder for 'slot' and 'prefixLength'; 'pathId' is only included when not 0).  Returns
+     * the number of bytes written, or 0 if 'bufferSize' is too small.
+     */
+    static size_t EncodeFrontCoded(
+        char *buffer, size_t bufferSize,
+        uint16_t operation, int32_t pid, uint32_t requestedAccess, uint32_t status,
+        bool reportExplicitly, uint32_t error, const char *path, size_t pathLength,
+        uint32_t producerId, int slot, size_t prefixLength, uint32_t pathId = 0)
+    {
+        size_t suffixLength = pathLength - prefixLength;
+        size_t size = EncodedSize(suffixLength, /* frontCoded */ true, pathId != 0);
+        if (bufferSize < size || prefixLength > pathLength || pathLength > MaxFrontCodedPathLength)
+        {
+            return 0;
+        }
+
+        uint8_t flags = ReportRecord::kFlagFrontCoded
+            | (reportExplicitly ? ReportRecord::kFlagReportExplicitly : 0)
+            | (pathId != 0 ? ReportRecord::kFlagHasPathId : 0);
+
+        char *pos = buffer;
+        pos = Put<uint8_t>(pos, BxlReportFormatVersion);
+        pos = Put<uint8_t>(pos, flags);
+        pos = Put<uint16_t>(pos, operation);
+        pos = Put<int32_t>(pos, pid);
+        pos = Put<uint32_t>(pos, requestedAccess);
+        pos = Put<uint32_t>(pos, status);
+        pos = Put<uint32_t>(pos, error);
+        pos = Put<uint32_t>(pos, (uint32_t)suffixLength);
+        pos = Put<uint32_t>(pos, producerId);
+        pos = Put<uint16_t>(pos, (uint16_t)prefixLength);
+        pos = Put<uint8_t>(pos, (uint8_t)slot);
+        pos = Put<uint8_t>(pos, 0);
+        if (pathId != 0)
+        {
+            pos = Put<uint32_t>(pos, pathId);
+        }
+        memcpy(pos, path + prefixLength, suffixLength);
+        return size;
+    }
+
+    /**
+     * Decodes the record in the first 'size' bytes of 'buffer' into 'record'.  Returns false
+     * if the buffer does not contain exactly one well-formed record of a supported version.
+     */
+    static bool Decode(const char *buffer, size_t size, ReportRecord *record)
+    {
+        if (size < HeaderSize)
+        {
+            return false;
+        }
+
+        const char *pos = buffer;
+        pos = Get(pos, &record->version);
+        pos = Get(pos, &record->flags);
+        pos = Get(pos, &record->operation);
+        pos = Get(pos, &record->pid);
+        pos = Get(pos, &record->requestedAccess);
+        pos = Get(pos, &record->status);
+        pos = Get(pos, &record->error);
+        pos = Get(pos, &record->pathLength);
+
+        record->producerId = 0;
+        record->prefixLength = 0;
+        record->slot = 0;
+        if (record->IsFrontCoded())
+        {
+            uint8_t reserved;
+            if (size < HeaderSize + FrontCodingSize)
+            {
+                return false;
+            }
+
+            pos = Get(pos, &record->producerId);
+            pos = Get(pos, &record->prefixLength);
+            pos = Get(pos, &record->slot);
+            pos = Get(pos, &reserved);
+            if (record->slot >= BxlFrontCodingNumSlots)
+            {
+                return false;
+            }
+        }
+
+        record->pathId = 0;
+        if (record->HasPathId())
+        {
+            if (size < (size_t)(pos - buffer) + PathIdSize)
+            {
+                return false;
+            }
+
+            pos = Get(pos, &record->pathId);
+        }
+
+        record->path = pos;
+
+        return record->version == BxlReportFormatVersion
+            && EncodedSize(record->pathLength, record->IsFrontCoded(), record->HasPathId()) == size;
+    }
+};
+
+/**
+ * Front-coding state of a producer of reports (see ReportFormat).
+ */
+class FrontCodingEncoder final
+{
+private:
+
+    // a path must share at least this many bytes with the path in its slot, or it replaces the least recently used path instead
+    static const size_t kMinPrefixLength = 8;
+
+    uint32_t producerId_;
+    uint32_t clock_;
+    uint32_t lastUse_[BxlFrontCodingNumSlots];
+    size_t lengths_[BxlFrontCodingNumSlots];
+    char paths_[BxlFrontCodingNumSlots][PATH_MAX];
+
+    static size_t SharedPrefixLength(const char *lhs, size_t lhsLength, const char *rhs, size_t rhsLength)
+    {
+        size_t maxLength = lhsLength < rhsLength ? lhsLength : rhsLength;
+        size_t length = 0;
+        while (length < maxLength && lhs[length] == rhs[length])
+        {
+            length++;
+        }
+
+        return length;
+    }
+
+public:
+
+    FrontCodingEncoder(uint32_t producerId) : producerId_(producerId)
+    {
+        Reset();
+    }
+
+    uint32_t ProducerId() const { return producerId_; }
+
+    /**
+     * Forgets all the paths (i.e., the host has not seen any path from this producer).
+     */
+    void Reset()
+    {
+        clock_ = 0;
+        for (int i = 0; i < BxlFrontCodingNumSlots; i++)
+        {
+            lastUse_[i] = 0;
+            lengths_[i] = 0;
+        }
+    }
+
+    /**
+     * Chooses the slot to code 'path' against and replaces the path in that slot with 'path'.  Returns false
+     * if 'path' cannot be front-coded, otherwise sets 'slot' and 'prefixLength' to encode the path with.
+     */
+    bool Code(const char *path, size_t pathLength, int *slot, size_t *prefixLength)
+    {
+        if (pathLength >= PATH_MAX || pathLength > ReportFormat::MaxFrontCodedPathLength)
+        {
+            return false;
+        }
+
+        int bestSlot = 0, lruSlot = 0;
+        size_t bestLength = 0;
+        for (int i = 0; i < BxlFrontCodingNumSlots; i++)
+        {
+            size_t length = SharedPrefixLength(paths_[i], lengths_[i], path, pathLength);
+            if (length > bestLength)
+            {
+                bestSlot = i;
+                bestLength = length;
+            }
+
+            if (lastUse_[i] < lastUse_[lruSlot])
+            {
+                lruSlot = i;
+            }
+        }
+
+        if (bestLength < kMinPrefixLength)
+        {
+            bestSlot = lruSlot;
+            bestLength = SharedPrefixLength(paths_[lruSlot], lengths_[lruSlot], path, pathLength);
+        }
+
+        memcpy(&paths_[bestSlot][bestLength], &path[bestLength], pathLength - bestLength);
+        lengths_[bestSlot] = pathLength;
+        lastUse_[bestSlot] = ++clock_;
+
+        *slot = bestSlot;
+        *prefixLength = bestLength;
+        return true;
+    }
+};
+
+/**
+ * Header of a fragment frame (see 'ReportFraming').
+ */
+struct FragmentHeader
+{
+    int32_t  pid;
+    uint32_t messageId;
+    uint16_t index;
+    uint16_t flags;
+
+    static constexpr uint16_t kFlagLastFragment = 0x01;
+};
+
+static_assert(sizeof(FragmentHeader) == 12, "FragmentHeader is part of the wire format");
+
+/**
+ * Framing of records sent through a FIFO.
+ *
+ * Every frame starts with a 32-bit little-endian length prefix (which does not count the prefix
+ * itself) and is written with a single 'write' of at most PIPE_BUF bytes, so that frames written
+ * concurrently by different threads and processes never interleave.  Several frames may be written
+ * at once (see report batching in BxlObserver).
+ *
+ * A record that does not fit into one frame is split into fragments.  The length prefix of a
+ * fragment frame has 'kFragmentFlag' set and its body is a 'FragmentHeader' followed by the next
+ * chunk of the record.  Fragments of one record are written in order by a single thread, and are
+ * identified by the writer's pid and a message id unique within that process; the record is complete
+ * once the fragment flagged 'kFlagLastFragment' has been received.
+ */
+class ReportFraming final
+{
+public:
+
+    static constexpr uint32_t kFragmentFlag = 0x80000000;
+
+    static constexpr size_t PrefixSize = sizeof(uint32_t);
+
+    static constexpr size_t MaxFragmentChunkSize = PIPE_BUF - PrefixSize - sizeof(FragmentHeader);
+
+    /**
+     * Encodes a fragment frame carrying 'chunkSize' bytes of 'chunk' into 'frame', which must be at
+     * least PIPE_BUF bytes long.  Returns the total size of the frame.
+     */
+    static size_t EncodeFragment(
+        char *frame, int32_t pid, uint32_t messageId, uint16_t index, bool isLast, const char *chunk, size_t chunkSize)
+    {
+        FragmentHeader header = { pid, messageId, index, (uint16_t)(isLast ? FragmentHeader::kFlagLastFragment : 0) };
+        uint32_t prefix = (uint32_t)(sizeof(header) + chunkSize) | kFragmentFlag;
+
+        memcpy(frame, &prefix, PrefixSize);
+        memcpy(frame + PrefixSize, &header, sizeof(header));
+        memcpy(frame + PrefixSize + sizeof(header), chunk, chunkSize);
+        return PrefixSize + sizeof(header) + chunkSize;
+    }
+};
+
+/**
+ * Header of an entry of a report journal (see 'ReportJournal').
+ */
+struct JournalEntryHeader
+{
+    uint64_t sequence;
+    uint32_t length;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(JournalEntryHeader) == 16, "JournalEntryHeader is part of the journal format");
+
+/**
+ * Overflow journals of the reports of a pip.
+ *
+ * When the host asks for it, sandboxed processes write to the FIFO without blocking.  Once a write
+ * finds the FIFO full, the process appends that write, and every later one, to its own journal
+ * ('<pid>.journal' in a directory given by the host) instead.  A journal entry is a 'JournalEntryHeader'
+ * followed by exactly the bytes that did not fit into the FIFO (one or more frames, see 'ReportFraming'),
+ * all appended with a single 'write'.  The images a process execs keep appending to its journal.
+ *
+ * Process start, exit and breakaway reports are never spilled: a process waits for room in the FIFO to
+ * send them, because the host tracks the processes of the pip with them and only reads the journals once
+ * the FIFO has been closed (i.e., once every process is done writing).  The host then hands over the
+ * entries of all the journals after everything received through the FIFO, sorted by their sequence
+ * numbers (CLOCK_MONOTONIC timestamps taken when the entries were written; entries with equal sequence
+ * numbers stay in journal order).
+ *
+ * Frames sent through the FIFO carry no sequence number, so spilled reports are not merged back into
+ * the order in which they were sent relative to the reports of the FIFO: a spilled file access is read
+ * after the FIFO's reports, including the exit of its own process (the managed host holds exit reports back
+ * until the journals have been read, see SandboxConnectionLinuxDetours).  Only the reports that each
+ * process spills keep their relative order (which front coding and the reassembly of fragments rely on;
+ * process reports are not front-coded).  The host treats the file accesses of a pip as a set, so it does
+ * not depend on their order.
+ */
+class ReportJournal final
+{
+public:
+
+    static constexpr size_t EntryHeaderSize = sizeof(JournalEntryHeader);
+
+    // whatever is written to the FIFO at once is never longer than PIPE_BUF (see ReportFraming)
+    static constexpr size_t MaxPayloadSize = PIPE_BUF;
+
+    /**
+     * Writes the path of the journal of process 'pid' in 'directory' into 'path'.  Returns false if it does not fit.
+     */
+    static bool GetPath(const char *directory, pid_t pid, char *path, size_t size)
+    {
+        int length = snprintf(path, size, "%s/%d.journal", directory, (int)pid);
+        return length > 0 && (size_t)length < size;
+    }
+
+    /**
+     * Encodes an entry carrying 'payload' into 'entry'.  Returns the total size of the entry, or 0 if
+     * 'entrySize' is too small.
+     */
+    static size_t EncodeEntry(char *entry, size_t entrySize, uint64_t sequence, const char *payload, size_t payloadLength)
+    {
+        if (entrySize < EntryHeaderSize + payloadLength)
+        {
+            return 0;
+        }
+
+        JournalEntryHeader header = { sequence, (uint32_t)payloadLength, 0 };
+        memcpy(entry, &header, EntryHeaderSize);
+        memcpy(entry + EntryHeaderSize, payload, payloadLength);
+        return EntryHeaderSize + payloadLength;
+    }
+
+    /**
+     * Decodes the header of the entry at the beginning of 'data'.  Returns the total size of the entry
+     * (its payload follows the header), or 0 if 'data' does not start with a complete entry.
+     */
+    static size_t DecodeEntry(const char *data, size_t length, JournalEntryHeader *header)
+    {
+        if (length < EntryHeaderSize)
+        {
+            return 0;
+        }
+
+        memcpy(header, data, EntryHeaderSize);
+        if (header->length > MaxPayloadSize || length - EntryHeaderSize < header->length)
+        {
+            return 0;
+        }
+
+        return EntryHeaderSize + header->length;
+    }
+};
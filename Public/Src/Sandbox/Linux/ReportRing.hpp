@@ -0,0 +1,447 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <atomic>
+
+#define BxlReportRingMagic   0x474E5242 // 'BRNG'
+#define BxlReportRingVersion 2
+
+// Default size of the data area of a report ring (must be a power of 2)
+#define BxlReportRingDefaultCapacity (1 << 20)
+
+/**
+ * Header of a report ring.  The header is placed at the beginning of a shared memory
+ * file (typically in /dev/shm) and is immediately followed by the data area.
+ *
+ * 'head' and 'tail' are monotonically increasing byte positions; their value modulo
+ * 'capacity' is the offset into the data area.  Producers (all processes of a pip's
+ * process tree) reserve space by advancing 'head' with a CAS; the single consumer
+ * (the host) advances 'tail' after it has consumed (and zeroed) a record.
+ */
+struct ReportRingHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+
+    // futex word bumped by producers after a commit, when the consumer is waiting for data
+    alignas(64) std::atomic<uint32_t> dataSeq;
+    std::atomic<uint32_t> consumerWaiting;
+
+    // futex word bumped by the consumer after freeing up space, when producers are waiting for it
+    alignas(64) std::atomic<uint32_t> spaceSeq;
+    std::atomic<uint32_t> producersWaiting;
+};
+
+/**
+ * Header of a single record in the data area.  A record is never split across the end of
+ * the data area; when a record does not fit, the producer fills the rest of the data area with
+ * a padding record and places the actual record at the beginning of the data area.
+ *
+ * 'word' is 0 until the producer stamps the record right after reserving it: 'owner' is set to
+ * the producer's pid and 'word' to the length of the payload combined with 'kReserved'.  When the
+ * record is committed, 'word' is set (with release semantics) to the length of the payload combined
+ * with 'kCommitted' (and 'kPadding' for padding records, in which case the length is the total size
+ * of the record).  The stamp lets the consumer skip the record of a producer that died before
+ * committing it (see 'SkipAbandonedRecord').
+ */
+struct ReportRingRecord
+{
+    static const uint32_t kCommitted  = 0x80000000;
+    static const uint32_t kPadding    = 0x40000000;
+    static const uint32_t kReserved   = 0x20000000;
+    static const uint32_t kLengthMask = 0x1FFFFFFF;
+
+    std::atomic<uint32_t> word;
+    std::atomic<uint32_t> owner;
+    char payload[0];
+};
+
+/**
+ * A multi-producer single-consumer ring buffer of access reports, shared between all the
+ * processes of a pip's process tree (producers) and the BuildXL host (consumer).
+ *
+ * Producers never make a system call on the hot path: space is reserved lock-free and a
+ * record is published by a single atomic store.  A futex is used only to wake up the
+ * consumer when it has announced that it is waiting for data, and to block producers
+ * when the ring is full (the equivalent of a write blocking on a full FIFO).
+ */
+class ReportRing final
+{
+private:
+
+    ReportRingHeader *header_;
+    char *data_;
+    size_t mappedSize_;
+    uint64_t mask_;
+
+    ReportRing(void *addr, size_t mappedSize)
+    {
+        header_     = (ReportRingHeader*)addr;
+        data_       = (char*)addr + DataOffset();
+        mappedSize_ = mappedSize;
+        mask_       = header_->capacity - 1;
+    }
+
+    static size_t DataOffset()
+    {
+        // keep the data area page-aligned
+        return (sizeof(ReportRingHeader) + 4095) & ~(size_t)4095;
+    }
+
+    static uint64_t RecordSize(size_t payloadLength)
+    {
+        return (sizeof(ReportRingRecord) + payloadLength + 7) & ~(uint64_t)7;
+    }
+
+    inline ReportRingRecord* RecordAt(uint64_t position) const
+    {
+        return (ReportRingRecord*)(data_ + (position & mask_));
+    }
+
+    static long Futex(std::atomic<uint32_t> *addr, int op, uint32_t val, int timeoutMs)
+    {
+        struct timespec timeout = { timeoutMs / 1000, (timeoutMs % 1000) * 1000000L };
+        return syscall(SYS_futex, (uint32_t*)addr, op, val, timeoutMs >= 0 ? &timeout : NULL, NULL, 0);
+    }
+
+    static void Wake(std::atomic<uint32_t> *seq, int numWaiters)
+    {
+        seq->fetch_add(1);
+        Futex(seq, FUTEX_WAKE, numWaiters, -1);
+    }
+
+    static ReportRing* Map(int fd, size_t size)
+    {
+        void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        return addr == MAP_FAILED ? NULL : new ReportRing(addr, size);
+    }
+
+public:
+
+    ~ReportRing()
+    {
+        munmap(header_, mappedSize_);
+    }
+
+    /**
+     * Creates a new ring at 'path' whose data area is 'capacity' bytes long.
+     * 'capacity' must be a power of 2 that record lengths can express.  Returns NULL (and sets errno) on error.
+     */
+    static ReportRing* Create(const char *path, uint64_t capacity)
+    {
+        if (capacity == 0 || (capacity & (capacity - 1)) != 0 || capacity > (uint64_t)ReportRingRecord::kLengthMask + 1)
+        {
+            errno = EINVAL;
+            return NULL;
+        }
+
+        int fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR);
+        if (fd == -1)
+        {
+            return NULL;
+        }
+
+        size_t size = DataOffset() + capacity;
+        ReportRing *ring = ftruncate(fd, size) == 0 ? Map(fd, size) : NULL;
+        close(fd);
+
+        if (ring == NULL)
+        {
+            unlink(path);
+            return NULL;
+        }
+
+        // a freshly truncated file is zero-filled, so only the constant part of the header needs to be set
+        ring->header_->capacity = capacity;
+        ring->header_->version  = BxlReportRingVersion;
+        ring->mask_             = capacity - 1;
+        std::atomic_thread_fence(std::memory_order_release);
+        ring->header_->magic    = BxlReportRingMagic;
+        return ring;
+    }
+
+    /**
+     * Maps an existing ring created by the host from 'fd' (a descriptor of the ring's file opened
+     * for reading and writing, which the caller may close afterwards).  Returns NULL on error.
+     *
+     * Only system calls that the sandbox does not interpose are made here.
+     */
+    static ReportRing* Attach(int fd)
+    {
+        off_t size = lseek(fd, 0, SEEK_END);
+        ReportRing *ring = size > (off_t)DataOffset()
+            ? Map(fd, size)
+            : NULL;
+
+        if (ring != NULL &&
+            (ring->header_->magic != BxlReportRingMagic ||
+             ring->header_->version != BxlReportRingVersion ||
+             DataOffset() + ring->header_->capacity != ring->mappedSize_))
+        {
+            delete ring;
+            errno = EINVAL;
+            return NULL;
+        }
+
+        return ring;
+    }
+
+    uint64_t Capacity() const { return header_->capacity; }
+
+    // ---------------------------------------------------------------------------------
+    // Producer side
+    // ---------------------------------------------------------------------------------
+
+    /**
+     * Largest payload that can be written as a single record.
+     */
+    size_t MaxPayloadLength() const
+    {
+        return header_->capacity / 2 - sizeof(ReportRingRecord);
+    }
+
+    /**
+     * Copies 'length' bytes from 'payload' into a new record on behalf of process 'pid' (the
+     * writing process).  Blocks while the ring is full.  Returns false if the payload is larger
+     * than 'MaxPayloadLength()'.
+     */
+    bool Write(const char *payload, size_t length, pid_t pid)
+    {
+        if (length > MaxPayloadLength())
+        {
+            return false;
+        }
+
+        uint64_t capacity = header_->capacity;
+        uint64_t size     = RecordSize(length);
+        uint64_t head     = header_->head.load(std::memory_order_relaxed);
+        uint64_t padding;
+
+        while (true)
+        {
+            uint64_t offset = head & mask_;
+            padding = offset + size > capacity ? capacity - offset : 0;
+
+            uint64_t tail = header_->tail.load(std::memory_order_acquire);
+            if (head + padding + size - tail > capacity)
+            {
+                WaitForSpace(head + padding + size - capacity);
+                head = header_->head.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            if (header_->head.compare_exchange_weak(head, head + padding + size, std::memory_order_acq_rel))
+            {
+                break;
+            }
+        }
+
+        if (padding > 0)
+        {
+            RecordAt(head)->word.store((uint32_t)padding | ReportRingRecord::kPadding | ReportRingRecord::kCommitted);
+            head += padding;
+        }
+
+        ReportRingRecord *record = RecordAt(head);
+        record->owner.store((uint32_t)pid, std::memory_order_relaxed);
+        record->word.store((uint32_t)length | ReportRingRecord::kReserved);
+        memcpy(record->payload, payload, length);
+        record->word.store((uint32_t)length | ReportRingRecord::kCommitted);
+
+        if (header_->consumerWaiting.load() != 0)
+        {
+            Wake(&header_->dataSeq, 1);
+        }
+
+        return true;
+    }
+
+private:
+
+    void WaitForSpace(uint64_t requiredTail)
+    {
+        header_->producersWaiting.fetch_add(1);
+        uint32_t seq = header_->spaceSeq.load();
+        if (header_->tail.load() < requiredTail)
+        {
+            // the timeout guards against a missed wakeup from a consumer that went away
+            Futex(&header_->spaceSeq, FUTEX_WAIT, seq, 10);
+        }
+        header_->producersWaiting.fetch_sub(1);
+    }
+
+    // Zeroes the 'size'-byte record at the tail of the ring and moves the tail past it
+    void Release(ReportRingRecord *record, uint64_t size)
+    {
+        // producers expect to find zeroed memory wherever they place their next record
+        memset(record->payload, 0, size - sizeof(ReportRingRecord));
+        record->owner.store(0, std::memory_order_relaxed);
+        record->word.store(0);
+        header_->tail.store(header_->tail.load(std::memory_order_relaxed) + size, std::memory_order_release);
+
+        if (header_->producersWaiting.load() != 0)
+        {
+            Wake(&header_->spaceSeq, INT_MAX);
+        }
+    }
+
+    // Whether 'pid' has exited (a zombie counts as exited: it will never write again)
+    static bool IsProcessGone(pid_t pid)
+    {
+        if (pid <= 0)
+        {
+            return false;
+        }
+
+        if (kill(pid, 0) == -1)
+        {
+            return errno == ESRCH;
+        }
+
+        char statPath[64];
+        snprintf(statPath, sizeof(statPath), "/proc/%d/stat", pid);
+        FILE *statFile = fopen(statPath, "r");
+        if (statFile == NULL)
+        {
+            return false;
+        }
+
+        // the state follows the parenthesized command name, which may itself contain parentheses
+        char stat[512];
+        size_t length = fread(stat, 1, sizeof(stat) - 1, statFile);
+        fclose(statFile);
+        stat[length] = '\0';
+
+        const char *nameEnd = strrchr(stat, ')');
+        return nameEnd != NULL && nameEnd[1] == ' ' && (nameEnd[2] == 'Z' || nameEnd[2] == 'X');
+    }
+
+public:
+
+    // ---------------------------------------------------------------------------------
+    // Consumer side (there must be only one consumer per ring)
+    // ---------------------------------------------------------------------------------
+
+    /**
+     * Copies the payload of the next committed record into 'buffer' and releases the record.
+     *
+     * Returns the length of the payload, 0 if there is no committed record available, or -1
+     * if the payload does not fit in 'bufferSize' bytes (in which case the record is dropped).
+     */
+    int Read(char *buffer, size_t bufferSize)
+    {
+        uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+        while (true)
+        {
+            ReportRingRecord *record = RecordAt(tail);
+            uint32_t word = record->word.load();
+            if ((word & ReportRingRecord::kCommitted) == 0)
+            {
+                return 0;
+            }
+
+            uint32_t length = word & ReportRingRecord::kLengthMask;
+            bool isPadding  = (word & ReportRingRecord::kPadding) != 0;
+            uint64_t size   = isPadding ? length : RecordSize(length);
+
+            int result = isPadding ? 0 : length <= bufferSize ? (int)length : -1;
+            if (result > 0)
+            {
+                memcpy(buffer, record->payload, length);
+            }
+
+            Release(record, size);
+            tail += size;
+
+            if (!isPadding)
+            {
+                return result;
+            }
+        }
+    }
+
+    /**
+     * Drops the record at the tail of the ring if it was reserved by a process that no longer
+     * exists (i.e., that was killed between reserving and committing it), which would otherwise
+     * keep the consumer from ever reading past it.  Returns whether a record was dropped.
+     *
+     * A producer killed in the few instructions between reserving a record and stamping it
+     * cannot be told apart from one that is still running; such a record still stalls the ring.
+     */
+    bool SkipAbandonedRecord()
+    {
+        uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+        ReportRingRecord *record = RecordAt(tail);
+        uint32_t word = record->word.load();
+        if ((word & (ReportRingRecord::kReserved | ReportRingRecord::kCommitted)) != ReportRingRecord::kReserved ||
+            !IsProcessGone((pid_t)record->owner.load()))
+        {
+            return false;
+        }
+
+        // the owner is gone, so the record can no longer be committed under our feet
+        Release(record, RecordSize(word & ReportRingRecord::kLengthMask));
+        return true;
+    }
+
+    /**
+     * Blocks for at most 'timeoutMs' milliseconds or until a producer commits a new record.
+     * Returns true if a committed record is available.
+     */
+    bool WaitForData(int timeoutMs)
+    {
+        header_->consumerWaiting.store(1);
+        uint32_t seq = header_->dataSeq.load();
+        bool hasData = HasCommittedRecord();
+        if (!hasData)
+        {
+            Futex(&header_->dataSeq, FUTEX_WAIT, seq, timeoutMs);
+            hasData = HasCommittedRecord();
+        }
+        header_->consumerWaiting.store(0);
+        return hasData;
+    }
+
+    /**
+     * Wakes up the consumer if it is blocked in 'WaitForData'.
+     */
+    void WakeConsumer()
+    {
+        Wake(&header_->dataSeq, 1);
+    }
+
+    bool HasCommittedRecord() const
+    {
+        uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+        return (RecordAt(tail)->word.load() & ReportRingRecord::kCommitted) != 0;
+    }
+
+    /**
+     * True when every reserved record has been consumed.  When this returns false while
+     * 'HasCommittedRecord' returns false, a producer is in the middle of writing a record.
+     */
+    bool IsDrained() const
+    {
+        return header_->head.load() == header_->tail.load();
+    }
+};
@@ -0,0 +1,219 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include <atomic>
+
+// Number of entries of a symlink cache (must be a power of 2)
+#define BxlSymlinkCacheNumEntries 2048
+
+// Maximum combined length of a cached path and its symlink target; longer ones are not cached
+#define BxlSymlinkCacheMaxDataLength 488
+
+// Milliseconds after which an entry is no longer trusted (bounding how long a change made by another process goes unnoticed)
+#define BxlSymlinkCacheMaxAgeMs 50
+
+/**
+ * An entry of a symlink cache.  'generation' is 0 while the entry is empty.
+ */
+struct SymlinkCacheEntry
+{
+    std::atomic<uint32_t> lock;
+    uint32_t hash;
+    uint64_t generation;
+
+    // when the entry was filled in (see 'SymlinkCache::NowMs')
+    uint64_t insertedAtMs;
+    uint16_t pathLength;
+
+    // -1 when the path is not a symlink
+    int16_t targetLength;
+
+    // the path followed by its symlink target (not null-terminated)
+    char data[BxlSymlinkCacheMaxDataLength];
+};
+
+/**
+ * A cache of what 'readlink' returned for the paths (typically, prefixes of paths) that a process resolved,
+ * recording for each either that it is not a symlink or its symlink target.
+ *
+ * The cache is private to a process (a forked child starts with an empty one) and only learns about
+ * changes to the file system that the process makes itself: every time the process creates, removes or renames
+ * a path the whole cache is invalidated by bumping its generation.  Changes made by other processes (e.g., a
+ * sibling replacing a directory with a symlink) are not observed, so an entry is only trusted for
+ * BxlSymlinkCacheMaxAgeMs after it was filled in.  Paths that do not exist are never cached as "not a symlink",
+ * since they are the ones most likely to be created later on (e.g., by a child process).
+ *
+ * The cache is direct-mapped with a fixed number of entries, each guarded by a lock that is only ever tried
+ * (a lookup or insert that finds the entry locked is a miss), so the cache never blocks and is safe to use from
+ * a signal handler or a forked child of a multi-threaded process.  Its memory is mapped on construction and
+ * only touched as entries are used.
+ */
+class SymlinkCache final
+{
+private:
+
+    SymlinkCacheEntry *entries_;
+    std::atomic<uint64_t> generation_;
+
+    /**
+     * FNV-1a hash of the path.
+     */
+    static uint32_t Hash(const char *path, size_t length)
+    {
+        uint32_t hash = 0x811c9dc5;
+        for (size_t i = 0; i < length; i++)
+        {
+            hash ^= (unsigned char)path[i];
+            hash *= 0x01000193;
+        }
+
+        return hash;
+    }
+
+    SymlinkCacheEntry* TryLock(uint32_t hash)
+    {
+        if (entries_ == NULL)
+        {
+            return NULL;
+        }
+
+        SymlinkCacheEntry *entry = &entries_[hash & (BxlSymlinkCacheNumEntries - 1)];
+        return entry->lock.exchange(1, std::memory_order_acquire) == 0 ? entry : NULL;
+    }
+
+    static void Unlock(SymlinkCacheEntry *entry)
+    {
+        entry->lock.store(0, std::memory_order_release);
+    }
+
+    /**
+     * Coarse monotonic clock (served from the vDSO, i.e., without a syscall) in milliseconds.
+     */
+    static uint64_t NowMs()
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+        return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+    }
+
+    static SymlinkCacheEntry* MapEntries()
+    {
+        // anonymous memory is zero-filled, i.e., every entry starts out empty and unlocked
+        void *addr = mmap(NULL, BxlSymlinkCacheNumEntries * sizeof(SymlinkCacheEntry), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return addr == MAP_FAILED ? NULL : (SymlinkCacheEntry*)addr;
+    }
+
+public:
+
+    enum Result { kMiss, kNotSymlink, kSymlink };
+
+    SymlinkCache() : entries_(MapEntries()), generation_(1)
+    {
+    }
+
+    SymlinkCache(const SymlinkCache&) = delete;
+    SymlinkCache& operator = (const SymlinkCache&) = delete;
+
+    /**
+     * Current generation of the cache, which must be read before calling 'readlink' on a path and then
+     * passed to 'Insert' (so that a result obtained before an invalidation never makes it into the cache).
+     */
+    uint64_t Generation() const { return generation_.load(std::memory_order_acquire); }
+
+    /**
+     * Looks up the first 'length' bytes of 'path'.  On kSymlink, copies the symlink target (not null-terminated)
+     * into 'target', which must hold at least BxlSymlinkCacheMaxDataLength bytes, and sets 'targetLength'.
+     */
+    Result Lookup(const char *path, size_t length, char *target, ssize_t *targetLength)
+    {
+        uint32_t hash = Hash(path, length);
+        SymlinkCacheEntry *entry = TryLock(hash);
+        if (entry == NULL)
+        {
+            return kMiss;
+        }
+
+        Result result = kMiss;
+        if (entry->generation == Generation() &&
+            NowMs() - entry->insertedAtMs <= BxlSymlinkCacheMaxAgeMs &&
+            entry->hash == hash &&
+            entry->pathLength == length &&
+            memcmp(entry->data, path, length) == 0)
+        {
+            result = entry->targetLength == -1 ? kNotSymlink : kSymlink;
+            if (result == kSymlink)
+            {
+                memcpy(target, entry->data + length, entry->targetLength);
+                *targetLength = entry->targetLength;
+            }
+        }
+
+        Unlock(entry);
+        return result;
+    }
+
+    /**
+     * Records that the first 'length' bytes of 'path' are a symlink to 'target' or, when 'targetLength'
+     * is -1, that they are not a symlink; 'generation' is what 'Generation' returned before 'readlink' was called.
+     */
+    void Insert(uint64_t generation, const char *path, size_t length, const char *target, ssize_t targetLength)
+    {
+        if (length + (targetLength > 0 ? targetLength : 0) > BxlSymlinkCacheMaxDataLength)
+        {
+            return;
+        }
+
+        uint32_t hash = Hash(path, length);
+        SymlinkCacheEntry *entry = TryLock(hash);
+        if (entry == NULL)
+        {
+            return;
+        }
+
+        if (generation == Generation())
+        {
+            entry->generation   = generation;
+            entry->insertedAtMs = NowMs();
+            entry->hash         = hash;
+            entry->pathLength   = (uint16_t)length;
+            entry->targetLength = (int16_t)targetLength;
+            memcpy(entry->data, path, length);
+            if (targetLength > 0)
+            {
+                memcpy(entry->data + length, target, targetLength);
+            }
+        }
+
+        Unlock(entry);
+    }
+
+    /**
+     * Forgets every entry.
+     */
+    void Invalidate()
+    {
+        generation_.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    /**
+     * Must be called in a forked child.  Entries that other threads of the parent held locked would stay
+     * locked forever (those threads do not exist in the child), so the child starts with a fresh cache.
+     */
+    void OnForked()
+    {
+        if (entries_ != NULL)
+        {
+            munmap(entries_, BxlSymlinkCacheNumEntries * sizeof(SymlinkCacheEntry));
+        }
+
+        entries_ = MapEntries();
+    }
+};
@@ -0,0 +1,209 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <string>
+
+#include "AccessDedupTable.hpp"
+#include "SandboxedRun.hpp"
+#include "TestHarness.hpp"
+
+// see RequestedAccess
+#define AccessRead  0x1u
+#define AccessWrite 0x2u
+#define AccessProbe 0x4u
+
+/** A table created in a file of its own, which is removed with it */
+class TestTable final
+{
+public:
+
+    explicit TestTable(uint64_t capacity, const std::string &path = std::string())
+    {
+        static int sNextId = 0;
+        path_ = !path.empty() ? path : "/tmp/bxldeduptest." + std::to_string(getpid()) + "." + std::to_string(sNextId++);
+        table_ = AccessDedupTable::Create(path_.c_str(), capacity);
+    }
+
+    ~TestTable()
+    {
+        delete table_;
+        unlink(path_.c_str());
+    }
+
+    bool IsValid() const { return table_ != NULL; }
+    const std::string& Path() const { return path_; }
+    AccessDedupTable& Table() { return *table_; }
+
+    bool Contains(const std::string &path, uint32_t access) { return table_->Contains(path.data(), path.size(), access, 0); }
+    void Record(const std::string &path, uint32_t access)   { table_->Record(path.data(), path.size(), access, 0); }
+
+    uint64_t Hits()       { return Counters().hits; }
+    uint64_t Misses()     { return Counters().misses; }
+    uint64_t Overflows()  { return Counters().overflows; }
+    uint64_t NumEntries() { return Counters().numEntries; }
+
+private:
+
+    struct Sums { uint64_t hits, misses, overflows, numEntries; };
+
+    Sums Counters()
+    {
+        Sums sums;
+        table_->GetCounters(&sums.hits, &sums.misses, &sums.overflows, &sums.numEntries);
+        return sums;
+    }
+
+    std::string path_;
+    AccessDedupTable *table_;
+};
+
+TEST(AccessDedupTable, RejectsCapacityThatIsNotPowerOfTwo)
+{
+    TestTable table(1000);
+    EXPECT_FALSE(table.IsValid());
+}
+
+TEST(AccessDedupTable, ContainsRecordedAccesses)
+{
+    TestTable table(1024);
+    ASSERT_TRUE(table.IsValid());
+
+    const std::string path = "/src/a.cpp";
+    EXPECT_FALSE(table.Contains(path, AccessProbe));
+
+    table.Record(path, AccessRead | AccessProbe);
+    EXPECT_TRUE(table.Contains(path, AccessProbe));
+    EXPECT_TRUE(table.Contains(path, AccessRead | AccessProbe));
+    EXPECT_FALSE(table.Contains(path, AccessWrite));
+    EXPECT_FALSE(table.Contains(path, AccessRead | AccessWrite));
+
+    // a path that is a prefix of the recorded one (i.e., differs only in length) is a different path
+    EXPECT_FALSE(table.Contains("/src/a.cp", AccessProbe));
+
+    // accesses only ever accumulate
+    table.Record(path, AccessProbe);
+    EXPECT_TRUE(table.Contains(path, AccessRead));
+
+    EXPECT_EQ(3u, table.Hits());
+    EXPECT_EQ(4u, table.Misses());
+    EXPECT_EQ(1u, table.NumEntries());
+}
+
+TEST(AccessDedupTable, DoesNotRecordEmptyAccess)
+{
+    TestTable table(1024);
+    ASSERT_TRUE(table.IsValid());
+
+    table.Record("/src/a.cpp", 0);
+    EXPECT_EQ(0u, table.NumEntries());
+}
+
+TEST(AccessDedupTable, OverflowsWhenFull)
+{
+    TestTable table(64);
+    ASSERT_TRUE(table.IsValid());
+
+    // the table takes up to 75% of its capacity; the paths that do not fit are never found, so their reports are sent
+    for (int i = 0; i < 64; i++)
+    {
+        table.Record("/src/" + std::to_string(i), AccessProbe);
+    }
+
+    EXPECT_EQ(48u, table.NumEntries());
+    EXPECT_EQ(16u, table.Overflows());
+    EXPECT_TRUE(table.Contains("/src/0", AccessProbe));
+    EXPECT_FALSE(table.Contains("/src/63", AccessProbe));
+}
+
+TEST(AccessDedupTable, AttachesToTableOfAnotherMapping)
+{
+    TestTable table(1024);
+    ASSERT_TRUE(table.IsValid());
+    table.Record("/src/a.cpp", AccessProbe);
+
+    int fd = open(table.Path().c_str(), O_RDWR | O_CLOEXEC);
+    ASSERT_TRUE(fd != -1);
+    AccessDedupTable *attached = AccessDedupTable::Attach(fd);
+    close(fd);
+    ASSERT_TRUE(attached != NULL);
+
+    const std::string path = "/src/a.cpp";
+    EXPECT_TRUE(attached->Contains(path.data(), path.size(), AccessProbe, 1));
+    EXPECT_EQ(1u, table.Hits());
+    delete attached;
+}
+
+TEST(AccessDedupTable, DoesNotAttachToOtherFile)
+{
+    std::string path = "/tmp/bxldeduptest." + std::to_string(getpid()) + ".other";
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    ASSERT_TRUE(fd != -1);
+    EXPECT_EQ(0, ftruncate(fd, 1 << 20));
+    EXPECT_TRUE(AccessDedupTable::Attach(fd) == NULL);
+    close(fd);
+    unlink(path.c_str());
+}
+
+// Writes 'f' under argv[1], then reads and probes it in a forked child and probes it again in the parent
+SCENARIO(ReadWrittenFile)
+{
+    std::string path = std::string(argv[1]) + "/f";
+    int fd = open(path.c_str(), O_CREAT | O_WRONLY, 0644);
+    if (fd == -1 || write(fd, "f", 1) != 1)
+    {
+        return 2;
+    }
+
+    close(fd);
+
+    pid_t child = fork();
+    if (child == 0)
+    {
+        fd = open(path.c_str(), O_RDONLY);
+        access(path.c_str(), F_OK);
+        _exit(fd != -1 ? 0 : 1);
+    }
+
+    int status;
+    if (child == -1 || waitpid(child, &status, 0) != child || status != 0)
+    {
+        return 3;
+    }
+
+    return access(path.c_str(), R_OK) == 0 ? 0 : 1;
+}
+
+static int CountReadsAndProbes(const SandboxedRun &run, const std::string &path)
+{
+    int count = 0;
+    for (const ObservedReport &report : run.ReportsOf(path))
+    {
+        count += report.requestedAccess != 0 && (report.requestedAccess & AccessWrite) == 0 ? 1 : 0;
+    }
+
+    return count;
+}
+
+TEST(AccessDedupTable, SuppressesReportsImpliedByWriteAcrossProcesses)
+{
+    SandboxedRun run;
+    TestTable table(1024, run.Path("dedup"));
+    ASSERT_TRUE(table.IsValid());
+    run.SetEnv("__BUILDXL_DEDUP_TABLE_PATH", table.Path());
+
+    ASSERT_EQ(0, run.Run("ReadWrittenFile", { run.Dir() }));
+    EXPECT_FALSE(run.ReportsOf(run.Path("f")).empty());
+    EXPECT_EQ(0, CountReadsAndProbes(run, run.Path("f")));
+    EXPECT_TRUE(table.Hits() >= 3);
+}
+
+TEST(AccessDedupTable, ReportsEveryAccessWithoutTable)
+{
+    SandboxedRun run;
+    ASSERT_EQ(0, run.Run("ReadWrittenFile", { run.Dir() }));
+    EXPECT_TRUE(CountReadsAndProbes(run, run.Path("f")) >= 3);
+}
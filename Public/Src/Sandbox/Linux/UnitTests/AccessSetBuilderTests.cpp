@@ -0,0 +1,145 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "Host/AccessSetBuilder.hpp"
+#include "OpNames.hpp"
+#include "SandboxedRun.hpp"
+#include "TestHarness.hpp"
+
+// see FileAccessStatus
+#define StatusAllowed 1u
+#define StatusDenied  2u
+
+/** Adds a report to 'set' the way the reader does, i.e., decoded from its wire format */
+static void Add(AccessSetBuilder &set, const std::string &path, uint16_t operation, int32_t pid, uint32_t access,
+    uint32_t status = StatusAllowed, bool reportExplicitly = false, uint32_t error = 0, uint32_t pathId = 0)
+{
+    std::vector<char> buffer(ReportFormat::EncodedSize(path.size(), false, pathId != 0));
+    ReportFormat::Encode(buffer.data(), buffer.size(), operation, pid, access, status, reportExplicitly, error, path.data(), path.size(), pathId);
+
+    ReportRecord record;
+    if (ReportFormat::Decode(buffer.data(), buffer.size(), &record))
+    {
+        set.Add(record);
+    }
+}
+
+static std::string PathOf(const ReportEntry &entry)
+{
+    return std::string(entry.path, entry.pathLength);
+}
+
+TEST(AccessSetBuilder, KeepsOneEntryPerPathSortedByPath)
+{
+    AccessSetBuilder set;
+    Add(set, "/b", 1, 100, 0x4);
+    Add(set, "/a/c", 1, 100, 0x4);
+    Add(set, "/a", 1, 100, 0x4);
+    Add(set, "/b", 1, 100, 0x4);
+    EXPECT_EQ(3u, set.Size());
+
+    // entries already in the vector are left alone
+    std::vector<ReportEntry> entries(1);
+    set.Build(&entries);
+    ASSERT_EQ(4u, entries.size());
+    EXPECT_EQ(std::string("/a"), PathOf(entries[1]));
+    EXPECT_EQ(std::string("/a/c"), PathOf(entries[2]));
+    EXPECT_EQ(std::string("/b"), PathOf(entries[3]));
+}
+
+TEST(AccessSetBuilder, FoldsReportsOfPath)
+{
+    AccessSetBuilder set;
+    Add(set, "/f", 10, 100, 0x4, StatusAllowed, false, 2);
+    Add(set, "/f", 11, 101, 0x1, StatusDenied, true, 0, 7);
+    Add(set, "/f", 12, 102, 0x4, StatusAllowed, false, 2, 8);
+
+    std::vector<ReportEntry> entries;
+    set.Build(&entries);
+    ASSERT_EQ(1u, entries.size());
+
+    const ReportEntry &entry = entries[0];
+    EXPECT_EQ(0x5u, entry.requestedAccess);
+    EXPECT_EQ(100, entry.pid);
+
+    // the last report that added an access, not the last report
+    EXPECT_EQ(11, (int)entry.operation);
+    EXPECT_EQ(StatusDenied, entry.status);
+    EXPECT_TRUE((entry.flags & ReportRecord::kFlagReportExplicitly) != 0);
+    EXPECT_EQ(0u, entry.error);
+    EXPECT_EQ(7u, entry.pathId);
+}
+
+TEST(AccessSetBuilder, KeepsErrorOfFirstReportWhenEveryReportFailed)
+{
+    AccessSetBuilder set;
+    Add(set, "/missing", 1, 100, 0x4, StatusAllowed, false, 2);
+    Add(set, "/missing", 1, 100, 0x4, StatusAllowed, false, 20);
+
+    std::vector<ReportEntry> entries;
+    set.Build(&entries);
+    ASSERT_EQ(1u, entries.size());
+    EXPECT_EQ(2u, entries[0].error);
+}
+
+// Probes and reads 'f' under argv[1] many times, in this process and in a forked child
+SCENARIO(AccessFileRepeatedly)
+{
+    std::string path = std::string(argv[1]) + "/f";
+    int fd = open(path.c_str(), O_CREAT | O_WRONLY, 0644);
+    if (fd == -1)
+    {
+        return 2;
+    }
+
+    close(fd);
+
+    pid_t child = fork();
+    for (int i = 0; i < 50; i++)
+    {
+        access(path.c_str(), F_OK);
+        fd = open(path.c_str(), O_RDONLY);
+        close(fd);
+    }
+
+    if (child == 0)
+    {
+        _exit(0);
+    }
+
+    int status;
+    return child != -1 && waitpid(child, &status, 0) == child && status == 0 ? 0 : 1;
+}
+
+TEST(AccessSetBuilder, FoldsReportsOfSandboxedProcesses)
+{
+    SandboxedRun run;
+    run.BuildAccessSet();
+    ASSERT_EQ(0, run.Run("AccessFileRepeatedly", { run.Dir() }));
+
+    std::vector<ObservedReport> reports = run.ReportsOf(run.Path("f"));
+    ASSERT_EQ(1u, reports.size());
+    EXPECT_EQ(0x7u, reports[0].requestedAccess & 0x7u);
+
+    // the process reports are not folded: the host tracks the processes of the pip with them
+    std::vector<int32_t> exited;
+    for (const ObservedReport &report : run.Reports())
+    {
+        if (report.operation == FileOperation::kOpProcessExit)
+        {
+            exited.push_back(report.pid);
+        }
+    }
+
+    std::sort(exited.begin(), exited.end());
+    EXPECT_EQ(2, (int)(std::unique(exited.begin(), exited.end()) - exited.begin()));
+}
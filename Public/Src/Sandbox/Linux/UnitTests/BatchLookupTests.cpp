@@ -0,0 +1,168 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <string>
+#include <vector>
+
+#include "OpNames.hpp"
+#include "PolicyCursorCache.hpp"
+#include "SandboxedRun.hpp"
+#include "TestAccessHandler.hpp"
+#include "TestHarness.hpp"
+
+static ManifestBuilder NestedScopes()
+{
+    ManifestBuilder manifest;
+    manifest.AddScope("/src", FileAccessPolicy_AllowRead, FileAccessPolicy_AllowRead, 1);
+    manifest.AddScope("/src/project/out", ManifestBuilder::kAllowAllAndReport, FileAccessPolicy_AllowRead, 2);
+    manifest.AddScope("/src/project/out/bin/app", FileAccessPolicy_AllowRead, FileAccessPolicy_AllowRead, 3);
+    manifest.AddScope("/src/project/out/lib", FileAccessPolicy_AllowRead, FileAccessPolicy_AllowRead, 4);
+    return manifest;
+}
+
+// out of order, with duplicates, paths at the root, a path that is the parent directory of others, paths in and
+// around the scopes, and directories that share a prefix without being the same
+static const std::vector<std::string> sPaths
+{
+    "/src/project/out/obj/b.o", "/src/project/out/obj/a.o", "/src", "/src/project/out/bin/app",
+    "/src/project/out/bin/app/data", "/other", "/src/project/out/obj", "/src/project/out/obj/a.o",
+    "/src/project/out/lib/x.so", "/src/project/out/libs/x.so", "/src/project/out/li/x.so", "/src/file",
+    "/src/project/out/obj/c.o", "/", "/src/project/out/bin/app/data/f", "/src/project/ou/x",
+};
+
+static std::vector<const char*> PathPointers(const std::vector<std::string> &paths)
+{
+    std::vector<const char*> pointers;
+    for (const std::string &path : paths)
+    {
+        pointers.push_back(path.c_str());
+    }
+
+    return pointers;
+}
+
+static void ExpectSameAsSingleLookups(bool compileIndex)
+{
+    // the single lookups are made by another handler, so that they do not use what the batch cached
+    TestAccessHandler batch(NestedScopes(), 1, compileIndex);
+    TestAccessHandler single(NestedScopes(), 1, compileIndex);
+    std::vector<const char*> paths = PathPointers(sPaths);
+
+    std::vector<PolicySearchCursor> cursors(paths.size());
+    batch.FindManifestRecords(paths.data(), paths.size(), cursors.data());
+    std::vector<PolicyResult> policies = batch.PolicyForPaths(paths.data(), paths.size());
+    ASSERT_EQ(paths.size(), policies.size());
+
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        PolicySearchCursor expected = single.FindManifestRecord(paths[i]);
+        EXPECT_EQ((uint32_t)expected.Record->GetPathId(), (uint32_t)cursors[i].Record->GetPathId());
+        EXPECT_EQ((uint32_t)expected.Record->GetConePolicy(), (uint32_t)cursors[i].Record->GetConePolicy());
+        EXPECT_EQ(expected.SearchWasTruncated, cursors[i].SearchWasTruncated);
+
+        PolicyResult policy = single.PolicyForPath(paths[i]);
+        EXPECT_EQ((uint32_t)policy.GetPolicy(), (uint32_t)policies[i].GetPolicy());
+        EXPECT_EQ((uint32_t)policy.GetExactPathId(), (uint32_t)policies[i].GetExactPathId());
+        EXPECT_EQ(std::string(paths[i]), std::string(policies[i].GetCanonicalizedPath()));
+    }
+}
+
+TEST(BatchLookup, FindsSameRecordsAsSingleLookups)
+{
+    ExpectSameAsSingleLookups(/*compileIndex*/ false);
+}
+
+TEST(BatchLookup, FindsSameRecordsAsSingleLookupsInIndex)
+{
+    ExpectSameAsSingleLookups(/*compileIndex*/ true);
+}
+
+TEST(BatchLookup, LooksUpSharedDirectoryOnce)
+{
+    TestAccessHandler handler(NestedScopes());
+    std::vector<std::string> files;
+    for (int i = 9; i >= 0; i--)
+    {
+        files.push_back("/src/project/out/obj/f" + std::to_string(i));
+        files.push_back("/src/project/out/lib/f" + std::to_string(i));
+    }
+
+    std::vector<const char*> paths = PathPointers(files);
+    std::vector<PolicySearchCursor> cursors(paths.size());
+    handler.FindManifestRecords(paths.data(), paths.size(), cursors.data());
+
+    // the files of each directory are next to each other once sorted, so each directory is looked up once (debug
+    // builds also look every path up on its own, once its directory is cached, which only adds hits)
+    PolicyCursorCache *cache = handler.GetPip()->GetPolicyCursorCache();
+    EXPECT_EQ(2u, cache->GetNumMisses());
+#if !(DEBUG || _DEBUG)
+    EXPECT_EQ(0u, cache->GetNumHits());
+#endif
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        EXPECT_EQ(i % 2 == 0 ? 2u : 4u, (uint32_t)cursors[i].Record->GetPathId());
+        EXPECT_TRUE(cursors[i].SearchWasTruncated);
+    }
+}
+
+TEST(BatchLookup, LooksUpEmptyBatch)
+{
+    TestAccessHandler handler(NestedScopes());
+    EXPECT_TRUE(handler.PolicyForPaths(nullptr, 0).empty());
+}
+
+// Renames argv[1]/z to argv[1]/a and links argv[1]/y to argv[1]/b, i.e., operations on two paths whose policies are
+// looked up together, with the source sorting after the destination
+SCENARIO(RenameAndLink)
+{
+    std::string dir = argv[1];
+    for (const char *name : { "z", "y" })
+    {
+        int fd = open((dir + "/" + name).c_str(), O_CREAT | O_WRONLY, 0644);
+        if (fd == -1)
+        {
+            return 2;
+        }
+
+        close(fd);
+    }
+
+    return rename((dir + "/z").c_str(), (dir + "/a").c_str()) == 0 && link((dir + "/y").c_str(), (dir + "/b").c_str()) == 0 ? 0 : 1;
+}
+
+TEST(BatchLookup, ReportsPolicyOfEachPathOfTwoPathOperations)
+{
+    SandboxedRun run;
+    run.Manifest()
+        .AddScope(run.Path("z"), ManifestBuilder::kAllowAllAndReport, ManifestBuilder::kAllowAllAndReport, 11)
+        .AddScope(run.Path("a"), ManifestBuilder::kAllowAllAndReport, ManifestBuilder::kAllowAllAndReport, 12)
+        .AddScope(run.Path("y"), ManifestBuilder::kAllowAllAndReport, ManifestBuilder::kAllowAllAndReport, 13)
+        .AddScope(run.Path("b"), ManifestBuilder::kAllowAllAndReport, ManifestBuilder::kAllowAllAndReport, 14);
+
+    int status = run.Run("RenameAndLink", { run.Dir() });
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+
+    struct { int operation; const char *name; uint32_t pathId; } expected[] =
+    {
+        { FileOperation::kOpKAuthMoveSource,           "z", 11 },
+        { FileOperation::kOpKAuthMoveDest,             "a", 12 },
+        { FileOperation::kOpKAuthCreateHardlinkSource, "y", 13 },
+        { FileOperation::kOpKAuthCreateHardlinkDest,   "b", 14 },
+    };
+
+    for (const auto &e : expected)
+    {
+        std::vector<ObservedReport> reports = run.ReportsOf(e.operation, run.Path(e.name));
+        ASSERT_FALSE(reports.empty());
+        for (const ObservedReport &report : reports)
+        {
+            EXPECT_EQ(e.pathId, report.pathId);
+        }
+    }
+}
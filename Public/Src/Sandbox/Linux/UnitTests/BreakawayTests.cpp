@@ -0,0 +1,142 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <limits.h>
+#include <spawn.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "OpNames.hpp"
+#include "SandboxedRun.hpp"
+#include "TestHarness.hpp"
+
+extern char **environ;
+
+static std::string GetTestBinaryPath()
+{
+    char path[PATH_MAX];
+    ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    return length > 0 ? std::string(path, length) : std::string();
+}
+
+static std::string GetTestBinaryName()
+{
+    std::string path = GetTestBinaryPath();
+    return path.substr(path.rfind('/') + 1);
+}
+
+// Probes argv[1]/child; exits with 0 if it runs without LD_PRELOAD (i.e., unmonitored) and with 4 otherwise
+SCENARIO(BrokenAway)
+{
+    access((std::string(argv[1]) + "/child").c_str(), F_OK);
+    return getenv("LD_PRELOAD") == NULL ? 0 : 4;
+}
+
+// Probes argv[2]/root, then runs BrokenAway in a child started the way given by argv[1] ('exec' or 'spawn'), or
+// ('missing') tries to exec a missing program named like the test binary and probes argv[2]/afterFailure;
+// exits with the child's exit code
+SCENARIO(StartChild)
+{
+    std::string how = argv[1];
+    std::string dir = argv[2];
+    access((dir + "/root").c_str(), F_OK);
+
+    std::string binary = GetTestBinaryPath();
+    std::string missing = dir + "/" + GetTestBinaryName();
+    char scenario[] = "--scenario", name[] = "BrokenAway";
+    char *args[] = { &binary[0], scenario, name, argv[2], NULL };
+
+    pid_t child;
+    if (how == "spawn")
+    {
+        if (posix_spawn(&child, binary.c_str(), NULL, NULL, args, environ) != 0)
+        {
+            return 2;
+        }
+    }
+    else
+    {
+        child = fork();
+        if (child == 0)
+        {
+            if (how == "missing")
+            {
+                execv(missing.c_str(), args);
+                access((dir + "/afterFailure").c_str(), F_OK);
+                _exit(0);
+            }
+
+            execv(binary.c_str(), args);
+            _exit(3);
+        }
+    }
+
+    int status;
+    return child != -1 && waitpid(child, &status, 0) == child && WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+static void ExpectChildBrokenAway(const char *how)
+{
+    SandboxedRun run;
+    run.Manifest().AddBreakaway(GetTestBinaryName());
+    int status = run.Run("StartChild", { how, run.Dir() });
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(0, WEXITSTATUS(status));
+
+    // the root process runs the program that breaks away, but is never broken away itself
+    EXPECT_FALSE(run.ReportsOf(run.Path("root")).empty());
+    EXPECT_TRUE(run.ReportsOf(run.Path("child")).empty());
+    EXPECT_EQ(1u, run.ReportsOf(FileOperation::kOpProcessBreakaway, GetTestBinaryPath()).size());
+}
+
+TEST(Breakaway, BreaksAwayOnExec)
+{
+    ExpectChildBrokenAway("exec");
+}
+
+TEST(Breakaway, BreaksAwayWhenSpawned)
+{
+    // posix_spawn execs the program without going through the interposed 'exec', so it breaks away at initialization
+    ExpectChildBrokenAway("spawn");
+}
+
+TEST(Breakaway, MonitorsChildNotToBreakAway)
+{
+    SandboxedRun run;
+    run.Manifest().AddBreakaway(GetTestBinaryName() + "x");
+    int status = run.Run("StartChild", { "exec", run.Dir() });
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(4, WEXITSTATUS(status));
+    EXPECT_FALSE(run.ReportsOf(run.Path("child")).empty());
+    EXPECT_TRUE(run.ReportsOf(FileOperation::kOpProcessBreakaway, GetTestBinaryPath()).empty());
+}
+
+TEST(Breakaway, ReportsFailedBreakawayAndKeepsMonitoring)
+{
+    SandboxedRun run;
+    run.Manifest().AddBreakaway(GetTestBinaryName());
+    int status = run.Run("StartChild", { "missing", run.Dir() });
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(0, WEXITSTATUS(status));
+
+    // the breakaway is taken back by reporting the process as started again, under the same path (the exec itself
+    // is reported as a start too, but before the breakaway)
+    std::string missing = run.Path(GetTestBinaryName());
+    EXPECT_EQ(1u, run.ReportsOf(FileOperation::kOpProcessBreakaway, missing).size());
+    const std::vector<ObservedReport> &reports = run.Reports();
+    auto breakaway = std::find_if(reports.begin(), reports.end(), [&](const ObservedReport &report)
+    {
+        return report.operation == FileOperation::kOpProcessBreakaway && report.path == missing;
+    });
+    ASSERT_TRUE(breakaway != reports.end());
+    EXPECT_TRUE(std::any_of(breakaway, reports.end(), [&](const ObservedReport &report)
+    {
+        return report.operation == FileOperation::kOpProcessStart && report.path == missing && report.pid == breakaway->pid;
+    }));
+    EXPECT_FALSE(run.ReportsOf(run.Path("afterFailure")).empty());
+}
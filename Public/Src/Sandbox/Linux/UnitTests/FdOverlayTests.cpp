@@ -0,0 +1,131 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include <string>
+
+#include "SandboxedRun.hpp"
+#include "TestHarness.hpp"
+
+// behind the sandbox's back, so that the overlay only learns about the descriptor when it is used
+static int RawOpen(const std::string &path, int flags)
+{
+    return (int)syscall(SYS_openat, AT_FDCWD, path.c_str(), flags | O_CLOEXEC, 0644);
+}
+
+// Writes 'a' through a descriptor (which fills in its overlay entry), gives up the descriptor the way given by argv[1]
+// so that it ends up referring to 'b' (opened behind the sandbox's back), and writes through it again
+SCENARIO(ReuseDescriptor)
+{
+    std::string how = argv[1];
+    std::string dir = argv[2];
+    int fd = open((dir + "/a").c_str(), O_CREAT | O_WRONLY, 0644);
+    if (fd == -1 || write(fd, "a", 1) != 1)
+    {
+        return 2;
+    }
+
+    int reused = -1;
+    if (how == "close")
+    {
+        close(fd);
+        reused = RawOpen(dir + "/b", O_CREAT | O_WRONLY);
+    }
+    else if (how == "close_range")
+    {
+        close_range(fd, fd, 0);
+        reused = RawOpen(dir + "/b", O_CREAT | O_WRONLY);
+    }
+    else if (how == "dup2" || how == "dup3")
+    {
+        int other = RawOpen(dir + "/b", O_CREAT | O_WRONLY);
+        reused = (how == "dup2" ? dup2(other, fd) : dup3(other, fd, 0));
+    }
+
+    if (reused != fd)
+    {
+        return 3;
+    }
+
+    return write(fd, "b", 1) == 1 ? 0 : 1;
+}
+
+// Opens a stream on 'a' the way given by argv[1], removes 'a' and then reads from the stream: the read is reported
+// on 'a' only if the overlay learned the path when the stream was opened (afterwards, /proc/self/fd reads "a (deleted)")
+SCENARIO(ReadRemovedFile)
+{
+    std::string how = argv[1];
+    std::string path = std::string(argv[2]) + "/a";
+    int fd = RawOpen(path, O_CREAT | O_WRONLY);
+    if (fd == -1 || write(fd, "a", 1) != 1)
+    {
+        return 2;
+    }
+
+    close(fd);
+
+    FILE *f = how == "fopen" ? fopen(path.c_str(), "r") : fdopen(RawOpen(path, O_RDONLY), "r");
+    if (f == NULL || unlink(path.c_str()) != 0)
+    {
+        return 3;
+    }
+
+    char c;
+    return fread(&c, 1, 1, f) == 1 ? 0 : 1;
+}
+
+static void ExpectWriteReportedOnReusedDescriptor(const char *how)
+{
+    SandboxedRun run;
+    int status = run.Run("ReuseDescriptor", { how, run.Dir() });
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+    EXPECT_FALSE(run.ReportsOf(run.Path("a")).empty());
+    EXPECT_FALSE(run.ReportsOf(run.Path("b")).empty());
+}
+
+static void ExpectReadReportedOnOpenedPath(const char *how)
+{
+    SandboxedRun run;
+    int status = run.Run("ReadRemovedFile", { how, run.Dir() });
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+    EXPECT_FALSE(run.ReportsOf(run.Path("a")).empty());
+    EXPECT_TRUE(run.ReportsOf(run.Path("a") + " (deleted)").empty());
+}
+
+TEST(FdOverlay, ForgetsDescriptorClosedByClose)
+{
+    ExpectWriteReportedOnReusedDescriptor("close");
+}
+
+TEST(FdOverlay, ForgetsDescriptorClosedByCloseRange)
+{
+    ExpectWriteReportedOnReusedDescriptor("close_range");
+}
+
+TEST(FdOverlay, ForgetsDescriptorReplacedByDup2)
+{
+    ExpectWriteReportedOnReusedDescriptor("dup2");
+}
+
+TEST(FdOverlay, ForgetsDescriptorReplacedByDup3)
+{
+    ExpectWriteReportedOnReusedDescriptor("dup3");
+}
+
+TEST(FdOverlay, LearnsPathFromFopen)
+{
+    ExpectReadReportedOnOpenedPath("fopen");
+}
+
+TEST(FdOverlay, LearnsPathFromFdopen)
+{
+    ExpectReadReportedOnOpenedPath("fdopen");
+}
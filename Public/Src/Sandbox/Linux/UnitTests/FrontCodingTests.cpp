@@ -0,0 +1,211 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <limits.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <array>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ReportFormat.hpp"
+#include "SandboxedRun.hpp"
+#include "TestHarness.hpp"
+
+#define NumFrontCodingThreads 4
+#define NumPathsPerThread     200
+
+/** The host's side of front coding: the slots of one producer (see ReportReader::AddRecord) */
+class FrontCodingDecoder final
+{
+public:
+
+    // Codes 'path' with 'encoder', sends it through the wire format and returns the path this decoder reconstructs
+    std::string RoundTrip(FrontCodingEncoder &encoder, const std::string &path)
+    {
+        int slot;
+        size_t prefixLength;
+        if (!encoder.Code(path.data(), path.size(), &slot, &prefixLength))
+        {
+            return std::string();
+        }
+
+        std::vector<char> buffer(ReportFormat::EncodedSize(path.size() - prefixLength, true));
+        ReportFormat::EncodeFrontCoded(
+            buffer.data(), buffer.size(), 3, 1000, 0x4, 1, false, 0, path.data(), path.size(), encoder.ProducerId(), slot, prefixLength);
+
+        ReportRecord record;
+        if (!ReportFormat::Decode(buffer.data(), buffer.size(), &record) || record.prefixLength > slots_[record.slot].size())
+        {
+            return std::string();
+        }
+
+        std::string &previous = slots_[record.slot];
+        previous.resize(record.prefixLength);
+        previous.append(record.path, record.pathLength);
+        return previous;
+    }
+
+private:
+
+    std::array<std::string, BxlFrontCodingNumSlots> slots_;
+};
+
+TEST(FrontCoding, CodesAgainstSlotWithLongestSharedPrefix)
+{
+    FrontCodingEncoder encoder(1);
+    int slot, sourceSlot;
+    size_t prefixLength;
+
+    ASSERT_TRUE(encoder.Code("/src/project/a.cpp", 18, &sourceSlot, &prefixLength));
+    EXPECT_EQ(0u, prefixLength);
+
+    // shares too short a prefix with the source file, so it takes a slot of its own (an empty one)
+    ASSERT_TRUE(encoder.Code("/out/a.o", 8, &slot, &prefixLength));
+    EXPECT_TRUE(slot != sourceSlot);
+    EXPECT_EQ(0u, prefixLength);
+
+    ASSERT_TRUE(encoder.Code("/src/project/b.cpp", 18, &slot, &prefixLength));
+    EXPECT_EQ(sourceSlot, slot);
+    EXPECT_EQ(13u, prefixLength);
+
+    // the slot now holds the last path coded against it
+    ASSERT_TRUE(encoder.Code("/src/project/b.hpp", 18, &slot, &prefixLength));
+    EXPECT_EQ(sourceSlot, slot);
+    EXPECT_EQ(15u, prefixLength);
+}
+
+TEST(FrontCoding, ReplacesLeastRecentlyUsedSlot)
+{
+    FrontCodingEncoder encoder(1);
+    int slot;
+    size_t prefixLength;
+    std::vector<int> slots;
+    for (int i = 0; i < BxlFrontCodingNumSlots; i++)
+    {
+        std::string path = "/" + std::to_string(i) + "/unrelated";
+        ASSERT_TRUE(encoder.Code(path.data(), path.size(), &slot, &prefixLength));
+        slots.push_back(slot);
+    }
+
+    // every slot is in use by now; refreshing the first one makes the second the least recently used
+    ASSERT_TRUE(encoder.Code("/0/unrelated", 12, &slot, &prefixLength));
+    EXPECT_EQ(slots[0], slot);
+    EXPECT_EQ(12u, prefixLength);
+
+    ASSERT_TRUE(encoder.Code("/9/unrelated", 12, &slot, &prefixLength));
+    EXPECT_EQ(slots[1], slot);
+}
+
+TEST(FrontCoding, ForgetsPathsOnReset)
+{
+    FrontCodingEncoder encoder(1);
+    int slot;
+    size_t prefixLength;
+    ASSERT_TRUE(encoder.Code("/src/project/a.cpp", 18, &slot, &prefixLength));
+    encoder.Reset();
+    ASSERT_TRUE(encoder.Code("/src/project/a.cpp", 18, &slot, &prefixLength));
+    EXPECT_EQ(0u, prefixLength);
+}
+
+TEST(FrontCoding, DoesNotCodePathTooLong)
+{
+    FrontCodingEncoder encoder(1);
+    int slot;
+    size_t prefixLength;
+    std::string path(PATH_MAX, 'x');
+    EXPECT_FALSE(encoder.Code(path.data(), path.size(), &slot, &prefixLength));
+    EXPECT_TRUE(encoder.Code(path.data(), path.size() - 1, &slot, &prefixLength));
+}
+
+TEST(FrontCoding, RoundTripsPaths)
+{
+    // paths sharing prefixes of every length with each other, from interleaved directories, including repeated
+    // paths, paths that are prefixes of earlier ones and the empty path
+    std::vector<std::string> paths { "", "/", "/src", "/src/", "/src/a", "/src", "" };
+    for (int i = 0; i < 500; i++)
+    {
+        std::string dir = "/d" + std::to_string(i % 7) + "/sub" + std::to_string(i % 3);
+        paths.push_back(dir + "/file" + std::to_string(i % 11) + (i % 2 ? ".cpp" : ".o"));
+        paths.push_back(dir);
+    }
+
+    FrontCodingEncoder encoder(1);
+    FrontCodingDecoder decoder;
+    for (const std::string &path : paths)
+    {
+        ASSERT_EQ(path, decoder.RoundTrip(encoder, path));
+    }
+}
+
+// Probes NumPathsPerThread paths (sharing prefixes) under argv[1] from each of NumFrontCodingThreads threads at once,
+// and from a forked child
+SCENARIO(ProbeSimilarPaths)
+{
+    std::string dir = argv[1];
+    auto probe = [&dir](const std::string &who)
+    {
+        for (int i = 0; i < NumPathsPerThread; i++)
+        {
+            access((dir + "/" + who + "/sub" + std::to_string(i % 3) + "/f" + std::to_string(i)).c_str(), F_OK);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < NumFrontCodingThreads; t++)
+    {
+        threads.emplace_back(probe, "t" + std::to_string(t));
+    }
+
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    pid_t child = fork();
+    if (child == 0)
+    {
+        probe("child");
+        _exit(0);
+    }
+
+    int status;
+    return child != -1 && waitpid(child, &status, 0) == child && status == 0 ? 0 : 1;
+}
+
+static void ExpectSimilarPathsReceived(SandboxedRun &run)
+{
+    run.SetEnv("__BUILDXL_FRONT_CODE_PATHS", "1");
+    ASSERT_EQ(0, run.Run("ProbeSimilarPaths", { run.Dir() }));
+
+    std::vector<std::string> whos { "child" };
+    for (int t = 0; t < NumFrontCodingThreads; t++)
+    {
+        whos.push_back("t" + std::to_string(t));
+    }
+
+    for (const std::string &who : whos)
+    {
+        for (int i = 0; i < NumPathsPerThread; i++)
+        {
+            EXPECT_EQ(1u, run.ReportsOf(run.Path(who + "/sub" + std::to_string(i % 3) + "/f" + std::to_string(i))).size());
+        }
+    }
+
+    EXPECT_EQ(0, run.NumMalformed());
+}
+
+TEST(FrontCoding, ReconstructsPathsOfSandboxedProcesses)
+{
+    SandboxedRun run;
+    ExpectSimilarPathsReceived(run);
+}
+
+TEST(FrontCoding, ReconstructsBatchedPathsOfSandboxedProcesses)
+{
+    SandboxedRun run;
+    run.SetEnv("__BUILDXL_BATCH_REPORTS", "1");
+    ExpectSimilarPathsReceived(run);
+}
@@ -0,0 +1,137 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <string>
+
+#include "SandboxedRun.hpp"
+#include "TestHarness.hpp"
+
+#ifndef SYS_openat2
+#define SYS_openat2 437
+#endif
+
+// Makes every 'openat2' of this process (and of the images it executes) fail with 'error'
+static bool FailOpenat2(int error)
+{
+    struct sock_filter filter[] =
+    {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, arch)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, 0, 3),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, SYS_openat2, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | (error & SECCOMP_RET_DATA)),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+    };
+
+    struct sock_fprog program = { (unsigned short)(sizeof(filter) / sizeof(filter[0])), filter };
+    return prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == 0 && prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &program) == 0;
+}
+
+// Probes, under argv[1], a file at the end of a long path with no symlinks on the way, the same file through a symlink
+// to a directory on the way and through the magic link to the working directory, and a path through a symlink cycle
+SCENARIO(ResolvePaths)
+{
+    std::string dir = argv[1];
+    access((dir + "/real/a/b/c/f").c_str(), F_OK);
+    access((dir + "/link/a/b/c/f").c_str(), F_OK);
+    access((dir + "/loop1/a/b/c/f").c_str(), F_OK);
+
+    if (chdir(dir.c_str()) != 0)
+    {
+        return 2;
+    }
+
+    access("/proc/self/cwd/real/a/b/c/f", F_OK);
+    return 0;
+}
+
+// Runs ResolvePaths for argv[3] with every 'openat2' failing with errno argv[1], starting either before the sandbox
+// checks whether it can use 'openat2' when it is loaded (argv[2] is "atLoad", which takes a new image of this binary)
+// or afterwards
+SCENARIO(ResolvePathsWithFailingOpenat2)
+{
+    if (!FailOpenat2(atoi(argv[1])))
+    {
+        return 2;
+    }
+
+    if (std::string(argv[2]) != "atLoad")
+    {
+        return Scenario_ResolvePaths(argc - 2, argv + 2);
+    }
+
+    char binary[PATH_MAX];
+    ssize_t length = readlink("/proc/self/exe", binary, sizeof(binary) - 1);
+    if (length <= 0)
+    {
+        return 3;
+    }
+
+    binary[length] = '\0';
+    char scenario[] = "--scenario", name[] = "ResolvePaths";
+    char *args[] = { binary, scenario, name, argv[3], NULL };
+    execv(binary, args);
+    return 4;
+}
+
+static void ExpectPathsResolved(const char *scenario, const std::vector<std::string> &args = {})
+{
+    // set up behind the sandbox's back, so that the only reports on the paths are those of the scenario
+    SandboxedRun run;
+    ASSERT_EQ(0, mkdir(run.Path("real").c_str(), S_IRWXU));
+    ASSERT_EQ(0, mkdir(run.Path("real/a").c_str(), S_IRWXU));
+    ASSERT_EQ(0, mkdir(run.Path("real/a/b").c_str(), S_IRWXU));
+    ASSERT_EQ(0, mkdir(run.Path("real/a/b/c").c_str(), S_IRWXU));
+    int fd = open(run.Path("real/a/b/c/f").c_str(), O_CREAT | O_WRONLY | O_CLOEXEC, 0644);
+    ASSERT_TRUE(fd != -1);
+    close(fd);
+    ASSERT_EQ(0, symlink("real", run.Path("link").c_str()));
+    ASSERT_EQ(0, symlink("loop2", run.Path("loop1").c_str()));
+    ASSERT_EQ(0, symlink("loop1", run.Path("loop2").c_str()));
+
+    std::vector<std::string> scenarioArgs = args;
+    scenarioArgs.push_back(run.Dir());
+    ASSERT_EQ(0, run.Run(scenario, scenarioArgs));
+
+    // every way to the file ends up at the file, and every symlink followed on the way is reported as read
+    EXPECT_EQ(3u, run.ReportsOf(run.Path("real/a/b/c/f")).size());
+    EXPECT_TRUE(run.ReportsOf(run.Path("link/a/b/c/f")).empty());
+    EXPECT_FALSE(run.ReportsOf(run.Path("link")).empty());
+
+    // the cycle is followed until the sandbox gives up on it
+    EXPECT_FALSE(run.ReportsOf(run.Path("loop1")).empty());
+    EXPECT_FALSE(run.ReportsOf(run.Path("loop2")).empty());
+}
+
+TEST(KernelResolve, ResolvesPaths)
+{
+    ExpectPathsResolved("ResolvePaths");
+}
+
+TEST(KernelResolve, ResolvesPathsWithoutOpenat2)
+{
+    ExpectPathsResolved("ResolvePathsWithFailingOpenat2", { std::to_string(ENOSYS), "atLoad" });
+}
+
+TEST(KernelResolve, ResolvesPathsWhenOpenat2IsNotPermitted)
+{
+    ExpectPathsResolved("ResolvePathsWithFailingOpenat2", { std::to_string(EPERM), "atLoad" });
+}
+
+TEST(KernelResolve, FallsBackWhenOpenat2Fails)
+{
+    // e.g., a walk that crosses into a file system the kernel does not let 'openat2' resolve
+    ExpectPathsResolved("ResolvePathsWithFailingOpenat2", { std::to_string(EXDEV), "afterLoad" });
+}
@@ -0,0 +1,365 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <string.h>
+
+#include <deque>
+
+#include "ManifestBuilder.hpp"
+#include "PolicyIndex.hpp"
+
+#ifdef _DEBUG
+#define ManifestDebugFlagValue 0xDB600001
+#else
+#define ManifestDebugFlagValue 0xDB600000
+#endif
+
+#define DefaultManifestFlags ((uint32_t)(FileAccessManifestFlag::ReportAllFileAccesses | FileAccessManifestFlag::MonitorChildProcesses))
+#define TestPipId            0x1234
+
+static void Put32(std::vector<char> &buffer, uint32_t value)
+{
+    buffer.insert(buffer.end(), (const char*)&value, (const char*)&value + sizeof(value));
+}
+
+static void Put64(std::vector<char> &buffer, uint64_t value)
+{
+    buffer.insert(buffer.end(), (const char*)&value, (const char*)&value + sizeof(value));
+}
+
+static void PutTag(std::vector<char> &buffer, uint32_t tag)
+{
+#ifdef _DEBUG
+    Put32(buffer, tag);
+#endif
+}
+
+static void Align(std::vector<char> &buffer, size_t alignment)
+{
+    buffer.resize((buffer.size() + alignment - 1) / alignment * alignment, 0);
+}
+
+// a null-terminated string, padded to 4 bytes (partial paths and the report path)
+static void PutPaddedString(std::vector<char> &buffer, const std::string &value)
+{
+    buffer.insert(buffer.end(), value.begin(), value.end());
+    buffer.push_back(0);
+    Align(buffer, sizeof(uint32_t));
+}
+
+// a char array of the v1 layout: its length followed by its UTF-16 code units (ASCII only)
+static void PutChars(std::vector<char> &buffer, const std::string &value)
+{
+    Put32(buffer, (uint32_t)value.length());
+    for (char c : value)
+    {
+        buffer.push_back(c);
+        buffer.push_back(0);
+    }
+}
+
+ManifestBuilder::ManifestBuilder()
+    : root_(kAllowAllAndReport, kAllowAllAndReport, 0), flags_(DefaultManifestFlags)
+{
+}
+
+ManifestBuilder& ManifestBuilder::AddScope(const std::string &path, uint32_t conePolicy, uint32_t nodePolicy, uint32_t pathId)
+{
+    Node *node = &root_;
+    for (size_t start = 0; start < path.length();)
+    {
+        size_t end = path.find('/', start);
+        end = end == std::string::npos ? path.length() : end;
+        if (end > start)
+        {
+            std::string component = path.substr(start, end - start);
+            Node *child = nullptr;
+            for (auto &entry : node->children)
+            {
+                if (entry.first == component)
+                {
+                    child = entry.second.get();
+                    break;
+                }
+            }
+
+            if (child == nullptr)
+            {
+                node->children.emplace_back(component, std::unique_ptr<Node>(new Node(node->conePolicy, node->conePolicy, 0)));
+                child = node->children.back().second.get();
+            }
+
+            node = child;
+        }
+
+        start = end + 1;
+    }
+
+    node->conePolicy = conePolicy;
+    node->nodePolicy = nodePolicy;
+    node->pathId     = pathId;
+    return *this;
+}
+
+ManifestBuilder& ManifestBuilder::AddBreakaway(const std::string &processName)
+{
+    breakaway_.push_back(processName);
+    return *this;
+}
+
+ManifestBuilder& ManifestBuilder::AddTranslation(const std::string &from, const std::string &to)
+{
+    translations_.emplace_back(from, to);
+    return *this;
+}
+
+std::vector<char> ManifestBuilder::Build(const std::string &reportsPath, int version) const
+{
+    return version == FAM_V2_VERSION ? BuildV2(reportsPath) : BuildV1(reportsPath);
+}
+
+uint32_t ManifestBuilder::HashComponent(const std::string &component)
+{
+    return PolicyIndex::HashComponent(component.c_str(), component.length());
+}
+
+// -----------------------------------------------------------------------------
+// Version 1 (see FileAccessManifest.cs: WriteManifestTreeBlock)
+// -----------------------------------------------------------------------------
+
+void ManifestBuilder::PutRecordV1(std::vector<char> &buffer, const std::string *partialPath, uint32_t conePolicy, uint32_t nodePolicy,
+    uint32_t pathId, const std::vector<std::pair<std::string, const Node*>> &children)
+{
+    size_t start = buffer.size();
+    PutTag(buffer, 0xF00DCAFE);
+    Put32(buffer, partialPath != nullptr ? HashPath(partialPath->c_str(), partialPath->length()) : 0);
+    Put32(buffer, conePolicy);
+    Put32(buffer, nodePolicy);
+    Put32(buffer, pathId);
+    Put64(buffer, 0); // expected USN
+
+    uint32_t bucketCount = children.empty() ? 0 : (uint32_t)(children.size() / 0.7);
+    Put32(buffer, bucketCount);
+    size_t bucketsOffset = buffer.size();
+    buffer.resize(buffer.size() + bucketCount * sizeof(uint32_t), 0);
+
+    if (partialPath != nullptr)
+    {
+        PutPaddedString(buffer, *partialPath);
+    }
+    else
+    {
+        Put32(buffer, 0);
+    }
+
+    std::vector<uint32_t> offsets(bucketCount, 0);
+    for (const auto &child : children)
+    {
+        uint32_t index = HashPath(child.first.c_str(), child.first.length()) % bucketCount;
+        if (offsets[index] != 0)
+        {
+            offsets[index] |= FileAccessBucketOffsetFlag::ChainStart;
+            index = (index + 1) % bucketCount;
+            while (offsets[index] != 0)
+            {
+                offsets[index] |= FileAccessBucketOffsetFlag::ChainContinuation;
+                index = (index + 1) % bucketCount;
+            }
+        }
+
+        offsets[index] = (uint32_t)(buffer.size() - start);
+
+        std::vector<std::pair<std::string, const Node*>> grandchildren;
+        for (const auto &grandchild : child.second->children)
+        {
+            grandchildren.emplace_back(grandchild.first, grandchild.second.get());
+        }
+
+        PutRecordV1(buffer, &child.first, child.second->conePolicy, child.second->nodePolicy, child.second->pathId, grandchildren);
+    }
+
+    memcpy(buffer.data() + bucketsOffset, offsets.data(), bucketCount * sizeof(uint32_t));
+}
+
+std::vector<char> ManifestBuilder::BuildV1(const std::string &reportsPath) const
+{
+    std::vector<char> buffer;
+    Put32(buffer, ManifestDebugFlagValue); // ManifestDebugFlag
+    Put32(buffer, 10);                     // ManifestInjectionTimeout
+
+    PutTag(buffer, 0xABCDEF05);
+    Put32(buffer, (uint32_t)breakaway_.size());
+    for (const std::string &name : breakaway_)
+    {
+        PutChars(buffer, name);
+    }
+
+    PutTag(buffer, 0xABCDEF02);
+    Put32(buffer, (uint32_t)translations_.size());
+    for (const auto &translation : translations_)
+    {
+        PutChars(buffer, translation.first);
+        PutChars(buffer, translation.second);
+    }
+
+    PutTag(buffer, 0xABCDEF03);
+    PutChars(buffer, ""); // error notification file
+
+    PutTag(buffer, 0xF1A6B10C);
+    Put32(buffer, flags_);
+    PutTag(buffer, 0xF1A6B10D);
+    Put32(buffer, 0); // extra flags
+
+#ifdef _DEBUG
+    Put32(buffer, 0xF1A6B10E);
+    Put32(buffer, 0); // padding of the pip id
+#endif
+    Put64(buffer, TestPipId);
+
+    PutTag(buffer, 0xFEEDF00D);
+    std::vector<char> reportPath;
+    PutPaddedString(reportPath, reportsPath);
+    Put32(buffer, (uint32_t)reportPath.size());
+    buffer.insert(buffer.end(), reportPath.begin(), reportPath.end());
+
+    PutTag(buffer, 0xD11B10CC); // DLL block (unused on Linux)
+    Put32(buffer, 8);
+    Put32(buffer, 2);
+    Put32(buffer, 0);
+    Put32(buffer, 4);
+    Put64(buffer, 0);
+
+    PutTag(buffer, 0xABCDEF04);
+    Put32(buffer, 0);     // substitute process execution shim
+    PutChars(buffer, ""); // its path
+
+    // the root record of a v1 tree has the unix root sentinel (an empty partial path) as its only child
+    PutRecordV1(buffer, nullptr, kAllowAllAndReport, kAllowAllAndReport, 0, { { "", &root_ } });
+    return buffer;
+}
+
+// -----------------------------------------------------------------------------
+// Version 2 (see FileAccessManifest.cs: WriteLinuxNativeSections)
+// -----------------------------------------------------------------------------
+
+class StringPool final
+{
+public:
+
+    std::vector<char> data { 0 };
+
+    uint32_t Add(const std::string &value)
+    {
+        auto existing = offsets_.find(value);
+        if (existing != offsets_.end())
+        {
+            return existing->second;
+        }
+
+        uint32_t offset = (uint32_t)data.size();
+        data.insert(data.end(), value.begin(), value.end());
+        data.push_back(0);
+        offsets_[value] = offset;
+        return offset;
+    }
+
+private:
+
+    std::map<std::string, uint32_t> offsets_ { { "", 0 } };
+};
+
+std::vector<char> ManifestBuilder::BuildV2(const std::string &reportsPath) const
+{
+    const uint32_t numSections = (uint32_t)ManifestV2SectionKind::NumSections;
+    std::vector<char> sections[numSections];
+    StringPool strings;
+
+    // breadth-first, the unix root sentinel first
+    std::vector<uint32_t> slots;
+    std::deque<std::pair<const Node*, ManifestV2Node>> queue;
+    queue.push_back({ &root_, ManifestV2Node { 0, 0, 0, 0 } });
+    uint32_t numNodes = 1;
+    while (!queue.empty())
+    {
+        const Node *node = queue.front().first;
+        ManifestV2Node entry = queue.front().second;
+        queue.pop_front();
+
+        uint32_t numSlots = 0;
+        if (!node->children.empty())
+        {
+            for (numSlots = 1; numSlots < 2 * node->children.size(); numSlots <<= 1);
+        }
+
+        entry.FirstSlot = (uint32_t)slots.size();
+        entry.NumSlots  = numSlots;
+        slots.resize(slots.size() + numSlots, 0);
+        for (const auto &child : node->children)
+        {
+            uint32_t hash = HashComponent(child.first);
+            uint32_t slot = hash & (numSlots - 1);
+            while (slots[entry.FirstSlot + slot] != 0)
+            {
+                slot = (slot + 1) & (numSlots - 1);
+            }
+
+            slots[entry.FirstSlot + slot] = numNodes++;
+            queue.push_back({ child.second.get(), ManifestV2Node { hash, strings.Add(child.first), 0, 0 } });
+        }
+
+        std::vector<char> &nodes = sections[(uint32_t)ManifestV2SectionKind::PolicyNodes];
+        nodes.insert(nodes.end(), (const char*)&entry, (const char*)&entry + sizeof(entry));
+
+        std::vector<char> &records = sections[(uint32_t)ManifestV2SectionKind::PolicyRecords];
+        size_t start = records.size();
+        PutTag(records, 0xF00DCAFE);
+        Put32(records, entry.Hash);
+        Put32(records, node->conePolicy);
+        Put32(records, node->nodePolicy);
+        Put32(records, node->pathId);
+        Put64(records, 0); // expected USN
+        Put32(records, 0); // no buckets
+        records.resize(start + sizeof(ManifestRecord), 0);
+    }
+
+    std::vector<char> &slotsSection = sections[(uint32_t)ManifestV2SectionKind::PolicySlots];
+    slotsSection.assign((const char*)slots.data(), (const char*)(slots.data() + slots.size()));
+
+    for (const std::string &name : breakaway_)
+    {
+        Put32(sections[(uint32_t)ManifestV2SectionKind::BreakawayProcesses], strings.Add(name));
+    }
+
+    for (const auto &translation : translations_)
+    {
+        Put32(sections[(uint32_t)ManifestV2SectionKind::TranslatePaths], strings.Add(translation.first));
+        Put32(sections[(uint32_t)ManifestV2SectionKind::TranslatePaths], strings.Add(translation.second));
+    }
+
+    ManifestV2Globals globals { flags_, 0, TestPipId, strings.Add(reportsPath), (uint32_t)reportsPath.length() };
+    sections[(uint32_t)ManifestV2SectionKind::Globals].assign((const char*)&globals, (const char*)(&globals + 1));
+    sections[(uint32_t)ManifestV2SectionKind::Strings] = strings.data;
+
+    std::vector<char> buffer;
+    Put32(buffer, FAM_V2_MAGIC);
+    Put32(buffer, FAM_V2_VERSION);
+    Put32(buffer, ManifestDebugFlagValue);
+    Put32(buffer, numSections);
+
+    size_t offset = buffer.size() + numSections * sizeof(ManifestV2Section);
+    for (uint32_t i = 0; i < numSections; i++)
+    {
+        offset = (offset + 7) / 8 * 8;
+        Put32(buffer, (uint32_t)offset);
+        Put32(buffer, (uint32_t)sections[i].size());
+        offset += sections[i].size();
+    }
+
+    for (uint32_t i = 0; i < numSections; i++)
+    {
+        Align(buffer, 8);
+        buffer.insert(buffer.end(), sections[i].begin(), sections[i].end());
+    }
+
+    return buffer;
+}
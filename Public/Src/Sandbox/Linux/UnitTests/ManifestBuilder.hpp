@@ -0,0 +1,72 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "DataTypes.h"
+
+/**
+ * Writes file access manifests the way the managed side does (see FileAccessManifest.cs), in either layout:
+ * version 1 (shared with Windows) or the Linux-native version 2 (see ManifestV2SectionKind).  The manifest is
+ * for the build configuration of the test binary, i.e., it has debug tags in debug builds.
+ *
+ * The policy tree starts out with the unix root sentinel only, whose policy (allow everything and report every
+ * access) applies to every path not below a scope added with 'AddScope'.
+ */
+class ManifestBuilder final
+{
+public:
+
+    static const uint32_t kAllowAllAndReport = FileAccessPolicy_AllowAll | FileAccessPolicy_ReportAccess;
+
+    ManifestBuilder();
+
+    /**
+     * Sets the policies and path id of the node of absolute path 'path'.  The nodes created on the way to it
+     * get the cone policy of their parent.
+     */
+    ManifestBuilder& AddScope(const std::string &path, uint32_t conePolicy, uint32_t nodePolicy, uint32_t pathId);
+
+    ManifestBuilder& AddBreakaway(const std::string &processName);
+    ManifestBuilder& AddTranslation(const std::string &from, const std::string &to);
+    ManifestBuilder& SetFlags(uint32_t flags) { flags_ = flags; return *this; }
+
+    /** The manifest, with layout 'version' (1 or 2), of a pip that sends its reports to 'reportsPath' */
+    std::vector<char> Build(const std::string &reportsPath, int version) const;
+
+    /** Hash of a component in the policy index (see PolicyIndex), with which the nodes of a version 2 manifest are hashed */
+    static uint32_t HashComponent(const std::string &component);
+
+private:
+
+    struct Node
+    {
+        uint32_t conePolicy;
+        uint32_t nodePolicy;
+        uint32_t pathId;
+
+        // in the order in which they were added
+        std::vector<std::pair<std::string, std::unique_ptr<Node>>> children;
+
+        Node(uint32_t cone, uint32_t node, uint32_t id) : conePolicy(cone), nodePolicy(node), pathId(id) {}
+    };
+
+    Node root_;
+    std::vector<std::string> breakaway_;
+    std::vector<std::pair<std::string, std::string>> translations_;
+    uint32_t flags_;
+
+    static void PutRecordV1(std::vector<char> &buffer, const std::string *partialPath, uint32_t conePolicy, uint32_t nodePolicy,
+        uint32_t pathId, const std::vector<std::pair<std::string, const Node*>> &children);
+
+    std::vector<char> BuildV1(const std::string &reportsPath) const;
+    std::vector<char> BuildV2(const std::string &reportsPath) const;
+};
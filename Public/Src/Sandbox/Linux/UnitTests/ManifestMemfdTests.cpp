@@ -0,0 +1,152 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "FileAccessManifestParser.hpp"
+#include "SandboxedRun.hpp"
+#include "TestHarness.hpp"
+
+// see Host/ManifestMemfdInterop.cpp
+extern "C"
+{
+    int BxlManifestMemfd_Create(const char *name, const char *payload, uint64_t length);
+    void BxlManifestMemfd_Dispose(int fd);
+}
+
+TEST(ManifestMemfd, CreatesSealedMemfdWithPayload)
+{
+    std::string payload(100000, 'm');
+    int fd = BxlManifestMemfd_Create("manifest", payload.data(), payload.size());
+    ASSERT_TRUE(fd != -1);
+
+    int seals = fcntl(fd, F_GET_SEALS);
+    EXPECT_EQ(F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL, seals);
+    EXPECT_TRUE((fcntl(fd, F_GETFD) & FD_CLOEXEC) != 0);
+
+    std::string content(payload.size() + 1, '\0');
+    EXPECT_EQ((ssize_t)payload.size(), pread(fd, &content[0], content.size(), 0));
+    content.resize(payload.size());
+    EXPECT_TRUE(content == payload);
+
+    EXPECT_EQ(-1, (int)pwrite(fd, "x", 1, 0));
+    EXPECT_EQ(EPERM, errno);
+    EXPECT_EQ(-1, ftruncate(fd, 0));
+    EXPECT_TRUE(mmap(NULL, payload.size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) == MAP_FAILED);
+    BxlManifestMemfd_Dispose(fd);
+}
+
+// Probes argv[1]/f, and probes it again from a child that execs the test binary (i.e., that loads the manifest again)
+SCENARIO(ProbeFileInChild)
+{
+    std::string path = std::string(argv[1]) + "/f";
+    access(path.c_str(), F_OK);
+    if (argc > 2)
+    {
+        return 0;
+    }
+
+    char binary[PATH_MAX];
+    ssize_t length = readlink("/proc/self/exe", binary, sizeof(binary) - 1);
+    if (length <= 0)
+    {
+        return 2;
+    }
+
+    binary[length] = '\0';
+    pid_t child = fork();
+    if (child == 0)
+    {
+        char scenario[] = "--scenario", name[] = "ProbeFileInChild", child[] = "child";
+        char *args[] = { binary, scenario, name, argv[1], child, NULL };
+        execv(binary, args);
+        _exit(3);
+    }
+
+    int status;
+    return child != -1 && waitpid(child, &status, 0) == child && status == 0 ? 0 : 1;
+}
+
+// the path id the manifest in the memfd gives argv[1]/f (the manifest in the file gives it kFilePathId)
+#define kMemfdPathId 21
+#define kFilePathId  22
+
+enum class MemfdKind { Sealed, Unsealed, Missing };
+
+/**
+ * Runs ProbeFileInChild with a manifest of layout 'version' in a memfd of 'kind', shared the way the host shares it
+ * (through its /proc entry), and expects the probes of both processes to have been checked against 'expectedPathId'
+ */
+static void ExpectManifestUsed(MemfdKind kind, int version, uint32_t expectedPathId)
+{
+    SandboxedRun run;
+    run.SetManifestVersion(version);
+    run.Manifest().AddScope(run.Path("f"), ManifestBuilder::kAllowAllAndReport, ManifestBuilder::kAllowAllAndReport, kFilePathId);
+
+    ManifestBuilder shared;
+    shared.AddScope(run.Path("f"), ManifestBuilder::kAllowAllAndReport, ManifestBuilder::kAllowAllAndReport, kMemfdPathId);
+    std::vector<char> payload = shared.Build(run.ReportsPath(), version);
+
+    int fd = -1;
+    if (kind == MemfdKind::Sealed)
+    {
+        fd = BxlManifestMemfd_Create("manifest", payload.data(), payload.size());
+    }
+    else if (kind == MemfdKind::Unsealed)
+    {
+        fd = memfd_create("manifest", MFD_CLOEXEC);
+        ASSERT_EQ((ssize_t)payload.size(), write(fd, payload.data(), payload.size()));
+    }
+
+    ASSERT_TRUE(kind == MemfdKind::Missing || fd != -1);
+    run.SetEnv("__BUILDXL_FAM_MEMFD_PATH", "/proc/" + std::to_string(getpid()) + "/fd/" + (fd != -1 ? std::to_string(fd) : "-1"));
+
+    int status = run.Run("ProbeFileInChild", { run.Dir() });
+    if (fd != -1)
+    {
+        BxlManifestMemfd_Dispose(fd);
+    }
+
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+
+    std::vector<ObservedReport> reports = run.ReportsOf(run.Path("f"));
+    ASSERT_FALSE(reports.empty());
+    std::set<pid_t> pids;
+    for (const ObservedReport &report : reports)
+    {
+        EXPECT_EQ(expectedPathId, report.pathId);
+        pids.insert(report.pid);
+    }
+
+    EXPECT_EQ(2u, pids.size());
+}
+
+TEST(ManifestMemfd, ParsesManifestFromMemfd)
+{
+    ExpectManifestUsed(MemfdKind::Sealed, 1, kMemfdPathId);
+}
+
+TEST(ManifestMemfd, ParsesV2ManifestFromMemfd)
+{
+    ExpectManifestUsed(MemfdKind::Sealed, FAM_V2_VERSION, kMemfdPathId);
+}
+
+TEST(ManifestMemfd, ReadsManifestFileInsteadOfUnsealedMemfd)
+{
+    ExpectManifestUsed(MemfdKind::Unsealed, 1, kFilePathId);
+}
+
+TEST(ManifestMemfd, ReadsManifestFileInsteadOfMissingMemfd)
+{
+    ExpectManifestUsed(MemfdKind::Missing, 1, kFilePathId);
+}
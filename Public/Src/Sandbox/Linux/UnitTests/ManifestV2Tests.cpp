@@ -0,0 +1,249 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "FileAccessManifestParser.hpp"
+#include "SandboxedRun.hpp"
+#include "TestHarness.hpp"
+
+static ManifestBuilder FullManifest()
+{
+    ManifestBuilder manifest;
+    manifest.AddScope("/src", FileAccessPolicy_AllowRead, FileAccessPolicy_AllowRead, 1)
+        .AddScope("/src/out", ManifestBuilder::kAllowAllAndReport, ManifestBuilder::kAllowAllAndReport, 2)
+        .AddBreakaway("tool")
+        .AddBreakaway("compiler")
+        .AddTranslation("/a/from", "/b/to")
+        .AddTranslation("/c", "/d/to/c")
+        .SetFlags((uint32_t)(FileAccessManifestFlag::ReportAllFileAccesses | FileAccessManifestFlag::FailUnexpectedFileAccesses));
+    return manifest;
+}
+
+static std::string ReportsPath(const FileAccessManifestParseResult &fam)
+{
+    int length;
+    const char *path = fam.GetReportsPath(&length);
+
+    // the length of a v1 manifest's path counts its terminator
+    return std::string(path, strnlen(path, length));
+}
+
+TEST(ManifestV2, ParsesSameManifestAsV1)
+{
+    const std::string reportsPath = "/tmp/reports.fifo";
+    std::vector<char> v1 = FullManifest().Build(reportsPath, 1);
+    std::vector<char> v2 = FullManifest().Build(reportsPath, FAM_V2_VERSION);
+
+    FileAccessManifestParseResult fam1, fam2;
+    ASSERT_TRUE(fam1.init((const BYTE*)v1.data(), v1.size()));
+    ASSERT_TRUE(fam2.init((const BYTE*)v2.data(), v2.size()));
+    EXPECT_EQ(1u, fam1.GetVersion());
+    EXPECT_EQ((uint32_t)FAM_V2_VERSION, fam2.GetVersion());
+    EXPECT_TRUE(fam1.GetPolicyTree() == nullptr);
+    ASSERT_TRUE(fam2.GetPolicyTree() != nullptr);
+
+    EXPECT_EQ((uint32_t)fam1.GetFamFlags(), (uint32_t)fam2.GetFamFlags());
+    EXPECT_EQ(fam1.GetPipId(), fam2.GetPipId());
+    EXPECT_EQ(reportsPath, ReportsPath(fam1));
+    EXPECT_EQ(reportsPath, ReportsPath(fam2));
+
+    for (const char *name : { "tool", "compiler", "tools", "too", "other" })
+    {
+        EXPECT_EQ(fam1.IsChildProcessToBreakAway(name), fam2.IsChildProcessToBreakAway(name));
+    }
+
+    EXPECT_TRUE(fam2.IsChildProcessToBreakAway("compiler"));
+    EXPECT_FALSE(fam2.IsChildProcessToBreakAway("tools"));
+
+    ASSERT_EQ(2u, fam1.GetNumTranslatePaths());
+    ASSERT_EQ(2u, fam2.GetNumTranslatePaths());
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        char from1[PATH_MAX], to1[PATH_MAX], from2[PATH_MAX], to2[PATH_MAX];
+        ASSERT_TRUE(fam1.GetTranslatePath(i, from1, to1, PATH_MAX));
+        ASSERT_TRUE(fam2.GetTranslatePath(i, from2, to2, PATH_MAX));
+        EXPECT_EQ(std::string(from1), std::string(from2));
+        EXPECT_EQ(std::string(to1), std::string(to2));
+    }
+
+    // a node per record of the v1 tree: the unix root sentinel, 'src' and 'out'
+    EXPECT_EQ(3u, fam2.GetPolicyTree()->NumNodes);
+    EXPECT_EQ((uint32_t)fam1.GetUnixRootNode()->GetConePolicy(), (uint32_t)fam2.GetUnixRootNode()->GetConePolicy());
+}
+
+static const ManifestV2Header* Header(const std::vector<char> &payload)
+{
+    return (const ManifestV2Header*)payload.data();
+}
+
+static ManifestV2Section& Section(std::vector<char> &payload, ManifestV2SectionKind kind)
+{
+    return ((ManifestV2Header*)payload.data())->Sections[(uint32_t)kind];
+}
+
+static bool Parses(const std::vector<char> &payload, size_t length)
+{
+    // a copy of exactly 'length' bytes, so that nothing past them is there to be read
+    std::vector<char> copy(payload.begin(), payload.begin() + length);
+    FileAccessManifestParseResult fam;
+    bool parsed = fam.init((const BYTE*)copy.data(), copy.size());
+    EXPECT_EQ(parsed, fam.Error() == nullptr);
+    return parsed;
+}
+
+TEST(ManifestV2, RejectsTruncatedManifest)
+{
+    std::vector<char> payload = FullManifest().Build("/tmp/reports.fifo", FAM_V2_VERSION);
+    size_t end = 0;
+    for (uint32_t i = 0; i < Header(payload)->NumSections; i++)
+    {
+        end = std::max(end, (size_t)Header(payload)->Sections[i].Offset + Header(payload)->Sections[i].Size);
+    }
+
+    ASSERT_TRUE(Parses(payload, payload.size()));
+    ASSERT_TRUE(Parses(payload, end));
+
+    // shorter than the magic number, the manifest would be taken for a v1 manifest
+    for (size_t length = sizeof(uint32_t); length < end; length++)
+    {
+        EXPECT_FALSE(Parses(payload, length));
+    }
+}
+
+TEST(ManifestV2, RejectsCorruptedManifest)
+{
+    typedef std::function<void(std::vector<char>&)> Corruption;
+    std::vector<Corruption> corruptions
+    {
+        [](std::vector<char> &p) { ((ManifestV2Header*)p.data())->Version = FAM_V2_VERSION + 1; },
+        [](std::vector<char> &p) { ((ManifestV2Header*)p.data())->NumSections = (uint32_t)ManifestV2SectionKind::NumSections - 1; },
+        [](std::vector<char> &p) { Section(p, ManifestV2SectionKind::Strings).Offset += 4; },
+        [](std::vector<char> &p) { Section(p, ManifestV2SectionKind::Strings).Size = (uint32_t)p.size(); },
+        [](std::vector<char> &p) { Section(p, ManifestV2SectionKind::PolicyNodes).Size = 0; },
+        [](std::vector<char> &p) { Section(p, ManifestV2SectionKind::PolicyRecords).Size -= sizeof(ManifestRecord); },
+        [](std::vector<char> &p) { Section(p, ManifestV2SectionKind::BreakawayProcesses).Size -= 1; },
+        [](std::vector<char> &p)
+        {
+            ManifestV2Section &strings = Section(p, ManifestV2SectionKind::Strings);
+            p[strings.Offset + strings.Size - 1] = 'x';
+        },
+        [](std::vector<char> &p)
+        {
+            ManifestV2Globals *globals = (ManifestV2Globals*)&p[Section(p, ManifestV2SectionKind::Globals).Offset];
+            globals->ReportPathOffset = Section(p, ManifestV2SectionKind::Strings).Size;
+        },
+        [](std::vector<char> &p)
+        {
+            uint32_t *offsets = (uint32_t*)&p[Section(p, ManifestV2SectionKind::TranslatePaths).Offset];
+            offsets[1] = Section(p, ManifestV2SectionKind::Strings).Size;
+        },
+    };
+
+    for (const Corruption &corrupt : corruptions)
+    {
+        std::vector<char> payload = FullManifest().Build("/tmp/reports.fifo", FAM_V2_VERSION);
+        corrupt(payload);
+        EXPECT_FALSE(Parses(payload, payload.size()));
+    }
+}
+
+// Under argv[1]: reads 'in/a', writes 'out/b', probes 'in/missing', writes 'in/c' (which the manifest does not allow)
+// and reads 'other'
+SCENARIO(AccessScopes)
+{
+    std::string dir = argv[1];
+    int fd = open((dir + "/in/a").c_str(), O_RDONLY);
+    if (fd != -1)
+    {
+        close(fd);
+    }
+
+    fd = open((dir + "/out/b").c_str(), O_CREAT | O_WRONLY, 0644);
+    if (fd != -1)
+    {
+        close(fd);
+    }
+
+    access((dir + "/in/missing").c_str(), F_OK);
+
+    fd = open((dir + "/in/c").c_str(), O_CREAT | O_WRONLY, 0644);
+    if (fd != -1)
+    {
+        close(fd);
+    }
+
+    fd = open((dir + "/other").c_str(), O_RDONLY);
+    if (fd != -1)
+    {
+        close(fd);
+    }
+
+    return 0;
+}
+
+typedef std::tuple<uint16_t, uint8_t, uint32_t, uint32_t, uint32_t, uint32_t, std::string> ReportKey;
+
+// the reports of AccessScopes run with a manifest of layout 'version', without their pids, sorted
+static std::vector<ReportKey> ReportsOfAccessScopes(int version, uint32_t flags)
+{
+    SandboxedRun run;
+    EXPECT_EQ(0, mkdir(run.Path("in").c_str(), S_IRWXU));
+    EXPECT_EQ(0, mkdir(run.Path("out").c_str(), S_IRWXU));
+    close(open(run.Path("in/a").c_str(), O_CREAT | O_WRONLY, 0644));
+    close(open(run.Path("other").c_str(), O_CREAT | O_WRONLY, 0644));
+
+    run.SetManifestVersion(version);
+    run.Manifest()
+        .SetFlags(flags)
+        .AddScope(run.Path("in"), FileAccessPolicy_AllowRead | FileAccessPolicy_AllowReadIfNonExistent | FileAccessPolicy_ReportAccess,
+                  FileAccessPolicy_AllowRead | FileAccessPolicy_ReportAccess, 1)
+        .AddScope(run.Path("out"), ManifestBuilder::kAllowAllAndReport, ManifestBuilder::kAllowAllAndReport, 2)
+        .AddScope(run.Path("in/a"), FileAccessPolicy_AllowRead | FileAccessPolicy_ReportAccess, FileAccessPolicy_AllowRead | FileAccessPolicy_ReportAccess, 3);
+
+    int status = run.Run("AccessScopes", { run.Dir() });
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    std::vector<ReportKey> keys;
+    for (const ObservedReport &report : run.Reports())
+    {
+        // relative to the directory of the run, which is another one for each layout
+        std::string path = report.path.compare(0, run.Dir().length(), run.Dir()) == 0 ? report.path.substr(run.Dir().length()) : report.path;
+        keys.emplace_back(report.operation, report.flags, report.requestedAccess, report.status, report.error, report.pathId, path);
+    }
+
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+static void ExpectSameReportsAsV1(uint32_t flags)
+{
+    std::vector<ReportKey> v1 = ReportsOfAccessScopes(1, flags);
+    std::vector<ReportKey> v2 = ReportsOfAccessScopes(FAM_V2_VERSION, flags);
+    EXPECT_TRUE(std::any_of(v1.begin(), v1.end(), [](const ReportKey &key) { return std::get<5>(key) == 3 && std::get<6>(key) == "/in/a"; }));
+    EXPECT_EQ(v1.size(), v2.size());
+    EXPECT_TRUE(v1 == v2);
+}
+
+TEST(ManifestV2, ReportsSameAccessesAsV1)
+{
+    ExpectSameReportsAsV1((uint32_t)(FileAccessManifestFlag::ReportAllFileAccesses | FileAccessManifestFlag::MonitorChildProcesses));
+}
+
+TEST(ManifestV2, ReportsSameAccessesAsV1WhenFailingUnexpectedAccesses)
+{
+    ExpectSameReportsAsV1((uint32_t)(FileAccessManifestFlag::ReportAllFileAccesses | FileAccessManifestFlag::MonitorChildProcesses |
+        FileAccessManifestFlag::FailUnexpectedFileAccesses));
+}
@@ -0,0 +1,75 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <string>
+
+#include "SandboxedRun.hpp"
+#include "TestHarness.hpp"
+
+#define ScopePathId 42
+
+// Creates 'scope/file' under argv[1] and probes the paths below 'scope' at various depths
+SCENARIO(ProbeScope)
+{
+    std::string scope = std::string(argv[1]) + "/scope";
+    mkdir(scope.c_str(), S_IRWXU);
+    int fd = open((scope + "/file").c_str(), O_CREAT | O_WRONLY, 0644);
+    if (fd == -1)
+    {
+        return 2;
+    }
+
+    close(fd);
+    access(argv[1], F_OK);
+    access(scope.c_str(), F_OK);
+    access((scope + "/file").c_str(), F_OK);
+    access((scope + "/missing/below").c_str(), F_OK);
+    return 0;
+}
+
+static void ExpectPathIds(SandboxedRun &run)
+{
+    run.Manifest().AddScope(run.Path("scope"), ManifestBuilder::kAllowAllAndReport, ManifestBuilder::kAllowAllAndReport, ScopePathId);
+    ASSERT_EQ(0, run.Run("ProbeScope", { run.Dir() }));
+
+    // only a path matching a record exactly carries the record's id; the search for the paths below it stops
+    // at the record, and the records created on the way to it have no id
+    auto expectPathId = [&run](const std::string &path, uint32_t pathId)
+    {
+        std::vector<ObservedReport> reports = run.ReportsOf(path);
+        EXPECT_FALSE(reports.empty());
+        for (const ObservedReport &report : reports)
+        {
+            EXPECT_EQ(pathId, report.pathId);
+        }
+    };
+
+    expectPathId(run.Path("scope"), ScopePathId);
+    expectPathId(run.Dir(), 0);
+    expectPathId(run.Path("scope/file"), 0);
+    expectPathId(run.Path("scope/missing/below"), 0);
+}
+
+TEST(PathId, ReportsIdOfExactlyMatchedRecord)
+{
+    SandboxedRun run;
+    ExpectPathIds(run);
+}
+
+TEST(PathId, ReportsIdOfExactlyMatchedRecordWithFrontCoding)
+{
+    SandboxedRun run;
+    run.SetEnv("__BUILDXL_FRONT_CODE_PATHS", "1");
+    ExpectPathIds(run);
+}
+
+TEST(PathId, ReportsIdOfExactlyMatchedRecordInAccessSet)
+{
+    SandboxedRun run;
+    run.BuildAccessSet();
+    ExpectPathIds(run);
+}
@@ -0,0 +1,168 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <string>
+#include <vector>
+
+#include "PolicyIndex.hpp"
+#include "PolicySearch.h"
+#include "TestAccessHandler.hpp"
+#include "TestHarness.hpp"
+
+/**
+ * A page followed by an inaccessible one: a string placed at the end of the page is the last thing that can be
+ * read, so reading past its terminator faults
+ */
+class GuardedPage final
+{
+public:
+
+    GuardedPage()
+    {
+        pageSize_ = (size_t)sysconf(_SC_PAGESIZE);
+        void *addr = mmap(NULL, 2 * pageSize_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        page_ = addr != MAP_FAILED && mprotect((char*)addr + pageSize_, pageSize_, PROT_NONE) == 0 ? (char*)addr : NULL;
+    }
+
+    ~GuardedPage()
+    {
+        if (page_ != NULL)
+        {
+            munmap(page_, 2 * pageSize_);
+        }
+    }
+
+    bool IsValid() const { return page_ != NULL; }
+
+    /** A copy of 'path' (with its terminator) that ends where the page ends */
+    const char* Place(const std::string &path)
+    {
+        char *copy = page_ + pageSize_ - (path.length() + 1);
+        memcpy(copy, path.c_str(), path.length() + 1);
+        return copy;
+    }
+
+private:
+
+    size_t pageSize_;
+    char *page_;
+};
+
+// a component of 'length' characters that differs from the other components of that length in its last one
+static std::string Component(size_t length, char last)
+{
+    std::string component(length, (char)('a' + length % 26));
+    component[length - 1] = last;
+    return component;
+}
+
+/**
+ * Scopes whose components have every length from 1 to 40 (so that the separators of the paths below them fall at
+ * every offset of a 16-byte block), both at the root and nested in one another
+ */
+static ManifestBuilder ComponentLengthScopes(std::vector<std::string> &scopes)
+{
+    ManifestBuilder manifest;
+    std::string nested;
+    for (size_t length = 1; length <= 40; length++)
+    {
+        scopes.push_back("/" + Component(length, 'x'));
+        nested += "/" + Component(length, 'y');
+        scopes.push_back(nested);
+    }
+
+    uint32_t pathId = 1;
+    for (const std::string &scope : scopes)
+    {
+        manifest.AddScope(scope, FileAccessPolicy_AllowRead, FileAccessPolicy_AllowRead, pathId++);
+    }
+
+    return manifest;
+}
+
+TEST(PathTokenizer, FindsSameRecordsAsTreeWithoutReadingPastPath)
+{
+    // every prefix of every path, each one placed right before the guard page, searched in the index compiled from
+    // the tree, in the index of the v2 layout of the same manifest and in the tree itself
+    GuardedPage page;
+    ASSERT_TRUE(page.IsValid());
+
+    std::vector<std::string> scopes;
+    ManifestBuilder manifest = ComponentLengthScopes(scopes);
+    TestAccessHandler compiled(manifest, 1, /*compileIndex*/ true);
+    TestAccessHandler opened(manifest, FAM_V2_VERSION);
+    PCManifestRecord tree = compiled.GetPip()->GetManifestRecord();
+    PCManifestRecord openedRoot = opened.GetPip()->GetManifestRecord();
+    const PolicyIndex *compiledIndex = compiled.GetPip()->GetPolicyIndex();
+    const PolicyIndex *openedIndex = opened.GetPip()->GetPolicyIndex();
+    ASSERT_TRUE(compiledIndex != nullptr && openedIndex != nullptr);
+
+    std::vector<std::string> paths;
+    for (const std::string &scope : scopes)
+    {
+        paths.push_back(scope + "/file");
+        paths.push_back(scope + "//file/");
+
+        // the tree splits paths at either separator (see GetPartialPathAndRemainder)
+        std::string backslashes = scope;
+        for (char &c : backslashes)
+        {
+            c = c == '/' ? '\\' : c;
+        }
+
+        paths.push_back(backslashes + "\\file");
+    }
+
+    size_t numFound = 0;
+    for (const std::string &path : paths)
+    {
+        for (size_t length = 0; length < path.length(); length++)
+        {
+            const std::string prefix = path.substr(1, length);
+            const char *placed = page.Place(prefix);
+            PolicySearchCursor expected = FindFileAccessPolicyInTreeEx(tree, prefix.c_str(), prefix.length());
+            PolicySearchCursor fromCompiled = compiledIndex->Find(tree, placed, prefix.length());
+            PolicySearchCursor fromOpened = openedIndex->Find(openedRoot, placed, prefix.length());
+
+            EXPECT_TRUE(expected.Record == fromCompiled.Record);
+            EXPECT_EQ(expected.SearchWasTruncated, fromCompiled.SearchWasTruncated);
+            ASSERT_TRUE(fromOpened.IsValid());
+            EXPECT_EQ((uint32_t)expected.Record->GetPathId(), (uint32_t)fromOpened.Record->GetPathId());
+            EXPECT_EQ(expected.SearchWasTruncated, fromOpened.SearchWasTruncated);
+            numFound += expected.Record->GetPathId() != 0 && !expected.SearchWasTruncated ? 1 : 0;
+        }
+    }
+
+    // every scope is found exactly (with and without a trailing separator, and with either separator)
+    EXPECT_TRUE(numFound >= 3 * scopes.size());
+}
+
+TEST(PathTokenizer, TellsApartComponentsThatDifferInLastByte)
+{
+    // components that differ only in the byte that the hash folds last, i.e., at the end of the word that ends the
+    // component, which is read shifted when the component is longer than a word
+    std::vector<std::string> scopes;
+    ManifestBuilder manifest = ComponentLengthScopes(scopes);
+    for (int version : { 1, FAM_V2_VERSION })
+    {
+        TestAccessHandler handler(manifest, version, /*compileIndex*/ true);
+        const PolicyIndex *index = handler.GetPip()->GetPolicyIndex();
+        PCManifestRecord root = handler.GetPip()->GetManifestRecord();
+        for (size_t length = 1; length <= 40; length++)
+        {
+            std::string found = Component(length, 'x');
+            std::string missing = Component(length, 'z');
+            PolicySearchCursor cursor = index->Find(root, found.c_str(), found.length());
+            EXPECT_FALSE(cursor.SearchWasTruncated);
+            EXPECT_TRUE(cursor.Record->GetPathId() != 0);
+
+            cursor = index->Find(root, missing.c_str(), missing.length());
+            EXPECT_TRUE(cursor.SearchWasTruncated);
+            EXPECT_EQ(0u, (uint32_t)cursor.Record->GetPathId());
+        }
+    }
+}
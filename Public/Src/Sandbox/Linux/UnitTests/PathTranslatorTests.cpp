@@ -0,0 +1,174 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <limits.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <string>
+
+#include "OpNames.hpp"
+#include "PathTranslator.hpp"
+#include "SandboxedRun.hpp"
+#include "TestHarness.hpp"
+
+// 'path' as translated by 'translator' (and whether any translation applied)
+static std::string Translated(const PathTranslator &translator, const std::string &path, bool expectTranslated = true)
+{
+    std::string translated = path;
+    EXPECT_EQ(expectTranslated, translator.Translate(translated));
+    return translated;
+}
+
+TEST(PathTranslator, TranslatesPathsInDirectory)
+{
+    PathTranslator translator;
+    EXPECT_TRUE(translator.IsEmpty());
+    ASSERT_TRUE(translator.Add("/a/from", "/b/to"));
+    EXPECT_FALSE(translator.IsEmpty());
+
+    EXPECT_EQ(std::string("/b/to"), Translated(translator, "/a/from"));
+    EXPECT_EQ(std::string("/b/to/f"), Translated(translator, "/a/from/f"));
+    EXPECT_EQ(std::string("/b/to/x/y/f"), Translated(translator, "/a/from/x/y/f"));
+
+    // only whole components match
+    EXPECT_EQ(std::string("/a/fromx/f"), Translated(translator, "/a/fromx/f", false));
+    EXPECT_EQ(std::string("/a/fro/f"), Translated(translator, "/a/fro/f", false));
+    EXPECT_EQ(std::string("/a"), Translated(translator, "/a", false));
+    EXPECT_EQ(std::string("/x/a/from"), Translated(translator, "/x/a/from", false));
+    EXPECT_EQ(std::string("a/from/f"), Translated(translator, "a/from/f", false));
+}
+
+TEST(PathTranslator, MatchesDirectoriesIgnoringCase)
+{
+    PathTranslator translator;
+    ASSERT_TRUE(translator.Add("/Src/Out", "/d/To"));
+    EXPECT_EQ(std::string("/d/To/File"), Translated(translator, "/src/OUT/File"));
+    EXPECT_EQ(std::string("/d/To"), Translated(translator, "/SRC/out"));
+}
+
+TEST(PathTranslator, IgnoresTrailingSlashesOfDirectories)
+{
+    PathTranslator translator;
+    ASSERT_TRUE(translator.Add("/a//", "/b/"));
+    EXPECT_EQ(std::string("/b/f"), Translated(translator, "/a/f"));
+    EXPECT_EQ(std::string("/b"), Translated(translator, "/a"));
+}
+
+TEST(PathTranslator, TranslatesRootAndToRoot)
+{
+    PathTranslator toRoot;
+    ASSERT_TRUE(toRoot.Add("/a", "/"));
+    EXPECT_EQ(std::string("/f"), Translated(toRoot, "/a/f"));
+    EXPECT_EQ(std::string("/"), Translated(toRoot, "/a"));
+
+    PathTranslator fromRoot;
+    ASSERT_TRUE(fromRoot.Add("/", "/r"));
+    EXPECT_EQ(std::string("/r/f"), Translated(fromRoot, "/f"));
+    EXPECT_EQ(std::string("/r"), Translated(fromRoot, "/"));
+}
+
+TEST(PathTranslator, LongestDirectoryWins)
+{
+    PathTranslator translator;
+    ASSERT_TRUE(translator.Add("/a", "/x"));
+    ASSERT_TRUE(translator.Add("/a/b/c", "/z"));
+    ASSERT_TRUE(translator.Add("/a/b", "/y"));
+
+    EXPECT_EQ(std::string("/x/f"), Translated(translator, "/a/f"));
+    EXPECT_EQ(std::string("/y/f"), Translated(translator, "/a/b/f"));
+    EXPECT_EQ(std::string("/z/f"), Translated(translator, "/a/b/c/f"));
+    EXPECT_EQ(std::string("/y/cc/f"), Translated(translator, "/a/b/cc/f"));
+}
+
+TEST(PathTranslator, KeepsFirstTranslationOfDirectory)
+{
+    PathTranslator translator;
+    ASSERT_TRUE(translator.Add("/a", "/b"));
+    ASSERT_TRUE(translator.Add("/A/", "/c"));
+    EXPECT_EQ(std::string("/b/f"), Translated(translator, "/a/f"));
+}
+
+TEST(PathTranslator, TranslatesUntilNoTranslationApplies)
+{
+    PathTranslator chain;
+    ASSERT_TRUE(chain.Add("/b", "/c/d"));
+    ASSERT_TRUE(chain.Add("/a", "/b"));
+    EXPECT_EQ(std::string("/c/d/f"), Translated(chain, "/a/f"));
+
+    // a cycle stops once every translation could have applied
+    PathTranslator cycle;
+    ASSERT_TRUE(cycle.Add("/p", "/q"));
+    ASSERT_TRUE(cycle.Add("/q", "/p"));
+    EXPECT_EQ(std::string("/p/f"), Translated(cycle, "/p/f"));
+}
+
+TEST(PathTranslator, RejectsRelativeDirectories)
+{
+    PathTranslator translator;
+    EXPECT_FALSE(translator.Add("a", "/b"));
+    EXPECT_FALSE(translator.Add("/a", "b"));
+    EXPECT_TRUE(translator.IsEmpty());
+    EXPECT_EQ(std::string("/a/f"), Translated(translator, "/a/f", false));
+}
+
+// Probes argv[1]/from/f and argv[1]/other/f
+SCENARIO(ProbeTranslatedAndOther)
+{
+    std::string dir = argv[1];
+    access((dir + "/from/f").c_str(), F_OK);
+    access((dir + "/other/f").c_str(), F_OK);
+    return 0;
+}
+
+static void RunWithTranslation(SandboxedRun &run, bool translateInSandbox)
+{
+    // the 'from' directory differs in case from the directory accessed, which the translation ignores
+    run.Manifest().AddTranslation(run.Path("FROM"), run.Path("to"));
+    if (translateInSandbox)
+    {
+        run.SetEnv("__BUILDXL_TRANSLATE_PATHS", "1");
+    }
+
+    int status = run.Run("ProbeTranslatedAndOther", { run.Dir() });
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+}
+
+TEST(PathTranslator, ReportsTranslatedPaths)
+{
+    SandboxedRun run;
+    RunWithTranslation(run, /*translateInSandbox*/ true);
+    EXPECT_FALSE(run.ReportsOf(run.Path("to/f")).empty());
+    EXPECT_TRUE(run.ReportsOf(run.Path("from/f")).empty());
+    EXPECT_FALSE(run.ReportsOf(run.Path("other/f")).empty());
+}
+
+TEST(PathTranslator, ReportsPathsAsIsUnlessAskedToTranslate)
+{
+    // the host translates the reports itself then
+    SandboxedRun run;
+    RunWithTranslation(run, /*translateInSandbox*/ false);
+    EXPECT_FALSE(run.ReportsOf(run.Path("from/f")).empty());
+    EXPECT_TRUE(run.ReportsOf(run.Path("to/f")).empty());
+}
+
+TEST(PathTranslator, TranslatesPathsOfProcessReports)
+{
+    char binary[PATH_MAX];
+    ssize_t length = readlink("/proc/self/exe", binary, sizeof(binary) - 1);
+    ASSERT_TRUE(length > 0);
+    std::string path(binary, length);
+    std::string name = path.substr(path.rfind('/') + 1);
+
+    // a failed breakaway under the 'from' directory (see StartChild in BreakawayTests.cpp)
+    SandboxedRun run;
+    run.Manifest().AddBreakaway(name).AddTranslation(run.Path("from"), run.Path("to"));
+    run.SetEnv("__BUILDXL_TRANSLATE_PATHS", "1");
+    int status = run.Run("StartChild", { "missing", run.Path("from") });
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+
+    EXPECT_EQ(1u, run.ReportsOf(FileOperation::kOpProcessBreakaway, run.Path("to/" + name)).size());
+    EXPECT_TRUE(run.ReportsOf(FileOperation::kOpProcessBreakaway, run.Path("from/" + name)).empty());
+}
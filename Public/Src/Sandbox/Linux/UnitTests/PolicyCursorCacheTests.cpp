@@ -0,0 +1,131 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <string>
+#include <vector>
+
+#include "PolicyCursorCache.hpp"
+#include "PolicySearch.h"
+#include "TestAccessHandler.hpp"
+#include "TestHarness.hpp"
+
+// the cache only stores the records' addresses, so any record does as a stand-in
+static const ManifestRecord sRecords[2] = {};
+
+TEST(PolicyCursorCache, FindsInsertedCursor)
+{
+    PolicyCursorCache cache;
+    const std::string path = "src/project";
+    PolicySearchCursor cursor;
+    EXPECT_FALSE(cache.TryGet(path.data(), path.size(), &cursor));
+
+    cache.Insert(path.data(), path.size(), PolicySearchCursor(&sRecords[1], true));
+    ASSERT_TRUE(cache.TryGet(path.data(), path.size(), &cursor));
+    EXPECT_TRUE(cursor.Record == &sRecords[1]);
+    EXPECT_TRUE(cursor.SearchWasTruncated);
+
+    // only the given prefix of the path is looked up
+    const std::string file = path + "/file";
+    EXPECT_TRUE(cache.TryGet(file.data(), path.size(), &cursor));
+    EXPECT_FALSE(cache.TryGet(file.data(), file.size(), &cursor));
+    EXPECT_FALSE(cache.TryGet(path.data(), path.size() - 1, &cursor));
+
+    EXPECT_EQ(2u, cache.GetNumHits());
+    EXPECT_EQ(3u, cache.GetNumMisses());
+}
+
+TEST(PolicyCursorCache, DoesNotCacheInvalidCursorOrLongPath)
+{
+    PolicyCursorCache cache;
+    PolicySearchCursor cursor;
+    const std::string path = "src";
+    cache.Insert(path.data(), path.size(), PolicySearchCursor());
+    EXPECT_FALSE(cache.TryGet(path.data(), path.size(), &cursor));
+
+    const std::string longPath(600, 'd');
+    cache.Insert(longPath.data(), longPath.size(), PolicySearchCursor(&sRecords[0]));
+    EXPECT_FALSE(cache.TryGet(longPath.data(), longPath.size(), &cursor));
+}
+
+TEST(PolicyCursorCache, KeepsLastOfPathsSharingEntry)
+{
+    // more directories than entries, so that some of them map to the same entry: each directory is either found
+    // with its own cursor or not found at all
+    PolicyCursorCache cache;
+    const int numPaths = 4096;
+    for (int i = 0; i < numPaths; i++)
+    {
+        std::string path = "dir" + std::to_string(i);
+        cache.Insert(path.data(), path.size(), PolicySearchCursor(&sRecords[i % 2], i % 3 == 0));
+    }
+
+    int numFound = 0;
+    for (int i = 0; i < numPaths; i++)
+    {
+        std::string path = "dir" + std::to_string(i);
+        PolicySearchCursor cursor;
+        if (cache.TryGet(path.data(), path.size(), &cursor))
+        {
+            numFound++;
+            EXPECT_TRUE(cursor.Record == &sRecords[i % 2]);
+            EXPECT_EQ(i % 3 == 0, cursor.SearchWasTruncated);
+        }
+    }
+
+    EXPECT_TRUE(numFound > 0 && numFound <= 1024);
+}
+
+static ManifestBuilder NestedScopes()
+{
+    ManifestBuilder manifest;
+    manifest.AddScope("/src", FileAccessPolicy_AllowRead, FileAccessPolicy_AllowRead, 1);
+    manifest.AddScope("/src/project/out", ManifestBuilder::kAllowAllAndReport, FileAccessPolicy_AllowRead, 2);
+    manifest.AddScope("/src/project/out/bin/app", FileAccessPolicy_AllowRead, FileAccessPolicy_AllowRead, 3);
+    return manifest;
+}
+
+TEST(PolicyCursorCache, LooksUpFilesOfCachedDirectory)
+{
+    TestAccessHandler handler(NestedScopes());
+    PolicyCursorCache *cache = handler.GetPip()->GetPolicyCursorCache();
+
+    // the first file of a directory looks the directory up, the others find its cursor in the cache
+    for (int i = 0; i < 10; i++)
+    {
+        std::string path = "/src/project/out/obj/f" + std::to_string(i);
+        PolicySearchCursor cursor = handler.FindManifestRecord(path.c_str());
+        PolicySearchCursor expected = FindFileAccessPolicyInTreeEx(handler.GetPip()->GetManifestRecord(), path.c_str() + 1, path.size() - 1);
+        EXPECT_TRUE(cursor.Record == expected.Record);
+        EXPECT_EQ(expected.SearchWasTruncated, cursor.SearchWasTruncated);
+        EXPECT_EQ(2u, (uint32_t)cursor.Record->GetPathId());
+    }
+
+    EXPECT_EQ(1u, cache->GetNumMisses());
+    EXPECT_EQ(9u, cache->GetNumHits());
+}
+
+TEST(PolicyCursorCache, LooksUpSameCursorsAsSearchFromRoot)
+{
+    // every path at every depth around the scopes, each looked up twice (the second time from the cache)
+    TestAccessHandler handler(NestedScopes());
+    std::vector<std::string> paths
+    {
+        "/", "/src", "/src/", "/other", "/other/file", "/src/file", "/src/project", "/src/project/file",
+        "/src/project/out", "/src/project/out/file", "/src/project/out/bin", "/src/project/out/bin/app",
+        "/src/project/out/bin/app/file", "/src/project/out/bin/app/dir/file", "/src/project/outer/file",
+        "/src/project/ou/file", "/src/project/out/bin/ap", "/src/project/out/bin/apps/file"
+    };
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (const std::string &path : paths)
+        {
+            PolicySearchCursor cursor = handler.FindManifestRecord(path.c_str());
+            PolicySearchCursor expected = FindFileAccessPolicyInTreeEx(handler.GetPip()->GetManifestRecord(), path.c_str() + 1, path.size() - 1);
+            EXPECT_TRUE(cursor.Record == expected.Record);
+            EXPECT_EQ(expected.SearchWasTruncated, cursor.SearchWasTruncated);
+        }
+    }
+
+    EXPECT_TRUE(handler.GetPip()->GetPolicyCursorCache()->GetNumHits() > 0);
+}
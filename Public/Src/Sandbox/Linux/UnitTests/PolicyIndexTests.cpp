@@ -0,0 +1,260 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "PolicyIndex.hpp"
+#include "PolicySearch.h"
+#include "StringOperations.h"
+#include "TestAccessHandler.hpp"
+#include "TestHarness.hpp"
+
+typedef std::pair<std::string, std::string> Collision;
+
+/**
+ * Two distinct components of 'length' characters (starting with 'first') that 'hash' maps to the same value, found
+ * by brute force among random components (which takes about 2^16 tries for a 32-bit hash; varying only the last few
+ * characters of a component would take much longer, as a hash that folds a character at a time maps those one to one)
+ */
+template <typename Hash>
+static Collision FindCollision(size_t length, char first, Hash hash)
+{
+    std::mt19937 random((uint32_t)length);
+    std::unordered_map<uint32_t, std::string> seen;
+    while (true)
+    {
+        std::string component(length, first);
+        for (size_t i = 1; i < length; i++)
+        {
+            component[i] = (char)('a' + random() % 26);
+        }
+
+        auto inserted = seen.emplace(hash(component), component);
+        if (!inserted.second && inserted.first->second != component)
+        {
+            return { inserted.first->second, component };
+        }
+    }
+}
+
+static std::vector<Collision> FindCollisions()
+{
+    // component lengths around the word size of PolicyIndex::HashComponent, i.e., with no tail, a word and no tail,
+    // and a word and a 1-byte tail (read from the 8 bytes that end the component)
+    std::vector<Collision> collisions;
+    for (size_t length : { 8, 16, 17 })
+    {
+        collisions.push_back(FindCollision(length, 'i', [](const std::string &c) { return ManifestBuilder::HashComponent(c); }));
+        collisions.push_back(FindCollision(length, 't', [](const std::string &c) { return (uint32_t)HashPath(c.c_str(), c.length()); }));
+    }
+
+    return collisions;
+}
+
+TEST(PolicyIndex, FindsCollidingComponents)
+{
+    for (const Collision &collision : FindCollisions())
+    {
+        EXPECT_TRUE(collision.first != collision.second);
+        EXPECT_EQ(collision.first.length(), collision.second.length());
+        bool collidesInIndex = ManifestBuilder::HashComponent(collision.first) == ManifestBuilder::HashComponent(collision.second);
+        bool collidesInTree = HashPath(collision.first.c_str(), collision.first.length()) == HashPath(collision.second.c_str(), collision.second.length());
+        EXPECT_TRUE(collidesInIndex || collidesInTree);
+    }
+}
+
+/** A randomly generated manifest (the same one every time), and paths in and around its scopes */
+class GeneratedManifest final
+{
+public:
+
+    GeneratedManifest()
+    {
+        std::mt19937 random(20240611);
+        std::vector<Collision> collisions = FindCollisions();
+
+        auto pick = [&random](size_t n) { return (size_t)std::uniform_int_distribution<size_t>(0, n - 1)(random); };
+        auto randomComponent = [&]()
+        {
+            static const size_t lengths[] = { 1, 3, 7, 8, 9, 15, 16, 17, 24, 31 };
+            std::string component(lengths[pick(sizeof(lengths) / sizeof(lengths[0]))], 'a');
+            for (char &c : component)
+            {
+                c = "abcdefghijklmnopqrstuvwxyz0123456789._-"[pick(39)];
+            }
+
+            return component;
+        };
+
+        static const uint32_t policies[] =
+        {
+            FileAccessPolicy_AllowRead,
+            FileAccessPolicy_AllowRead | FileAccessPolicy_ReportAccess,
+            FileAccessPolicy_AllowAll,
+            ManifestBuilder::kAllowAllAndReport,
+            FileAccessPolicy_AllowReadIfNonExistent,
+        };
+
+        auto addScope = [&](const std::string &scope)
+        {
+            uint32_t cone = policies[pick(5)];
+            uint32_t node = policies[pick(5)];
+            manifest.AddScope(scope, cone, node, (uint32_t)scopes.size() + 1);
+            scopes.push_back(scope);
+        };
+
+        // nested cones, i.e., scopes below the scopes added before them
+        scopes.push_back("");
+        for (int i = 0; i < 300; i++)
+        {
+            addScope(scopes[pick(scopes.size())] + "/" + randomComponent());
+        }
+
+        // both components of every collision under the same parent, and the first one only under another parent,
+        // where looking up the second one finds a child with the same hash but another path
+        for (const Collision &collision : collisions)
+        {
+            std::string parent = scopes[1 + pick(scopes.size() - 1)];
+            addScope(parent + "/" + collision.first);
+            addScope(parent + "/" + collision.second);
+
+            std::string otherParent = scopes[1 + pick(scopes.size() - 1)];
+            addScope(otherParent + "/" + collision.first);
+            paths.push_back(otherParent + "/" + collision.second + "/file");
+        }
+
+        // the scopes themselves, with a trailing or doubled separator, and paths below them (and below their leaves)
+        // that leave the tree at once or after a component that is a prefix or an extension of a child's
+        for (size_t i = 1; i < scopes.size(); i++)
+        {
+            const std::string &scope = scopes[i];
+            paths.push_back(scope);
+            paths.push_back(scope + "/");
+            paths.push_back(scope + "/" + randomComponent() + "/" + randomComponent());
+
+            size_t lastSeparator = scope.rfind('/');
+            paths.push_back(scope.substr(0, lastSeparator) + "//" + scope.substr(lastSeparator + 1) + "/f");
+            paths.push_back(scope.substr(0, scope.length() - 1) + "/f");
+            paths.push_back(scope + "x/f");
+        }
+    }
+
+    ManifestBuilder manifest;
+    std::vector<std::string> scopes;
+    std::vector<std::string> paths;
+};
+
+static void ExpectSameCursor(const PolicySearchCursor &expected, const PolicySearchCursor &actual)
+{
+    EXPECT_TRUE(expected.Record == actual.Record);
+    EXPECT_EQ(expected.SearchWasTruncated, actual.SearchWasTruncated);
+}
+
+// records of different manifests: the same policies and path id
+static void ExpectSamePolicies(const PolicySearchCursor &expected, const PolicySearchCursor &actual)
+{
+    ASSERT_TRUE(actual.IsValid());
+    EXPECT_EQ((uint32_t)expected.Record->GetConePolicy(), (uint32_t)actual.Record->GetConePolicy());
+    EXPECT_EQ((uint32_t)expected.Record->GetNodePolicy(), (uint32_t)actual.Record->GetNodePolicy());
+    EXPECT_EQ((uint32_t)expected.Record->GetPathId(), (uint32_t)actual.Record->GetPathId());
+    EXPECT_EQ(expected.SearchWasTruncated, actual.SearchWasTruncated);
+}
+
+TEST(PolicyIndex, FindsSameRecordsAsTree)
+{
+    // every prefix of every path (without the root sentinel), searched from the root and, at every separator,
+    // resumed from the cursor of the prefix before it
+    GeneratedManifest generated;
+    TestAccessHandler compiled(generated.manifest, 1, /*compileIndex*/ true);
+    TestAccessHandler opened(generated.manifest, FAM_V2_VERSION);
+
+    const PolicyIndex *compiledIndex = compiled.GetPip()->GetPolicyIndex();
+    const PolicyIndex *openedIndex = opened.GetPip()->GetPolicyIndex();
+    ASSERT_TRUE(compiledIndex != nullptr && !compiledIndex->IsOpenedInPlace());
+    ASSERT_TRUE(openedIndex != nullptr && openedIndex->IsOpenedInPlace());
+    EXPECT_EQ(compiledIndex->NumNodes(), openedIndex->NumNodes());
+
+    PCManifestRecord tree = compiled.GetPip()->GetManifestRecord();
+    PCManifestRecord openedRoot = opened.GetPip()->GetManifestRecord();
+
+    size_t numTruncated = 0;
+    for (const std::string &path : generated.paths)
+    {
+        const std::string pathWithoutRootSentinel = path.substr(1);
+        PolicySearchCursor treeCursor(tree);
+        PolicySearchCursor compiledCursor(tree);
+        PolicySearchCursor openedCursor(openedRoot);
+        size_t cursorLength = 0;
+
+        for (size_t length = 0; length <= pathWithoutRootSentinel.length(); length++)
+        {
+            const std::string prefix = pathWithoutRootSentinel.substr(0, length);
+            PolicySearchCursor expected = FindFileAccessPolicyInTreeEx(tree, prefix.c_str(), prefix.length());
+            ExpectSameCursor(expected, compiledIndex->Find(tree, prefix.c_str(), prefix.length()));
+            ExpectSamePolicies(expected, openedIndex->Find(openedRoot, prefix.c_str(), prefix.length()));
+            numTruncated += expected.SearchWasTruncated ? 1 : 0;
+
+            if (length > 0 && prefix[length - 1] == '/')
+            {
+                const std::string rest = pathWithoutRootSentinel.substr(cursorLength);
+                PolicySearchCursor resumed = FindFileAccessPolicyInTreeEx(treeCursor, rest.c_str(), rest.length());
+                ExpectSameCursor(resumed, compiledIndex->Find(compiledCursor, rest.c_str(), rest.length()));
+                ExpectSamePolicies(resumed, openedIndex->Find(openedCursor, rest.c_str(), rest.length()));
+
+                const std::string component = pathWithoutRootSentinel.substr(cursorLength, length - cursorLength);
+                treeCursor     = FindFileAccessPolicyInTreeEx(treeCursor, component.c_str(), component.length());
+                compiledCursor = compiledIndex->Find(compiledCursor, component.c_str(), component.length());
+                openedCursor   = openedIndex->Find(openedCursor, component.c_str(), component.length());
+                ExpectSameCursor(treeCursor, compiledCursor);
+                ExpectSamePolicies(treeCursor, openedCursor);
+                cursorLength = length;
+            }
+        }
+    }
+
+    EXPECT_TRUE(numTruncated > 0);
+}
+
+TEST(PolicyIndex, FindsCollidingSiblings)
+{
+    // siblings whose hashes are equal are told apart by their paths; a missing sibling with the same hash is not found
+    std::vector<Collision> collisions = FindCollisions();
+    ManifestBuilder manifest;
+    uint32_t pathId = 1;
+    for (const Collision &collision : collisions)
+    {
+        manifest.AddScope("/both/" + collision.first, FileAccessPolicy_AllowRead, FileAccessPolicy_AllowRead, pathId++);
+        manifest.AddScope("/both/" + collision.second, FileAccessPolicy_AllowAll, FileAccessPolicy_AllowAll, pathId++);
+        manifest.AddScope("/one/" + collision.first, FileAccessPolicy_AllowRead, FileAccessPolicy_AllowRead, pathId++);
+    }
+
+    for (int version : { 1, FAM_V2_VERSION })
+    {
+        TestAccessHandler handler(manifest, version, /*compileIndex*/ true);
+        const PolicyIndex *index = handler.GetPip()->GetPolicyIndex();
+        ASSERT_TRUE(index != nullptr);
+        PCManifestRecord root = handler.GetPip()->GetManifestRecord();
+
+        pathId = 1;
+        for (const Collision &collision : collisions)
+        {
+            for (const std::string &path : { "both/" + collision.first, "both/" + collision.second, "one/" + collision.first })
+            {
+                PolicySearchCursor cursor = index->Find(root, path.c_str(), path.length());
+                ASSERT_TRUE(cursor.IsValid());
+                EXPECT_FALSE(cursor.SearchWasTruncated);
+                EXPECT_EQ(pathId++, (uint32_t)cursor.Record->GetPathId());
+            }
+
+            std::string missing = "one/" + collision.second;
+            PolicySearchCursor cursor = index->Find(root, missing.c_str(), missing.length());
+            ASSERT_TRUE(cursor.IsValid());
+            EXPECT_TRUE(cursor.SearchWasTruncated);
+            EXPECT_EQ(0u, (uint32_t)cursor.Record->GetPathId());
+        }
+    }
+}
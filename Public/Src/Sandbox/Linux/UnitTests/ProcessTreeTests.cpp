@@ -0,0 +1,270 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include "Host/ProcessTreeMonitor.hpp"
+#include "ProcessTree.hpp"
+#include "SandboxedRun.hpp"
+#include "TestHarness.hpp"
+
+#define TreeCompletionTimeoutSeconds 10
+
+/** A tree created in a file of its own, which is removed with it */
+class TestTree final
+{
+public:
+
+    TestTree(uint64_t capacity, pid_t rootPid, const std::string &path = std::string())
+    {
+        static int sNextId = 0;
+        path_ = !path.empty() ? path : "/tmp/bxltreetest." + std::to_string(getpid()) + "." + std::to_string(sNextId++);
+        tree_ = ProcessTree::Create(path_.c_str(), capacity, rootPid);
+    }
+
+    ~TestTree()
+    {
+        delete tree_;
+        unlink(path_.c_str());
+    }
+
+    bool IsValid() const { return tree_ != NULL; }
+    const std::string& Path() const { return path_; }
+    ProcessTree* operator -> () { return tree_; }
+    ProcessTree* Get() { return tree_; }
+
+private:
+
+    std::string path_;
+    ProcessTree *tree_;
+};
+
+static std::mutex sCompletedLock;
+static std::condition_variable sTreeCompleted;
+static std::set<int64_t> sCompleted;
+
+static void OnTreeCompleted(int64_t treeId)
+{
+    std::lock_guard<std::mutex> lock(sCompletedLock);
+    sCompleted.insert(treeId);
+    sTreeCompleted.notify_all();
+}
+
+static bool WaitForCompletion(int64_t treeId, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(sCompletedLock);
+    return sTreeCompleted.wait_for(lock, timeout, [treeId] { return sCompleted.count(treeId) != 0; });
+}
+
+// a child that waits to be killed
+static pid_t ForkSleeper()
+{
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        pause();
+        _exit(0);
+    }
+
+    return pid;
+}
+
+TEST(ProcessTree, TracksRegisteredProcesses)
+{
+    TestTree tree(16, 100);
+    ASSERT_TRUE(tree.IsValid());
+    EXPECT_EQ(1, tree->NumActive());
+    EXPECT_EQ(1u, tree->NumSlots());
+
+    // a child about to be forked has no pid yet
+    int child = tree->Register(0);
+    EXPECT_EQ(1, child);
+    uint32_t state;
+    EXPECT_EQ(0, tree->GetProcess(child, &state));
+    EXPECT_EQ(ProcessTreeSlot::kActive, state);
+
+    tree->SetPid(child, 101);
+    EXPECT_EQ(101, tree->GetProcess(child, &state));
+    EXPECT_EQ(child, tree->FindOrRegister(101));
+    EXPECT_EQ(2, tree->FindOrRegister(102));
+    EXPECT_EQ(3, tree->NumActive());
+
+    // a process is accounted for once, whoever marks it exited first
+    EXPECT_FALSE(tree->MarkExited(child, 999));
+    EXPECT_TRUE(tree->MarkExited(child, 101));
+    EXPECT_FALSE(tree->MarkExited(child));
+    EXPECT_EQ(2, tree->NumActive());
+    EXPECT_EQ(101, tree->GetProcess(child, &state));
+    EXPECT_EQ(ProcessTreeSlot::kExited, state);
+
+    // an exited process that shows up again (e.g., with its pid reused) gets a slot of its own
+    EXPECT_EQ(3, tree->FindOrRegister(101));
+
+    EXPECT_TRUE(tree->MarkExited(0));
+    EXPECT_TRUE(tree->MarkExited(2));
+    EXPECT_TRUE(tree->MarkExited(3));
+    EXPECT_TRUE(tree->IsCompleted());
+}
+
+TEST(ProcessTree, NeverCompletesOnceOverflowed)
+{
+    TestTree tree(2, 100);
+    ASSERT_TRUE(tree.IsValid());
+
+    EXPECT_EQ(1, tree->Register(101));
+    EXPECT_EQ(-1, tree->Register(102));
+    EXPECT_TRUE(tree->Overflowed());
+    EXPECT_EQ(2u, tree->NumSlots());
+
+    EXPECT_TRUE(tree->MarkExited(0));
+    EXPECT_TRUE(tree->MarkExited(1));
+    EXPECT_FALSE(tree->MarkExited(-1));
+    EXPECT_FALSE(tree->IsCompleted());
+}
+
+TEST(ProcessTree, AttachesToTreeOfAnotherMapping)
+{
+    TestTree tree(16, 100);
+    ASSERT_TRUE(tree.IsValid());
+
+    int fd = open(tree.Path().c_str(), O_RDWR | O_CLOEXEC);
+    ASSERT_TRUE(fd != -1);
+    ProcessTree *attached = ProcessTree::Attach(fd);
+    close(fd);
+    ASSERT_TRUE(attached != NULL);
+
+    EXPECT_EQ(1, attached->Register(101));
+    EXPECT_EQ(2, tree->NumActive());
+    delete attached;
+}
+
+TEST(ProcessTree, DoesNotAttachToOtherFile)
+{
+    std::string path = "/tmp/bxltreetest." + std::to_string(getpid()) + ".other";
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    ASSERT_TRUE(fd != -1);
+    EXPECT_EQ(0, ftruncate(fd, 4096));
+    EXPECT_TRUE(ProcessTree::Attach(fd) == NULL);
+    close(fd);
+    unlink(path.c_str());
+}
+
+TEST(ProcessTreeMonitor, MarksKilledProcessesExited)
+{
+    ProcessTreeMonitor monitor(OnTreeCompleted);
+    ASSERT_TRUE(monitor.IsValid());
+
+    pid_t root = ForkSleeper();
+    pid_t child = ForkSleeper();
+    TestTree tree(16, root);
+    ASSERT_TRUE(tree.IsValid());
+    tree->Register(child);
+    ASSERT_TRUE(monitor.AddTree(1, tree.Get()));
+
+    kill(root, SIGKILL);
+    waitpid(root, NULL, 0);
+    EXPECT_FALSE(WaitForCompletion(1, std::chrono::milliseconds(100)));
+    EXPECT_EQ(1, tree->NumActive());
+
+    kill(child, SIGKILL);
+    waitpid(child, NULL, 0);
+    EXPECT_TRUE(WaitForCompletion(1, std::chrono::seconds(TreeCompletionTimeoutSeconds)));
+    EXPECT_TRUE(tree->IsCompleted());
+    EXPECT_FALSE(monitor.RemoveTree(1));
+}
+
+TEST(ProcessTreeMonitor, PicksUpProcessesRegisteredLater)
+{
+    ProcessTreeMonitor monitor(OnTreeCompleted);
+    ASSERT_TRUE(monitor.IsValid());
+
+    pid_t root = ForkSleeper();
+    TestTree tree(16, root);
+    ASSERT_TRUE(tree.IsValid());
+    ASSERT_TRUE(monitor.AddTree(2, tree.Get()));
+
+    // registered the way a child about to be forked is, with its pid filled in afterwards
+    int slot = tree->Register(0);
+    usleep(50 * 1000);
+    pid_t child = ForkSleeper();
+    tree->SetPid(slot, child);
+
+    // the root exits on its own
+    tree->MarkExited(0, root);
+    kill(root, SIGKILL);
+    waitpid(root, NULL, 0);
+    EXPECT_FALSE(WaitForCompletion(2, std::chrono::milliseconds(100)));
+
+    kill(child, SIGKILL);
+    waitpid(child, NULL, 0);
+    EXPECT_TRUE(WaitForCompletion(2, std::chrono::seconds(TreeCompletionTimeoutSeconds)));
+}
+
+TEST(ProcessTreeMonitor, MakesNoCallbackForRemovedTree)
+{
+    ProcessTreeMonitor monitor(OnTreeCompleted);
+    ASSERT_TRUE(monitor.IsValid());
+
+    pid_t root = ForkSleeper();
+    TestTree tree(16, root);
+    ASSERT_TRUE(tree.IsValid());
+    ASSERT_TRUE(monitor.AddTree(3, tree.Get()));
+    EXPECT_FALSE(monitor.AddTree(3, tree.Get()));
+    EXPECT_TRUE(monitor.RemoveTree(3));
+
+    kill(root, SIGKILL);
+    waitpid(root, NULL, 0);
+    EXPECT_FALSE(WaitForCompletion(3, std::chrono::milliseconds(100)));
+}
+
+// Forks a child that exits and a child that is killed
+SCENARIO(ForkAndKill)
+{
+    pid_t exiting = fork();
+    if (exiting == 0)
+    {
+        _exit(0);
+    }
+
+    pid_t killed = fork();
+    if (killed == 0)
+    {
+        raise(SIGKILL);
+        _exit(0);
+    }
+
+    int status;
+    return exiting != -1 && killed != -1 && waitpid(exiting, &status, 0) == exiting && waitpid(killed, &status, 0) == killed ? 0 : 1;
+}
+
+TEST(ProcessTree, TracksProcessesOfSandboxedRun)
+{
+    SandboxedRun run;
+
+    // the scenario's root process registers itself next to a stand-in for the root (this process, which the test
+    // marks exited once the run is over)
+    TestTree tree(16, getpid(), run.Path("tree"));
+    ASSERT_TRUE(tree.IsValid());
+    run.SetEnv("__BUILDXL_PROCESS_TREE_PATH", tree.Path());
+    ASSERT_EQ(0, run.Run("ForkAndKill"));
+    EXPECT_TRUE(tree->MarkExited(0, getpid()));
+
+    EXPECT_EQ(4u, tree->NumSlots());
+    EXPECT_FALSE(tree->Overflowed());
+
+    // the killed child never got to mark itself exited
+    EXPECT_EQ(1, tree->NumActive());
+
+    ProcessTreeMonitor monitor(OnTreeCompleted);
+    ASSERT_TRUE(monitor.AddTree(4, tree.Get()));
+    EXPECT_TRUE(WaitForCompletion(4, std::chrono::seconds(TreeCompletionTimeoutSeconds)));
+}
@@ -0,0 +1,129 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <string>
+
+#include "SandboxedRun.hpp"
+#include "TestHarness.hpp"
+
+#define NumBatchedAccesses 5
+
+static std::string sHandlerPath;
+
+static void ProbeFiles(const std::string &dir, const char *prefix)
+{
+    for (int i = 0; i < NumBatchedAccesses; i++)
+    {
+        access((dir + "/" + prefix + std::to_string(i)).c_str(), F_OK);
+    }
+}
+
+static void ProgramHandler(int sig)
+{
+    access(sHandlerPath.c_str(), F_OK);
+    _exit(3);
+}
+
+// Makes a few accesses (fewer than a batch holds) and then ends the way given by argv[1]
+SCENARIO(EndWithBatchedReports)
+{
+    std::string dir = argv[2];
+    ProbeFiles(dir, "probe");
+
+    if (strcmp(argv[1], "exit") == 0)
+    {
+        exit(0);
+    }
+    else if (strcmp(argv[1], "_exit") == 0)
+    {
+        _exit(0);
+    }
+    else if (strcmp(argv[1], "crash") == 0)
+    {
+        raise(SIGSEGV);
+    }
+    else if (strcmp(argv[1], "handler") == 0)
+    {
+        // installed after the sandbox has installed its own, which must report the program's old action back
+        struct sigaction action, old;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = ProgramHandler;
+        sigemptyset(&action.sa_mask);
+        if (sigaction(SIGSEGV, &action, &old) != 0 || old.sa_handler != SIG_DFL)
+        {
+            return 1;
+        }
+
+        sHandlerPath = dir + "/handler";
+        raise(SIGSEGV);
+    }
+    else if (strcmp(argv[1], "resethand") == 0)
+    {
+        // the usual crash handler: restore the default action and raise the signal again
+        signal(SIGABRT, [](int sig) { signal(sig, SIG_DFL); raise(sig); });
+        abort();
+    }
+
+    return 2;
+}
+
+static void ExpectBatchedReports(const SandboxedRun &run)
+{
+    for (int i = 0; i < NumBatchedAccesses; i++)
+    {
+        EXPECT_EQ(1u, run.ReportsOf(run.Path("probe" + std::to_string(i))).size());
+    }
+}
+
+TEST(ReportBatching, FlushesOnExit)
+{
+    SandboxedRun run;
+    run.SetEnv("__BUILDXL_BATCH_REPORTS", "1");
+    EXPECT_EQ(0, run.Run("EndWithBatchedReports", { "exit", run.Dir() }));
+    ExpectBatchedReports(run);
+}
+
+TEST(ReportBatching, FlushesOnRawExit)
+{
+    SandboxedRun run;
+    run.SetEnv("__BUILDXL_BATCH_REPORTS", "1");
+    EXPECT_EQ(0, run.Run("EndWithBatchedReports", { "_exit", run.Dir() }));
+    ExpectBatchedReports(run);
+}
+
+TEST(ReportBatching, FlushesOnCrash)
+{
+    SandboxedRun run;
+    run.SetEnv("__BUILDXL_BATCH_REPORTS", "1");
+    int status = run.Run("EndWithBatchedReports", { "crash", run.Dir() });
+    ASSERT_TRUE(WIFSIGNALED(status));
+    EXPECT_EQ(SIGSEGV, WTERMSIG(status));
+    ExpectBatchedReports(run);
+}
+
+TEST(ReportBatching, ChainsToHandlerInstalledLater)
+{
+    SandboxedRun run;
+    run.SetEnv("__BUILDXL_BATCH_REPORTS", "1");
+    int status = run.Run("EndWithBatchedReports", { "handler", run.Dir() });
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(3, WEXITSTATUS(status));
+    ExpectBatchedReports(run);
+    EXPECT_EQ(1u, run.ReportsOf(run.Path("handler")).size());
+}
+
+TEST(ReportBatching, ChainsToHandlerThatRaisesAgain)
+{
+    SandboxedRun run;
+    run.SetEnv("__BUILDXL_BATCH_REPORTS", "1");
+    int status = run.Run("EndWithBatchedReports", { "resethand", run.Dir() });
+    ASSERT_TRUE(WIFSIGNALED(status));
+    EXPECT_EQ(SIGABRT, WTERMSIG(status));
+    ExpectBatchedReports(run);
+}
@@ -0,0 +1,84 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "SandboxedRun.hpp"
+#include "TestHarness.hpp"
+
+#ifndef SYS_close_range
+#define SYS_close_range 436
+#endif
+
+// Reports an access, closes every descriptor above stderr in the way given by argv[1] (which closes the report
+// descriptor the process keeps open, see BxlObserver::GetReportFd), and then reports more accesses.
+SCENARIO(CloseAllDescriptors)
+{
+    std::string dir = argv[2];
+    access((dir + "/before").c_str(), F_OK);
+
+    if (strcmp(argv[1], "syscall") == 0)
+    {
+        // behind the sandbox's back: the descriptor is found closed when the next report is written
+        syscall(SYS_close_range, 3u, ~0u, 0);
+    }
+    else if (strcmp(argv[1], "close_range") == 0)
+    {
+        close_range(3, ~0u, 0);
+    }
+    else if (strcmp(argv[1], "closefrom") == 0)
+    {
+        closefrom(3);
+    }
+    else if (strcmp(argv[1], "dup3") == 0)
+    {
+        int fd = open("/dev/null", O_RDONLY);
+        for (int i = 3; i < 2048; i++)
+        {
+            if (i != fd)
+            {
+                dup3(fd, i, 0);
+            }
+        }
+    }
+
+    access((dir + "/after").c_str(), F_OK);
+    int fd = open((dir + "/opened").c_str(), O_CREAT | O_WRONLY, 0644);
+    return fd != -1 && close(fd) == 0 ? 0 : 1;
+}
+
+static void ExpectReportsAfterClosingAllDescriptors(const char *how)
+{
+    SandboxedRun run;
+    int status = run.Run("CloseAllDescriptors", { how, run.Dir() });
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(0, WEXITSTATUS(status));
+    EXPECT_FALSE(run.ReportsOf(run.Path("before")).empty());
+    EXPECT_FALSE(run.ReportsOf(run.Path("after")).empty());
+    EXPECT_FALSE(run.ReportsOf(run.Path("opened")).empty());
+    EXPECT_EQ(0, run.NumMalformed());
+}
+
+TEST(ReportChannel, ReopensReportFileClosedBehindItsBack)
+{
+    ExpectReportsAfterClosingAllDescriptors("syscall");
+}
+
+TEST(ReportChannel, ReopensReportFileClosedByCloseRange)
+{
+    ExpectReportsAfterClosingAllDescriptors("close_range");
+}
+
+TEST(ReportChannel, ReopensReportFileClosedByClosefrom)
+{
+    ExpectReportsAfterClosingAllDescriptors("closefrom");
+}
+
+TEST(ReportChannel, ReopensReportFileReplacedByDup3)
+{
+    ExpectReportsAfterClosingAllDescriptors("dup3");
+}
@@ -0,0 +1,123 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "ReportFormat.hpp"
+#include "TestHarness.hpp"
+
+static const std::string sPath = "/home/user/src/project/file.cpp";
+
+static std::vector<char> EncodeRecord(const std::string &path, uint32_t pathId = 0)
+{
+    std::vector<char> buffer(ReportFormat::EncodedSize(path.size(), false, pathId != 0));
+    size_t size = ReportFormat::Encode(buffer.data(), buffer.size(), 7, 4321, 0x4, 1, true, 2, path.data(), path.size(), pathId);
+    buffer.resize(size);
+    return buffer;
+}
+
+TEST(ReportFormat, RoundTripsRecord)
+{
+    std::vector<char> buffer = EncodeRecord(sPath);
+    ASSERT_EQ(ReportFormat::HeaderSize + sPath.size(), buffer.size());
+
+    ReportRecord record;
+    ASSERT_TRUE(ReportFormat::Decode(buffer.data(), buffer.size(), &record));
+    EXPECT_EQ(BxlReportFormatVersion, (int)record.version);
+    EXPECT_EQ(7, (int)record.operation);
+    EXPECT_EQ(4321, record.pid);
+    EXPECT_EQ(0x4u, record.requestedAccess);
+    EXPECT_EQ(1u, record.status);
+    EXPECT_EQ(2u, record.error);
+    EXPECT_TRUE(record.ReportExplicitly());
+    EXPECT_FALSE(record.IsFrontCoded());
+    EXPECT_FALSE(record.HasPathId());
+    EXPECT_EQ(0u, record.pathId);
+    EXPECT_EQ(sPath, std::string(record.path, record.pathLength));
+}
+
+TEST(ReportFormat, RoundTripsRecordWithPathId)
+{
+    std::vector<char> buffer = EncodeRecord(sPath, 0xABCD);
+    ASSERT_EQ(ReportFormat::HeaderSize + ReportFormat::PathIdSize + sPath.size(), buffer.size());
+
+    ReportRecord record;
+    ASSERT_TRUE(ReportFormat::Decode(buffer.data(), buffer.size(), &record));
+    EXPECT_TRUE(record.HasPathId());
+    EXPECT_EQ(0xABCDu, record.pathId);
+    EXPECT_EQ(sPath, std::string(record.path, record.pathLength));
+}
+
+TEST(ReportFormat, RoundTripsRecordWithEmptyPath)
+{
+    std::vector<char> buffer = EncodeRecord("");
+    ReportRecord record;
+    ASSERT_TRUE(ReportFormat::Decode(buffer.data(), buffer.size(), &record));
+    EXPECT_EQ(0u, record.pathLength);
+}
+
+TEST(ReportFormat, RoundTripsFrontCodedRecord)
+{
+    const size_t prefixLength = 12;
+    std::vector<char> buffer(ReportFormat::EncodedSize(sPath.size() - prefixLength, true, true));
+    ASSERT_EQ(buffer.size(), ReportFormat::EncodeFrontCoded(
+        buffer.data(), buffer.size(), 7, 4321, 0x4, 1, false, 0, sPath.data(), sPath.size(), 99, 3, prefixLength, 5));
+
+    ReportRecord record;
+    ASSERT_TRUE(ReportFormat::Decode(buffer.data(), buffer.size(), &record));
+    EXPECT_TRUE(record.IsFrontCoded());
+    EXPECT_FALSE(record.ReportExplicitly());
+    EXPECT_EQ(99u, record.producerId);
+    EXPECT_EQ(3, (int)record.slot);
+    EXPECT_EQ(prefixLength, (size_t)record.prefixLength);
+    EXPECT_EQ(5u, record.pathId);
+    EXPECT_EQ(sPath.substr(prefixLength), std::string(record.path, record.pathLength));
+}
+
+TEST(ReportFormat, FailsToEncodeIntoSmallBuffer)
+{
+    std::vector<char> buffer(ReportFormat::EncodedSize(sPath.size()) - 1);
+    EXPECT_EQ(0u, ReportFormat::Encode(buffer.data(), buffer.size(), 7, 4321, 0x4, 1, true, 2, sPath.data(), sPath.size()));
+}
+
+TEST(ReportFormat, RejectsOtherVersion)
+{
+    std::vector<char> buffer = EncodeRecord(sPath);
+    buffer[0] = BxlReportFormatVersion + 1;
+
+    ReportRecord record;
+    EXPECT_FALSE(ReportFormat::Decode(buffer.data(), buffer.size(), &record));
+}
+
+TEST(ReportFormat, RejectsTruncatedRecord)
+{
+    std::vector<char> buffer = EncodeRecord(sPath, 0xABCD);
+    ReportRecord record;
+    for (size_t size = 0; size < buffer.size(); size++)
+    {
+        EXPECT_FALSE(ReportFormat::Decode(buffer.data(), size, &record));
+    }
+}
+
+TEST(ReportFormat, RejectsTrailingBytes)
+{
+    std::vector<char> buffer = EncodeRecord(sPath);
+    buffer.push_back('x');
+
+    ReportRecord record;
+    EXPECT_FALSE(ReportFormat::Decode(buffer.data(), buffer.size(), &record));
+}
+
+TEST(ReportFormat, RejectsFrontCodingSlotOutOfRange)
+{
+    std::vector<char> buffer(ReportFormat::EncodedSize(sPath.size(), true));
+    ASSERT_EQ(buffer.size(), ReportFormat::EncodeFrontCoded(
+        buffer.data(), buffer.size(), 7, 4321, 0x4, 1, false, 0, sPath.data(), sPath.size(), 99, 0, 0));
+    buffer[ReportFormat::HeaderSize + 6] = BxlFrontCodingNumSlots;
+
+    ReportRecord record;
+    EXPECT_FALSE(ReportFormat::Decode(buffer.data(), buffer.size(), &record));
+}
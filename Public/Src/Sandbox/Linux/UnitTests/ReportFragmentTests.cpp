@@ -0,0 +1,120 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ReportFormat.hpp"
+#include "SandboxedRun.hpp"
+#include "TestHarness.hpp"
+
+#define NumLongPathThreads    4
+#define NumLongPathsPerThread 25
+
+// Length of the long paths: their reports do not fit into PIPE_BUF, even though the paths are valid
+#define LongPathLength (PIPE_BUF - 16)
+
+static_assert(ReportFormat::HeaderSize + LongPathLength + ReportFraming::PrefixSize > PIPE_BUF, "the reports must be fragmented");
+static_assert(LongPathLength < PATH_MAX, "the paths must be valid");
+
+// 'dir' followed by as many components as it takes to be LongPathLength bytes long (each no longer than NAME_MAX)
+static std::string LongPath(const std::string &dir, int thread, int i)
+{
+    std::string path = dir;
+    std::string last = "/t" + std::to_string(thread) + "p" + std::to_string(i);
+    while (path.size() + 201 + last.size() <= LongPathLength)
+    {
+        path += "/" + std::string(200, 'd');
+    }
+
+    path += last;
+    path += std::string(LongPathLength - path.size(), 'x');
+    return path;
+}
+
+// Probes NumLongPathsPerThread long paths under argv[1] from each of NumLongPathThreads threads at once
+SCENARIO(ProbeLongPaths)
+{
+    std::string dir = argv[1];
+    std::vector<std::thread> threads;
+    for (int t = 0; t < NumLongPathThreads; t++)
+    {
+        threads.emplace_back([&dir, t]
+        {
+            for (int i = 0; i < NumLongPathsPerThread; i++)
+            {
+                access(LongPath(dir, t, i).c_str(), F_OK);
+            }
+        });
+    }
+
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    return 0;
+}
+
+static void ExpectLongPathsReceived(SandboxedRun &run)
+{
+    EXPECT_EQ(0, run.Run("ProbeLongPaths", { run.Dir() }));
+    for (int t = 0; t < NumLongPathThreads; t++)
+    {
+        for (int i = 0; i < NumLongPathsPerThread; i++)
+        {
+            EXPECT_EQ(1u, run.ReportsOf(LongPath(run.Dir(), t, i)).size());
+        }
+    }
+
+    EXPECT_EQ(0, run.NumMalformed());
+    EXPECT_EQ(0, run.NumIncomplete());
+}
+
+TEST(ReportFragments, ReassemblesReportsLargerThanPipeBuf)
+{
+    SandboxedRun run;
+    ExpectLongPathsReceived(run);
+}
+
+TEST(ReportFragments, ReassemblesBatchedReportsLargerThanPipeBuf)
+{
+    SandboxedRun run;
+    run.SetEnv("__BUILDXL_BATCH_REPORTS", "1");
+    ExpectLongPathsReceived(run);
+}
+
+TEST(ReportFragments, ReassemblesSpilledReportsLargerThanPipeBuf)
+{
+    // fragments of one report may be split between the FIFO and the journal
+    SandboxedRun run;
+    run.EnableJournals();
+    run.SlowDownReader(std::chrono::milliseconds(100));
+    ExpectLongPathsReceived(run);
+    EXPECT_TRUE(run.NumSpilled() > 0);
+}
+
+TEST(ReportFragments, EncodesFragmentFrame)
+{
+    char frame[PIPE_BUF];
+    std::string chunk(ReportFraming::MaxFragmentChunkSize, 'c');
+    size_t size = ReportFraming::EncodeFragment(frame, 4321, 7, 2, true, chunk.data(), chunk.size());
+    EXPECT_EQ((size_t)PIPE_BUF, size);
+
+    uint32_t prefix;
+    FragmentHeader header;
+    memcpy(&prefix, frame, sizeof(prefix));
+    memcpy(&header, frame + ReportFraming::PrefixSize, sizeof(header));
+    EXPECT_EQ(ReportFraming::kFragmentFlag | (uint32_t)(size - ReportFraming::PrefixSize), prefix);
+    EXPECT_EQ(4321, header.pid);
+    EXPECT_EQ(7u, header.messageId);
+    EXPECT_EQ(2, (int)header.index);
+    EXPECT_EQ(FragmentHeader::kFlagLastFragment, header.flags);
+}
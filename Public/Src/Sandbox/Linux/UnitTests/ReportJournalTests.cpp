@@ -0,0 +1,99 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <string>
+
+#include "ReportFormat.hpp"
+#include "SandboxedRun.hpp"
+#include "TestHarness.hpp"
+
+// enough (with the long names) to fill a FIFO the reader is slow to empty several times over
+#define NumSpillingAccesses 2000
+
+static std::string SpillingAccessName(int i)
+{
+    return "spill" + std::string(200, 'x') + std::to_string(i);
+}
+
+// Probes argv[2] files under argv[1], in a process of its own when argv[3] is "child"
+SCENARIO(ProbeManyFiles)
+{
+    std::string dir = argv[1];
+    int count = atoi(argv[2]);
+    bool inChild = argc > 3 && std::string(argv[3]) == "child";
+
+    pid_t child = inChild ? fork() : 0;
+    if (child == 0)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            access((dir + "/" + SpillingAccessName(i)).c_str(), F_OK);
+        }
+
+        if (inChild)
+        {
+            _exit(0);
+        }
+    }
+
+    int status = 0;
+    return child == -1 || (inChild && (waitpid(child, &status, 0) != child || status != 0)) ? 1 : 0;
+}
+
+static void ExpectAllAccessesReceived(const SandboxedRun &run)
+{
+    for (int i = 0; i < NumSpillingAccesses; i++)
+    {
+        EXPECT_EQ(1u, run.ReportsOf(run.Path(SpillingAccessName(i))).size());
+    }
+
+    EXPECT_EQ(0, run.NumMalformed());
+    EXPECT_EQ(0, run.NumIncomplete());
+}
+
+TEST(ReportJournal, SpillsWhenTheChannelIsFull)
+{
+    SandboxedRun run;
+    run.EnableJournals();
+    run.SlowDownReader(std::chrono::milliseconds(200));
+    EXPECT_EQ(0, run.Run("ProbeManyFiles", { run.Dir(), std::to_string(NumSpillingAccesses) }));
+    EXPECT_TRUE(run.NumSpilled() > 0);
+    ExpectAllAccessesReceived(run);
+}
+
+TEST(ReportJournal, SpillsFromChildProcesses)
+{
+    SandboxedRun run;
+    run.EnableJournals();
+    run.SlowDownReader(std::chrono::milliseconds(200));
+    EXPECT_EQ(0, run.Run("ProbeManyFiles", { run.Dir(), std::to_string(NumSpillingAccesses), "child" }));
+    EXPECT_TRUE(run.NumSpilled() > 0);
+    ExpectAllAccessesReceived(run);
+}
+
+TEST(ReportJournal, DoesNotSpillWithoutJournalDirectory)
+{
+    SandboxedRun run;
+    run.SlowDownReader(std::chrono::milliseconds(20));
+    EXPECT_EQ(0, run.Run("ProbeManyFiles", { run.Dir(), std::to_string(NumSpillingAccesses) }));
+    EXPECT_EQ(0, run.NumSpilled());
+    ExpectAllAccessesReceived(run);
+}
+
+TEST(ReportJournal, RoundTripsEntry)
+{
+    std::string path = "/home/user/src/project/file.cpp";
+    char entry[ReportJournal::EntryHeaderSize + 64];
+    size_t size = ReportJournal::EncodeEntry(entry, sizeof(entry), 123456789, path.data(), path.size());
+    ASSERT_EQ(ReportJournal::EntryHeaderSize + path.size(), size);
+
+    JournalEntryHeader header;
+    EXPECT_EQ(size, ReportJournal::DecodeEntry(entry, size, &header));
+    EXPECT_EQ((uint64_t)123456789, header.sequence);
+    EXPECT_EQ(path, std::string(entry + ReportJournal::EntryHeaderSize, header.length));
+    EXPECT_EQ(0u, ReportJournal::DecodeEntry(entry, size - 1, &header));
+}
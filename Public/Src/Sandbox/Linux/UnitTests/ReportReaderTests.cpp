@@ -0,0 +1,355 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Host/ReportReader.hpp"
+#include "ReportFormat.hpp"
+#include "SandboxedRun.hpp"
+#include "TestHarness.hpp"
+
+#define ChannelCloseTimeoutSeconds 10
+
+/** What the reader handed over for a channel */
+struct ChannelResult
+{
+    std::vector<ObservedReport> reports;
+    int numBatches;
+    bool closed;
+    int error;
+    int numMalformed;
+    int numIncomplete;
+};
+
+static std::mutex sResultsLock;
+static std::condition_variable sChannelClosed;
+static std::map<int64_t, ChannelResult> sResults;
+static int64_t sNextChannelId = 1;
+
+static void OnBatch(int64_t channelId, const ReportEntry *entries, int numEntries)
+{
+    std::lock_guard<std::mutex> lock(sResultsLock);
+    ChannelResult &result = sResults[channelId];
+    result.numBatches++;
+    for (int i = 0; i < numEntries; i++)
+    {
+        const ReportEntry &entry = entries[i];
+        result.reports.push_back(ObservedReport
+        {
+            entry.operation, entry.flags, entry.pid, entry.requestedAccess, entry.status, entry.error, entry.pathId,
+            std::string(entry.path, entry.pathLength)
+        });
+    }
+}
+
+static void OnClosed(int64_t channelId, int error, int numMalformed, int numIncomplete, int numSpilled)
+{
+    std::lock_guard<std::mutex> lock(sResultsLock);
+    ChannelResult &result = sResults[channelId];
+    result.closed        = true;
+    result.error         = error;
+    result.numMalformed  = numMalformed;
+    result.numIncomplete = numIncomplete;
+    sChannelClosed.notify_all();
+}
+
+/** A channel of a reader, with a FIFO of its own (removed with it) that the test writes frames to directly */
+class TestChannel final
+{
+public:
+
+    TestChannel(ReportReader &reader) : reader_(reader), writeFd_(-1)
+    {
+        {
+            std::lock_guard<std::mutex> lock(sResultsLock);
+            id_ = sNextChannelId++;
+            sResults[id_] = ChannelResult();
+        }
+
+        fifoPath_ = "/tmp/bxlreadertest." + std::to_string(getpid()) + "." + std::to_string(id_);
+        if (mkfifo(fifoPath_.c_str(), S_IRUSR | S_IWUSR) == 0 && reader_.AddChannel(id_, fifoPath_.c_str(), false, NULL))
+        {
+            writeFd_ = open(fifoPath_.c_str(), O_WRONLY | O_CLOEXEC);
+        }
+    }
+
+    ~TestChannel()
+    {
+        CloseWriter();
+        unlink(fifoPath_.c_str());
+    }
+
+    bool IsValid() const { return writeFd_ != -1; }
+
+    /** Writes 'data' with a single write, like a sandboxed process */
+    void Write(const std::string &data)
+    {
+        ssize_t written = write(writeFd_, data.data(), data.size());
+        (void)written;
+    }
+
+    /** Closes the test's write end, i.e., the last sandboxed process goes away */
+    void CloseWriter()
+    {
+        if (writeFd_ != -1)
+        {
+            close(writeFd_);
+            writeFd_ = -1;
+        }
+    }
+
+    /** Closes both write ends and waits for the channel to be closed */
+    ChannelResult Close()
+    {
+        CloseWriter();
+        reader_.CloseChannelWriter(id_);
+
+        std::unique_lock<std::mutex> lock(sResultsLock);
+        sChannelClosed.wait_for(lock, std::chrono::seconds(ChannelCloseTimeoutSeconds), [this] { return sResults[id_].closed; });
+        return sResults[id_];
+    }
+
+    bool IsClosed()
+    {
+        std::lock_guard<std::mutex> lock(sResultsLock);
+        return sResults[id_].closed;
+    }
+
+    int64_t Id() const { return id_; }
+
+private:
+
+    ReportReader &reader_;
+    int64_t id_;
+    std::string fifoPath_;
+    int writeFd_;
+};
+
+static std::string Record(const std::string &path, int32_t pid = 1000, uint32_t pathId = 0)
+{
+    std::string record(ReportFormat::EncodedSize(path.size(), false, pathId != 0), '\0');
+    ReportFormat::Encode(&record[0], record.size(), 3, pid, 0x4, 1, false, 0, path.data(), path.size(), pathId);
+    return record;
+}
+
+static std::string Frame(const std::string &record)
+{
+    uint32_t prefix = (uint32_t)record.size();
+    return std::string((const char*)&prefix, ReportFraming::PrefixSize) + record;
+}
+
+static std::string Fragment(int32_t pid, uint32_t messageId, uint16_t index, bool isLast, const std::string &chunk)
+{
+    char frame[PIPE_BUF];
+    size_t size = ReportFraming::EncodeFragment(frame, pid, messageId, index, isLast, chunk.data(), chunk.size());
+    return std::string(frame, size);
+}
+
+static std::vector<std::string> PathsOf(const ChannelResult &result)
+{
+    std::vector<std::string> paths;
+    for (const ObservedReport &report : result.reports)
+    {
+        paths.push_back(report.path);
+    }
+
+    return paths;
+}
+
+TEST(ReportReader, DeliversReportsOfEachChannelToItsOwnId)
+{
+    ReportReader reader(2, OnBatch, OnClosed);
+    ASSERT_TRUE(reader.IsValid());
+
+    const int numChannels = 3;
+    TestChannel *channels[numChannels];
+    for (int c = 0; c < numChannels; c++)
+    {
+        channels[c] = new TestChannel(reader);
+        ASSERT_TRUE(channels[c]->IsValid());
+    }
+
+    std::vector<std::string> expected[numChannels];
+    for (int i = 0; i < 100; i++)
+    {
+        for (int c = 0; c < numChannels; c++)
+        {
+            std::string path = "/c" + std::to_string(c) + "/" + std::to_string(i);
+            channels[c]->Write(Frame(Record(path, 1000 + c, i + 1)));
+            expected[c].push_back(path);
+        }
+    }
+
+    for (int c = 0; c < numChannels; c++)
+    {
+        ChannelResult result = channels[c]->Close();
+        EXPECT_TRUE(result.closed);
+        EXPECT_EQ(0, result.error);
+        EXPECT_EQ(0, result.numMalformed);
+        EXPECT_TRUE(expected[c] == PathsOf(result));
+        EXPECT_EQ(1000 + c, result.reports.back().pid);
+        EXPECT_EQ(100u, result.reports.back().pathId);
+        delete channels[c];
+    }
+}
+
+TEST(ReportReader, DeliversFramesWrittenAtOnce)
+{
+    ReportReader reader(1, OnBatch, OnClosed);
+    TestChannel channel(reader);
+    ASSERT_TRUE(channel.IsValid());
+
+    // several frames in one write, the way a batch of reports is sent
+    channel.Write(Frame(Record("/a")) + Frame(Record("/b")) + Frame(Record("/c")));
+
+    ChannelResult result = channel.Close();
+    EXPECT_TRUE((std::vector<std::string> { "/a", "/b", "/c" }) == PathsOf(result));
+    EXPECT_EQ(0, result.numMalformed);
+}
+
+TEST(ReportReader, CountsMalformedRecordsAndKeepsReading)
+{
+    ReportReader reader(1, OnBatch, OnClosed);
+    TestChannel channel(reader);
+    ASSERT_TRUE(channel.IsValid());
+
+    std::string otherVersion = Record("/other");
+    otherVersion[0] = BxlReportFormatVersion + 1;
+    std::string trailingBytes = Record("/trailing") + "x";
+
+    channel.Write(Frame(Record("/before")));
+    channel.Write(Frame(otherVersion));
+    channel.Write(Frame(trailingBytes));
+    channel.Write(Frame(Record("/after")));
+
+    ChannelResult result = channel.Close();
+    EXPECT_TRUE((std::vector<std::string> { "/before", "/after" }) == PathsOf(result));
+    EXPECT_EQ(2, result.numMalformed);
+}
+
+TEST(ReportReader, CountsFrameCutShortAsMalformed)
+{
+    ReportReader reader(1, OnBatch, OnClosed);
+    TestChannel channel(reader);
+    ASSERT_TRUE(channel.IsValid());
+
+    std::string frame = Frame(Record("/cut"));
+    channel.Write(Frame(Record("/whole")));
+    channel.Write(frame.substr(0, frame.size() / 2));
+
+    ChannelResult result = channel.Close();
+    EXPECT_TRUE((std::vector<std::string> { "/whole" }) == PathsOf(result));
+    EXPECT_EQ(1, result.numMalformed);
+}
+
+TEST(ReportReader, ReassemblesInterleavedFragments)
+{
+    ReportReader reader(1, OnBatch, OnClosed);
+    TestChannel channel(reader);
+    ASSERT_TRUE(channel.IsValid());
+
+    // fragments of records of two processes (one of them with two records in flight), interleaved with a plain frame
+    std::string first = Record("/first/" + std::string(3000, 'f'), 1001);
+    std::string second = Record("/second/" + std::string(3000, 's'), 1002);
+    std::string third = Record("/third/" + std::string(3000, 't'), 1001);
+    channel.Write(Fragment(1001, 1, 0, false, first.substr(0, 1000)));
+    channel.Write(Fragment(1002, 1, 0, false, second.substr(0, 2000)));
+    channel.Write(Fragment(1001, 2, 0, false, third.substr(0, 1500)));
+    channel.Write(Frame(Record("/plain")));
+    channel.Write(Fragment(1001, 1, 1, true, first.substr(1000)));
+    channel.Write(Fragment(1001, 2, 1, true, third.substr(1500)));
+    channel.Write(Fragment(1002, 1, 1, true, second.substr(2000)));
+
+    ChannelResult result = channel.Close();
+    EXPECT_TRUE((std::vector<std::string>
+    {
+        "/plain", "/first/" + std::string(3000, 'f'), "/third/" + std::string(3000, 't'), "/second/" + std::string(3000, 's')
+    }) == PathsOf(result));
+    EXPECT_EQ(0, result.numMalformed);
+    EXPECT_EQ(0, result.numIncomplete);
+}
+
+TEST(ReportReader, CountsIncompleteRecords)
+{
+    ReportReader reader(1, OnBatch, OnClosed);
+    TestChannel channel(reader);
+    ASSERT_TRUE(channel.IsValid());
+
+    std::string record = Record("/killed/" + std::string(3000, 'k'));
+    channel.Write(Fragment(1001, 1, 0, false, record.substr(0, 1000)));
+    channel.Write(Frame(Record("/plain")));
+
+    ChannelResult result = channel.Close();
+    EXPECT_TRUE((std::vector<std::string> { "/plain" }) == PathsOf(result));
+    EXPECT_EQ(0, result.numMalformed);
+    EXPECT_EQ(1, result.numIncomplete);
+}
+
+TEST(ReportReader, ExpandsFrontCodedPaths)
+{
+    ReportReader reader(1, OnBatch, OnClosed);
+    TestChannel channel(reader);
+    ASSERT_TRUE(channel.IsValid());
+
+    std::vector<std::string> paths
+    {
+        "/home/user/src/project/a.cpp", "/home/user/src/project/a.hpp", "/usr/include/stdio.h",
+        "/home/user/src/project/b.cpp", "/usr/include/stdlib.h", "/home/user/src/project/a.cpp"
+    };
+
+    // two producers of the same process keep slots of their own
+    FrontCodingEncoder encoders[] = { FrontCodingEncoder(1), FrontCodingEncoder(2) };
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        FrontCodingEncoder &encoder = encoders[i % 2];
+        const std::string &path = paths[i];
+        int slot;
+        size_t prefixLength;
+        ASSERT_TRUE(encoder.Code(path.data(), path.size(), &slot, &prefixLength));
+
+        std::string record(ReportFormat::EncodedSize(path.size() - prefixLength, true), '\0');
+        ReportFormat::EncodeFrontCoded(
+            &record[0], record.size(), 3, 1000, 0x4, 1, false, 0, path.data(), path.size(), encoder.ProducerId(), slot, prefixLength);
+        channel.Write(Frame(record));
+    }
+
+    ChannelResult result = channel.Close();
+    EXPECT_TRUE(paths == PathsOf(result));
+    EXPECT_EQ(0, result.numMalformed);
+}
+
+TEST(ReportReader, KeepsChannelOpenUntilHostWriterIsClosed)
+{
+    ReportReader reader(1, OnBatch, OnClosed);
+    TestChannel channel(reader);
+    ASSERT_TRUE(channel.IsValid());
+
+    // every sandboxed process is gone, but the host may still start another one
+    channel.Write(Frame(Record("/a")));
+    channel.CloseWriter();
+    usleep(200 * 1000);
+    EXPECT_FALSE(channel.IsClosed());
+
+    ChannelResult result = channel.Close();
+    EXPECT_TRUE(result.closed);
+    EXPECT_EQ(1u, result.reports.size());
+}
+
+TEST(ReportReader, FailsToAddChannelWithoutFifo)
+{
+    ReportReader reader(1, OnBatch, OnClosed);
+    EXPECT_FALSE(reader.AddChannel(sNextChannelId++, "/tmp/bxlreadertest.nonexistent", false, NULL));
+    EXPECT_FALSE(reader.CloseChannelWriter(sNextChannelId));
+}
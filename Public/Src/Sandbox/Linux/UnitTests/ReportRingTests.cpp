@@ -0,0 +1,251 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <string>
+#include <thread>
+
+#include "ReportRing.hpp"
+#include "TestHarness.hpp"
+
+/** A ring created in a file of its own (removed with it), with a producer's view of it attached the way the sandbox attaches one */
+class TestRing final
+{
+public:
+
+    explicit TestRing(uint64_t capacity)
+    {
+        static int sNextId = 0;
+        path_ = "/tmp/bxlringtest." + std::to_string(getpid()) + "." + std::to_string(sNextId++);
+        consumer_ = ReportRing::Create(path_.c_str(), capacity);
+
+        int fd = open(path_.c_str(), O_RDWR | O_CLOEXEC);
+        producer_ = fd != -1 ? ReportRing::Attach(fd) : NULL;
+        if (fd != -1)
+        {
+            close(fd);
+        }
+    }
+
+    ~TestRing()
+    {
+        delete producer_;
+        delete consumer_;
+        unlink(path_.c_str());
+    }
+
+    bool IsValid() const { return consumer_ != NULL && producer_ != NULL; }
+    ReportRing& Consumer() { return *consumer_; }
+    ReportRing& Producer() { return *producer_; }
+
+    /**
+     * Reserves a record of 'length' bytes at the head of the ring and stamps it as owned by 'owner' without committing it,
+     * which is what a producer killed in the middle of writing the record leaves behind
+     */
+    void ReserveWithoutCommitting(uint32_t length, pid_t owner)
+    {
+        int fd = open(path_.c_str(), O_RDWR | O_CLOEXEC);
+        size_t dataOffset = (sizeof(ReportRingHeader) + 4095) & ~(size_t)4095;
+        size_t size = dataOffset + consumer_->Capacity();
+        void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+
+        ReportRingHeader *header = (ReportRingHeader*)addr;
+        uint64_t head = header->head.load();
+        header->head.store(head + ((sizeof(ReportRingRecord) + length + 7) & ~(uint64_t)7));
+
+        ReportRingRecord *record = (ReportRingRecord*)((char*)addr + dataOffset + (head & (consumer_->Capacity() - 1)));
+        record->owner.store((uint32_t)owner);
+        record->word.store(length | ReportRingRecord::kReserved);
+        munmap(addr, size);
+    }
+
+private:
+
+    std::string path_;
+    ReportRing *consumer_;
+    ReportRing *producer_;
+};
+
+static std::string MakePayload(int i)
+{
+    // lengths that are not multiples of the record alignment, so that records land at every offset
+    return std::string(1 + (i * 37) % 300, (char)('a' + i % 26)) + std::to_string(i);
+}
+
+static std::string ReadRecord(ReportRing &ring)
+{
+    char buffer[4096];
+    int length = ring.Read(buffer, sizeof(buffer));
+    return length > 0 ? std::string(buffer, length) : std::string();
+}
+
+// a pid that is guaranteed not to be running: a child that has exited and been reaped
+static pid_t GetExitedPid()
+{
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        _exit(0);
+    }
+
+    waitpid(pid, NULL, 0);
+    return pid;
+}
+
+TEST(ReportRing, RejectsCapacityThatIsNotPowerOfTwo)
+{
+    TestRing ring(3000);
+    EXPECT_FALSE(ring.IsValid());
+}
+
+TEST(ReportRing, ReadsRecordsInOrder)
+{
+    TestRing ring(1 << 16);
+    ASSERT_TRUE(ring.IsValid());
+    EXPECT_EQ(0, ring.Consumer().Read(NULL, 0));
+    EXPECT_TRUE(ring.Consumer().IsDrained());
+
+    for (int i = 0; i < 10; i++)
+    {
+        std::string payload = MakePayload(i);
+        ASSERT_TRUE(ring.Producer().Write(payload.data(), payload.size(), getpid()));
+    }
+
+    EXPECT_FALSE(ring.Consumer().IsDrained());
+    for (int i = 0; i < 10; i++)
+    {
+        EXPECT_EQ(MakePayload(i), ReadRecord(ring.Consumer()));
+    }
+
+    EXPECT_EQ(0, ring.Consumer().Read(NULL, 0));
+    EXPECT_TRUE(ring.Consumer().IsDrained());
+}
+
+TEST(ReportRing, WrapsAroundTheEndOfTheDataArea)
+{
+    // a small ring that the records go around many times, with padding wherever a record does not fit before the end
+    TestRing ring(4096);
+    ASSERT_TRUE(ring.IsValid());
+
+    int numRead = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        std::string payload = MakePayload(i);
+        ASSERT_TRUE(ring.Producer().Write(payload.data(), payload.size(), getpid()));
+
+        // keep a few records in the ring, so that the head and the tail wrap around at different times
+        if (i % 5 == 4)
+        {
+            for (; numRead < i - 2; numRead++)
+            {
+                ASSERT_EQ(MakePayload(numRead), ReadRecord(ring.Consumer()));
+            }
+        }
+    }
+
+    for (; numRead < 1000; numRead++)
+    {
+        ASSERT_EQ(MakePayload(numRead), ReadRecord(ring.Consumer()));
+    }
+
+    EXPECT_TRUE(ring.Consumer().IsDrained());
+}
+
+TEST(ReportRing, BlocksProducerWhileFull)
+{
+    TestRing ring(4096);
+    ASSERT_TRUE(ring.IsValid());
+
+    // many times what the ring holds, so the producer keeps waiting for the consumer to make room
+    const int numRecords = 2000;
+    std::thread producer([&ring]
+    {
+        for (int i = 0; i < numRecords; i++)
+        {
+            std::string payload = MakePayload(i);
+            ring.Producer().Write(payload.data(), payload.size(), getpid());
+        }
+    });
+
+    int numRead = 0;
+    bool inOrder = true;
+    while (numRead < numRecords)
+    {
+        std::string record = ReadRecord(ring.Consumer());
+        if (record.empty())
+        {
+            ring.Consumer().WaitForData(100);
+            continue;
+        }
+
+        inOrder = inOrder && record == MakePayload(numRead);
+        numRead++;
+    }
+
+    producer.join();
+    EXPECT_TRUE(inOrder);
+    EXPECT_TRUE(ring.Consumer().IsDrained());
+}
+
+TEST(ReportRing, RejectsPayloadLargerThanHalfTheRing)
+{
+    TestRing ring(4096);
+    ASSERT_TRUE(ring.IsValid());
+
+    std::string payload(ring.Producer().MaxPayloadLength() + 1, 'x');
+    EXPECT_FALSE(ring.Producer().Write(payload.data(), payload.size(), getpid()));
+    EXPECT_TRUE(ring.Producer().Write(payload.data(), payload.size() - 1, getpid()));
+}
+
+TEST(ReportRing, SkipsRecordOfDeadProducer)
+{
+    TestRing ring(4096);
+    ASSERT_TRUE(ring.IsValid());
+
+    ring.ReserveWithoutCommitting(100, GetExitedPid());
+    std::string payload = MakePayload(1);
+    ASSERT_TRUE(ring.Producer().Write(payload.data(), payload.size(), getpid()));
+
+    // the committed record is stuck behind the abandoned one until that is dropped
+    EXPECT_EQ(0, ring.Consumer().Read(NULL, 0));
+    EXPECT_TRUE(ring.Consumer().SkipAbandonedRecord());
+    EXPECT_EQ(payload, ReadRecord(ring.Consumer()));
+    EXPECT_TRUE(ring.Consumer().IsDrained());
+}
+
+TEST(ReportRing, SkipsRecordOfZombieProducer)
+{
+    TestRing ring(4096);
+    ASSERT_TRUE(ring.IsValid());
+
+    pid_t zombie = fork();
+    if (zombie == 0)
+    {
+        _exit(0);
+    }
+
+    // not reaped yet, so the pid still exists, but the process will never write again
+    usleep(100 * 1000);
+    ring.ReserveWithoutCommitting(100, zombie);
+    EXPECT_TRUE(ring.Consumer().SkipAbandonedRecord());
+    EXPECT_TRUE(ring.Consumer().IsDrained());
+    waitpid(zombie, NULL, 0);
+}
+
+TEST(ReportRing, WaitsForRecordOfLiveProducer)
+{
+    TestRing ring(4096);
+    ASSERT_TRUE(ring.IsValid());
+
+    ring.ReserveWithoutCommitting(100, getpid());
+    EXPECT_FALSE(ring.Consumer().SkipAbandonedRecord());
+    EXPECT_FALSE(ring.Consumer().HasCommittedRecord());
+    EXPECT_FALSE(ring.Consumer().IsDrained());
+}
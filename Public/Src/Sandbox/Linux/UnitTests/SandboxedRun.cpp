@@ -0,0 +1,268 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <fcntl.h>
+#include <ftw.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "Host/ReportReader.hpp"
+#include "SandboxedRun.hpp"
+
+extern char **environ;
+
+#define ReportsFifoName   "reports.fifo"
+#define ManifestFileName  "manifest.fam"
+#define RootPidVar        "__BUILDXL_ROOT_PID="
+#define RootPidDigits     10
+#define ChannelCloseTimeoutSeconds 60
+
+static std::mutex sRunsLock;
+static std::condition_variable sChannelClosed;
+static std::map<int64_t, SandboxedRun*> sRuns;
+static int64_t sNextChannelId = 1;
+
+static ReportReader* GetReportReader(ReportBatchCallback onBatch, ChannelClosedCallback onClosed)
+{
+    // shared by all the runs (and never deleted, like the host's)
+    static ReportReader *reader = new ReportReader(2, onBatch, onClosed);
+    return reader;
+}
+
+static std::string GetTestBinaryPath()
+{
+    char path[PATH_MAX];
+    ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    return length > 0 ? std::string(path, length) : std::string();
+}
+
+static int RemoveEntry(const char *path, const struct stat *, int, struct FTW *)
+{
+    return remove(path);
+}
+
+SandboxedRun::SandboxedRun()
+    : manifestVersion_(1), useJournals_(false), readerDelay_(0), buildAccessSet_(false), closed_(false), numMalformed_(0), numIncomplete_(0), numSpilled_(0)
+{
+    char dir[] = "/tmp/bxlsandboxtests.XXXXXX";
+    if (mkdtemp(dir) != NULL)
+    {
+        dir_ = dir;
+        mkfifo(ReportsPath().c_str(), S_IRUSR | S_IWUSR);
+    }
+}
+
+SandboxedRun::~SandboxedRun()
+{
+    if (!dir_.empty())
+    {
+        nftw(dir_.c_str(), RemoveEntry, 16, FTW_DEPTH | FTW_PHYS);
+    }
+}
+
+std::string SandboxedRun::ReportsPath() const
+{
+    return Path(ReportsFifoName);
+}
+
+void SandboxedRun::EnableJournals()
+{
+    useJournals_ = true;
+    mkdir(JournalDir().c_str(), S_IRWXU);
+    SetEnv("__BUILDXL_REPORTS_JOURNAL_DIR", JournalDir());
+}
+
+std::vector<ObservedReport> SandboxedRun::ReportsOf(int operation, const std::string &path) const
+{
+    std::vector<ObservedReport> found;
+    for (const ObservedReport &report : reports_)
+    {
+        if (report.operation == operation && report.path == path)
+        {
+            found.push_back(report);
+        }
+    }
+
+    return found;
+}
+
+std::vector<ObservedReport> SandboxedRun::ReportsOf(const std::string &path) const
+{
+    std::vector<ObservedReport> found;
+    for (const ObservedReport &report : reports_)
+    {
+        if (report.path == path)
+        {
+            found.push_back(report);
+        }
+    }
+
+    return found;
+}
+
+void SandboxedRun::OnBatch(int64_t channelId, const ReportEntry *entries, int numEntries)
+{
+    std::unique_lock<std::mutex> lock(sRunsLock);
+    auto run = sRuns.find(channelId);
+    if (run == sRuns.end())
+    {
+        return;
+    }
+
+    std::chrono::milliseconds delay = run->second->readerDelay_;
+    if (delay.count() > 0)
+    {
+        // a run is only removed once its channel has been closed, which happens on this thread
+        lock.unlock();
+        std::this_thread::sleep_for(delay);
+        lock.lock();
+    }
+
+    for (int i = 0; i < numEntries; i++)
+    {
+        const ReportEntry &entry = entries[i];
+        run->second->reports_.push_back(ObservedReport
+        {
+            entry.operation, entry.flags, entry.pid, entry.requestedAccess, entry.status, entry.error, entry.pathId,
+            std::string(entry.path, entry.pathLength)
+        });
+    }
+}
+
+void SandboxedRun::OnClosed(int64_t channelId, int error, int numMalformed, int numIncomplete, int numSpilled)
+{
+    std::lock_guard<std::mutex> lock(sRunsLock);
+    auto run = sRuns.find(channelId);
+    if (run == sRuns.end())
+    {
+        return;
+    }
+
+    if (error != 0)
+    {
+        fprintf(stderr, "Reading the reports of channel %ld failed; errno: %d\n", (long)channelId, error);
+    }
+
+    run->second->closed_        = true;
+    run->second->numMalformed_  = numMalformed;
+    run->second->numIncomplete_ = numIncomplete;
+    run->second->numSpilled_    = numSpilled;
+    sChannelClosed.notify_all();
+}
+
+int SandboxedRun::Run(const char *scenario, const std::vector<std::string> &args)
+{
+    std::string binary = GetTestBinaryPath();
+    if (dir_.empty() || binary.empty())
+    {
+        return -1;
+    }
+
+    std::string fifoPath = ReportsPath();
+    std::vector<char> manifest = manifest_.Build(fifoPath, manifestVersion_);
+    FILE *manifestFile = fopen(Path(ManifestFileName).c_str(), "wb");
+    if (manifestFile == NULL || fwrite(manifest.data(), 1, manifest.size(), manifestFile) != manifest.size() || fclose(manifestFile) != 0)
+    {
+        return -1;
+    }
+
+    // everything the child needs is set up before forking (the reader's threads may hold locks the child would need)
+    std::map<std::string, std::string> env;
+    for (char **var = environ; *var != NULL; var++)
+    {
+        const char *equals = strchr(*var, '=');
+        if (equals != NULL)
+        {
+            env[std::string(*var, equals - *var)] = equals + 1;
+        }
+    }
+
+    env["LD_PRELOAD"]         = binary.substr(0, binary.rfind('/')) + "/libDetours.so";
+    env["__BUILDXL_FAM_PATH"] = Path(ManifestFileName);
+    env["__BUILDXL_ROOT_PID"] = std::string(RootPidDigits, '0');
+    for (const auto &var : env_)
+    {
+        env[var.first] = var.second;
+    }
+
+    std::vector<std::string> envStrings;
+    for (const auto &var : env)
+    {
+        envStrings.push_back(var.first + "=" + var.second);
+    }
+
+    std::vector<std::string> argStrings { binary, "--scenario", scenario };
+    argStrings.insert(argStrings.end(), args.begin(), args.end());
+
+    std::vector<char*> argv, envp;
+    for (std::string &arg : argStrings)
+    {
+        argv.push_back(&arg[0]);
+    }
+
+    // the root process of the run is the child, whose pid is only known once it is forked (see below)
+    char *rootPidDigits = NULL;
+    for (std::string &var : envStrings)
+    {
+        envp.push_back(&var[0]);
+        if (var.compare(0, sizeof(RootPidVar) - 1, RootPidVar) == 0 && var.length() == sizeof(RootPidVar) - 1 + RootPidDigits)
+        {
+            rootPidDigits = &var[sizeof(RootPidVar) - 1];
+        }
+    }
+
+    argv.push_back(NULL);
+    envp.push_back(NULL);
+
+    ReportReader *reader = GetReportReader(OnBatch, OnClosed);
+    int64_t channelId;
+    {
+        std::lock_guard<std::mutex> lock(sRunsLock);
+        channelId = sNextChannelId++;
+        sRuns[channelId] = this;
+    }
+
+    int status = -1;
+    if (reader->AddChannel(channelId, fifoPath.c_str(), buildAccessSet_, useJournals_ ? JournalDir().c_str() : NULL))
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            // written in place: nothing is allocated between fork and exec
+            for (int i = RootPidDigits - 1, n = getpid(); rootPidDigits != NULL && i >= 0; i--, n /= 10)
+            {
+                rootPidDigits[i] = (char)('0' + n % 10);
+            }
+
+            execve(argv[0], argv.data(), envp.data());
+            _exit(127);
+        }
+
+        if (pid != -1)
+        {
+            waitpid(pid, &status, 0);
+        }
+
+        reader->CloseChannelWriter(channelId);
+
+        std::unique_lock<std::mutex> lock(sRunsLock);
+        if (!sChannelClosed.wait_for(lock, std::chrono::seconds(ChannelCloseTimeoutSeconds), [this] { return closed_; }))
+        {
+            fprintf(stderr, "The reports of scenario '%s' were not all read in time\n", scenario);
+            status = -1;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(sRunsLock);
+    sRuns.erase(channelId);
+    return status;
+}
@@ -0,0 +1,108 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ManifestBuilder.hpp"
+
+/** An access report received from a sandboxed process (see ReportEntry) */
+struct ObservedReport
+{
+    uint16_t operation;
+    uint8_t flags;
+    int32_t pid;
+    uint32_t requestedAccess;
+    uint32_t status;
+    uint32_t error;
+    uint32_t pathId;
+    std::string path;
+};
+
+/**
+ * Runs a scenario of the test binary (see SCENARIO) in a child process with libDetours.so preloaded, the way the
+ * host runs a pip: with a file access manifest (see 'Manifest') and a FIFO for the reports, which are read with
+ * the host's ReportReader until every process of the run has closed it.
+ *
+ * Every run has its own temporary directory (see 'Path'), which is removed with it.
+ */
+class SandboxedRun final
+{
+public:
+
+    SandboxedRun();
+    ~SandboxedRun();
+
+    SandboxedRun(const SandboxedRun&) = delete;
+    SandboxedRun& operator = (const SandboxedRun&) = delete;
+
+    /** The manifest of the run, written when the scenario is run */
+    ManifestBuilder& Manifest() { return manifest_; }
+
+    /** Layout of the manifest (1 or FAM_V2_VERSION) */
+    void SetManifestVersion(int version) { manifestVersion_ = version; }
+
+    /** Sets an environment variable of the scenario */
+    void SetEnv(const std::string &name, const std::string &value) { env_[name] = value; }
+
+    /** Lets the sandboxed processes spill their reports to overflow journals in 'JournalDir' */
+    void EnableJournals();
+
+    /** Makes the reader take 'delay' over every batch of reports, so that the report channel fills up */
+    void SlowDownReader(std::chrono::milliseconds delay) { readerDelay_ = delay; }
+
+    /** Folds the file access reports into an access set (see AccessSetBuilder) */
+    void BuildAccessSet() { buildAccessSet_ = true; }
+
+    /** The directory of the run */
+    const std::string& Dir() const { return dir_; }
+
+    /** The path of 'name' in the directory of the run */
+    std::string Path(const std::string &name) const { return dir_ + "/" + name; }
+
+    std::string JournalDir() const { return Path("journals"); }
+
+    /** The FIFO the reports are sent to, which the manifest of the run names */
+    std::string ReportsPath() const;
+
+    /** Runs 'scenario' with 'args' and reads its reports; returns its wait status (-1 if it could not be run) */
+    int Run(const char *scenario, const std::vector<std::string> &args = {});
+
+    const std::vector<ObservedReport>& Reports() const { return reports_; }
+
+    /** The reports of 'operation' (a FileOperation) on 'path' */
+    std::vector<ObservedReport> ReportsOf(int operation, const std::string &path) const;
+
+    /** The reports on 'path', of any operation */
+    std::vector<ObservedReport> ReportsOf(const std::string &path) const;
+
+    int NumMalformed() const  { return numMalformed_; }
+    int NumIncomplete() const { return numIncomplete_; }
+    int NumSpilled() const    { return numSpilled_; }
+
+private:
+
+    std::string dir_;
+    ManifestBuilder manifest_;
+    int manifestVersion_;
+    std::map<std::string, std::string> env_;
+    bool useJournals_;
+    std::chrono::milliseconds readerDelay_;
+    bool buildAccessSet_;
+
+    std::vector<ObservedReport> reports_;
+    bool closed_;
+    int numMalformed_;
+    int numIncomplete_;
+    int numSpilled_;
+
+    static void OnBatch(int64_t channelId, const struct ReportEntry *entries, int numEntries);
+    static void OnClosed(int64_t channelId, int error, int numMalformed, int numIncomplete, int numSpilled);
+};
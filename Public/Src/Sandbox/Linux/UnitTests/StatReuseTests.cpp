@@ -0,0 +1,65 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <string>
+
+#include "OpNames.hpp"
+#include "SandboxedRun.hpp"
+#include "TestHarness.hpp"
+
+#define DefaultManifestFlags ((uint32_t)(FileAccessManifestFlag::ReportAllFileAccesses | FileAccessManifestFlag::MonitorChildProcesses))
+
+// Opens 'file', 'link' (a dangling symlink to 'missing') and 'missing' under argv[1] for reading
+SCENARIO(OpenPaths)
+{
+    std::string dir = argv[1];
+    for (const char *name : { "file", "link", "missing" })
+    {
+        int fd = open((dir + "/" + name).c_str(), O_RDONLY);
+        if (fd != -1)
+        {
+            close(fd);
+        }
+    }
+
+    return 0;
+}
+
+static void ExpectLastOperation(const SandboxedRun &run, const std::string &path, int operation)
+{
+    std::vector<ObservedReport> reports = run.ReportsOf(path);
+    ASSERT_FALSE(reports.empty());
+    EXPECT_EQ(operation, (int)reports.back().operation);
+}
+
+// Opening a path reports what the open found there, whether the path was opened before the access was reported
+// (taking the mode from the new descriptor) or after it was checked (stat'ing the path up front)
+static void ExpectOpenedPathsReported(uint32_t flags)
+{
+    // set up behind the sandbox's back, so that the only reports on the paths are those of the opens
+    SandboxedRun run;
+    int fd = open(run.Path("file").c_str(), O_CREAT | O_WRONLY | O_CLOEXEC, 0644);
+    ASSERT_TRUE(fd != -1);
+    close(fd);
+    ASSERT_EQ(0, symlink(run.Path("missing").c_str(), run.Path("link").c_str()));
+
+    run.Manifest().SetFlags(flags);
+    ASSERT_EQ(0, run.Run("OpenPaths", { run.Dir() }));
+    ExpectLastOperation(run, run.Path("file"), FileOperation::kOpKAuthReadFile);
+    ExpectLastOperation(run, run.Path("link"), FileOperation::kOpMacReadlink);
+    ExpectLastOperation(run, run.Path("missing"), FileOperation::kOpMacLookup);
+}
+
+TEST(StatReuse, ReportsWhatOpenFoundWhenOpeningBeforeReporting)
+{
+    ExpectOpenedPathsReported(DefaultManifestFlags);
+}
+
+TEST(StatReuse, ReportsWhatOpenFoundWhenCheckingBeforeOpening)
+{
+    ExpectOpenedPathsReported(DefaultManifestFlags | (uint32_t)FileAccessManifestFlag::FailUnexpectedFileAccesses);
+}
@@ -0,0 +1,94 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include <string>
+
+#include "SandboxedRun.hpp"
+#include "TestHarness.hpp"
+
+// behind the sandbox's back, so that only the call under test can have invalidated the cache
+static int RawSymlink(const std::string &target, const std::string &linkPath)
+{
+    return (int)syscall(SYS_symlinkat, target.c_str(), AT_FDCWD, linkPath.c_str());
+}
+
+// Probes 'x/f' under argv[2] (which fills in the symlink cache), replaces 'x' with a symlink to 'b' using the call
+// given by argv[1] (plus a raw syscall where that call only removes 'x'), and probes 'x/f' again
+SCENARIO(ReplaceWithSymlink)
+{
+    std::string how = argv[1];
+    std::string dir = argv[2];
+    std::string x = dir + "/x";
+    mkdir((dir + "/a").c_str(), S_IRWXU);
+    mkdir((dir + "/b").c_str(), S_IRWXU);
+
+    if (how == "rmdir")
+    {
+        mkdir(x.c_str(), S_IRWXU);
+    }
+    else
+    {
+        symlink("a", x.c_str());
+        symlink("b", (dir + "/y").c_str());
+    }
+
+    access((x + "/f").c_str(), F_OK);
+
+    int result = -1;
+    if (how == "renameat")
+    {
+        result = renameat(AT_FDCWD, (dir + "/y").c_str(), AT_FDCWD, x.c_str());
+    }
+    else if (how == "renameat2")
+    {
+        result = renameat2(AT_FDCWD, (dir + "/y").c_str(), AT_FDCWD, x.c_str(), 0);
+    }
+    else if (how == "unlinkat")
+    {
+        result = unlinkat(AT_FDCWD, x.c_str(), 0) == 0 ? RawSymlink("b", x) : -1;
+    }
+    else if (how == "rmdir")
+    {
+        result = rmdir(x.c_str()) == 0 ? RawSymlink("b", x) : -1;
+    }
+
+    access((x + "/f").c_str(), F_OK);
+    return result == 0 ? 0 : 1;
+}
+
+static void ExpectReplacementSeen(const char *how)
+{
+    SandboxedRun run;
+    int status = run.Run("ReplaceWithSymlink", { how, run.Dir() });
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+    EXPECT_FALSE(run.ReportsOf(run.Path("b/f")).empty());
+}
+
+TEST(SymlinkCache, SeesSymlinkReplacedByRenameat)
+{
+    ExpectReplacementSeen("renameat");
+}
+
+TEST(SymlinkCache, SeesSymlinkReplacedByRenameat2)
+{
+    ExpectReplacementSeen("renameat2");
+}
+
+TEST(SymlinkCache, SeesSymlinkRemovedByUnlinkat)
+{
+    ExpectReplacementSeen("unlinkat");
+}
+
+TEST(SymlinkCache, SeesDirectoryRemovedByRmdir)
+{
+    ExpectReplacementSeen("rmdir");
+}
@@ -0,0 +1,40 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AccessHandler.hpp"
+#include "ManifestBuilder.hpp"
+
+/**
+ * The access handler of a pip whose manifest (see ManifestBuilder) is parsed in this process, the way the sandbox
+ * parses it, with the handler's manifest lookups made public.
+ */
+class TestAccessHandler final : public AccessHandler
+{
+public:
+
+    /** Parses 'manifest' with layout 'version'; compiles the policy index of a version 1 manifest if 'compileIndex' */
+    TestAccessHandler(const ManifestBuilder &manifest, int version = 1, bool compileIndex = false)
+        : AccessHandler(nullptr)
+    {
+        std::vector<char> payload = manifest.Build("/dev/null", version);
+        std::shared_ptr<SandboxedPip> pip = std::make_shared<SandboxedPip>(getpid(), payload.data(), payload.size());
+        if (compileIndex)
+        {
+            pip->CompilePolicyIndex();
+        }
+
+        SetProcess(std::make_shared<SandboxedProcess>(getpid(), pip));
+    }
+
+    using AccessHandler::GetPip;
+    using AccessHandler::FindManifestRecord;
+    using AccessHandler::FindManifestRecords;
+};
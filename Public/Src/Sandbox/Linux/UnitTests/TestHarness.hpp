@@ -0,0 +1,113 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * A minimal harness for the native tests of the Linux sandbox (see 'make test').
+ *
+ * TEST(Suite, Name) defines a test, which fails if any of its EXPECT_* or ASSERT_* checks fails (a failed ASSERT_*
+ * check also returns from the test).  Tests that observe the sandbox the way the host does run a scenario, defined
+ * with SCENARIO(Name), in a child process of the test binary that has libDetours.so preloaded (see SandboxedRun).
+ *
+ * usage: sandboxtests [substring of Suite.Name]...
+ *        sandboxtests --scenario Name [args]...
+ */
+namespace TestHarness
+{
+    typedef void (*TestFunction)();
+    typedef int (*ScenarioFunction)(int argc, char **argv);
+
+    struct Test
+    {
+        const char *suite;
+        const char *name;
+        TestFunction function;
+    };
+
+    struct Scenario
+    {
+        const char *name;
+        ScenarioFunction function;
+    };
+
+    std::vector<Test>& Tests();
+    std::vector<Scenario>& Scenarios();
+
+    /** Marks the running test failed */
+    void Fail(const char *file, int line, const std::string &message);
+
+    struct Registration
+    {
+        Registration(const char *suite, const char *name, TestFunction function) { Tests().push_back({ suite, name, function }); }
+        Registration(const char *name, ScenarioFunction function)                 { Scenarios().push_back({ name, function }); }
+    };
+
+    inline std::string Describe(const std::string &value) { return "\"" + value + "\""; }
+    inline std::string Describe(const char *value)        { return value == nullptr ? "NULL" : Describe(std::string(value)); }
+    inline std::string Describe(bool value)               { return value ? "true" : "false"; }
+
+    template<typename T>
+    std::string Describe(const T &value)
+    {
+        if constexpr (std::is_enum<T>::value)
+        {
+            return std::to_string((int64_t)value);
+        }
+        else if constexpr (std::is_pointer<T>::value)
+        {
+            return value == nullptr ? "NULL" : "(pointer)";
+        }
+        else
+        {
+            return std::to_string(value);
+        }
+    }
+}
+
+#define TEST(suite, name)                                                                               \
+    static void suite##_##name();                                                                       \
+    static TestHarness::Registration suite##_##name##_registration(#suite, #name, suite##_##name);      \
+    static void suite##_##name()
+
+#define SCENARIO(name)                                                                                  \
+    static int Scenario_##name(int argc, char **argv);                                                  \
+    static TestHarness::Registration Scenario_##name##_registration(#name, Scenario_##name);            \
+    static int Scenario_##name(int argc, char **argv)
+
+// the checked expressions are stringified by the outer macros, before their own macros are expanded
+#define CHECK_TRUE_(condition, text, onFailure)                                                         \
+    do                                                                                                  \
+    {                                                                                                   \
+        if (!(condition))                                                                               \
+        {                                                                                               \
+            TestHarness::Fail(__FILE__, __LINE__, std::string("expected ") + text);                     \
+            onFailure;                                                                                  \
+        }                                                                                               \
+    } while (0)
+
+#define CHECK_EQ_(expected, actual, text, onFailure)                                                    \
+    do                                                                                                  \
+    {                                                                                                   \
+        auto expected_ = (expected);                                                                    \
+        auto actual_ = (actual);                                                                        \
+        if (!(expected_ == actual_))                                                                    \
+        {                                                                                               \
+            TestHarness::Fail(__FILE__, __LINE__, std::string(text) + " is " +                          \
+                TestHarness::Describe(actual_) + ", expected " + TestHarness::Describe(expected_));     \
+            onFailure;                                                                                  \
+        }                                                                                               \
+    } while (0)
+
+#define EXPECT_TRUE(condition)      CHECK_TRUE_(condition, #condition, (void)0)
+#define ASSERT_TRUE(condition)      CHECK_TRUE_(condition, #condition, return)
+#define EXPECT_FALSE(condition)     CHECK_TRUE_(!(condition), "!(" #condition ")", (void)0)
+#define ASSERT_FALSE(condition)     CHECK_TRUE_(!(condition), "!(" #condition ")", return)
+#define EXPECT_EQ(expected, actual) CHECK_EQ_(expected, actual, #actual, (void)0)
+#define ASSERT_EQ(expected, actual) CHECK_EQ_(expected, actual, #actual, return)
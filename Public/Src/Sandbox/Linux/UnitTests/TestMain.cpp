@@ -0,0 +1,95 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "TestHarness.hpp"
+
+static bool sCurrentTestFailed = false;
+
+std::vector<TestHarness::Test>& TestHarness::Tests()
+{
+    static std::vector<Test> tests;
+    return tests;
+}
+
+std::vector<TestHarness::Scenario>& TestHarness::Scenarios()
+{
+    static std::vector<Scenario> scenarios;
+    return scenarios;
+}
+
+void TestHarness::Fail(const char *file, int line, const std::string &message)
+{
+    sCurrentTestFailed = true;
+    fprintf(stderr, "%s:%d: %s\n", file, line, message.c_str());
+}
+
+static int RunScenario(int argc, char **argv)
+{
+    for (const TestHarness::Scenario &scenario : TestHarness::Scenarios())
+    {
+        if (strcmp(scenario.name, argv[0]) == 0)
+        {
+            return scenario.function(argc, argv);
+        }
+    }
+
+    fprintf(stderr, "Unknown scenario '%s'\n", argv[0]);
+    return 2;
+}
+
+static bool IsSelected(const std::string &fullName, int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (fullName.find(argv[i]) != std::string::npos)
+        {
+            return true;
+        }
+    }
+
+    return argc <= 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 3 && strcmp(argv[1], "--scenario") == 0)
+    {
+        return RunScenario(argc - 2, argv + 2);
+    }
+
+    std::vector<std::string> failed;
+    int numRun = 0;
+    for (const TestHarness::Test &test : TestHarness::Tests())
+    {
+        std::string fullName = std::string(test.suite) + "." + test.name;
+        if (!IsSelected(fullName, argc, argv))
+        {
+            continue;
+        }
+
+        printf("[ RUN      ] %s\n", fullName.c_str());
+        fflush(stdout);
+
+        sCurrentTestFailed = false;
+        test.function();
+        numRun++;
+
+        printf("[ %s ] %s\n", sCurrentTestFailed ? " FAILED " : "      OK", fullName.c_str());
+        fflush(stdout);
+        if (sCurrentTestFailed)
+        {
+            failed.push_back(fullName);
+        }
+    }
+
+    printf("%d tests run, %zu failed\n", numRun, failed.size());
+    for (const std::string &name : failed)
+    {
+        printf("  FAILED: %s\n", name.c_str());
+    }
+
+    return failed.empty() ? 0 : 1;
+}
@@ -0,0 +1,75 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include <string>
+
+#include "SandboxedRun.hpp"
+#include "TestHarness.hpp"
+
+// Changes the working directory to 'a' under argv[1] with 'chdir', to 'b' with 'fchdir' and to 'c' behind the
+// sandbox's back right before forking, probing a relative path after each change (in the child after the last one)
+SCENARIO(ChangeWorkingDirectory)
+{
+    std::string dir = argv[1];
+    for (const char *name : { "a", "b", "c" })
+    {
+        mkdir((dir + "/" + name).c_str(), S_IRWXU);
+    }
+
+    access("start", F_OK);
+
+    if (chdir((dir + "/a").c_str()) != 0)
+    {
+        return 2;
+    }
+
+    access("afterChdir", F_OK);
+
+    int fd = open((dir + "/b").c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd == -1 || fchdir(fd) != 0)
+    {
+        return 3;
+    }
+
+    close(fd);
+    access("afterFchdir", F_OK);
+
+    if (syscall(SYS_chdir, (dir + "/c").c_str()) != 0)
+    {
+        return 4;
+    }
+
+    pid_t child = fork();
+    if (child == 0)
+    {
+        access("afterFork", F_OK);
+        _exit(0);
+    }
+
+    int status;
+    return child != -1 && waitpid(child, &status, 0) == child && status == 0 ? 0 : 1;
+}
+
+TEST(WorkingDirectory, ResolvesRelativePathsAgainstCurrentDirectory)
+{
+    SandboxedRun run;
+    std::string cwd(PATH_MAX, '\0');
+    ASSERT_TRUE(getcwd(&cwd[0], cwd.size()) != NULL);
+    cwd.resize(strlen(cwd.c_str()));
+
+    int status = run.Run("ChangeWorkingDirectory", { run.Dir() });
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+    EXPECT_FALSE(run.ReportsOf((cwd == "/" ? "" : cwd) + "/start").empty());
+    EXPECT_FALSE(run.ReportsOf(run.Path("a/afterChdir")).empty());
+    EXPECT_FALSE(run.ReportsOf(run.Path("b/afterFchdir")).empty());
+    EXPECT_FALSE(run.ReportsOf(run.Path("c/afterFork")).empty());
+}
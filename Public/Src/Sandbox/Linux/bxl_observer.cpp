@@ -7,122 +7,1206 @@
 #include <stdlib.h>
 #include <string.h>
 #include <dlfcn.h>
+#include <pthread.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 
+#ifdef SYS_openat2
+#include <linux/openat2.h>
+#endif
+
 #include "bxl_observer.hpp"
 #include "IOHandler.hpp"
 
-static std::string empty_str("");
+static std::string empty_str("");
+
+// Report batch of the current thread (see BxlObserver::GetThreadBatch)
+static __thread ReportBatch *sThreadBatch = NULL;
+static __thread bool sThreadBatchUnavailable = false;
+
+// Used to get notified when a thread exits, so that its report batch can be flushed
+static pthread_key_t sThreadBatchKey;
+
+// Front coding state of the current thread (allocated when it first sends a report)
+static __thread FrontCodingEncoder *sFrontCodingEncoder = NULL;
+
+// Set while the current thread is sending a front-coded report
+static __thread bool sSendingFrontCodedReport = false;
+
+// Used to free the front coding state of exiting threads
+static pthread_key_t sFrontCodingEncoderKey;
+
+static void ReleaseFrontCodingEncoder(void *encoder)
+{
+    // this runs on the exiting thread, which may still send reports afterwards (from other destructors)
+    sFrontCodingEncoder = NULL;
+    delete (FrontCodingEncoder*)encoder;
+}
+
+// Signals raised by a crash of the process, before which batched reports are flushed.  Signals sent by other
+// processes (e.g., SIGTERM or SIGINT) are left alone: the program may handle them in ways a handler chained
+// in front of its own cannot reproduce (e.g., 'sigwait'), and a killed pip does not need its reports anyway.
+static const int sFatalSignals[] = { SIGABRT, SIGBUS, SIGFPE, SIGILL, SIGSEGV };
+
+// Set before the handlers of 'sFatalSignals' are installed (a signal may arrive while the singleton is still being constructed)
+static BxlObserver *sBatchingObserver = NULL;
+
+// The actions the program set (or inherited) for 'sFatalSignals', which 'HandleFatalSignal' carries out after the flush
+static struct sigaction sProgramSignalActions[ARRAYSIZE(sFatalSignals)];
+
+static int FatalSignalIndex(int sig)
+{
+    for (size_t i = 0; i < ARRAYSIZE(sFatalSignals); i++)
+    {
+        if (sFatalSignals[i] == sig)
+        {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+static void HandleFatalSignal(int sig, siginfo_t *info, void *context)
+{
+    sBatchingObserver->FlushReportsOnFatalSignal();
+
+    int index = FatalSignalIndex(sig);
+    struct sigaction action = sProgramSignalActions[index];
+    if (action.sa_handler == SIG_DFL)
+    {
+        // deliver the signal with its default action once this handler returns (the signal is not blocked, see 'InstallFatalSignalHandler')
+        struct sigaction dfl;
+        memset(&dfl, 0, sizeof(dfl));
+        dfl.sa_handler = SIG_DFL;
+        sigemptyset(&dfl.sa_mask);
+        sBatchingObserver->real_sigaction(sig, &dfl, NULL);
+        raise(sig);
+        return;
+    }
+
+    if (action.sa_flags & SA_RESETHAND)
+    {
+        sProgramSignalActions[index].sa_handler = SIG_DFL;
+        sProgramSignalActions[index].sa_flags &= ~SA_SIGINFO;
+        sBatchingObserver->InstallFatalSignalHandler(sig);
+    }
+
+    if (action.sa_flags & SA_SIGINFO)
+    {
+        action.sa_sigaction(sig, info, context);
+    }
+    else
+    {
+        action.sa_handler(sig);
+    }
+}
+
+static inline void Lock(ReportBatch *batch)
+{
+    while (batch->lock.test_and_set(std::memory_order_acquire));
+}
+
+static inline void Unlock(ReportBatch *batch)
+{
+    batch->lock.clear(std::memory_order_release);
+}
+
+// Whether 'report' is one of the reports by which the host tracks the processes of the pip
+static inline bool IsProcessReport(const AccessReport &report)
+{
+    return report.operation == FileOperation::kOpProcessStart ||
+           report.operation == FileOperation::kOpProcessExit ||
+           report.operation == FileOperation::kOpProcessBreakaway;
+}
+
+static void HandleAccessReport(AccessReport report, int _)
+{
+    BxlObserver::GetInstance()->SendReport(report);
+}
+
+AccessCheckResult BxlObserver::sNotChecked = AccessCheckResult::Invalid();
+
+BxlObserver* BxlObserver::GetInstance()
+{
+    static BxlObserver s_singleton;
+    return &s_singleton;
+}
+
+BxlObserver::BxlObserver() : reportFd_(-1), reportFdOwnerPid_(getpid()), numReportOpensSaved_(0), ring_(NULL), dedupTable_(NULL), processTree_(NULL), processTreeSlot_(-1), batchReports_(false), numBatchWrites_(0), nextFragmentedMessageId_(0), frontCodePaths_(false), numProducerIds_(0), journalFd_(-1), spilling_(false), numSpilledWrites_(0), cwdSeq_(0), cwdCached_(false), numGetcwdSaved_(0), kernelResolve_(false), numKernelResolves_(0), breakaway_(false)
+{
+    real_readlink("/proc/self/exe", progFullPath_, PATH_MAX);
+
+    const char *rootPidStr = getenv(BxlEnvRootPid);
+    rootPid_ = (rootPidStr && *rootPidStr) ? atoi(rootPidStr) : -1;
+
+    InitFam();
+    InitBreakaway();
+    InitPathTranslator();
+    InitLogFile();
+    InitReportRing();
+    InitReportJournal();
+    InitReportBatching();
+    InitDedupTable();
+    InitProcessTree();
+    InitCwd();
+    InitKernelResolve();
+
+    const char *frontCodePaths = getenv(BxlEnvFrontCodePaths);
+    frontCodePaths_ = frontCodePaths && *frontCodePaths && pthread_key_create(&sFrontCodingEncoderKey, ReleaseFrontCodingEncoder) == 0;
+
+    // the one report of a process that broke away, after which it lets go of the report channel (the host would
+    // otherwise keep receiving from it for as long as it runs, which for a server can be much longer than the pip)
+    if (breakaway_)
+    {
+        ReportBreakaway(progFullPath_);
+        CloseReportChannel();
+    }
+}
+
+void BxlObserver::InitFam()
+{
+    // read FAM env var
+    const char *famPath = getenv(BxlEnvFamPath);
+    if (!(famPath && *famPath))
+    {
+        real_fprintf(stderr, "[%s] ERROR: Env var '%s' not set\n", __func__, BxlEnvFamPath);
+        return;
+    }
+
+    // map the FAM from the memfd the host shared it through, in which case it is parsed in place
+    size_t famMappedLength = 0;
+    const char *famMemfdPath = getenv(BxlEnvFamMemfdPath);
+    const char *famMapped = famMemfdPath && *famMemfdPath ? MapFam(famMemfdPath, &famMappedLength) : NULL;
+    if (famMapped != NULL)
+    {
+        // create SandboxedPip (which parses FAM and throws on error)
+        pip_ = std::shared_ptr<SandboxedPip>(new SandboxedPip(getpid(), famMapped, famMappedLength, /* copyPayload */ false));
+    }
+    else
+    {
+        // read FAM 
+        FILE *famFile = real_fopen(famPath, "rb");
+        if (!famFile)
+        {
+            _fatal("Could not open file '%s'; errno: %d", famPath, errno);
+        }
+
+        fseek(famFile, 0, SEEK_END);
+        long famLength = ftell(famFile);
+        rewind(famFile);
+
+        char *famPayload = (char *)malloc(famLength);
+        real_fread(famPayload, famLength, 1, famFile);
+        real_fclose(famFile);
+
+        // create SandboxedPip (which parses FAM and throws on error)
+        pip_ = std::shared_ptr<SandboxedPip>(new SandboxedPip(getpid(), famPayload, famLength));
+        free(famPayload);
+    }
+
+    // paths are looked up in a flat index of the FAM instead of its tree (when the index cannot be compiled, in the tree)
+    const char *compilePolicyIndex = getenv(BxlEnvCompilePolicyIndex);
+    if (compilePolicyIndex && *compilePolicyIndex)
+    {
+        pip_->CompilePolicyIndex();
+    }
+
+    // create sandbox
+    sandbox_ = new Sandbox(0, Configuration::DetoursLinuxSandboxType);
+
+    // initialize sandbox
+    if (!sandbox_->TrackRootProcess(pip_))
+    {
+        _fatal("Could not track root process %s:%d", __progname, getpid());
+    }
+
+    process_ = sandbox_->FindTrackedProcess(getpid());
+    process_->SetPath(progFullPath_);
+    sandbox_->SetAccessReportCallback(HandleAccessReport);
+}
+
+void BxlObserver::InitBreakaway()
+{
+    if (!IsBreakawayProcess(progFullPath_))
+    {
+        return;
+    }
+
+    // started without going through an interposed 'exec' (which would have exec'd it without LD_PRELOAD)
+    breakaway_ = true;
+    unsetenv("LD_PRELOAD");
+}
+
+void BxlObserver::InitPathTranslator()
+{
+    const char *translatePaths = getenv(BxlEnvTranslatePaths);
+    if (!(translatePaths && *translatePaths) || !IsEnabled())
+    {
+        return;
+    }
+
+    char from[PATH_MAX];
+    char to[PATH_MAX];
+    for (uint32_t i = 0; i < pip_->GetNumTranslatePaths(); i++)
+    {
+        // the host does not translate the reported paths again, so a translation left out here would be lost
+        if (!pip_->GetTranslatePath(i, from, to, PATH_MAX) || !pathTranslator_.Add(from, to))
+        {
+            _fatal("Could not load directory translation #%d of the manifest", i);
+        }
+    }
+}
+
+const char* BxlObserver::MapFam(const char *famMemfdPath, size_t *famLength)
+{
+    int fd = real_open(famMemfdPath, O_RDONLY | O_CLOEXEC, 0);
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    // only a memfd sealed against writing and shrinking is mapped: its content can never change under the parser
+    // (nor can pages of the mapping go away); on any error the FAM is read from its file instead
+    void *addr = MAP_FAILED;
+    int seals = fcntl(fd, F_GET_SEALS);
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (seals != -1 && (seals & (F_SEAL_WRITE | F_SEAL_SHRINK)) == (F_SEAL_WRITE | F_SEAL_SHRINK) && size > 0)
+    {
+        addr = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+
+    real_close(fd);
+    if (addr == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    *famLength = (size_t)size;
+    return (const char*)addr;
+}
+
+void BxlObserver::InitLogFile()
+{
+    const char *logPath = getenv(BxlEnvLogPath);
+    if (logPath && *logPath)
+    {
+        strlcpy(logFile_, logPath, PATH_MAX);
+        logFile_[PATH_MAX-1] = '\0';
+    }
+    else
+    {
+        logFile_[0] = '\0';
+    }
+}
+
+void BxlObserver::InitReportRing()
+{
+    const char *ringPath = getenv(BxlEnvReportsRingPath);
+    if (!(ringPath && *ringPath) || !IsValid())
+    {
+        return;
+    }
+
+    int fd = real_open(ringPath, O_RDWR | O_CLOEXEC, 0);
+    if (fd != -1)
+    {
+        ring_ = ReportRing::Attach(fd);
+        real_close(fd);
+    }
+
+    if (ring_ == NULL)
+    {
+        _fatal("Could not map report ring '%s'; errno: %d", ringPath, errno);
+    }
+}
+
+void BxlObserver::InitReportJournal()
+{
+    journalDir_[0] = '\0';
+
+    const char *journalDir = getenv(BxlEnvReportsJournalDir);
+    if (!(journalDir && *journalDir) || !IsValid() || ring_ != NULL)
+    {
+        // writing to the ring never blocks
+        return;
+    }
+
+    size_t journalDirLength = strlen(journalDir);
+    if (journalDirLength >= sizeof(journalDir_))
+    {
+        LOG_DEBUG("Not spilling reports: the journal directory path is too long: %s", journalDir);
+        return;
+    }
+
+    memcpy(journalDir_, journalDir, journalDirLength + 1);
+
+    // an image exec'd by a process that has spilled keeps spilling, so that the process's reports stay in order
+    if (OpenJournal(/* create */ false) != -1)
+    {
+        spilling_ = true;
+    }
+}
+
+void BxlObserver::InitCwd()
+{
+    cwdCached_ = getcwd(cwd_, PATH_MAX) != NULL;
+}
+
+void BxlObserver::InitKernelResolve()
+{
+#ifdef SYS_openat2
+    // older kernels fail with ENOSYS (and some seccomp profiles with EPERM): paths are then only resolved by 'resolve_path'
+    struct open_how how = {};
+    how.flags = O_PATH | O_CLOEXEC;
+    how.resolve = RESOLVE_NO_MAGICLINKS;
+    int fd = syscall(SYS_openat2, AT_FDCWD, "/", &how, sizeof(how));
+    if (fd != -1)
+    {
+        kernelResolve_ = true;
+        real_close(fd);
+    }
+#endif
+}
+
+void BxlObserver::OnCwdChanged()
+{
+    // a vfork'd child shares this memory with its parent, whose working directory has not changed
+    if (!OwnsReportFd())
+    {
+        cwdCached_ = false;
+        return;
+    }
+
+    // another thread is changing the working directory at the same time: there is no telling which change wins
+    uint32_t seq = cwdSeq_.load();
+    if ((seq & 1) != 0 || !cwdSeq_.compare_exchange_strong(seq, seq + 1))
+    {
+        cwdCached_ = false;
+        return;
+    }
+
+    if (getcwd(cwd_, PATH_MAX) == NULL)
+    {
+        cwdCached_ = false;
+    }
+
+    cwdSeq_.store(seq + 2, std::memory_order_release);
+}
+
+size_t BxlObserver::GetCwd(char *buf, size_t bufsiz)
+{
+    // the cached working directory is kept up to date by the interposed 'chdir'/'fchdir' (a change made behind
+    // them, e.g., by 'syscall(SYS_chdir)', goes unnoticed until the process forks or execs)
+    if (cwdCached_)
+    {
+        uint32_t seq = cwdSeq_.load(std::memory_order_acquire);
+        if ((seq & 1) == 0)
+        {
+            size_t len = strnlen(cwd_, PATH_MAX);
+            if (len < bufsiz)
+            {
+                memcpy(buf, cwd_, len);
+                buf[len] = '\0';
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (cwdSeq_.load(std::memory_order_relaxed) == seq && len < bufsiz && len > 0)
+            {
+                numGetcwdSaved_++;
+                return len;
+            }
+        }
+    }
+
+    return getcwd(buf, bufsiz) != NULL ? strlen(buf) : 0;
+}
+
+void BxlObserver::InitReportBatching()
+{
+    for (int i = 0; i < BxlMaxReportBatches; i++)
+    {
+        batches_[i] = NULL;
+    }
+
+    const char *batchReports = getenv(BxlEnvBatchReports);
+    if (!(batchReports && *batchReports) || !IsValid() || ring_ != NULL)
+    {
+        // writing to the ring does not involve a system call, so there is nothing to gain from batching
+        return;
+    }
+
+    if (pthread_key_create(&sThreadBatchKey, ReleaseThreadBatch) != 0)
+    {
+        return;
+    }
+
+    batchReports_ = true;
+    sBatchingObserver = this;
+
+    // flush batched reports when the process crashes; the actions the program sets for these signals from now on
+    // are recorded by 'SetSignalAction' and carried out after the flush
+    for (size_t i = 0; i < ARRAYSIZE(sFatalSignals); i++)
+    {
+        if (real_sigaction(sFatalSignals[i], NULL, &sProgramSignalActions[i]) == 0 && sProgramSignalActions[i].sa_handler != SIG_IGN)
+        {
+            InstallFatalSignalHandler(sFatalSignals[i]);
+        }
+    }
+}
+
+void BxlObserver::InstallFatalSignalHandler(int sig)
+{
+    const struct sigaction &program = sProgramSignalActions[FatalSignalIndex(sig)];
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = HandleFatalSignal;
+    if (program.sa_handler == SIG_DFL)
+    {
+        // the default action is taken by raising the signal again from the handler
+        action.sa_flags = SA_SIGINFO | SA_NODEFER;
+        sigemptyset(&action.sa_mask);
+    }
+    else
+    {
+        // the handler resets the program's action itself, after the flush
+        action.sa_flags = (program.sa_flags & ~SA_RESETHAND) | SA_SIGINFO;
+        action.sa_mask = program.sa_mask;
+    }
+
+    real_sigaction(sig, &action, NULL);
+}
+
+bool BxlObserver::IsChainingSignal(int sig)
+{
+    return batchReports_ && OwnsReportFd() && FatalSignalIndex(sig) != -1;
+}
+
+int BxlObserver::SetSignalAction(int sig, const struct sigaction *act, struct sigaction *oldact)
+{
+    if (!IsChainingSignal(sig))
+    {
+        return real_sigaction(sig, act, oldact);
+    }
+
+    int index = FatalSignalIndex(sig);
+    struct sigaction previous = sProgramSignalActions[index];
+    if (act != NULL)
+    {
+        if (act->sa_handler == SIG_IGN)
+        {
+            // an ignored signal does not end the process, so there is nothing to flush
+            if (real_sigaction(sig, act, NULL) != 0)
+            {
+                return -1;
+            }
+
+            sProgramSignalActions[index] = *act;
+        }
+        else
+        {
+            sProgramSignalActions[index] = *act;
+            InstallFatalSignalHandler(sig);
+        }
+    }
+
+    if (oldact != NULL)
+    {
+        *oldact = previous;
+    }
+
+    return 0;
+}
+
+void BxlObserver::InitDedupTable()
+{
+    const char *tablePath = getenv(BxlEnvDedupTablePath);
+    if (!(tablePath && *tablePath) || !IsValid())
+    {
+        return;
+    }
+
+    // the table is only an optimization: if it cannot be mapped, every access is simply reported
+    int fd = real_open(tablePath, O_RDWR | O_CLOEXEC, 0);
+    if (fd != -1)
+    {
+        dedupTable_ = AccessDedupTable::Attach(fd);
+        real_close(fd);
+    }
+}
+
+void BxlObserver::InitProcessTree()
+{
+    const char *treePath = getenv(BxlEnvProcessTreePath);
+    if (!(treePath && *treePath) || !IsEnabled())
+    {
+        return;
+    }
+
+    int fd = real_open(treePath, O_RDWR | O_CLOEXEC, 0);
+    if (fd != -1)
+    {
+        processTree_ = ProcessTree::Attach(fd);
+        real_close(fd);
+    }
+
+    if (processTree_ == NULL)
+    {
+        _fatal("Could not map process tree '%s'; errno: %d", treePath, errno);
+    }
+
+    // the root process and forked children are registered already (an exec'd image keeps the slot of the
+    // image it replaced); a child created otherwise (e.g., with 'vfork' or 'posix_spawn') registers itself here
+    processTreeSlot_ = processTree_->FindOrRegister(getpid());
+}
+
+bool BxlObserver::IsAlreadyReported(const AccessReport &report, pid_t pid)
+{
+    // the host tracks the processes of the pip by their start/exit/breakaway reports, so those are always sent
+    if (dedupTable_ == NULL || IsProcessReport(report))
+    {
+        return false;
+    }
+
+    return dedupTable_->Contains(report.path, strnlen(report.path, sizeof(report.path)), report.requestedAccess, pid);
+}
+
+uint32_t BxlObserver::GetAccessToRecord(const AccessReport &report)
+{
+    if (dedupTable_ == NULL || IsProcessReport(report))
+    {
+        return 0;
+    }
+
+    // CODESYNC: PathCacheRecord.GetClosure in SandboxConnectionLinuxDetours.cs (Read implies Probe; Write implies
+    // Read and Probe).  Like the host, only the implied accesses are accumulated, not the reported access itself.
+    uint32_t access = report.requestedAccess;
+    uint32_t closure = 0;
+    if (access & (uint32_t)RequestedAccess::Read)
+    {
+        closure |= (uint32_t)RequestedAccess::Probe;
+    }
+    if (access & (uint32_t)RequestedAccess::Write)
+    {
+        closure |= (uint32_t)RequestedAccess::Read | (uint32_t)RequestedAccess::Probe;
+    }
+
+    return closure;
+}
+
+void BxlObserver::RecordReported(const char *path, size_t length, uint32_t access)
+{
+    if (access != 0)
+    {
+        dedupTable_->Record(path, length, access, getpid());
+    }
+}
+
+bool BxlObserver::AddPendingRecord(ReportBatch *batch, const char *path, size_t length, uint32_t access)
+{
+    if (access == 0)
+    {
+        return true;
+    }
+
+    uint32_t pathLength = (uint32_t)length;
+    if (batch->pendingLength + 2 * sizeof(uint32_t) + length > sizeof(batch->pending))
+    {
+        return false;
+    }
+
+    char *entry = &batch->pending[batch->pendingLength];
+    memcpy(entry, &access, sizeof(access));
+    memcpy(entry + sizeof(access), &pathLength, sizeof(pathLength));
+    memcpy(entry + 2 * sizeof(uint32_t), path, length);
+    batch->pendingLength += 2 * sizeof(uint32_t) + length;
+    return true;
+}
+
+ReportBatch* BxlObserver::GetThreadBatch()
+{
+    if (sThreadBatch != NULL || sThreadBatchUnavailable)
+    {
+        return sThreadBatch;
+    }
+
+    ReportBatch *newBatch = NULL;
+    for (int i = 0; i < BxlMaxReportBatches && sThreadBatch == NULL; i++)
+    {
+        ReportBatch *batch = batches_[i].load();
+        if (batch == NULL)
+        {
+            if (newBatch == NULL)
+            {
+                newBatch = (ReportBatch*)calloc(1, sizeof(ReportBatch));
+                if (newBatch == NULL)
+                {
+                    break;
+                }
+
+                newBatch->inUse = true;
+            }
+
+            if (batches_[i].compare_exchange_strong(batch, newBatch))
+            {
+                sThreadBatch = newBatch;
+                newBatch = NULL;
+                break;
+            }
+        }
+
+        // reuse a batch released by an exited thread
+        if (!batch->inUse.exchange(true))
+        {
+            sThreadBatch = batch;
+        }
+    }
+
+    free(newBatch);
+
+    if (sThreadBatch == NULL)
+    {
+        sThreadBatchUnavailable = true;
+    }
+    else
+    {
+        pthread_setspecific(sThreadBatchKey, sThreadBatch);
+    }
+
+    return sThreadBatch;
+}
+
+void BxlObserver::SendBatch(ReportBatch *batch)
+{
+    if (batch->length > 0)
+    {
+        Send(batch->buffer, batch->length);
+        batch->length = 0;
+        numBatchWrites_++;
+    }
+
+    // only now that the reports are out may other processes rely on them having been sent
+    for (size_t position = 0; position < batch->pendingLength;)
+    {
+        uint32_t access, pathLength;
+        memcpy(&access, &batch->pending[position], sizeof(access));
+        memcpy(&pathLength, &batch->pending[position + sizeof(access)], sizeof(pathLength));
+        RecordReported(&batch->pending[position + 2 * sizeof(uint32_t)], pathLength, access);
+        position += 2 * sizeof(uint32_t) + pathLength;
+    }
+
+    batch->pendingLength = 0;
+}
+
+void BxlObserver::FlushReports()
+{
+    if (!batchReports_)
+    {
+        return;
+    }
+
+    for (int i = 0; i < BxlMaxReportBatches; i++)
+    {
+        ReportBatch *batch = batches_[i].load();
+        if (batch == NULL)
+        {
+            break;
+        }
+
+        Lock(batch);
+        SendBatch(batch);
+        Unlock(batch);
+    }
+}
+
+void BxlObserver::FlushReportsOnFatalSignal()
+{
+    // spilling or fragmenting involve calls that are not async-signal-safe
+    if (!batchReports_ || !OwnsReportFd() || spilling_.load())
+    {
+        return;
+    }
+
+    // the reports of a process that crashes before its first batch is full have not opened the report file yet
+    // ('open' is async-signal-safe, unlike the bookkeeping 'GetReportFd' does around it)
+    int fd = reportFd_.load();
+    bool isTransient = fd == -1;
+    if (isTransient)
+    {
+        fd = real_open(GetReportsPath(), O_WRONLY | O_APPEND | O_CLOEXEC | (journalDir_[0] != '\0' ? O_NONBLOCK : 0), 0);
+        if (fd == -1)
+        {
+            return;
+        }
+    }
+
+    for (int i = 0; i < BxlMaxReportBatches; i++)
+    {
+        ReportBatch *batch = batches_[i].load();
+        if (batch == NULL)
+        {
+            break;
+        }
+
+        // the interrupted code may be holding this lock, in which case waiting for it would deadlock
+        if (batch->lock.test_and_set(std::memory_order_acquire))
+        {
+            continue;
+        }
+
+        // a write to a full (non-blocking) report file fails, dropping the batch
+        // the accesses of the batch are not recorded in the dedup table, which only costs other processes a report
+        if (batch->length > 0)
+        {
+            real_write(fd, batch->buffer, batch->length);
+            batch->length = 0;
+        }
+        batch->pendingLength = 0;
+
+        Unlock(batch);
+    }
+
+    if (isTransient)
+    {
+        real_close(fd);
+    }
+}
+
+void BxlObserver::ReleaseThreadBatch(void *batch)
+{
+    ReportBatch *threadBatch = (ReportBatch*)batch;
+    Lock(threadBatch);
+    GetInstance()->SendBatch(threadBatch);
+    Unlock(threadBatch);
+
+    threadBatch->inUse = false;
+    sThreadBatch = NULL;
+}
+
+int BxlObserver::GetReportFd(bool *isTransient)
+{
+    *isTransient = !OwnsReportFd();
+
+    int fd = reportFd_.load();
+    if (fd != -1 && !*isTransient)
+    {
+        numReportOpensSaved_++;
+        return fd;
+    }
+
+    if (!real_open)
+    {
+        _fatal("syscall 'open' not found; errno: %d", errno);
+    }
+
+    const char *reportsPath = GetReportsPath();
+    fd = real_open(reportsPath, O_WRONLY | O_APPEND | O_CLOEXEC, 0);
+    if (fd == -1)
+    {
+        _fatal("Could not open file '%s'; errno: %d", reportsPath, errno);
+    }
+
+    if (*isTransient)
+    {
+        return fd;
+    }
+
+    int highFd = fcntl(fd, F_DUPFD_CLOEXEC, BxlReportFdMin);
+    if (highFd != -1)
+    {
+        real_close(fd);
+        fd = highFd;
+    }
+
+    // The FIFO is opened in blocking mode (which waits for the host to open it for reading) and only
+    // then made non-blocking, so that a write to a full FIFO fails instead of stalling the program.
+    if (journalDir_[0] != '\0')
+    {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    // another thread may have opened the channel concurrently, in which case we use that one
+    int expected = -1;
+    if (!reportFd_.compare_exchange_strong(expected, fd))
+    {
+        real_close(fd);
+        fd = expected;
+    }
+
+    return fd;
+}
+
+int BxlObserver::RegisterChildProcess()
+{
+    return processTree_ != NULL ? processTree_->Register(0) : -1;
+}
+
+void BxlObserver::OnChildProcessCreated(int processTreeSlot, pid_t childPid)
+{
+    if (processTree_ == NULL)
+    {
+        return;
+    }
+
+    // the child sets its pid too, whichever comes first lets the host watch it
+    if (childPid > 0)
+    {
+        processTree_->SetPid(processTreeSlot, childPid);
+    }
+    else
+    {
+        processTree_->MarkExited(processTreeSlot);
+    }
+}
+
+void BxlObserver::OnChildProcessForked(int processTreeSlot)
+{
+    if (processTree_ != NULL)
+    {
+        processTree_->SetPid(processTreeSlot, getpid());
+        processTreeSlot_ = processTreeSlot;
+    }
+
+    // The inherited report descriptor shares the open file description (and thus O_APPEND) 
+    // with the parent, so the child can keep writing to it; only the per-process stats are reset.
+    reportFdOwnerPid_ = getpid();
+    numReportOpensSaved_ = 0;
+
+    // the child has a journal of its own, and starts out writing to the report file again
+    int journalFd = journalFd_.exchange(-1);
+    if (journalFd != -1)
+    {
+        real_close(journalFd);
+    }
+    spilling_ = false;
+    numSpilledWrites_ = 0;
+
+    symlinkCache_.OnForked();
+    fdOverlay_.OnForked();
+
+    // a thread of the parent may have been in the middle of updating the cached working directory
+    cwdSeq_ = 0;
+    InitCwd();
+
+    // the host has not seen any path from this process yet
+    if (sFrontCodingEncoder != NULL)
+    {
+        sFrontCodingEncoder->Reset();
+    }
+
+    // Only the forking thread exists in the child.  Batches were flushed right before forking, so
+    // anything other threads appended since then is sent by the parent; the child must drop it.
+    for (int i = 0; i < BxlMaxReportBatches && batchReports_; i++)
+    {
+        ReportBatch *batch = batches_[i].load();
+        if (batch == NULL)
+        {
+            break;
+        }
+
+        if (batch != sThreadBatch)
+        {
+            batch->lock.clear();
+            batch->inUse = false;
+            batch->length = 0;
+            batch->pendingLength = 0;
+        }
+    }
+}
+
+void BxlObserver::OnFdOpened(int fd, const std::string &path, int oflags, mode_t mode)
+{
+    if (fd == -1 || !IsEnabled())
+    {
+        return;
+    }
+
+    // The normalized path is what /proc/self/fd/N reads for a regular file or a directory (including a file just
+    // created); for anything else (e.g., /dev/stdout) that is read on the first operation on the descriptor instead.
+    bool isFile = S_ISREG(mode) || S_ISDIR(mode) || (mode == 0 && (oflags & O_CREAT));
+    if (isFile && !(oflags & O_NOFOLLOW))
+    {
+        fdOverlay_.Set(fd, path.c_str(), path.length());
+    }
+    else
+    {
+        fdOverlay_.Clear(fd);
+    }
+}
+
+void BxlObserver::OnFdStreamOpened(int fd)
+{
+    if (fd == -1 || !IsEnabled())
+    {
+        return;
+    }
+
+    // the descriptor is already known if it was opened through an interposed function
+    char path[PATH_MAX];
+    if (fdOverlay_.TryGetPath(fd, path, PATH_MAX) != -1)
+    {
+        return;
+    }
+
+    ssize_t len = fd_to_path(fd, path, PATH_MAX);
+    mode_t mode = len > 0 && len < PATH_MAX && path[0] == '/' ? get_fd_mode(fd) : 0;
+    if (S_ISREG(mode) || S_ISDIR(mode))
+    {
+        fdOverlay_.Set(fd, path, len);
+    }
+}
+
+void BxlObserver::OnFdClosing(int fd)
+{
+    fdOverlay_.Clear(fd);
+
+    int expected = fd;
+    if (fd != -1 && OwnsReportFd() && reportFd_.compare_exchange_strong(expected, -1))
+    {
+        LOG_DEBUG("Report channel descriptor %d is being closed by the traced program", fd);
+    }
+
+    // the journal is reopened (for appending) on the next spilled write
+    expected = fd;
+    if (fd != -1 && OwnsReportFd() && journalFd_.compare_exchange_strong(expected, -1))
+    {
+        LOG_DEBUG("Journal descriptor %d is being closed by the traced program", fd);
+    }
+}
+
+void BxlObserver::OnFdRangeClosing(unsigned int first, unsigned int last)
+{
+    fdOverlay_.ClearRange(first, last);
+
+    int reportFd = reportFd_.load();
+    if (reportFd != -1 && (unsigned int)reportFd >= first && (unsigned int)reportFd <= last)
+    {
+        OnFdClosing(reportFd);
+    }
+
+    int journalFd = journalFd_.load();
+    if (journalFd != -1 && (unsigned int)journalFd >= first && (unsigned int)journalFd <= last)
+    {
+        OnFdClosing(journalFd);
+    }
+}
+
+void BxlObserver::CloseReportChannel()
+{
+    FlushReports();
+
+    if (!OwnsReportFd())
+    {
+        return;
+    }
+
+    // the journal is complete by the time the host reads it, i.e., once every process has closed the report file
+    int journalFd = journalFd_.exchange(-1);
+    if (journalFd != -1)
+    {
+        real_close(journalFd);
+    }
+
+    int fd = reportFd_.exchange(-1);
+    if (fd != -1)
+    {
+        LOG_DEBUG("Closing report channel descriptor %d; number of saved opens: %lu; number of batch writes: %lu; number of spilled writes: %lu; number of saved getcwd calls: %lu; number of kernel path resolutions: %lu",
+            fd, numReportOpensSaved_.load(), numBatchWrites_.load(), numSpilledWrites_.load(), numGetcwdSaved_.load(), numKernelResolves_.load());
+        if (IsValid())
+        {
+            LOG_DEBUG("Policy cursor cache hits: %lu; misses: %lu",
+                pip_->GetPolicyCursorCache()->GetNumHits(), pip_->GetPolicyCursorCache()->GetNumMisses());
+        }
+
+        real_close(fd);
+    }
+
+    // only once all of its reports are out, because the host may stop receiving reports when the last process is gone
+    if (processTree_ != NULL)
+    {
+        processTree_->MarkExited(processTreeSlot_, getpid());
+    }
+}
 
-static void HandleAccessReport(AccessReport report, int _)
+bool BxlObserver::Send(const char *buf, size_t bufsiz, bool maySpill)
 {
-    BxlObserver::GetInstance()->SendReport(report);
-}
+    if (ring_ != NULL)
+    {
+        // ring records carry their own length, so the length prefix is not copied
+        if (!ring_->Write(buf + ReportFraming::PrefixSize, bufsiz - ReportFraming::PrefixSize, reportFdOwnerPid_.load()))
+        {
+            _fatal("Could not write a %ld-byte message into the report ring", bufsiz);
+        }
 
-AccessCheckResult BxlObserver::sNotChecked = AccessCheckResult::Invalid();
+        return true;
+    }
 
-BxlObserver* BxlObserver::GetInstance()
-{
-    static BxlObserver s_singleton;
-    return &s_singleton;
+    // writes of more than PIPE_BUF bytes are not atomic, i.e., could interleave with other writers
+    if (bufsiz > PIPE_BUF)
+    {
+        return SendFragments(buf + ReportFraming::PrefixSize, bufsiz - ReportFraming::PrefixSize, maySpill);
+    }
+
+    WriteToReportFd(buf, bufsiz, maySpill);
+    return true;
 }
 
-BxlObserver::BxlObserver()
+bool BxlObserver::SendFragments(const char *record, size_t length, bool maySpill)
 {
-    real_readlink("/proc/self/exe", progFullPath_, PATH_MAX);
+    char frame[PIPE_BUF];
+    uint32_t messageId = nextFragmentedMessageId_++;
+    uint16_t index = 0;
 
-    const char *rootPidStr = getenv(BxlEnvRootPid);
-    rootPid_ = (rootPidStr && *rootPidStr) ? atoi(rootPidStr) : -1;
+    // Once a fragment is spilled, so are the rest (spilling is sticky); the host reassembles a record whose
+    // first fragments came through the report file and the others from the journal once it reads the journal.
+    for (size_t offset = 0; offset < length; offset += ReportFraming::MaxFragmentChunkSize, index++)
+    {
+        size_t chunkSize = std::min(ReportFraming::MaxFragmentChunkSize, length - offset);
+        bool isLast = offset + chunkSize == length;
+        size_t frameLength = ReportFraming::EncodeFragment(frame, getpid(), messageId, index, isLast, record + offset, chunkSize);
+        WriteToReportFd(frame, frameLength, maySpill);
+    }
 
-    InitFam();
-    InitLogFile();
+    LOG_DEBUG("Sent a %ld-byte record in %d fragments", length, index);
+    return true;
 }
 
-void BxlObserver::InitFam()
+bool BxlObserver::WriteToReportFd(const char *buf, size_t bufsiz, bool maySpill)
 {
-    // read FAM env var
-    const char *famPath = getenv(BxlEnvFamPath);
-    if (!(famPath && *famPath))
+    bool isTransient;
+    int reportFd = GetReportFd(&isTransient);
+
+    // a transient descriptor (see GetReportFd) is blocking, as it is only used until the process execs
+    bool spill = maySpill && !isTransient && journalDir_[0] != '\0';
+    if (spill && spilling_)
     {
-        real_fprintf(stderr, "[%s] ERROR: Env var '%s' not set\n", __func__, BxlEnvFamPath);
-        return;
+        AppendToJournal(buf, bufsiz);
+        return false;
     }
 
-    // read FAM 
-    FILE *famFile = real_fopen(famPath, "rb");
-    if (!famFile)
+    ssize_t numWritten;
+    while ((numWritten = real_write(reportFd, buf, bufsiz)) == -1 && (errno == EAGAIN || errno == EBADF))
     {
-        _fatal("Could not open file '%s'; errno: %d", famPath, errno);
-    }
+        if (errno == EBADF)
+        {
+            if (isTransient)
+            {
+                break;
+            }
+
+            // the traced program closed the descriptor without going through an interposed function (e.g., with
+            // a raw system call), so it is dropped and the report file is opened again
+            LOG_DEBUG("Report channel descriptor %d was closed behind the sandbox's back; reopening the report file", reportFd);
+            int expected = reportFd;
+            reportFd_.compare_exchange_strong(expected, -1);
+            reportFd = GetReportFd(&isTransient);
+            continue;
+        }
 
-    fseek(famFile, 0, SEEK_END);
-    long famLength = ftell(famFile);
-    rewind(famFile);
+        if (spill)
+        {
+            if (!spilling_.exchange(true))
+            {
+                LOG_DEBUG("Report channel is full; spilling reports to the journal in '%s'", journalDir_);
+            }
 
-    char *famPayload = (char *)malloc(famLength);
-    real_fread(famPayload, famLength, 1, famFile);
-    real_fclose(famFile);
+            AppendToJournal(buf, bufsiz);
+            return false;
+        }
 
-    // create SandboxedPip (which parses FAM and throws on error)
-    pip_ = std::shared_ptr<SandboxedPip>(new SandboxedPip(getpid(), famPayload, famLength));
+        // A report that must not be spilled (see SendReport) waits for room in the report file.  The host
+        // keeps reading the report file until every process is done, so this wait always ends.
+        struct pollfd pollFd = { reportFd, POLLOUT, 0 };
+        poll(&pollFd, 1, -1);
+    }
 
-    // create sandbox
-    sandbox_ = new Sandbox(0, Configuration::DetoursLinuxSandboxType);
+    if (numWritten < (ssize_t)bufsiz)
+    {
+        _fatal("Wrote only %ld bytes out of %ld; errno: %d", numWritten, bufsiz, errno);
+    }
 
-    // initialize sandbox
-    if (!sandbox_->TrackRootProcess(pip_))
+    if (isTransient)
     {
-        _fatal("Could not track root process %s:%d", __progname, getpid());
+        real_close(reportFd);
     }
 
-    process_ = sandbox_->FindTrackedProcess(getpid());
-    process_->SetPath(progFullPath_);
-    sandbox_->SetAccessReportCallback(HandleAccessReport);
+    return true;
 }
 
-void BxlObserver::InitLogFile()
+int BxlObserver::OpenJournal(bool create)
 {
-    const char *logPath = getenv(BxlEnvLogPath);
-    if (logPath && *logPath)
+    char path[PATH_MAX];
+    if (!ReportJournal::GetPath(journalDir_, getpid(), path, sizeof(path)))
     {
-        strlcpy(logFile_, logPath, PATH_MAX);
-        logFile_[PATH_MAX-1] = '\0';
+        _fatal("Journal path in '%s' is too long", journalDir_);
     }
-    else
+
+    int fd = real_open(path, O_WRONLY | O_APPEND | O_CLOEXEC | (create ? O_CREAT : 0), S_IRUSR | S_IWUSR);
+    if (fd == -1)
     {
-        logFile_[0] = '\0';
+        if (create)
+        {
+            _fatal("Could not open journal '%s'; errno: %d", path, errno);
+        }
+
+        return -1;
     }
-}
 
-bool BxlObserver::Send(const char *buf, size_t bufsiz)
-{
-    if (!real_open)
+    int highFd = fcntl(fd, F_DUPFD_CLOEXEC, BxlReportFdMin);
+    if (highFd != -1)
     {
-        _fatal("syscall 'open' not found; errno: %d", errno);
+        real_close(fd);
+        fd = highFd;
     }
 
-    // TODO: instead of failing, implement a critical section
-    if (bufsiz > PIPE_BUF)
+    int expected = -1;
+    if (!journalFd_.compare_exchange_strong(expected, fd))
     {
-        _fatal("Cannot atomically send a buffer whose size (%ld) is greater than PIPE_BUF (%d)", bufsiz, PIPE_BUF);
+        real_close(fd);
+        fd = expected;
     }
 
-    const char *reportsPath = GetReportsPath();
-    int logFd = real_open(reportsPath, O_WRONLY | O_APPEND, 0);
-    if (logFd == -1)
+    return fd;
+}
+
+void BxlObserver::AppendToJournal(const char *buf, size_t bufsiz)
+{
+    int fd = journalFd_.load();
+    if (fd == -1)
     {
-        _fatal("Could not open file '%s'; errno: %d", reportsPath, errno);
+        fd = OpenJournal(/* create */ true);
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t sequence = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+
+    // a single append, so that entries written concurrently by different threads never interleave
+    char entry[ReportJournal::EntryHeaderSize + ReportJournal::MaxPayloadSize];
+    size_t entryLength = ReportJournal::EncodeEntry(entry, sizeof(entry), sequence, buf, bufsiz);
+    ssize_t numWritten = entryLength > 0 ? real_write(fd, entry, entryLength) : -1;
+    if (numWritten == -1 && errno == EBADF)
+    {
+        // closed behind the sandbox's back, like the report descriptor (see WriteToReportFd)
+        int expected = fd;
+        journalFd_.compare_exchange_strong(expected, -1);
+        fd = OpenJournal(/* create */ true);
+        numWritten = real_write(fd, entry, entryLength);
     }
 
-    ssize_t numWritten = real_write(logFd, buf, bufsiz);
-    if (numWritten < bufsiz)
+    if (numWritten < (ssize_t)entryLength || entryLength == 0)
     {
-        _fatal("Wrote only %ld bytes out of %ld", numWritten, bufsiz);
+        _fatal("Could not append a %ld-byte message to the journal; errno: %d", bufsiz, errno);
     }
 
-    real_close(logFd);
-    return true;
+    numSpilledWrites_++;
 }
 
 bool BxlObserver::SendReport(AccessReport &report)
@@ -134,21 +1218,103 @@ bool BxlObserver::SendReport(AccessReport &report)
         return true;
     }
 
-    const int PrefixLength = sizeof(uint);
-    char buffer[PIPE_BUF] = {0};
-    int maxMessageLength = PIPE_BUF - PrefixLength;
-    int numWritten = snprintf(
-        &buffer[PrefixLength], maxMessageLength, "%s|%d|%d|%d|%d|%d|%d|%s\n", 
-        __progname, getpid(), report.requestedAccess, report.status, report.reportExplicitly, report.error, report.operation, report.path);
-    if (numWritten == maxMessageLength)
+    pid_t pid = getpid();
+    if (IsAlreadyReported(report, pid))
+    {
+        LOG_DEBUG("Skipping already reported access: %s|%d|%d|%d|%s", __progname, pid, report.requestedAccess, report.operation, report.path);
+        return true;
+    }
+
+    // recorded in the dedup table once the report is out (see AccessDedupTable)
+    uint32_t accessToRecord = GetAccessToRecord(report);
+
+    // Front-coding relies on the host receiving this thread's records in the order they are encoded, so it is off
+    // for a report sent while the thread is in the middle of sending another one (e.g., from a signal handler), in
+    // a vfork'd child (which runs on its parent's thread and memory, but reports with its own pid), and for process
+    // reports (which are never spilled, so they may reach the host ahead of reports spilled before them).
+    bool isProcessReport = IsProcessReport(report);
+    bool frontCode = frontCodePaths_ && !isProcessReport && !sSendingFrontCodedReport && OwnsReportFd();
+    if (frontCode && sFrontCodingEncoder == NULL)
+    {
+        sFrontCodingEncoder = new FrontCodingEncoder(++numProducerIds_);
+        pthread_setspecific(sFrontCodingEncoderKey, sFrontCodingEncoder);
+    }
+
+    // large enough for any report; messages longer than PIPE_BUF are sent in fragments
+    const int PrefixLength = ReportFraming::PrefixSize;
+    char buffer[PrefixLength + ReportFormat::EncodedSize(sizeof(report.path), /* frontCoded */ true, /* hasPathId */ true)];
+    size_t pathLength = strnlen(report.path, sizeof(report.path));
+    size_t numWritten;
+    int slot;
+    size_t prefixLength;
+    if (frontCode && sFrontCodingEncoder->Code(report.path, pathLength, &slot, &prefixLength))
     {
-        // TODO: once 'send' is capable of sending more than PIPE_BUF at once, allocate a bigger buffer and send that
-        _fatal("Message truncated to fit PIPE_BUF (%d): %s", PIPE_BUF, buffer);
+        sSendingFrontCodedReport = true;
+        numWritten = ReportFormat::EncodeFrontCoded(
+            &buffer[PrefixLength], sizeof(buffer) - PrefixLength,
+            report.operation, pid, report.requestedAccess, report.status, report.reportExplicitly != 0, report.error,
+            report.path, pathLength, sFrontCodingEncoder->ProducerId(), slot, prefixLength, report.pathId);
+    }
+    else
+    {
+        numWritten = ReportFormat::Encode(
+            &buffer[PrefixLength], sizeof(buffer) - PrefixLength,
+            report.operation, pid, report.requestedAccess, report.status, report.reportExplicitly != 0, report.error,
+            report.path, pathLength, report.pathId);
     }
 
-    LOG_DEBUG("Sending report: %s", &buffer[PrefixLength]);
+    LOG_DEBUG("Sending report: %s|%d|%d|%d|%d|%d|%d|%s", 
+        __progname, pid, report.requestedAccess, report.status, report.reportExplicitly, report.error, report.operation, report.path);
     *(uint*)(buffer) = numWritten;
-    return Send(buffer, numWritten + PrefixLength);
+    size_t messageLength = numWritten + PrefixLength;
+
+    // A process report is sent right away, after whatever was batched before it, so that e.g. the report of a fork
+    // reaches the host before the child (which flushes its own batches on exit) can report that it exited.  It is
+    // never spilled to the journal either, because the host only reads the journals once it has seen the exit of
+    // every process.
+    ReportBatch *batch = batchReports_ && !isProcessReport ? GetThreadBatch() : NULL;
+    if (batch == NULL)
+    {
+        if (isProcessReport)
+        {
+            FlushReports();
+        }
+
+        bool sent = Send(buffer, messageLength, /* maySpill */ !isProcessReport);
+        if (frontCode) sSendingFrontCodedReport = false;
+        RecordReported(report.path, pathLength, accessToRecord);
+        return sent;
+    }
+
+    Lock(batch);
+    if (batch->length + messageLength > sizeof(batch->buffer) ||
+        !AddPendingRecord(batch, report.path, pathLength, accessToRecord))
+    {
+        SendBatch(batch);
+        AddPendingRecord(batch, report.path, pathLength, accessToRecord);
+    }
+
+    if (messageLength > sizeof(batch->buffer))
+    {
+        // only happens for reports that must be sent in fragments
+        Send(buffer, messageLength);
+        SendBatch(batch);
+    }
+    else
+    {
+        memcpy(&batch->buffer[batch->length], buffer, messageLength);
+        batch->length += messageLength;
+    }
+    Unlock(batch);
+    if (frontCode) sSendingFrontCodedReport = false;
+
+    // the process may fail right after a denied access, so make sure the host learns about it
+    if (report.status == FileAccessStatus_Denied)
+    {
+        FlushReports();
+    }
+
+    return true;
 }
 
 void BxlObserver::report_exec(const char *syscallName, const char *procName, const char *file)
@@ -158,10 +1324,74 @@ void BxlObserver::report_exec(const char *syscallName, const char *procName, con
     report_access(__func__, ES_EVENT_TYPE_NOTIFY_EXEC, file);
 }
 
-AccessCheckResult BxlObserver::report_access(const char *syscallName, es_event_type_t eventType, std::string reportPath, std::string secondPath)
+bool BxlObserver::IsBreakawayProcess(const char *path)
+{
+    if (!IsValid() || !pip_->AllowChildProcessesToBreakAway() || getpid() == rootPid_ || path == NULL)
+    {
+        return false;
+    }
+
+    const char *fileName = strrchr(path, '/');
+    return pip_->IsChildProcessToBreakAway(fileName != NULL ? fileName + 1 : path);
+}
+
+void BxlObserver::ReportBreakaway(const char *path)
+{
+    LOG_DEBUG("Breaking away: %s", path);
+    SendProcessReport(FileOperation::kOpProcessBreakaway, path);
+}
+
+void BxlObserver::OnBreakawayFailed(const char *path)
 {
-    // TODO: don't stat all the time
-    mode_t mode = get_mode(reportPath.c_str());
+    // the host stopped tracking this process when it got the breakaway report (which named 'path'), so it is
+    // reported again, under the same path, as a process the host must wait for
+    LOG_DEBUG("Could not break away (errno: %d): %s", errno, path);
+    SendProcessReport(FileOperation::kOpProcessStart, path);
+}
+
+void BxlObserver::SendProcessReport(FileOperation operation, const char *path)
+{
+    AccessReport report =
+    {
+        .operation          = operation,
+        .pid                = getpid(),
+        .rootPid            = pip_->GetProcessId(),
+        .requestedAccess    = (int)RequestedAccess::Read,
+        .status             = FileAccessStatus::FileAccessStatus_Allowed,
+        .reportExplicitly   = 0,
+        .error              = 0,
+        .pipId              = pip_->GetPipId(),
+        .path               = {0},
+        .stats              = {}
+    };
+
+    // translated like the paths of accesses (see 'report_access')
+    std::string translated;
+    if (!pathTranslator_.IsEmpty())
+    {
+        translated = path;
+        if (pathTranslator_.Translate(translated))
+        {
+            path = translated.c_str();
+        }
+    }
+
+    // leaves the last byte of the (zeroed) buffer as the terminator of a path that does not fit
+    strlcpy(report.path, path, sizeof(report.path) - 1);
+    SendReport(report);
+}
+
+AccessCheckResult BxlObserver::report_access(const char *syscallName, es_event_type_t eventType, std::string reportPath, std::string secondPath, mode_t mode)
+{
+    if (!IsEnabled())
+    {
+        return sNotChecked;
+    }
+
+    if (mode == kUnknownMode)
+    {
+        mode = get_mode(reportPath.c_str());
+    }
 
     std::string execPath = eventType == ES_EVENT_TYPE_NOTIFY_EXEC
         ? reportPath
@@ -171,14 +1401,28 @@ AccessCheckResult BxlObserver::report_access(const char *syscallName, es_event_t
     return report_access(syscallName, event);
 }
 
-AccessCheckResult BxlObserver::report_access(const char *syscallName, IOEvent &event)
+void BxlObserver::TranslateEventPath(IOEvent &event, int index)
 {
-    es_event_type_t eventType = event.GetEventType();
+    std::string path(event.GetEventPath(index));
+    if (pathTranslator_.Translate(path))
+    {
+        event.SetEventPath(&path[0], index);
+    }
+}
 
+AccessCheckResult BxlObserver::report_access(const char *syscallName, IOEvent &event)
+{
     AccessCheckResult result = sNotChecked;
 
     if (IsEnabled())
     {
+        // the last step of normalizing the paths, which then match the manifest the way the host specified it
+        if (!pathTranslator_.IsEmpty())
+        {
+            TranslateEventPath(event, SRC_PATH);
+            TranslateEventPath(event, DST_PATH);
+        }
+
         IOHandler handler(sandbox_);
         handler.SetProcess(process_);
         result = handler.HandleEvent(event);
@@ -191,30 +1435,93 @@ AccessCheckResult BxlObserver::report_access(const char *syscallName, IOEvent &e
     return result;
 }
 
-AccessCheckResult BxlObserver::report_access(const char *syscallName, es_event_type_t eventType, const char *pathname, int flags)
+AccessCheckResult BxlObserver::report_access(const char *syscallName, es_event_type_t eventType, const char *pathname, int flags, mode_t mode)
+{
+    if (!IsEnabled())
+    {
+        return sNotChecked;
+    }
+
+    return report_access(syscallName, eventType, normalize_path(pathname, flags), "", mode);
+}
+
+// kind of a descriptor operation under which its access check is kept in 'fdOverlay_' (-1 if it is not kept)
+static int fd_event_kind(es_event_type_t eventType)
 {
-    return report_access(syscallName, eventType, normalize_path(pathname, flags), "");
+    switch (eventType)
+    {
+        case ES_EVENT_TYPE_NOTIFY_OPEN:    return 0;
+        case ES_EVENT_TYPE_NOTIFY_WRITE:   return 1;
+        case ES_EVENT_TYPE_NOTIFY_STAT:    return 2;
+        case ES_EVENT_TYPE_NOTIFY_READDIR: return 3;
+        case ES_EVENT_TYPE_NOTIFY_SETTIME: return 4;
+        case ES_EVENT_TYPE_NOTIFY_SETMODE: return 5;
+        default:                           return -1;
+    }
 }
 
-AccessCheckResult BxlObserver::report_access_fd(const char *syscallName, es_event_type_t eventType, int fd)
+AccessCheckResult BxlObserver::report_access_fd(const char *syscallName, es_event_type_t eventType, int fd, mode_t mode)
 {
+    if (!IsEnabled())
+    {
+        return sNotChecked;
+    }
+
+    // the same operation on the same descriptor is checked (and reported) only once
+    int kind = fd_event_kind(eventType);
+    AccessCheckResult result = sNotChecked;
+    if (kind != -1 && fdOverlay_.TryGetCheck(fd, kind, &result))
+    {
+        return result;
+    }
+
+    uint32_t version = fdOverlay_.GetVersion(fd);
     char fullpath[PATH_MAX] = {0};
-    fd_to_path(fd, fullpath, PATH_MAX);
+    ssize_t len = fdOverlay_.TryGetPath(fd, fullpath, PATH_MAX);
+    if (len == -1)
+    {
+        len = fd_to_path(fd, fullpath, PATH_MAX);
+    }
+
+    if (len <= 0 || len >= PATH_MAX)
+    {
+        return sNotChecked;
+    }
+
+    fullpath[len] = '\0';
+    if (fullpath[0] == '/')
+    {
+        result = report_access(syscallName, eventType, std::string(fullpath, len), empty_str, mode);
+    }
+    // otherwise, this file descriptor is not a non-file (e.g., a pipe, or socket, etc.) so we don't care about it
+
+    if (kind != -1)
+    {
+        fdOverlay_.SetCheck(fd, version, fullpath, len, kind, result);
+    }
 
-    return fullpath[0] == '/'
-        ? report_access(syscallName, eventType, std::string(fullpath), empty_str)
-        : sNotChecked; // this file descriptor is not a non-file (e.g., a pipe, or socket, etc.) so we don't care about it
+    return result;
 }
 
-AccessCheckResult BxlObserver::report_access_at(const char *syscallName, es_event_type_t eventType, int dirfd, const char *pathname, int flags)
+AccessCheckResult BxlObserver::report_access_at(const char *syscallName, es_event_type_t eventType, int dirfd, const char *pathname, int flags, mode_t mode)
 {
+    if (!IsEnabled())
+    {
+        return sNotChecked;
+    }
+
+    // an absolute path ignores 'dirfd'
+    if (pathname[0] == '/')
+    {
+        return report_access(syscallName, eventType, pathname, flags, mode);
+    }
+
     char fullpath[PATH_MAX] = {0};
     ssize_t len = 0;
 
     if (dirfd == AT_FDCWD)
     {
-        getcwd(fullpath, PATH_MAX);
-        len = strlen(fullpath);
+        len = GetCwd(fullpath, PATH_MAX);
     }
     else
     {
@@ -227,7 +1534,7 @@ AccessCheckResult BxlObserver::report_access_at(const char *syscallName, es_even
     }
 
     snprintf(&fullpath[len], PATH_MAX - len, "/%s", pathname);
-    return report_access(syscallName, eventType, fullpath, flags);
+    return report_access(syscallName, eventType, fullpath, flags, mode);
 }
 
 ssize_t BxlObserver::fd_to_path(int fd, char *buf, size_t bufsiz)
@@ -240,6 +1547,12 @@ ssize_t BxlObserver::fd_to_path(int fd, char *buf, size_t bufsiz)
 
 std::string BxlObserver::normalize_path_at(int dirfd, const char *pathname, int oflags)
 {
+    // nothing is checked (nor reported) for the paths of a process that broke away
+    if (!IsEnabled())
+    {
+        return std::string();
+    }
+
     char fullpath[PATH_MAX] = {0};
     size_t len = 0;
 
@@ -255,8 +1568,7 @@ std::string BxlObserver::normalize_path_at(int dirfd, const char *pathname, int
     {
         if (dirfd == AT_FDCWD)
         {
-            getcwd(fullpath, PATH_MAX);
-            len = strlen(fullpath);
+            len = GetCwd(fullpath, PATH_MAX);
         }
         else
         {
@@ -296,15 +1608,139 @@ static char* find_prev_slash(char *pStr)
     return pStr;
 }
 
-// resolve any intermediate directory symlinks 
-//   - TODO: cache this
-//   - TODO: break symlink cycles
+// readlink of the first 'length' bytes of 'path' (which must be null-terminated there), going through 'symlinkCache_';
+// when 'missed' is not NULL, a path that is not cached is not looked up: 'missed' is set and -1 returned instead
+ssize_t BxlObserver::readlink_cached(const char *path, size_t length, char *buf, bool *missed)
+{
+    ssize_t targetLength;
+    switch (symlinkCache_.Lookup(path, length, buf, &targetLength))
+    {
+        case SymlinkCache::kNotSymlink:
+            return -1;
+        case SymlinkCache::kSymlink:
+            return targetLength;
+        default:
+            break;
+    }
+
+    if (missed != NULL)
+    {
+        *missed = true;
+        return -1;
+    }
+
+    uint64_t generation = symlinkCache_.Generation();
+    targetLength = real_readlink(path, buf, PATH_MAX);
+
+    // EINVAL: the path exists but is not a symlink (paths that do not exist are not cached)
+    if (targetLength != -1 || errno == EINVAL)
+    {
+        symlinkCache_.Insert(generation, path, length, buf, targetLength);
+    }
+
+    return targetLength;
+}
+
+// number of paths that 'resolve_path' has yet to check for symlinks from 'pStr' on
+static int count_components(const char *pStr, bool followFinalSymlink)
+{
+    int count = followFinalSymlink ? 1 : 0;
+    for (; *pStr; pStr++)
+    {
+        if (*pStr == '/')
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+// resolve 'fullpath' with a single kernel walk, which only succeeds if there are no symlinks on the way (in which case
+// 'fullpath' is rewritten the way 'resolve_path' would and every directory on the way is cached as not a symlink)
+bool BxlObserver::resolve_path_in_kernel(char *fullpath, bool followFinalSymlink)
+{
+#ifdef SYS_openat2
+    // collapse "//" and "/./" like 'resolve_path' does; "/.." may climb out of a symlink, and 'resolve_path'
+    // keeps a trailing "/" or "/." (which the kernel drops), so paths with those are left to 'resolve_path'
+    char lexical[PATH_MAX];
+    size_t len = 0;
+    for (const char *p = fullpath; *p != '\0'; )
+    {
+        if (p[0] == '/' && p[1] == '/')
+        {
+            p++;
+        }
+        else if (p[0] == '/' && p[1] == '.' && p[2] == '/')
+        {
+            p += 2;
+        }
+        else if (p[0] == '/' && p[1] == '.' && (p[2] == '\0' || (p[2] == '.' && (p[3] == '/' || p[3] == '\0'))))
+        {
+            return false;
+        }
+        else
+        {
+            lexical[len++] = *p++;
+        }
+    }
+
+    if (len > 1 && lexical[len - 1] == '/')
+    {
+        return false;
+    }
+
+    lexical[len] = '\0';
+
+    struct open_how how = {};
+    how.flags = O_PATH | O_CLOEXEC | (followFinalSymlink ? 0 : O_NOFOLLOW);
+    how.resolve = RESOLVE_NO_MAGICLINKS;
+    uint64_t generation = symlinkCache_.Generation();
+    int fd = syscall(SYS_openat2, AT_FDCWD, lexical, &how, sizeof(how));
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    // the path the kernel ended up at is the lexical path unless a symlink was followed
+    char canonical[PATH_MAX];
+    ssize_t canonicalLen = fd_to_path(fd, canonical, PATH_MAX);
+    real_close(fd);
+    if (canonicalLen != (ssize_t)len || memcmp(canonical, lexical, len) != 0)
+    {
+        return false;
+    }
+
+    for (size_t i = 1; i < len; i++)
+    {
+        if (lexical[i] == '/')
+        {
+            symlinkCache_.Insert(generation, lexical, i, NULL, -1);
+        }
+    }
+
+    if (followFinalSymlink)
+    {
+        symlinkCache_.Insert(generation, lexical, len, NULL, -1);
+    }
+
+    memcpy(fullpath, lexical, len + 1);
+    numKernelResolves_++;
+    return true;
+#else
+    return false;
+#endif
+}
+
+// resolve any intermediate directory symlinks (giving up after BxlMaxSymlinkHops of them, e.g., in a symlink cycle)
 void BxlObserver::resolve_path(char *fullpath, bool followFinalSymlink)
 {
     assert(fullpath[0] == '/');
 
     char readlinkBuf[PATH_MAX];
     char *pFullpath = fullpath + 1;
+    int numHops = 0;
+    bool tryKernelResolve = kernelResolve_;
     while (true)
     {
         // first handle "/../", "/./", and "//"
@@ -342,9 +1778,25 @@ void BxlObserver::resolve_path(char *fullpath, bool followFinalSymlink)
         char ch = *pFullpath;
         if (*pFullpath == '/' || (*pFullpath == '\0' && followFinalSymlink))
         {
+            bool missed = false;
             *pFullpath = '\0';
-            nReadlinkBuf = real_readlink(fullpath, readlinkBuf, PATH_MAX);
+            nReadlinkBuf = readlink_cached(fullpath, pFullpath - fullpath, readlinkBuf, tryKernelResolve ? &missed : NULL);
             *pFullpath = ch;
+
+            // on the first path missing from the cache, try resolving the whole path at once if that saves enough calls
+            if (missed)
+            {
+                tryKernelResolve = false;
+                if (count_components(pFullpath, followFinalSymlink) >= BxlMinComponentsForKernelResolve &&
+                    resolve_path_in_kernel(fullpath, followFinalSymlink))
+                {
+                    break;
+                }
+
+                *pFullpath = '\0';
+                nReadlinkBuf = readlink_cached(fullpath, pFullpath - fullpath, readlinkBuf);
+                *pFullpath = ch;
+            }
         }
 
         // if not a symlink --> either continue or exit if at the end of the path
@@ -362,6 +1814,12 @@ void BxlObserver::resolve_path(char *fullpath, bool followFinalSymlink)
         }
 
         // current path is a symlink
+        if (++numHops > BxlMaxSymlinkHops)
+        {
+            LOG_DEBUG("Stopped resolving '%s' after following %d symlinks", fullpath, BxlMaxSymlinkHops);
+            break;
+        }
+
         readlinkBuf[nReadlinkBuf] = '\0';
 
         // report readlink for the current path
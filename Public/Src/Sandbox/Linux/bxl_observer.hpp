@@ -11,12 +11,46 @@
 
 #include "Sandbox.hpp"
 #include "SandboxedPip.hpp"
+#include "ReportFormat.hpp"
+#include "ReportRing.hpp"
+#include "AccessDedupTable.hpp"
+#include "ProcessTree.hpp"
+#include "SymlinkCache.hpp"
+#include "FdOverlay.hpp"
+#include "PathTranslator.hpp"
 
 extern const char *__progname;
 
 #define BxlEnvFamPath "__BUILDXL_FAM_PATH"
 #define BxlEnvLogPath "__BUILDXL_LOG_PATH"
 #define BxlEnvRootPid "__BUILDXL_ROOT_PID"
+#define BxlEnvReportsRingPath "__BUILDXL_REPORTS_RING_PATH"
+#define BxlEnvBatchReports "__BUILDXL_BATCH_REPORTS"
+#define BxlEnvDedupTablePath "__BUILDXL_DEDUP_TABLE_PATH"
+#define BxlEnvProcessTreePath "__BUILDXL_PROCESS_TREE_PATH"
+#define BxlEnvFrontCodePaths "__BUILDXL_FRONT_CODE_PATHS"
+#define BxlEnvReportsJournalDir "__BUILDXL_REPORTS_JOURNAL_DIR"
+#define BxlEnvCompilePolicyIndex "__BUILDXL_COMPILE_POLICY_INDEX"
+#define BxlEnvFamMemfdPath "__BUILDXL_FAM_MEMFD_PATH"
+#define BxlEnvTranslatePaths "__BUILDXL_TRANSLATE_PATHS"
+
+// The report channel descriptor is moved at or above this number so that it does not
+// take up the low descriptor numbers that traced programs commonly expect to get back
+#define BxlReportFdMin 1000
+
+// Maximum number of threads of a process whose reports can be batched at the same time;
+// reports of any additional threads are sent right away
+#define BxlMaxReportBatches 256
+
+// Room a report batch has for the accesses to record in the dedup table once the batch is sent
+#define BxlReportBatchPendingSize (2 * PIPE_BUF)
+
+// Maximum number of symlinks followed while resolving a path (the same limit as the kernel's)
+#define BxlMaxSymlinkHops 40
+
+// Minimum number of components of a path left to check for symlinks for the path to be resolved with a
+// single kernel walk (which takes 3 system calls) instead of one 'readlink' per component
+#define BxlMinComponentsForKernelResolve 4
 
 #define ARRAYSIZE(arr) (sizeof(arr)/sizeof(arr[0]))
 
@@ -98,6 +132,26 @@ public:
     }
 };
 
+/**
+ * Reports of a single thread that have not been sent yet.  A batch never grows beyond
+ * PIPE_BUF bytes so that it can be sent with a single atomic write.
+ *
+ * Batches are never freed: when a thread exits its batch is flushed and released for
+ * reuse by another thread, so a concurrent 'FlushReports' never touches freed memory.
+ */
+struct ReportBatch
+{
+    std::atomic_flag lock;
+    std::atomic<bool> inUse;
+    size_t length;
+    char buffer[PIPE_BUF];
+
+    // accesses of the batched reports to record in the dedup table once the batch is sent: for each report,
+    // the access (uint32_t), the length of the path (uint32_t) and the path
+    size_t pendingLength;
+    char pending[BxlReportBatchPendingSize];
+};
+
 /**
  * Singleton class responsible for reporting accesses.
  * 
@@ -105,6 +159,63 @@ public:
  * 
  * Accesses are reported to a file (can be a regular file or a FIFO)
  * at the location specified by the FileAccessManifest.
+ *
+ * The report file is opened lazily (with O_CLOEXEC) the first time a report is sent and
+ * the descriptor is then kept open for the lifetime of the process.  A forked child keeps
+ * using the inherited descriptor (which shares the parent's open file description), while
+ * an exec'd image opens its own.  A vfork'd child, which shares its parent's memory, opens
+ * a transient descriptor per report instead.  The descriptor is closed when the process exits.
+ *
+ * When the host sets the __BUILDXL_REPORTS_RING_PATH environment variable, reports are instead
+ * written into a shared memory ring buffer (see ReportRing.hpp), which every process of the pip
+ * maps at initialization; in that mode the report file is not used at all.
+ *
+ * When the host sets the __BUILDXL_BATCH_REPORTS environment variable (and the report file is
+ * used), each thread accumulates its reports and writes them all at once when its batch is full.
+ * To keep the reports causally ordered, all batches are flushed before the process forks, execs
+ * or exits, after a denied access, and when the process crashes (SIGSEGV, SIGBUS, SIGILL, SIGFPE
+ * or SIGABRT).  The handler that flushes on a crash stays installed for the lifetime of the process:
+ * the actions the program sets for those signals are recorded and carried out after the flush.
+ *
+ * When the host sets the __BUILDXL_DEDUP_TABLE_PATH environment variable, every process of the pip
+ * maps a shared table of the accesses reported so far (see AccessDedupTable.hpp) and does not send
+ * file access reports that would not tell the host anything new.
+ *
+ * When the host sets the __BUILDXL_PROCESS_TREE_PATH environment variable, every process of the pip
+ * maps a shared table of the pip's processes (see ProcessTree.hpp): a process registers its child
+ * before forking and marks itself exited once it has closed its report channel, which lets the host
+ * tell as soon as the last process of the pip is gone.
+ *
+ * When the host sets the __BUILDXL_FRONT_CODE_PATHS environment variable, each thread sends the paths
+ * of its reports front-coded against the paths of its recent reports (see ReportFormat.hpp).
+ *
+ * When the host sets the __BUILDXL_REPORTS_JOURNAL_DIR environment variable, writes to the report file
+ * never block: once the report file is full (i.e., the host has fallen behind), the process appends its
+ * reports to an overflow journal in that directory instead (see ReportJournal in ReportFormat.hpp).
+ *
+ * Symlinks in reported paths are resolved with the help of a per-process cache (see SymlinkCache.hpp),
+ * which is invalidated whenever the process creates, removes or renames a path and whose entries expire shortly
+ * after they are filled in (so changes made by other processes are picked up too).  When the kernel supports
+ * 'openat2', a path with several components missing from the cache is first resolved with a single kernel
+ * walk; only if that finds symlinks on the way is the path walked component by component (so that every
+ * symlink followed is reported).
+ *
+ * When the host sets the __BUILDXL_TRANSLATE_PATHS environment variable, the paths of accesses are mapped through the
+ * directory translations of the FAM (see PathTranslator.hpp) right before their policies are looked up, so the host
+ * receives the translated paths.
+ *
+ * Operations on file descriptors are checked with the help of a per-process fd overlay (see FdOverlay.hpp),
+ * which remembers what each descriptor refers to and the access checks already made for operations on it.
+ *
+ * Relative paths are resolved against a cached copy of the current working directory, which is read at
+ * initialization (i.e., on exec), in a forked child, and whenever the process changes it through the interposed
+ * 'chdir' or 'fchdir'; it is not checked against the actual working directory on every use.
+ *
+ * A program whose file name is one of the FAM's child processes to break away (other than the root process of the
+ * pip) runs unmonitored, together with all its descendants: it is exec'd without LD_PRELOAD, and the host only gets
+ * a breakaway report for it.  A process that is started that way without going through an interposed 'exec' (e.g.,
+ * with 'posix_spawn') finds out at initialization, in which case it reports the breakaway itself, removes LD_PRELOAD
+ * from its environment, and forwards every interposed call without checking or reporting it.
  */
 class BxlObserver final
 {
@@ -122,9 +233,115 @@ private:
     std::shared_ptr<SandboxedProcess> process_;
     Sandbox *sandbox_;
 
+    // Persistent descriptor of the report file (-1 when not open)
+    std::atomic<int> reportFd_;
+
+    // Process that owns 'reportFd_'.  A child created with 'vfork' (or 'clone(CLONE_VM)') runs in
+    // its parent's memory while having its own descriptor table, so it must not touch 'reportFd_'.
+    std::atomic<pid_t> reportFdOwnerPid_;
+
+    // Number of sent reports that reused 'reportFd_' instead of opening the report file
+    std::atomic<uint64_t> numReportOpensSaved_;
+
+    // Shared memory ring the reports are written to (NULL when reporting to the report file)
+    ReportRing *ring_;
+
+    // Shared memory table of the accesses reported by the processes of the pip (NULL when not deduplicating)
+    AccessDedupTable *dedupTable_;
+
+    // Shared memory table of the processes of the pip (NULL when not tracking them there)
+    ProcessTree *processTree_;
+
+    // Slot of this process in 'processTree_' (-1 when not registered)
+    int processTreeSlot_;
+
+    // Whether reports are batched per thread
+    bool batchReports_;
+
+    // Batches of the threads of this process (NULL entries are free slots)
+    std::atomic<ReportBatch*> batches_[BxlMaxReportBatches];
+
+    // Number of writes made to send report batches
+    std::atomic<uint64_t> numBatchWrites_;
+
+    // Id of the next record of this process that is sent in fragments (see ReportFraming)
+    std::atomic<uint32_t> nextFragmentedMessageId_;
+
+    // Whether the paths of reports are front-coded
+    bool frontCodePaths_;
+
+    // Number of producer ids handed out to the threads of this process (see ReportFormat)
+    std::atomic<uint32_t> numProducerIds_;
+
+    // Directory of the overflow journals (empty when writes to the report file may block)
+    char journalDir_[PATH_MAX];
+
+    // Descriptor of this process's overflow journal (-1 when not open)
+    std::atomic<int> journalFd_;
+
+    // Whether this process sends its reports to its journal (once set, it stays set; see ReportJournal)
+    std::atomic<bool> spilling_;
+
+    // Number of writes that went to the journal because the report file was full
+    std::atomic<uint64_t> numSpilledWrites_;
+
+    // What 'readlink' returned for the paths resolved so far
+    SymlinkCache symlinkCache_;
+
+    // What the descriptors of this process refer to and the access checks made for operations on them
+    FdOverlay fdOverlay_;
+
+    // Current working directory of the process; guarded by the sequence lock 'cwdSeq_' (odd while it is being updated)
+    char cwd_[PATH_MAX];
+    std::atomic<uint32_t> cwdSeq_;
+
+    // Whether 'cwd_' is up to date (once cleared, e.g., by a vfork'd child changing its working directory, it stays cleared
+    // until the process forks or execs)
+    std::atomic<bool> cwdCached_;
+
+    // Number of times 'cwd_' was used instead of calling 'getcwd'
+    std::atomic<uint64_t> numGetcwdSaved_;
+
+    // Whether paths can be resolved with a single kernel walk (i.e., whether the kernel supports 'openat2')
+    bool kernelResolve_;
+
+    // Number of paths resolved with a single kernel walk
+    std::atomic<uint64_t> numKernelResolves_;
+
+    // Whether this process broke away from the sandbox (see IsBreakawayProcess)
+    bool breakaway_;
+
+    // Directory translations applied to the paths of accesses (empty when paths are not translated)
+    PathTranslator pathTranslator_;
+
     void InitFam();
+    const char* MapFam(const char *famMemfdPath, size_t *famLength);
     void InitLogFile();
-    bool Send(const char *buf, size_t bufsiz);
+    void InitReportRing();
+    void InitReportBatching();
+    void InitDedupTable();
+    void InitProcessTree();
+    void InitReportJournal();
+    void InitCwd();
+    void InitKernelResolve();
+    void InitBreakaway();
+    void InitPathTranslator();
+    size_t GetCwd(char *buf, size_t bufsiz);
+    bool IsAlreadyReported(const AccessReport &report, pid_t pid);
+    uint32_t GetAccessToRecord(const AccessReport &report);
+    void RecordReported(const char *path, size_t length, uint32_t access);
+    bool AddPendingRecord(ReportBatch *batch, const char *path, size_t length, uint32_t access);
+    ReportBatch* GetThreadBatch();
+    void SendBatch(ReportBatch *batch);
+    int GetReportFd(bool *isTransient);
+    inline bool OwnsReportFd() { return reportFdOwnerPid_.load() == getpid(); }
+    bool Send(const char *buf, size_t bufsiz, bool maySpill = true);
+    bool SendFragments(const char *record, size_t length, bool maySpill);
+    bool WriteToReportFd(const char *buf, size_t bufsiz, bool maySpill = true);
+    int OpenJournal(bool create);
+    void AppendToJournal(const char *buf, size_t bufsiz);
+    void SendProcessReport(FileOperation operation, const char *path);
+    void TranslateEventPath(IOEvent &event, int index);
 
     inline bool IsValid()   { return sandbox_ != NULL; }
     inline bool IsEnabled()
@@ -132,8 +349,8 @@ private:
         return
             // successfully initialized
             IsValid() &&
-            // NOT (child processes should break away AND this is a child process)
-            !(pip_->AllowChildProcessesToBreakAway() && getpid() != rootPid_);
+            // NOT broken away from the sandbox
+            !breakaway_;
     }
 
     void PrintArgs(std::stringstream& str, bool isFirst)
@@ -159,6 +376,8 @@ private:
     }
 
     void resolve_path(char *fullpath, bool followFinalSymlink);
+    bool resolve_path_in_kernel(char *fullpath, bool followFinalSymlink);
+    ssize_t readlink_cached(const char *path, size_t length, char *buf, bool *missed = NULL);
 
     static BxlObserver *sInstance;
     static AccessCheckResult sNotChecked;
@@ -176,12 +395,104 @@ public:
 
     void report_exec(const char *syscallName, const char *procName, const char *file);
 
+    /**
+     * Returns whether the program at 'path' (as passed to 'exec') breaks away from the sandbox, i.e., whether its file
+     * name is one of the FAM's child processes to break away and this is not the root process of the pip.
+     */
+    bool IsBreakawayProcess(const char *path);
+
+    /**
+     * Must be called right before exec'ing 'path' without LD_PRELOAD, i.e., when 'IsBreakawayProcess' returns true for it;
+     * then, if the exec returns, 'OnBreakawayFailed' must be called (this process is still monitored).
+     */
+    void ReportBreakaway(const char *path);
+    void OnBreakawayFailed(const char *path);
+
+    /**
+     * Must be called right before forking.  Registers the child about to be created in the process tree
+     * and returns its slot there (-1 if processes are not tracked in a process tree), which must then be
+     * passed to 'OnChildProcessForked' and 'OnChildProcessCreated'.
+     */
+    int RegisterChildProcess();
+
+    /** Must be called in the child process right after 'fork' returns */
+    void OnChildProcessForked(int processTreeSlot);
+
+    /** Must be called in the parent process right after 'fork' returns ('childPid' is -1 if 'fork' failed) */
+    void OnChildProcessCreated(int processTreeSlot, pid_t childPid);
+
+    /** Must be called before the traced program closes (or replaces via dup2 or dup3) descriptor 'fd' */
+    void OnFdClosing(int fd);
+
+    /** Must be called before the traced program closes descriptors 'first' through 'last' (e.g., with close_range) */
+    void OnFdRangeClosing(unsigned int first, unsigned int last);
+
+    /** Must be called after the traced program has created, removed or renamed a path */
+    void InvalidateSymlinkCache() { symlinkCache_.Invalidate(); }
+
+    /** Must be called after the traced program has changed its working directory */
+    void OnCwdChanged();
+
+    /** Must be called after the traced program has renamed a path (the paths of open descriptors may have changed) */
+    void InvalidateFdOverlay() { fdOverlay_.Invalidate(); }
+
+    /**
+     * Must be called after the traced program has opened 'path' (as normalized for the access check) with 'oflags'
+     * as descriptor 'fd' ('fd' is -1 if the open failed); 'mode' is the mode of 'path' before it was opened (0 if unknown)
+     */
+    void OnFdOpened(int fd, const std::string &path, int oflags, mode_t mode);
+
+    /** Must be called after the traced program has opened a stream on descriptor 'fd' (e.g., with fdopen) */
+    void OnFdStreamOpened(int fd);
+
+    /** Must be called after the traced program has duplicated descriptor 'oldfd' as 'newfd' ('newfd' is -1 if that failed) */
+    void OnFdDuplicated(int oldfd, int newfd) { if (newfd != -1) fdOverlay_.Duplicate(oldfd, newfd); }
+
+    /**
+     * Closes the report channel (after flushing any batched reports) and marks this process exited
+     * in the process tree; called when the process is about to exit
+     */
+    void CloseReportChannel();
+
+    /** Sends the batched reports of all threads */
+    void FlushReports();
+
+    /**
+     * Sends the batched reports of all threads from the handler of a signal that kills the process.
+     * Only async-signal-safe operations are made: a batch holds whole frames, so it is written as is to
+     * the report descriptor (opened just for the flush if this process has not opened it yet).  Batches
+     * locked by the interrupted code, and all batches while reports are being spilled to the journal,
+     * are lost.
+     */
+    void FlushReportsOnFatalSignal();
+
+    /** Installs the handler that flushes batched reports before carrying out the program's action for a crash signal */
+    void InstallFatalSignalHandler(int sig);
+
+    /** Whether the actions the program sets for signal 'sig' go through 'SetSignalAction' */
+    bool IsChainingSignal(int sig);
+
+    /**
+     * 'sigaction' as seen by the program.  For the signals the batched reports are flushed on, the action is recorded
+     * and reported back to the program instead of replacing the handler that flushes (unless it ignores the signal).
+     */
+    int SetSignalAction(int sig, const struct sigaction *act, struct sigaction *oldact);
+
+    /** Flushes and releases the report batch of an exiting thread */
+    static void ReleaseThreadBatch(void *batch);
+
+    /**
+     * Stands for the mode of a reported path when the caller does not know it, in which case the path is stat'ed.
+     * Interposers that already hold the answer of the kernel (e.g., the 'stat' family) pass the mode along instead.
+     */
+    static const mode_t kUnknownMode = (mode_t)-1;
+
     AccessCheckResult report_access(const char *syscallName, IOEvent &event);
-    AccessCheckResult report_access(const char *syscallName, es_event_type_t eventType, const char *pathname, int oflags = 0);
-    AccessCheckResult report_access(const char *syscallName, es_event_type_t eventType, std::string reportPath, std::string secondPath);
+    AccessCheckResult report_access(const char *syscallName, es_event_type_t eventType, const char *pathname, int oflags = 0, mode_t mode = kUnknownMode);
+    AccessCheckResult report_access(const char *syscallName, es_event_type_t eventType, std::string reportPath, std::string secondPath, mode_t mode = kUnknownMode);
 
-    AccessCheckResult report_access_fd(const char *syscallName, es_event_type_t eventType, int fd);
-    AccessCheckResult report_access_at(const char *syscallName, es_event_type_t eventType, int dirfd, const char *pathname, int oflags = 0);
+    AccessCheckResult report_access_fd(const char *syscallName, es_event_type_t eventType, int fd, mode_t mode = kUnknownMode);
+    AccessCheckResult report_access_at(const char *syscallName, es_event_type_t eventType, int dirfd, const char *pathname, int oflags = 0, mode_t mode = kUnknownMode);
 
     ssize_t fd_to_path(int fd, char *buf, size_t bufsiz);
     std::string normalize_path_at(int dirfd, const char *pathname, int oflags = 0);
@@ -215,6 +526,14 @@ public:
             : 0;
     }
 
+    mode_t get_fd_mode(int fd)
+    {
+        struct stat buf;
+        return real___fxstat(1, fd, &buf) == 0
+            ? buf.st_mode
+            : 0;
+    }
+
     std::string normalize_path(const char *pathname, int oflags = 0)
     {
         return normalize_path_at(AT_FDCWD, pathname, oflags);
@@ -242,11 +561,22 @@ public:
         return IsEnabled() && check.ShouldDenyAccess() && IsFailingUnexpectedAccesses();
     }
 
+    /**
+     * Returns whether any access may be denied (see 'should_deny').  When not, an access can just as well be
+     * reported after the call that makes it, using what the call returned.
+     */
+    bool can_deny()
+    {
+        return IsEnabled() && IsFailingUnexpectedAccesses();
+    }
+
     GEN_FN_DEF(void*, dlopen, const char *filename, int flags);
     GEN_FN_DEF(int, dlclose, void *handle);
 
     GEN_FN_DEF(pid_t, fork, void)
     GEN_FN_DEF_REAL(void, _exit, int)
+    GEN_FN_DEF_REAL(int, sigaction, int, const struct sigaction *, struct sigaction *)
+    GEN_FN_DEF_REAL(sighandler_t, signal, int, sighandler_t)
     GEN_FN_DEF(int, fexecve, int, char *const[], char *const[])
     GEN_FN_DEF(int, execv, const char *, char *const[])
     GEN_FN_DEF(int, execve, const char *, char *const[], char *const[])
@@ -262,6 +592,7 @@ public:
     GEN_FN_DEF(int, __fxstat64, int, int, struct stat64*)
     GEN_FN_DEF(int, __fxstatat64, int, int, const char*, struct stat64*, int)
     GEN_FN_DEF(FILE*, fopen, const char *, const char *)
+    GEN_FN_DEF(FILE*, fdopen, int, const char *)
     GEN_FN_DEF(size_t, fread, void*, size_t, size_t, FILE*)
     GEN_FN_DEF(size_t, fwrite, const void*, size_t, size_t, FILE*)
     GEN_FN_DEF(int, fclose, FILE*)
@@ -279,15 +610,22 @@ public:
     GEN_FN_DEF(ssize_t, write, int, const void*, size_t)
     GEN_FN_DEF(int, remove, const char *)
     GEN_FN_DEF(int, rename, const char *, const char *)
+    GEN_FN_DEF(int, renameat, int, const char *, int, const char *)
+    GEN_FN_DEF(int, renameat2, int, const char *, int, const char *, unsigned int)
     GEN_FN_DEF(int, link, const char *, const char *)
     GEN_FN_DEF(int, linkat, int, const char *, int, const char *, int)
     GEN_FN_DEF(int, unlink, const char *)
+    GEN_FN_DEF(int, unlinkat, int, const char *, int)
+    GEN_FN_DEF(int, rmdir, const char *)
     GEN_FN_DEF(int, symlink, const char *, const char *)
     GEN_FN_DEF(int, symlinkat, const char *, int, const char *)
     GEN_FN_DEF(ssize_t, readlink, const char *, char *, size_t)
     GEN_FN_DEF(ssize_t, readlinkat, int, const char *, char *, size_t)
     GEN_FN_DEF(char*, realpath, const char*, char*)
     GEN_FN_DEF(DIR*, opendir, const char*)
+    GEN_FN_DEF(int, closedir, DIR*)
+    GEN_FN_DEF(int, chdir, const char*)
+    GEN_FN_DEF(int, fchdir, int)
     GEN_FN_DEF(DIR*, fdopendir, int)
     GEN_FN_DEF(int, utimensat, int, const char*, const struct timespec[2], int)
     GEN_FN_DEF(int, futimens, int, const struct timespec[2])
@@ -295,6 +633,9 @@ public:
     GEN_FN_DEF(int, mkdirat, int, const char*, mode_t)
     GEN_FN_DEF(int, dup, int)
     GEN_FN_DEF(int, dup2, int, int)
+    GEN_FN_DEF(int, dup3, int, int, int)
+    GEN_FN_DEF(int, close_range, unsigned int, unsigned int, int)
+    GEN_FN_DEF_REAL(void, closefrom, int)
     GEN_FN_DEF(int, printf, const char*, ...);
     GEN_FN_DEF(int, fprintf, FILE*, const char*, ...);
     GEN_FN_DEF(int, dprintf, int, const char*, ...);
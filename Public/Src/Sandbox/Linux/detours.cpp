@@ -23,19 +23,74 @@
 
 #include "bxl_observer.hpp"
 
+#ifndef CLOSE_RANGE_CLOEXEC
+#define CLOSE_RANGE_CLOEXEC (1U << 2)
+#endif
+
 #define ERROR_RETURN_VALUE -1
 
 static std::string sEmptyStr("");
 
+// Mode of what a call that returned 'result' found at a path, where 'mode' is what it found if it succeeded
+// (a path that does not exist has mode 0; when the call failed for any other reason the mode is not known)
+static mode_t found_mode(result_t<int> &result, mode_t mode)
+{
+    return result.get() != -1
+        ? mode
+        : result.get_errno() == ENOENT || result.get_errno() == ENOTDIR
+            ? 0
+            : BxlObserver::kUnknownMode;
+}
+
+template<typename TStat>
+static mode_t found_mode(result_t<int> &result, const TStat *buf)
+{
+    return found_mode(result, result.get() != -1 ? buf->st_mode : 0);
+}
+
 INTERPOSE(void, _exit, int status)({
     bxl->report_access("_exit", ES_EVENT_TYPE_NOTIFY_EXIT, std::string(""), std::string(""));
+    bxl->CloseReportChannel();
     bxl->real__exit(status);
     _exit(status);
 })
 
+INTERPOSE(int, sigaction, int signum, const struct sigaction *act, struct sigaction *oldact)({
+    return bxl->SetSignalAction(signum, act, oldact);
+})
+
+INTERPOSE(sighandler_t, signal, int signum, sighandler_t handler)({
+    if (!bxl->IsChainingSignal(signum))
+    {
+        return bxl->real_signal(signum, handler);
+    }
+
+    // the BSD semantics of glibc's 'signal'
+    struct sigaction act;
+    struct sigaction oldact;
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = handler;
+    sigemptyset(&act.sa_mask);
+    sigaddset(&act.sa_mask, signum);
+    act.sa_flags = SA_RESTART;
+    return bxl->SetSignalAction(signum, &act, &oldact) == 0 ? oldact.sa_handler : SIG_ERR;
+})
+
 INTERPOSE(pid_t, fork, void)({
+    // otherwise the child would inherit (and send again) reports batched so far
+    bxl->FlushReports();
+    int processTreeSlot = bxl->RegisterChildProcess();
     result_t<pid_t> childPid = bxl->fwd_fork();
 
+    if (childPid.get() == 0)
+    {
+        bxl->OnChildProcessForked(processTreeSlot);
+    }
+    else
+    {
+        bxl->OnChildProcessCreated(processTreeSlot, childPid.get());
+    }
+
     // report fork only when we are in the parent process
     if (childPid.get() > 0)
     {
@@ -47,29 +102,71 @@ INTERPOSE(pid_t, fork, void)({
     return childPid.restore();
 })
 
+// Copy of 'envp' (null-terminated, like 'envp') without LD_PRELOAD
+static std::vector<char*> env_without_preload(char *const envp[])
+{
+    static const char prefix[] = "LD_PRELOAD=";
+    std::vector<char*> env;
+    for (char *const *var = envp; var != NULL && *var != NULL; var++)
+    {
+        if (strncmp(*var, prefix, sizeof(prefix) - 1) != 0)
+        {
+            env.push_back(*var);
+        }
+    }
+
+    env.push_back(NULL);
+    return env;
+}
+
+// Execs the program at 'path' by calling 'exec' with the environment to exec it with: 'envp' as is, unless the
+// program breaks away from the sandbox, in which case 'envp' without LD_PRELOAD (so that it runs unmonitored)
+template<typename TExec>
+static int exec_or_break_away(BxlObserver *bxl, const char *path, char *const envp[], TExec exec)
+{
+    if (!bxl->IsBreakawayProcess(path))
+    {
+        bxl->FlushReports();
+        return exec(envp).restore();
+    }
+
+    std::vector<char*> env = env_without_preload(envp);
+    bxl->ReportBreakaway(path);
+    result_t<int> result = exec(env.data());
+    bxl->OnBreakawayFailed(path);
+    return result.restore();
+}
+
 INTERPOSE(int, fexecve, int fd, char *const argv[], char *const envp[])({
     bxl->report_access_fd(__func__, ES_EVENT_TYPE_NOTIFY_EXEC, fd);
-    return bxl->fwd_fexecve(fd, argv, envp).restore();
+    char path[PATH_MAX] = {0};
+    ssize_t len = bxl->fd_to_path(fd, path, PATH_MAX - 1);
+    return exec_or_break_away(bxl, len > 0 ? path : NULL, envp,
+        [&](char *const env[]) { return bxl->fwd_fexecve(fd, argv, env); });
 })
 
 INTERPOSE(int, execv, const char *file, char *const argv[])({
     bxl->report_exec(__func__, argv[0], file);
-    return bxl->fwd_execv(file, argv).restore();
+    return exec_or_break_away(bxl, file, environ,
+        [&](char *const env[]) { return env == environ ? bxl->fwd_execv(file, argv) : bxl->fwd_execve(file, argv, env); });
 })
 
 INTERPOSE(int, execve, const char *file, char *const argv[], char *const envp[])({
     bxl->report_exec(__func__, argv[0], file);
-    return bxl->fwd_execve(file, argv, envp).restore();
+    return exec_or_break_away(bxl, file, envp,
+        [&](char *const env[]) { return bxl->fwd_execve(file, argv, env); });
 })
 
 INTERPOSE(int, execvp, const char *file, char *const argv[])({
     bxl->report_exec(__func__, argv[0], file);
-    return bxl->fwd_execvp(file, argv).restore();
+    return exec_or_break_away(bxl, file, environ,
+        [&](char *const env[]) { return env == environ ? bxl->fwd_execvp(file, argv) : bxl->fwd_execvpe(file, argv, env); });
 })
 
 INTERPOSE(int, execvpe, const char *file, char *const argv[], char *const envp[])({
     bxl->report_exec(__func__, argv[0], file);
-    return bxl->fwd_execvpe(file, argv, envp).restore();
+    return exec_or_break_away(bxl, file, envp,
+        [&](char *const env[]) { return bxl->fwd_execvpe(file, argv, env); });
 })
 
 INTERPOSE(int, statfs, const char *pathname, struct statfs *buf)({
@@ -80,55 +177,68 @@ INTERPOSE(int, statfs, const char *pathname, struct statfs *buf)({
 
 INTERPOSE(int, __fxstat, int __ver, int fd, struct stat *__stat_buf)({
     result_t<int> result = bxl->fwd___fxstat(__ver, fd, __stat_buf);
-    bxl->report_access_fd(__func__, ES_EVENT_TYPE_NOTIFY_STAT, fd);
+    bxl->report_access_fd(__func__, ES_EVENT_TYPE_NOTIFY_STAT, fd, found_mode(result, __stat_buf));
     return result.restore();
 })
 
 INTERPOSE(int, __fxstat64, int __ver, int fd, struct stat64 *buf)({
     result_t<int> result(bxl->fwd___fxstat64(__ver, fd, buf));
-    auto check = bxl->report_access_fd(__func__, ES_EVENT_TYPE_NOTIFY_STAT, fd);
+    auto check = bxl->report_access_fd(__func__, ES_EVENT_TYPE_NOTIFY_STAT, fd, found_mode(result, buf));
     return result.restore();
 })
 
 INTERPOSE(int, __fxstatat, int __ver, int fd, const char *pathname, struct stat *__stat_buf, int flag)({
     result_t<int> result = bxl->fwd___fxstatat(__ver, fd, pathname, __stat_buf, flag);
-    bxl->report_access_at(__func__, ES_EVENT_TYPE_NOTIFY_STAT, fd, pathname);
+    // the reported path has its symlinks resolved, so what the call found is only of use when it followed them
+    mode_t mode = (flag & AT_SYMLINK_NOFOLLOW) ? BxlObserver::kUnknownMode : found_mode(result, __stat_buf);
+    bxl->report_access_at(__func__, ES_EVENT_TYPE_NOTIFY_STAT, fd, pathname, 0, mode);
     return result.restore();
 })
 
 INTERPOSE(int, __fxstatat64, int __ver, int fd, const char *pathname, struct stat64 *buf, int flag)({
     result_t<int> result(bxl->fwd___fxstatat64(__ver, fd, pathname, buf, flag));
-    auto check = bxl->report_access_at(__func__, ES_EVENT_TYPE_NOTIFY_STAT, fd, pathname);
+    // the reported path has its symlinks resolved, so what the call found is only of use when it followed them
+    mode_t mode = (flag & AT_SYMLINK_NOFOLLOW) ? BxlObserver::kUnknownMode : found_mode(result, buf);
+    auto check = bxl->report_access_at(__func__, ES_EVENT_TYPE_NOTIFY_STAT, fd, pathname, 0, mode);
     return result.restore();
 })
 
 INTERPOSE(int, __xstat, int __ver, const char *pathname, struct stat *buf)({
     result_t<int> result = bxl->fwd___xstat(__ver, pathname, buf);
-    bxl->report_access(__func__, ES_EVENT_TYPE_NOTIFY_STAT, pathname);
+    bxl->report_access(__func__, ES_EVENT_TYPE_NOTIFY_STAT, pathname, 0, found_mode(result, buf));
     return result.restore();
 })
 
 INTERPOSE(int, __xstat64, int __ver, const char *pathname, struct stat64 *buf)({
     result_t<int> result(bxl->fwd___xstat64(__ver, pathname, buf));
-    bxl->report_access(__func__, ES_EVENT_TYPE_NOTIFY_STAT, pathname);
+    bxl->report_access(__func__, ES_EVENT_TYPE_NOTIFY_STAT, pathname, 0, found_mode(result, buf));
     return result.restore();
 })
 
 INTERPOSE(int, __lxstat, int __ver, const char *pathname, struct stat *buf)({
     result_t<int> result = bxl->fwd___lxstat(__ver, pathname, buf);
-    bxl->report_access(__func__, ES_EVENT_TYPE_NOTIFY_STAT, pathname, O_NOFOLLOW);
+    bxl->report_access(__func__, ES_EVENT_TYPE_NOTIFY_STAT, pathname, O_NOFOLLOW, found_mode(result, buf));
     return result.restore();
 })
 
 INTERPOSE(int, __lxstat64, int __ver, const char *pathname, struct stat64 *buf)({
     result_t<int> result(bxl->fwd___lxstat64(__ver, pathname, buf));
-    bxl->report_access(__func__, ES_EVENT_TYPE_NOTIFY_STAT, pathname, O_NOFOLLOW);
+    bxl->report_access(__func__, ES_EVENT_TYPE_NOTIFY_STAT, pathname, O_NOFOLLOW, found_mode(result, buf));
     return result.restore();
 })
 
 INTERPOSE(FILE*, fopen, const char *pathname, const char *mode)({
-    auto check = bxl->report_access(__func__, ES_EVENT_TYPE_NOTIFY_OPEN, pathname);
-    return bxl->check_and_fwd_fopen(check, (FILE*)NULL, pathname, mode);
+    std::string pathStr = bxl->normalize_path(pathname);
+    auto check = bxl->report_access(__func__, ES_EVENT_TYPE_NOTIFY_OPEN, pathStr, sEmptyStr);
+    FILE *f = bxl->check_and_fwd_fopen(check, (FILE*)NULL, pathname, mode);
+    if (f != NULL) bxl->OnFdOpened(fileno(f), pathStr, 0, bxl->get_fd_mode(fileno(f)));
+    return f;
+})
+
+INTERPOSE(FILE*, fdopen, int fd, const char *mode)({
+    result_t<FILE*> result = bxl->fwd_fdopen(fd, mode);
+    if (result.get() != NULL) bxl->OnFdStreamOpened(fd);
+    return result.restore();
 })
 
 INTERPOSE(size_t, fread, void *ptr, size_t size, size_t nmemb, FILE *stream)({
@@ -183,13 +293,25 @@ INTERPOSE(int, open, const char *path, int oflag, ...)({
     va_end(args);
 
     std::string pathStr = bxl->normalize_path(path);
+    if (!bxl->can_deny() && (oflag & (O_CREAT|O_TRUNC|O_NOFOLLOW)) == 0)
+    {
+        // nothing to check up front: open the file first and take its mode from the new descriptor
+        result_t<int> fd = bxl->fwd_open(path, oflag, mode);
+        mode_t pathMode = found_mode(fd, fd.get() != -1 ? bxl->get_fd_mode(fd.get()) : 0);
+        bxl->report_access(__func__, ES_EVENT_TYPE_NOTIFY_OPEN, pathStr, sEmptyStr, pathMode);
+        bxl->OnFdOpened(fd.get(), pathStr, oflag, pathMode);
+        return fd.restore();
+    }
+
     mode_t pathMode = bxl->get_mode(pathStr.c_str());
     IOEvent event(
         pathMode == 0 && (oflag & (O_CREAT|O_TRUNC)) ? ES_EVENT_TYPE_NOTIFY_CREATE : ES_EVENT_TYPE_NOTIFY_OPEN, 
         pathStr, bxl->GetProgramPath(), pathMode, false);
     auto check = bxl->report_access(__func__, event);
 
-    return bxl->check_and_fwd_open(check, ERROR_RETURN_VALUE, path, oflag, mode);
+    int fd = bxl->check_and_fwd_open(check, ERROR_RETURN_VALUE, path, oflag, mode);
+    bxl->OnFdOpened(fd, pathStr, oflag, pathMode);
+    return fd;
 })
 
 INTERPOSE(int, openat, int dirfd, const char *pathname, int flags, ...)({
@@ -199,13 +321,25 @@ INTERPOSE(int, openat, int dirfd, const char *pathname, int flags, ...)({
     va_end(args);
 
     std::string pathStr = bxl->normalize_path_at(dirfd, pathname);
+    if (!bxl->can_deny() && (flags & (O_CREAT|O_TRUNC|O_NOFOLLOW)) == 0)
+    {
+        // nothing to check up front: open the file first and take its mode from the new descriptor
+        result_t<int> fd = bxl->fwd_openat(dirfd, pathname, flags, mode);
+        mode_t pathMode = found_mode(fd, fd.get() != -1 ? bxl->get_fd_mode(fd.get()) : 0);
+        bxl->report_access(__func__, ES_EVENT_TYPE_NOTIFY_OPEN, pathStr, sEmptyStr, pathMode);
+        bxl->OnFdOpened(fd.get(), pathStr, flags, pathMode);
+        return fd.restore();
+    }
+
     mode_t pathMode = bxl->get_mode(pathStr.c_str());
     IOEvent event(
         pathMode == 0 && (flags & (O_CREAT|O_TRUNC)) ? ES_EVENT_TYPE_NOTIFY_CREATE : ES_EVENT_TYPE_NOTIFY_OPEN, 
         pathStr, bxl->GetProgramPath(), pathMode, false);
     auto check = bxl->report_access(__func__, event);
 
-    return bxl->check_and_fwd_openat(check, ERROR_RETURN_VALUE, dirfd, pathname, flags, mode);
+    int fd = bxl->check_and_fwd_openat(check, ERROR_RETURN_VALUE, dirfd, pathname, flags, mode);
+    bxl->OnFdOpened(fd, pathStr, flags, pathMode);
+    return fd;
 })
 
 INTERPOSE(int, creat, const char *pathname, mode_t mode)({
@@ -219,7 +353,9 @@ INTERPOSE(ssize_t, write, int fd, const void *buf, size_t bufsiz)({
 
 INTERPOSE(int, remove, const char *pathname)({
     auto check = bxl->report_access(__func__, ES_EVENT_TYPE_NOTIFY_UNLINK, pathname, O_NOFOLLOW);
-    return bxl->check_and_fwd_remove(check, ERROR_RETURN_VALUE, pathname);
+    int result = bxl->check_and_fwd_remove(check, ERROR_RETURN_VALUE, pathname);
+    bxl->InvalidateSymlinkCache();
+    return result;
 })
 
 INTERPOSE(int, rename, const char *old, const char *n)({
@@ -234,6 +370,8 @@ INTERPOSE(int, rename, const char *old, const char *n)({
     auto check = bxl->report_access(__func__, event); // TODO: this step should only check permission without reporting anything if allowed
 
     result_t<int> result = bxl->check_and_fwd_rename(check, ERROR_RETURN_VALUE, old, n);
+    bxl->InvalidateSymlinkCache();
+    bxl->InvalidateFdOverlay();
 
     // if allowed and 'old' is a directory --> report again so that bxl can translate accesses to renamed files
     if (S_ISDIR(mode) && result.get() != -1)
@@ -244,13 +382,38 @@ INTERPOSE(int, rename, const char *old, const char *n)({
     return result.restore();
 })
 
+// Unlike 'rename', 'unlink' and 'remove' above, the *at variants are neither checked nor reported; they are only
+// interposed so that the paths they rename or remove do not linger in the process's caches.
+INTERPOSE(int, renameat, int olddirfd, const char *old, int newdirfd, const char *n)({
+    result_t<int> result = bxl->fwd_renameat(olddirfd, old, newdirfd, n);
+    bxl->InvalidateSymlinkCache();
+    bxl->InvalidateFdOverlay();
+    return result.restore();
+})
+
+INTERPOSE(int, renameat2, int olddirfd, const char *old, int newdirfd, const char *n, unsigned int flags)({
+    if (bxl->real_renameat2 == NULL)
+    {
+        // older libc without 'renameat2'
+        errno = ENOSYS;
+        return -1;
+    }
+
+    result_t<int> result = bxl->fwd_renameat2(olddirfd, old, newdirfd, n, flags);
+    bxl->InvalidateSymlinkCache();
+    bxl->InvalidateFdOverlay();
+    return result.restore();
+})
+
 INTERPOSE(int, link, const char *path1, const char *path2)({
     auto check = bxl->report_access(
         __func__,
         ES_EVENT_TYPE_NOTIFY_LINK,
         bxl->normalize_path(path1, O_NOFOLLOW),
         bxl->normalize_path(path2, O_NOFOLLOW));
-    return bxl->check_and_fwd_link(check, ERROR_RETURN_VALUE, path1, path2);
+    int result = bxl->check_and_fwd_link(check, ERROR_RETURN_VALUE, path1, path2);
+    bxl->InvalidateSymlinkCache();
+    return result;
 })
 
 INTERPOSE(int, linkat, int fd1, const char *name1, int fd2, const char *name2, int flag)({
@@ -259,24 +422,44 @@ INTERPOSE(int, linkat, int fd1, const char *name1, int fd2, const char *name2, i
         ES_EVENT_TYPE_NOTIFY_LINK,
         bxl->normalize_path_at(fd1, name1, O_NOFOLLOW),
         bxl->normalize_path_at(fd2, name2, O_NOFOLLOW));
-    return bxl->check_and_fwd_linkat(check, ERROR_RETURN_VALUE, fd1, name1, fd2, name2, flag);
+    int result = bxl->check_and_fwd_linkat(check, ERROR_RETURN_VALUE, fd1, name1, fd2, name2, flag);
+    bxl->InvalidateSymlinkCache();
+    return result;
 })
 
 INTERPOSE(int, unlink, const char *path)({
     auto check = bxl->report_access(__func__, ES_EVENT_TYPE_NOTIFY_UNLINK, path, O_NOFOLLOW);
-    return bxl->check_and_fwd_unlink(check, ERROR_RETURN_VALUE, path);
+    int result = bxl->check_and_fwd_unlink(check, ERROR_RETURN_VALUE, path);
+    bxl->InvalidateSymlinkCache();
+    return result;
+})
+
+INTERPOSE(int, unlinkat, int dirfd, const char *path, int flags)({
+    result_t<int> result = bxl->fwd_unlinkat(dirfd, path, flags);
+    bxl->InvalidateSymlinkCache();
+    return result.restore();
+})
+
+INTERPOSE(int, rmdir, const char *path)({
+    result_t<int> result = bxl->fwd_rmdir(path);
+    bxl->InvalidateSymlinkCache();
+    return result.restore();
 })
 
 INTERPOSE(int, symlink, const char *target, const char *linkPath)({
     IOEvent event(ES_EVENT_TYPE_NOTIFY_CREATE, bxl->normalize_path(linkPath, O_NOFOLLOW), bxl->GetProgramPath(), S_IFLNK);
     auto check = bxl->report_access(__func__, event);
-    return bxl->check_and_fwd_symlink(check, ERROR_RETURN_VALUE, target, linkPath);
+    int result = bxl->check_and_fwd_symlink(check, ERROR_RETURN_VALUE, target, linkPath);
+    bxl->InvalidateSymlinkCache();
+    return result;
 })
 
 INTERPOSE(int, symlinkat, const char *target, int dirfd, const char *linkPath)({
     IOEvent event(ES_EVENT_TYPE_NOTIFY_CREATE, bxl->normalize_path_at(dirfd, linkPath, O_NOFOLLOW), bxl->GetProgramPath(), S_IFLNK);
     auto check = bxl->report_access(__func__, event);
-    return bxl->check_and_fwd_symlinkat(check, ERROR_RETURN_VALUE, target, dirfd, linkPath);
+    int result = bxl->check_and_fwd_symlinkat(check, ERROR_RETURN_VALUE, target, dirfd, linkPath);
+    bxl->InvalidateSymlinkCache();
+    return result;
 })
 
 INTERPOSE(ssize_t, readlink, const char *path, char *buf, size_t bufsize)({
@@ -290,8 +473,11 @@ INTERPOSE(ssize_t, readlinkat, int fd, const char *path, char *buf, size_t bufsi
 })
 
 INTERPOSE(DIR*, opendir, const char *name)({
-    auto check = bxl->report_access(__func__, ES_EVENT_TYPE_NOTIFY_READDIR, name);
-    return bxl->check_and_fwd_opendir(check, (DIR*)NULL, name);
+    std::string pathStr = bxl->normalize_path(name);
+    auto check = bxl->report_access(__func__, ES_EVENT_TYPE_NOTIFY_READDIR, pathStr, sEmptyStr);
+    DIR *dir = bxl->check_and_fwd_opendir(check, (DIR*)NULL, name);
+    if (dir != NULL) bxl->OnFdOpened(dirfd(dir), pathStr, 0, S_IFDIR);
+    return dir;
 })
 
 INTERPOSE(DIR*, fdopendir, int fd)({
@@ -312,13 +498,17 @@ INTERPOSE(int, futimens, int fd, const struct timespec times[2])({
 INTERPOSE(int, mkdir, const char *pathname, mode_t mode)({
     IOEvent event(ES_EVENT_TYPE_NOTIFY_CREATE, bxl->normalize_path(pathname), bxl->GetProgramPath(), S_IFDIR);
     auto check = bxl->report_access(__func__, event);
-    return bxl->check_and_fwd_mkdir(check, ERROR_RETURN_VALUE, pathname, mode);
+    int result = bxl->check_and_fwd_mkdir(check, ERROR_RETURN_VALUE, pathname, mode);
+    bxl->InvalidateSymlinkCache();
+    return result;
 })
 
 INTERPOSE(int, mkdirat, int dirfd, const char *pathname, mode_t mode)({
     IOEvent event(ES_EVENT_TYPE_NOTIFY_CREATE, bxl->normalize_path_at(dirfd, pathname), bxl->GetProgramPath(), S_IFDIR);
     auto check = bxl->report_access(__func__, event);
-    return bxl->check_and_fwd_mkdirat(check, ERROR_RETURN_VALUE, dirfd, pathname, mode);
+    int result = bxl->check_and_fwd_mkdirat(check, ERROR_RETURN_VALUE, dirfd, pathname, mode);
+    bxl->InvalidateSymlinkCache();
+    return result;
 })
 
 INTERPOSE(int, vprintf, const char *fmt, va_list args)({
@@ -361,10 +551,67 @@ INTERPOSE(int, dprintf, int fd, const char *fmt, ...)({
 })
 
 // TODO: temporarily interposing syscalls not needed for access checking but useful for tracing
-INTERPOSE(int, close, int fd)             ({ return bxl->fwd_close(fd).restore(); })
-INTERPOSE(int, fclose, FILE *f)           ({ return bxl->fwd_fclose(f).restore(); })
-INTERPOSE(int, dup, int fd)               ({ return bxl->fwd_dup(fd).restore(); })
-INTERPOSE(int, dup2, int oldfd, int newfd)({ return bxl->fwd_dup2(oldfd, newfd).restore(); })
+INTERPOSE(int, fclose, FILE *f)({
+    // 'fclose' closes the stream's descriptor without going through 'close'
+    bxl->OnFdClosing(fileno(f));
+    return bxl->fwd_fclose(f).restore();
+})
+
+INTERPOSE(int, closedir, DIR *dir)({
+    // 'closedir' closes the stream's descriptor without going through 'close'
+    bxl->OnFdClosing(dirfd(dir));
+    return bxl->fwd_closedir(dir).restore();
+})
+
+INTERPOSE(int, dup, int fd)({
+    result_t<int> result = bxl->fwd_dup(fd);
+    bxl->OnFdDuplicated(fd, result.get());
+    return result.restore();
+})
+
+INTERPOSE(int, close, int fd)({
+    bxl->OnFdClosing(fd);
+    return bxl->fwd_close(fd).restore();
+})
+
+INTERPOSE(int, dup2, int oldfd, int newfd)({
+    // 'dup2' implicitly closes 'newfd'
+    if (oldfd != newfd) bxl->OnFdClosing(newfd);
+    result_t<int> result = bxl->fwd_dup2(oldfd, newfd);
+    bxl->OnFdDuplicated(oldfd, result.get());
+    return result.restore();
+})
+
+INTERPOSE(int, dup3, int oldfd, int newfd, int flags)({
+    // 'dup3' implicitly closes 'newfd' (it fails if 'newfd' is 'oldfd')
+    if (oldfd != newfd) bxl->OnFdClosing(newfd);
+    result_t<int> result = bxl->fwd_dup3(oldfd, newfd, flags);
+    bxl->OnFdDuplicated(oldfd, result.get());
+    return result.restore();
+})
+
+INTERPOSE(int, close_range, unsigned int first, unsigned int last, int flags)({
+    // with CLOSE_RANGE_CLOEXEC the descriptors are only closed when the process execs
+    if (!(flags & CLOSE_RANGE_CLOEXEC)) bxl->OnFdRangeClosing(first, last);
+    return bxl->fwd_close_range(first, last, flags).restore();
+})
+
+INTERPOSE(void, closefrom, int lowfd)({
+    if (lowfd >= 0) bxl->OnFdRangeClosing((unsigned int)lowfd, ~0U);
+    bxl->real_closefrom(lowfd);
+})
+
+INTERPOSE(int, chdir, const char *path)({
+    result_t<int> result = bxl->fwd_chdir(path);
+    if (result.get() == 0) bxl->OnCwdChanged();
+    return result.restore();
+})
+
+INTERPOSE(int, fchdir, int fd)({
+    result_t<int> result = bxl->fwd_fchdir(fd);
+    if (result.get() == 0) bxl->OnCwdChanged();
+    return result.restore();
+})
 
 INTERPOSE(int, chmod, const char *pathname, mode_t mode)({
     auto check = bxl->report_access(__func__, ES_EVENT_TYPE_NOTIFY_SETMODE, pathname);
@@ -399,7 +646,9 @@ INTERPOSE(void*, dlopen, const char *filename, int flags)({
 
 static void report_exit(int exitCode, void *args)
 {
-    BxlObserver::GetInstance()->report_access("on_exit", ES_EVENT_TYPE_NOTIFY_EXIT, std::string(""), std::string(""));
+    BxlObserver *bxl = BxlObserver::GetInstance();
+    bxl->report_access("on_exit", ES_EVENT_TYPE_NOTIFY_EXIT, std::string(""), std::string(""));
+    bxl->CloseReportChannel();
 }
 
 void __attribute__ ((constructor)) _bxl_linux_sandbox_init(void)
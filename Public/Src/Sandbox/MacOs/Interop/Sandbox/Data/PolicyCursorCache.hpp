@@ -0,0 +1,159 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef PolicyCursorCache_hpp
+#define PolicyCursorCache_hpp
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "PolicySearch.h"
+
+/*!
+ * An entry of a policy cursor cache: the cursor of a search for 'path' (a directory path relative to the root
+ * of the manifest, not null-terminated).  'record' is NULL while the entry is empty.
+ */
+struct PolicyCursorCacheEntry
+{
+    std::atomic<uint32_t> lock;
+    uint32_t hash;
+    const ManifestRecord *record;
+    uint16_t pathLength;
+    bool searchWasTruncated;
+    char path[1];
+};
+
+/*!
+ * A cache of the policy search cursors of the directories whose files were looked up in a manifest, so that
+ * looking up a file whose parent directory is cached resumes the search from the parent's cursor instead of
+ * the root of the manifest (i.e., only the final component of the path is hashed and looked up).
+ *
+ * A manifest never changes, so neither do the cursors: the cache is never invalidated.  The cache is
+ * direct-mapped with fixed-size entries, each guarded by a lock that is only ever tried (a lookup or insert that
+ * finds the entry locked is a miss), so the cache never blocks.  Its memory is allocated on construction and
+ * only touched as entries are used.
+ */
+class PolicyCursorCache final
+{
+private:
+
+    /*! Number of entries (must be a power of 2) */
+    static const size_t kNumEntries = 1024;
+
+    /*! Size of an entry; directory paths that do not fit are not cached */
+    static const size_t kEntrySize = 512;
+
+    static const size_t kMaxPathLength = kEntrySize - offsetof(PolicyCursorCacheEntry, path);
+
+    PolicyCursorCacheEntry *entries_;
+
+    std::atomic<uint64_t> numHits_;
+    std::atomic<uint64_t> numMisses_;
+
+    /*! FNV-1a hash of the path */
+    static uint32_t Hash(const char *path, size_t length)
+    {
+        uint32_t hash = 0x811c9dc5;
+        for (size_t i = 0; i < length; i++)
+        {
+            hash ^= (unsigned char)path[i];
+            hash *= 0x01000193;
+        }
+
+        return hash;
+    }
+
+    PolicyCursorCacheEntry* TryLock(uint32_t hash)
+    {
+        if (entries_ == nullptr)
+        {
+            return nullptr;
+        }
+
+        PolicyCursorCacheEntry *entry = (PolicyCursorCacheEntry*)((char*)entries_ + (hash & (kNumEntries - 1)) * kEntrySize);
+        return entry->lock.exchange(1, std::memory_order_acquire) == 0 ? entry : nullptr;
+    }
+
+    static void Unlock(PolicyCursorCacheEntry *entry)
+    {
+        entry->lock.store(0, std::memory_order_release);
+    }
+
+public:
+
+    // zero-filled memory: every entry starts out empty and unlocked
+    PolicyCursorCache() : entries_((PolicyCursorCacheEntry*)calloc(kNumEntries, kEntrySize)), numHits_(0), numMisses_(0)
+    {
+    }
+
+    ~PolicyCursorCache()
+    {
+        free(entries_);
+    }
+
+    PolicyCursorCache(const PolicyCursorCache&) = delete;
+    PolicyCursorCache& operator = (const PolicyCursorCache&) = delete;
+
+    /*! Number of lookups that found the cursor of the directory */
+    uint64_t GetNumHits() const   { return numHits_.load(std::memory_order_relaxed); }
+
+    /*! Number of lookups that did not */
+    uint64_t GetNumMisses() const { return numMisses_.load(std::memory_order_relaxed); }
+
+    /*!
+     * Looks up the first 'length' bytes of 'path'.  Returns whether the cursor of that directory was found
+     * (in which case it is copied into 'cursor').
+     */
+    bool TryGet(const char *path, size_t length, PolicySearchCursor *cursor)
+    {
+        bool found = false;
+        uint32_t hash = length <= kMaxPathLength ? Hash(path, length) : 0;
+        PolicyCursorCacheEntry *entry = length <= kMaxPathLength ? TryLock(hash) : nullptr;
+        if (entry != nullptr)
+        {
+            if (entry->record != nullptr &&
+                entry->hash == hash &&
+                entry->pathLength == length &&
+                memcmp(entry->path, path, length) == 0)
+            {
+                *cursor = PolicySearchCursor(entry->record, entry->searchWasTruncated);
+                found = true;
+            }
+
+            Unlock(entry);
+        }
+
+        (found ? numHits_ : numMisses_).fetch_add(1, std::memory_order_relaxed);
+        return found;
+    }
+
+    /*!
+     * Records 'cursor' as the cursor of the directory made of the first 'length' bytes of 'path'.
+     */
+    void Insert(const char *path, size_t length, const PolicySearchCursor &cursor)
+    {
+        if (length > kMaxPathLength || !cursor.IsValid())
+        {
+            return;
+        }
+
+        uint32_t hash = Hash(path, length);
+        PolicyCursorCacheEntry *entry = TryLock(hash);
+        if (entry == nullptr)
+        {
+            return;
+        }
+
+        entry->hash               = hash;
+        entry->record             = cursor.Record;
+        entry->searchWasTruncated = cursor.SearchWasTruncated;
+        entry->pathLength         = (uint16_t)length;
+        memcpy(entry->path, path, length);
+        Unlock(entry);
+    }
+};
+
+#endif /* PolicyCursorCache_hpp */
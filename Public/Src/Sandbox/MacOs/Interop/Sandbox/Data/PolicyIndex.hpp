@@ -0,0 +1,483 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef PolicyIndex_hpp
+#define PolicyIndex_hpp
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#if defined(__SSE2__) && __linux__
+#include <emmintrin.h>
+#endif
+
+#include "FileAccessManifestParser.hpp"
+#include "PolicySearch.h"
+#include "StringOperations.h"
+
+/*!
+ * A flat, read-only index of the policy tree of a file access manifest, compiled when the manifest is loaded.
+ *
+ * The manifest's tree is laid out the way the managed side serialized it: every record has a hash table
+ * of offsets to its children, sized to the number of children and probed with a modulo, and the partial paths of
+ * the children live inside the records, scattered across the payload.  The index instead keeps
+ *   - the nodes in breadth-first order, each with the hash of its partial path and where its children are,
+ *   - the children of every node in an open-addressed table whose size is a power of 2 (at most half full),
+ *   - the partial paths of all the nodes in one contiguous string pool,
+ * so that looking up a path touches a few cache lines per component instead of wandering through the payload.
+ *
+ * The nodes do not keep the hashes stored in the manifest: the partial paths are rehashed when the index is
+ * compiled, with a hash that folds a word (instead of a character) at a time, and a path being looked up is split
+ * into its components in a single pass over it (see PathTokenizer), so the v1 manifest format (shared with Windows)
+ * is not affected.
+ *
+ * A lookup produces the same cursor as FindFileAccessPolicyInTreeEx (the nodes keep pointers to the records they
+ * were compiled from), i.e., the same cone and node policies.
+ *
+ * A manifest with the Linux-native layout (see ManifestV2SectionKind) already holds its tree laid out this way, so
+ * instead of being compiled, its index is opened in place: the nodes (hashed by the managed side the same way),
+ * slots and string pool are sections of the manifest, and the records are the manifest's policy records, one per
+ * node (which have no children of their own, i.e., cursors into such a manifest can only be resolved through its
+ * index).
+ */
+class PolicyIndex final
+{
+private:
+
+    // measures PathTokenizer and HashComponent (see Sandbox/Linux/Bench)
+    friend class PolicyIndexBenchmark;
+
+    // hashes the nodes of the v2 manifests it writes with HashComponent (see Sandbox/Linux/UnitTests)
+    friend class ManifestBuilder;
+
+    /*! A node of the index.  'NumSlots' is 0 for a leaf (a record without buckets). */
+    typedef ManifestV2Node Node;
+
+    static constexpr uint32_t kNoNode = 0;
+
+    const Node *nodes_;
+    size_t numNodes_;
+
+    // 'NumSlots' consecutive entries per node, holding the indices of its children (kNoNode for an empty slot;
+    // the root, node 0, is never a child)
+    const uint32_t *slots_;
+
+    PCPathChar pathPool_;
+    size_t pathPoolSize_;
+
+    // the record of every node, when the index is opened in place (otherwise, see 'nodeRecords_')
+    PCManifestRecord records_;
+
+    // the storage of a compiled index
+    std::vector<Node> nodeStorage_;
+    std::vector<uint32_t> slotStorage_;
+    std::vector<PathChar> pathStorage_;
+
+    // the record every node was compiled from
+    std::vector<PCManifestRecord> nodeRecords_;
+
+    // open-addressed map from a record to 1 + the index of its node
+    std::vector<uint32_t> recordMap_;
+
+    static uint32_t TableSize(size_t numEntries)
+    {
+        uint32_t size = 1;
+        while (size < 2 * numEntries)
+        {
+            size <<= 1;
+        }
+
+        return size;
+    }
+
+    static uint32_t HashRecord(PCManifestRecord record)
+    {
+        uint64_t value = (uint64_t)(uintptr_t)record;
+        return (uint32_t)((value * 0x9E3779B97F4A7C15ull) >> 32);
+    }
+
+    PCManifestRecord GetRecord(size_t node) const
+    {
+        return records_ != nullptr ? &records_[node] : nodeRecords_[node];
+    }
+
+    /*! Index of the node of 'record', or -1 if 'record' is not part of the index. */
+    int64_t FindNode(PCManifestRecord record) const
+    {
+        if (records_ != nullptr)
+        {
+            return record >= records_ && record < records_ + numNodes_ ? record - records_ : -1;
+        }
+
+        uint32_t mask = (uint32_t)recordMap_.size() - 1;
+        for (uint32_t i = HashRecord(record) & mask; recordMap_[i] != 0; i = (i + 1) & mask)
+        {
+            if (nodeRecords_[recordMap_[i] - 1] == record)
+            {
+                return recordMap_[i] - 1;
+            }
+        }
+
+        return -1;
+    }
+
+    /*!
+     * Finds the directory separators of a path, which must be null-terminated.  With SSE2, the path is scanned
+     * 16 bytes at a time, and the separators found in the current block are kept in a bitmask, so each byte of
+     * the path is looked at once no matter how many components are asked for.  Nothing outside the path is read:
+     * the last block, when shorter than 16 bytes, is copied out before it is compared.
+     */
+    class PathTokenizer final
+    {
+    private:
+
+        PCPathChar path_;
+        size_t length_;
+
+#if defined(__SSE2__) && __linux__
+        // offset (relative to 'path_') of the current block
+        size_t blockOffset_;
+        uint32_t mask_;
+
+        uint32_t LoadBlock() const
+        {
+            __m128i block;
+            size_t blockLength = length_ - blockOffset_;
+            if (blockLength >= 16)
+            {
+                block = _mm_loadu_si128((const __m128i*)(path_ + blockOffset_));
+            }
+            else
+            {
+                // the rest of the block is zeros, which are not separators
+                PathChar tail[16] = { 0 };
+                memcpy(tail, path_ + blockOffset_, blockLength);
+                block = _mm_loadu_si128((const __m128i*)tail);
+            }
+
+            __m128i separators = _mm_or_si128(
+                _mm_cmpeq_epi8(block, _mm_set1_epi8(UNIX_DIRECTORY_SEPARATOR)),
+                _mm_cmpeq_epi8(block, _mm_set1_epi8(NT_DIRECTORY_SEPARATOR)));
+            return (uint32_t)_mm_movemask_epi8(separators);
+        }
+#endif
+
+    public:
+
+        PathTokenizer(PCPathChar path, size_t length) : path_(path), length_(length)
+        {
+#if defined(__SSE2__) && __linux__
+            blockOffset_ = 0;
+            mask_        = length > 0 ? LoadBlock() : 0;
+#endif
+        }
+
+        /*! Offset of the first separator at or after 'from', or the length of the path if there is none. */
+        size_t NextSeparator(size_t from)
+        {
+#if defined(__SSE2__) && __linux__
+            // offsets only ever increase, so a block is never loaded twice
+            while (blockOffset_ < length_)
+            {
+                size_t start = from > blockOffset_ ? from - blockOffset_ : 0;
+                uint32_t mask = start < 16 ? mask_ & (~0u << start) : 0;
+                if (mask != 0)
+                {
+                    return blockOffset_ + __builtin_ctz(mask);
+                }
+
+                blockOffset_ += 16;
+                mask_ = blockOffset_ < length_ ? LoadBlock() : 0;
+            }
+
+            return length_;
+#else
+            for (; from < length_ && !IsDirectorySeparator(path_[from]); from++);
+            return from;
+#endif
+        }
+
+        /*!
+         * Same as GetPartialPathAndRemainder (see PolicySearch.cpp) for the part of the path that starts at 'from':
+         * returns the length of the partial path, and sets 'remainder' to the offset of what follows it.
+         */
+        size_t GetPartialPathAndRemainder(size_t from, size_t *remainder)
+        {
+            // leading separators are part of the partial path
+            size_t start = from;
+            while (IsDirectorySeparator(path_[start]))
+            {
+                start++;
+            }
+
+            size_t end = start < length_ ? NextSeparator(start) : start;
+            *remainder = end < length_ ? end + 1 : end;
+            return end - from;
+        }
+    };
+
+    /*!
+     * Hash of a partial path, which the index uses instead of HashPath: it folds 8 bytes at a time (of a path
+     * whose characters need no normalization, otherwise it is HashPath).
+     */
+    static ManifestRecord::HashType HashComponent(PCPathChar path, size_t length)
+    {
+#if __linux__
+        const uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+        uint64_t hash = length;
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t))
+        {
+            uint64_t word;
+            memcpy(&word, path + i, sizeof(uint64_t));
+            hash = (hash ^ word) * multiplier;
+            hash ^= hash >> 32;
+        }
+
+        if (i < length)
+        {
+            // the last (partial) word, zero-extended: the 8 bytes that end the path when there are that many,
+            // shifted right, otherwise the bytes of the path loaded 4, 2 and 1 at a time (never past its end)
+            size_t tailLength = length - i;
+            uint64_t word = 0;
+            if (length >= sizeof(uint64_t))
+            {
+                memcpy(&word, path + length - sizeof(uint64_t), sizeof(uint64_t));
+                word >>= 8 * (sizeof(uint64_t) - tailLength);
+            }
+            else
+            {
+                const unsigned char *tail = (const unsigned char*)path;
+                size_t shift = 0;
+                if (tailLength & 4)
+                {
+                    uint32_t part;
+                    memcpy(&part, tail, sizeof(part));
+                    word = part;
+                    tail += 4;
+                    shift = 32;
+                }
+
+                if (tailLength & 2)
+                {
+                    uint16_t part;
+                    memcpy(&part, tail, sizeof(part));
+                    word |= (uint64_t)part << shift;
+                    tail += 2;
+                    shift += 16;
+                }
+
+                if (tailLength & 1)
+                {
+                    word |= (uint64_t)*tail << shift;
+                }
+            }
+
+            hash = (hash ^ word) * multiplier;
+            hash ^= hash >> 32;
+        }
+
+        return (ManifestRecord::HashType)hash;
+#else
+        return HashPath(path, length);
+#endif
+    }
+
+    /*! Same as ArePathsEqual for the partial path of 'node' (without a call per character where possible) */
+    bool IsPartialPathOf(const Node *node, PCPathChar path, size_t length) const
+    {
+        PCPathChar partialPath = &pathPool_[node->PathOffset];
+#if __linux__
+        // the pool ends with a terminator, so a partial path that is too short is never compared past the pool
+        return node->PathOffset + length < pathPoolSize_ && memcmp(path, partialPath, length) == 0 && partialPath[length] == 0;
+#else
+        return ArePathsEqual(path, partialPath, length);
+#endif
+    }
+
+    PolicyIndex() : nodes_(nullptr), numNodes_(0), slots_(nullptr), pathPool_(nullptr), pathPoolSize_(0), records_(nullptr) {}
+
+public:
+
+    PolicyIndex(const PolicyIndex&) = delete;
+    PolicyIndex& operator = (const PolicyIndex&) = delete;
+
+    /*! Number of nodes (i.e., of records of the compiled tree) */
+    size_t NumNodes() const { return numNodes_; }
+
+    /*! Whether the index was opened in place (see Open), rather than compiled */
+    bool IsOpenedInPlace() const { return records_ != nullptr; }
+
+    /*!
+     * Opens the index of the policy tree of a v2 manifest in place (the tree must outlive the index).
+     */
+    static PolicyIndex* Open(const ManifestV2PolicyTree &tree)
+    {
+        PolicyIndex *index   = new PolicyIndex();
+        index->nodes_        = tree.Nodes;
+        index->numNodes_     = tree.NumNodes;
+        index->slots_        = tree.Slots;
+        index->pathPool_     = tree.Strings;
+        index->pathPoolSize_ = tree.StringsSize;
+        index->records_      = tree.Records;
+        return index;
+    }
+
+    /*!
+     * Compiles the tree rooted at 'root'.  Returns nullptr if the tree is too large to be indexed.
+     */
+    static PolicyIndex* Compile(PCManifestRecord root)
+    {
+        PolicyIndex *index = new PolicyIndex();
+        std::vector<Node> &nodes = index->nodeStorage_;
+        std::vector<uint32_t> &slots = index->slotStorage_;
+        std::vector<PathChar> &pathPool = index->pathStorage_;
+        std::vector<PCManifestRecord> &nodeRecords = index->nodeRecords_;
+
+        nodes.push_back({ 0, 0, 0, 0 });
+        nodeRecords.push_back(root);
+        pathPool.push_back(0);
+
+        // breadth-first: the children of a node are appended (and their slots filled in) when the node is visited
+        for (size_t n = 0; n < nodes.size(); n++)
+        {
+            PCManifestRecord record = nodeRecords[n];
+            if (record->BucketCount == 0)
+            {
+                continue;
+            }
+
+            size_t numChildren = 0;
+            for (ManifestRecord::BucketCountType b = 0; b < record->BucketCount; b++)
+            {
+                numChildren += record->GetChildRecord(b) != nullptr ? 1 : 0;
+            }
+
+            uint32_t numSlots = TableSize(numChildren);
+            size_t firstSlot = slots.size();
+            if (firstSlot + numSlots > UINT32_MAX || nodes.size() + numChildren > UINT32_MAX)
+            {
+                delete index;
+                return nullptr;
+            }
+
+            nodes[n].FirstSlot = (uint32_t)firstSlot;
+            nodes[n].NumSlots  = numSlots;
+            slots.resize(firstSlot + numSlots, kNoNode);
+
+            for (ManifestRecord::BucketCountType b = 0; b < record->BucketCount; b++)
+            {
+                PCManifestRecord child = record->GetChildRecord(b);
+                if (child == nullptr)
+                {
+                    continue;
+                }
+
+                PCPathChar partialPath = child->GetPartialPath();
+                size_t partialPathLength = pathlen(partialPath);
+                size_t pathOffset = pathPool.size();
+                if (pathOffset > UINT32_MAX)
+                {
+                    delete index;
+                    return nullptr;
+                }
+
+                pathPool.insert(pathPool.end(), partialPath, partialPath + partialPathLength + 1);
+
+                ManifestRecord::HashType hash = HashComponent(partialPath, partialPathLength);
+                uint32_t childNode = (uint32_t)nodes.size();
+                nodes.push_back({ hash, (uint32_t)pathOffset, 0, 0 });
+                nodeRecords.push_back(child);
+
+                uint32_t slot = hash & (numSlots - 1);
+                while (slots[firstSlot + slot] != kNoNode)
+                {
+                    slot = (slot + 1) & (numSlots - 1);
+                }
+
+                slots[firstSlot + slot] = childNode;
+            }
+        }
+
+        index->recordMap_.resize(TableSize(nodes.size()), 0);
+        uint32_t mask = (uint32_t)index->recordMap_.size() - 1;
+        for (size_t n = 0; n < nodes.size(); n++)
+        {
+            uint32_t i = HashRecord(nodeRecords[n]) & mask;
+            while (index->recordMap_[i] != 0)
+            {
+                i = (i + 1) & mask;
+            }
+
+            index->recordMap_[i] = (uint32_t)n + 1;
+        }
+
+        index->nodes_        = nodes.data();
+        index->numNodes_     = nodes.size();
+        index->slots_        = slots.data();
+        index->pathPool_     = pathPool.data();
+        index->pathPoolSize_ = pathPool.size();
+        return index;
+    }
+
+    /*!
+     * Same as FindFileAccessPolicyInTreeEx (which it falls back to when 'cursor' does not point into the index;
+     * which never happens for an index opened in place).
+     */
+    PolicySearchCursor Find(const PolicySearchCursor &cursor, PCPathChar absolutePath, size_t absolutePathLength) const
+    {
+        if (cursor.SearchWasTruncated)
+        {
+            return cursor;
+        }
+
+        int64_t found = FindNode(cursor.Record);
+        if (found == -1)
+        {
+            assert(!IsOpenedInPlace());
+            return FindFileAccessPolicyInTreeEx(cursor, absolutePath, absolutePathLength);
+        }
+
+        const Node *node = &nodes_[found];
+        PathTokenizer tokenizer(absolutePath, absolutePathLength);
+        size_t offset = 0;
+        while (true)
+        {
+            bool isLeaf = node->NumSlots == 0;
+            bool endOfPath = absolutePath[offset] == 0;
+            if (isLeaf || endOfPath)
+            {
+                return PolicySearchCursor(GetRecord(node - nodes_), /*searchWasTruncated*/ !endOfPath);
+            }
+
+            size_t remainder = 0;
+            PCPathChar partialPath = absolutePath + offset;
+            size_t partialPathLength = tokenizer.GetPartialPathAndRemainder(offset, &remainder);
+            ManifestRecord::HashType hash = HashComponent(partialPath, partialPathLength);
+
+            const Node *child = nullptr;
+            uint32_t mask = node->NumSlots - 1;
+            for (uint32_t slot = hash & mask; slots_[node->FirstSlot + slot] != kNoNode; slot = (slot + 1) & mask)
+            {
+                const Node *candidate = &nodes_[slots_[node->FirstSlot + slot]];
+                if (candidate->Hash == hash && IsPartialPathOf(candidate, partialPath, partialPathLength))
+                {
+                    child = candidate;
+                    break;
+                }
+            }
+
+            if (child == nullptr)
+            {
+                return PolicySearchCursor(GetRecord(node - nodes_), /*searchWasTruncated*/ true);
+            }
+
+            offset = remainder;
+            node = child;
+        }
+    }
+};
+
+#endif /* PolicyIndex_hpp */
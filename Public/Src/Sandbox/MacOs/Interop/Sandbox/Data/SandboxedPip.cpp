@@ -7,16 +7,30 @@
 #pragma mark SandboxedPip Implementation
 
 SandboxedPip::SandboxedPip(pid_t pid, const char *payload, size_t length)
+    : SandboxedPip(pid, payload, length, /* copyPayload */ true)
+{
+}
+
+SandboxedPip::SandboxedPip(pid_t pid, const char *payload, size_t length, bool copyPayload)
 {
     log_debug("Initializing with pid (%d) from: %{public}s", pid, __FUNCTION__);
     
-    payload_ = (char *) malloc(length);
-    if (payload == NULL)
+    ownsPayload_ = copyPayload;
+    if (copyPayload)
     {
-        throw BuildXLException("Could not allocate memory for FAM payload storage!");
+        payload_ = (char *) malloc(length);
+        if (payload_ == NULL)
+        {
+            throw BuildXLException("Could not allocate memory for FAM payload storage!");
+        }
+
+        memcpy(payload_, payload, length);
     }
-    
-    memcpy(payload_, payload, length);
+    else
+    {
+        payload_ = (char *) payload;
+    }
+
     fam_.init((BYTE*)payload_, length);
     
     if (fam_.HasErrors())
@@ -24,13 +38,33 @@ SandboxedPip::SandboxedPip(pid_t pid, const char *payload, size_t length)
         std::string error= "FileAccessManifest parsing exception, error: ";
         throw BuildXLException(error.append(fam_.Error()));
     }
+
+    // the policy tree of a v2 manifest is already laid out as an index (and can only be looked up through it)
+    const ManifestV2PolicyTree *policyTree = fam_.GetPolicyTree();
+    if (policyTree != nullptr)
+    {
+        policyIndex_.reset(PolicyIndex::Open(*policyTree));
+    }
     
     processId_ = pid;
     processTreeCount_ = 1;
 }
 
+bool SandboxedPip::CompilePolicyIndex()
+{
+    if (policyIndex_ == nullptr)
+    {
+        policyIndex_.reset(PolicyIndex::Compile(GetManifestRecord()));
+    }
+
+    return policyIndex_ != nullptr;
+}
+
 SandboxedPip::~SandboxedPip()
 {
     log_debug("Releasing pip object (%#llX) - freed from %{public}s", GetPipId(),  __FUNCTION__);
-    free(payload_);
+    if (ownsPayload_)
+    {
+        free(payload_);
+    }
 }
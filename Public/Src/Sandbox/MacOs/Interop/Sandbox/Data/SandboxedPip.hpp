@@ -6,6 +6,8 @@
 
 #include "BuildXLSandboxShared.hpp"
 #include "FileAccessManifestParser.hpp"
+#include "PolicyCursorCache.hpp"
+#include "PolicyIndex.hpp"
 
 /*!
  * Represents the root of the process tree being tracked.
@@ -29,27 +31,54 @@ private:
     /*! File access manifest payload bytes */
     char *payload_;
 
+    /*! Whether 'payload_' is a copy owned (and released) by this pip */
+    bool ownsPayload_;
+
     /*! File access manifest (contains pointers into the 'payload_' byte array */
     FileAccessManifestParseResult fam_;
 
     /*! Number of processses in this pip's process tree */
     std::atomic<int> processTreeCount_;
+
+    /*! Policy search cursors of the directories looked up in the FAM so far */
+    PolicyCursorCache policyCursorCache_;
+
+    /*! Flat index of the FAM's policy tree (null unless compiled, or opened in place for a v2 FAM) */
+    std::unique_ptr<PolicyIndex> policyIndex_;
     
 public:
 
     SandboxedPip() = delete;
     SandboxedPip(pid_t pid, const char *payload, size_t length);
+
+    /*!
+     * Unless 'copyPayload' is set, parses the FAM in place: 'payload' is neither copied nor released by the pip
+     * (and so must outlive it), e.g., because it is mapped from memory shared by the whole process tree.
+     */
+    SandboxedPip(pid_t pid, const char *payload, size_t length, bool copyPayload);
     ~SandboxedPip();
 
     /*! Process id of the root process of this pip. */
     inline const pid_t GetProcessId() const                 { return processId_; }
 
     /*! A unique identifier of this pip. */
-    inline const pipid_t GetPipId() const                   { return fam_.GetPipId()->PipId; }
+    inline const pipid_t GetPipId() const                   { return fam_.GetPipId(); }
 
     /*! File access manifest record for this pip (to be used for checking file accesses) */
     inline const PCManifestRecord GetManifestRecord() const { return fam_.GetUnixRootNode(); }
 
+    /*! Flat index of 'GetManifestRecord()', or nullptr if it has not been compiled (never for a v2 FAM) */
+    inline const PolicyIndex* GetPolicyIndex() const        { return policyIndex_.get(); }
+
+    /*!
+     * Compiles the FAM's policy tree into a flat index, which is then used for looking up paths.
+     * Returns whether the index could be compiled.
+     */
+    bool CompilePolicyIndex();
+
+    /*! Cache of policy search cursors of directories (for looking up paths in 'GetManifestRecord()') */
+    inline PolicyCursorCache* GetPolicyCursorCache()        { return &policyCursorCache_; }
+
     /*! File access manifest flags */
     inline const FileAccessManifestFlag GetFamFlags() const { return fam_.GetFamFlags(); }
 
@@ -63,8 +92,15 @@ public:
     /*! Number of currently active processes in this pip's process tree */
     inline const int GetTreeSize() const                    { return processTreeCount_; }
     
-    /*! When this returns true, child processes should not be tracked. */
+    /*! When this returns true, some child processes may break away from the sandbox. */
     bool AllowChildProcessesToBreakAway() const             { return fam_.AllowChildProcessesToBreakAway(); }
+
+    /*! Whether the program named 'name' (the file name of its image) breaks away from the sandbox. */
+    bool IsChildProcessToBreakAway(const char *name) const  { return fam_.IsChildProcessToBreakAway(name); }
+
+    /*! Directory translations of this pip (see FileAccessManifestParseResult::GetTranslatePath). */
+    inline uint32_t GetNumTranslatePaths() const            { return fam_.GetNumTranslatePaths(); }
+    inline bool GetTranslatePath(uint32_t index, char *from, char *to, size_t size) const { return fam_.GetTranslatePath(index, from, to, size); }
     
 
 #pragma mark Process Tree Tracking
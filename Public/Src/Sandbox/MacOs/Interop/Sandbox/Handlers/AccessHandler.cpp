@@ -1,6 +1,8 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
+#include <algorithm>
+
 #include "AccessHandler.hpp"
 
 bool AccessHandler::TryInitializeWithTrackedProcess(pid_t pid)
@@ -15,13 +17,134 @@ bool AccessHandler::TryInitializeWithTrackedProcess(pid_t pid)
     return true;
 }
 
+PolicySearchCursor AccessHandler::FindInManifest(const PolicySearchCursor &cursor, const char *path, size_t pathLength)
+{
+    const PolicyIndex *index = GetPip()->GetPolicyIndex();
+    if (index == nullptr)
+    {
+        return FindFileAccessPolicyInTreeEx(cursor, path, pathLength);
+    }
+
+    PolicySearchCursor result = index->Find(cursor, path, pathLength);
+
+#if DEBUG || _DEBUG
+    // the index must agree with the tree it was compiled from (an index opened in place has no other tree)
+    if (!index->IsOpenedInPlace())
+    {
+        PolicySearchCursor expected = FindFileAccessPolicyInTreeEx(cursor, path, pathLength);
+        assert(result.Record == expected.Record && result.SearchWasTruncated == expected.SearchWasTruncated);
+    }
+#endif
+
+    return result;
+}
+
 PolicySearchCursor AccessHandler::FindManifestRecord(const char *absolutePath, size_t pathLength)
 {
     assert(absolutePath[0] == '/');
     const char *pathWithoutRootSentinel = absolutePath + 1;
 
     size_t len = pathLength == -1 ? strlen(pathWithoutRootSentinel) : pathLength;
-    return FindFileAccessPolicyInTreeEx(GetPip()->GetManifestRecord(), pathWithoutRootSentinel, len);
+
+    size_t parentLength = len;
+    while (parentLength > 0 && pathWithoutRootSentinel[parentLength - 1] != '/')
+    {
+        parentLength--;
+    }
+
+    if (parentLength <= 1 || parentLength > PATH_MAX)
+    {
+        return FindInManifest(GetPip()->GetManifestRecord(), pathWithoutRootSentinel, len);
+    }
+
+    // Searching from the cursor of the parent directory is equivalent to searching from the root
+    // (see PolicySearchCursor), and only looks up the final component of the path.
+    parentLength--;
+    PolicySearchCursor parentCursor = FindDirectoryRecord(pathWithoutRootSentinel, parentLength);
+
+    const char *finalComponent = pathWithoutRootSentinel + parentLength + 1;
+    return FindInManifest(parentCursor, finalComponent, len - parentLength - 1);
+}
+
+PolicySearchCursor AccessHandler::FindDirectoryRecord(const char *pathWithoutRootSentinel, size_t length)
+{
+    assert(length < PATH_MAX);
+
+    PolicyCursorCache *cache = GetPip()->GetPolicyCursorCache();
+    PolicySearchCursor cursor;
+    if (!cache->TryGet(pathWithoutRootSentinel, length, &cursor))
+    {
+        char directoryPath[PATH_MAX];
+        memcpy(directoryPath, pathWithoutRootSentinel, length);
+        directoryPath[length] = '\0';
+        cursor = FindInManifest(GetPip()->GetManifestRecord(), directoryPath, length);
+        cache->Insert(pathWithoutRootSentinel, length, cursor);
+    }
+
+    return cursor;
+}
+
+void AccessHandler::FindManifestRecords(const char * const *absolutePaths, size_t count, PolicySearchCursor *cursors)
+{
+    // the paths of a rename or a link (the common case) are ordered without allocating
+    size_t stackOrder[2];
+    std::vector<size_t> heapOrder;
+    size_t *order = stackOrder;
+    if (count > sizeof(stackOrder) / sizeof(stackOrder[0]))
+    {
+        heapOrder.resize(count);
+        order = heapOrder.data();
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        order[i] = i;
+    }
+
+    std::sort(order, order + count, [absolutePaths](size_t a, size_t b) { return strcmp(absolutePaths[a], absolutePaths[b]) < 0; });
+
+    // the parent directory of the previous path (its first 'directoryLength' characters) and its cursor
+    const char *directory = nullptr;
+    size_t directoryLength = 0;
+    PolicySearchCursor directoryCursor;
+
+    for (size_t k = 0; k < count; k++)
+    {
+        size_t i = order[k];
+        assert(absolutePaths[i][0] == '/');
+        const char *pathWithoutRootSentinel = absolutePaths[i] + 1;
+        size_t len = strlen(pathWithoutRootSentinel);
+
+        // same split as in 'FindManifestRecord', which also takes care of the paths that have no parent directory
+        // to search from and of those that are too long to be split
+        size_t parentLength = len;
+        while (parentLength > 0 && pathWithoutRootSentinel[parentLength - 1] != '/')
+        {
+            parentLength--;
+        }
+
+        if (parentLength <= 1 || parentLength > PATH_MAX)
+        {
+            cursors[i] = FindManifestRecord(absolutePaths[i], len);
+            continue;
+        }
+
+        parentLength--;
+        if (directory == nullptr || directoryLength != parentLength || memcmp(directory, pathWithoutRootSentinel, parentLength) != 0)
+        {
+            directory       = pathWithoutRootSentinel;
+            directoryLength = parentLength;
+            directoryCursor = FindDirectoryRecord(pathWithoutRootSentinel, parentLength);
+        }
+
+        const char *finalComponent = pathWithoutRootSentinel + parentLength + 1;
+        cursors[i] = FindInManifest(directoryCursor, finalComponent, len - parentLength - 1);
+
+#if DEBUG || _DEBUG
+        PolicySearchCursor expected = FindManifestRecord(absolutePaths[i]);
+        assert(cursors[i].Record == expected.Record && cursors[i].SearchWasTruncated == expected.SearchWasTruncated);
+#endif
+    }
 }
 
 void AccessHandler::SetProcessPath(AccessReport *report)
@@ -48,6 +171,10 @@ ReportResult AccessHandler::ReportFileOpAccess(FileOperation operation,
         .stats              = {0}
     };
 
+#if __linux__
+    report.pathId = policyResult.GetExactPathId();
+#endif
+
     assert(strlen(policyResult.Path()) > 0);
     strlcpy(report.path, policyResult.Path(), sizeof(report.path));
     sandbox_->SendAccessReport(report, GetPip());
@@ -134,6 +261,26 @@ PolicyResult AccessHandler::PolicyForPath(const char *absolutePath)
     return PolicyResult(GetPip()->GetFamFlags(), absolutePath, cursor);
 }
 
+std::vector<PolicyResult> AccessHandler::PolicyForPaths(const char * const *absolutePaths, size_t count)
+{
+    std::vector<PolicySearchCursor> cursors(count);
+    FindManifestRecords(absolutePaths, count, cursors.data());
+
+    std::vector<PolicyResult> policies;
+    policies.reserve(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!cursors[i].IsValid())
+        {
+            log_error("Invalid policy cursor for path '%s'", absolutePaths[i]);
+        }
+
+        policies.push_back(PolicyResult(GetPip()->GetFamFlags(), absolutePaths[i], cursors[i]));
+    }
+
+    return policies;
+}
+
 static bool is_prefix(const char *s1, const char *s2)
 {
     int c;
@@ -165,7 +312,15 @@ AccessCheckResult AccessHandler::CheckAndReportInternal(FileOperation operation,
                                                         const pid_t pid,
                                                         bool isDir)
 {
-    PolicyResult policy = PolicyForPath(IgnoreDataPartitionPrefix(path));
+    return CheckAndReportInternal(operation, checker, pid, isDir, PolicyForPath(IgnoreDataPartitionPrefix(path)));
+}
+
+AccessCheckResult AccessHandler::CheckAndReportInternal(FileOperation operation,
+                                                        CheckFunc checker,
+                                                        const pid_t pid,
+                                                        bool isDir,
+                                                        const PolicyResult &policy)
+{
     AccessCheckResult result = AccessCheckResult::Invalid();
     checker(policy, isDir, &result);
         
@@ -178,3 +333,15 @@ AccessCheckResult AccessHandler::CheckAndReportInternal(FileOperation operation,
     
     return result;
 }
+
+AccessCheckResult AccessHandler::CheckAndReport(FileOperation sourceOperation, const char *sourcePath, CheckFunc sourceChecker,
+                                                FileOperation destinationOperation, const char *destinationPath, CheckFunc destinationChecker,
+                                                const pid_t pid)
+{
+    const char *paths[] = { IgnoreDataPartitionPrefix(sourcePath), IgnoreDataPartitionPrefix(destinationPath) };
+    std::vector<PolicyResult> policies = PolicyForPaths(paths, 2);
+
+    return AccessCheckResult::Combine(
+        CheckAndReportInternal(sourceOperation, sourceChecker, pid, /*isDir*/ false, policies[0]),
+        CheckAndReportInternal(destinationOperation, destinationChecker, pid, /*isDir*/ false, policies[1]));
+}
@@ -8,6 +8,8 @@
 #include "Checkers.hpp"
 #include "IOEvent.hpp"
 
+#include <vector>
+
 enum ReportResult
 {
     kReported,
@@ -42,6 +44,25 @@ protected:
     inline const std::shared_ptr<SandboxedPip> GetPip()         const { return process_->GetPip(); }
 
     PolicySearchCursor FindManifestRecord(const char *absolutePath, size_t pathLength = -1);
+
+    /*!
+     * Resumes a search of the FAM from 'cursor', through the pip's compiled policy index when there is one.
+     */
+    PolicySearchCursor FindInManifest(const PolicySearchCursor &cursor, const char *path, size_t pathLength);
+
+    /*!
+     * Returns the cursor of the directory made of the first 'length' characters of 'pathWithoutRootSentinel'
+     * (from the pip's PolicyCursorCache when it is there; the cursor is added to the cache otherwise).
+     */
+    PolicySearchCursor FindDirectoryRecord(const char *pathWithoutRootSentinel, size_t length);
+
+    /*!
+     * Same as calling 'FindManifestRecord' on each of the 'count' absolute paths of 'absolutePaths' (the cursor of
+     * 'absolutePaths[i]' is stored into 'cursors[i]'), except that a parent directory shared by several of the paths
+     * is looked up only once: the paths are visited in sorted order, so that the paths of a directory are next to
+     * each other, and each of them is searched from the cursor of its parent directory.
+     */
+    void FindManifestRecords(const char * const *absolutePaths, size_t count, PolicySearchCursor *cursors);
     
     /*!
      * Copies 'process_->getPath()' into 'report->path'.
@@ -65,6 +86,15 @@ protected:
                                      const pid_t pid,
                                      bool isDir);
 
+    /*!
+     * Same as above, with the policy of the path already looked up (the policy carries the path).
+     */
+    AccessCheckResult CheckAndReportInternal(FileOperation operation,
+                                     CheckFunc checker,
+                                     const pid_t pid,
+                                     bool isDir,
+                                     const PolicyResult &policy);
+
     inline AccessCheckResult CheckAndReport(FileOperation operation, const char *path, CheckFunc checker, const pid_t pid)
     {
         return CheckAndReportInternal(operation, path, checker, pid, false);
@@ -75,6 +105,14 @@ protected:
         return CheckAndReportInternal(operation, path, checker, pid, isDir);
     }
 
+    /*!
+     * Checks and reports an operation on two paths (e.g., the source and the destination of a rename), whose
+     * policies are looked up together (see 'PolicyForPaths'), and combines the results.
+     */
+    AccessCheckResult CheckAndReport(FileOperation sourceOperation, const char *sourcePath, CheckFunc sourceChecker,
+                                     FileOperation destinationOperation, const char *destinationPath, CheckFunc destinationChecker,
+                                     const pid_t pid);
+
 public:
     
     AccessHandler() = delete;
@@ -113,6 +151,12 @@ public:
 
     PolicyResult PolicyForPath(const char *absolutePath);
 
+    /*!
+     * Policies of the 'count' absolute paths of 'absolutePaths' (in the same order), which are the same as
+     * 'PolicyForPath' would return for each of them; the directories the paths have in common are looked up once.
+     */
+    std::vector<PolicyResult> PolicyForPaths(const char * const *absolutePaths, size_t count);
+
     bool ReportProcessTreeCompleted(pid_t processId);
     bool ReportProcessExited(pid_t childPid);
     bool ReportChildProcessSpawned(pid_t childPid);
@@ -9,10 +9,14 @@ static AccessCheckResult s_allowedCheckResult(RequestedAccess::None, ResultActio
 
 AccessCheckResult IOHandler::HandleProcessFork(const IOEvent &event)
 {
+#if __APPLE__
+    // which child processes break away is not known here, so none of them is tracked (on Linux, a child process is
+    // tracked until it execs a program that breaks away, see BxlObserver::IsBreakawayProcess)
     if (GetPip()->AllowChildProcessesToBreakAway())
     {
         return s_allowedCheckResult;
     }
+#endif
 
     pid_t childProcessPid = event.GetChildPid();
     if (GetSandbox()->TrackChildProcess(childProcessPid, event.GetExecutablePath(), GetProcess()))
@@ -86,9 +90,9 @@ AccessCheckResult IOHandler::HandleClose(const IOEvent &event)
 
 AccessCheckResult IOHandler::HandleLink(const IOEvent &event)
 {
-    return AccessCheckResult::Combine(
-        CheckAndReport(kOpKAuthCreateHardlinkSource, event.GetEventPath(SRC_PATH), Checkers::CheckRead, event.GetPid()),
-        CheckAndReport(kOpKAuthCreateHardlinkDest, event.GetEventPath(DST_PATH), Checkers::CheckWrite, event.GetPid()));
+    return CheckAndReport(kOpKAuthCreateHardlinkSource, event.GetEventPath(SRC_PATH), Checkers::CheckRead,
+                          kOpKAuthCreateHardlinkDest, event.GetEventPath(DST_PATH), Checkers::CheckWrite,
+                          event.GetPid());
 }
 
 AccessCheckResult IOHandler::HandleUnlink(const IOEvent &event)
@@ -105,23 +109,23 @@ AccessCheckResult IOHandler::HandleReadlink(const IOEvent &event)
 
 AccessCheckResult IOHandler::HandleRename(const IOEvent &event)
 {
-    return AccessCheckResult::Combine(
-        CheckAndReport(kOpKAuthMoveSource, event.GetEventPath(SRC_PATH), Checkers::CheckRead, event.GetPid()),
-        CheckAndReport(kOpKAuthMoveDest, event.GetEventPath(DST_PATH), Checkers::CheckWrite, event.GetPid()));
+    return CheckAndReport(kOpKAuthMoveSource, event.GetEventPath(SRC_PATH), Checkers::CheckRead,
+                          kOpKAuthMoveDest, event.GetEventPath(DST_PATH), Checkers::CheckWrite,
+                          event.GetPid());
 }
 
 AccessCheckResult IOHandler::HandleClone(const IOEvent &event)
 {
-    return AccessCheckResult::Combine(
-        CheckAndReport(kOpMacVNodeCloneSource, event.GetEventPath(SRC_PATH), Checkers::CheckReadWrite, event.GetPid()),
-        CheckAndReport(kOpMacVNodeCloneDest, event.GetEventPath(DST_PATH), Checkers::CheckReadWrite, event.GetPid()));
+    return CheckAndReport(kOpMacVNodeCloneSource, event.GetEventPath(SRC_PATH), Checkers::CheckReadWrite,
+                          kOpMacVNodeCloneDest, event.GetEventPath(DST_PATH), Checkers::CheckReadWrite,
+                          event.GetPid());
 }
 
 AccessCheckResult IOHandler::HandleExchange(const IOEvent &event)
 {
-    return AccessCheckResult::Combine(
-        CheckAndReport(kOpKAuthCopySource, event.GetEventPath(SRC_PATH), Checkers::CheckReadWrite, event.GetPid()),
-        CheckAndReport(kOpKAuthCopyDest, event.GetEventPath(DST_PATH), Checkers::CheckReadWrite, event.GetPid()));
+    return CheckAndReport(kOpKAuthCopySource, event.GetEventPath(SRC_PATH), Checkers::CheckReadWrite,
+                          kOpKAuthCopyDest, event.GetEventPath(DST_PATH), Checkers::CheckReadWrite,
+                          event.GetPid());
 }
 
 AccessCheckResult IOHandler::HandleCreate(const IOEvent &event)
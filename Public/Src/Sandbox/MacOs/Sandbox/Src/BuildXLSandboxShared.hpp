@@ -282,6 +282,12 @@ typedef struct {
     char path[MAXPATHLEN];
 #endif
     AccessReportStatistics stats;
+#if __linux__
+    // Id of the manifest record matching 'path' exactly (see PolicyResult::GetExactPathId), or 0.  Only the Linux
+    // sandbox has it: it reaches the host in the Linux report record (see Linux/ReportFormat.hpp), whereas the rest
+    // of this struct is what the kext and the EndpointSecurity sandbox share with the managed AccessReport.
+    uint32_t pathId = 0;
+#endif
 } AccessReport;
 
 inline bool HasAnyFlags(const int source, const int bitMask)
@@ -89,32 +89,55 @@ const char *CheckValidUnixManifestTreeRoot(PCManifestRecord node)
 
 bool FileAccessManifestParseResult::init(const BYTE *payload, size_t payloadSize)
 {
+    version_                             = 1;
+    numChildProcessesToBreakAwayFromJob_ = 0;
+    childProcessesToBreakAwayFromJob_    = nullptr;
+    numTranslatePaths_                   = 0;
+    translatePaths_                      = nullptr;
+    flags_                               = FileAccessManifestFlag::None;
+    pipId_                               = 0;
+    reportPath_                          = nullptr;
+    reportPathLength_                    = 0;
+    root_                                = nullptr;
+    policyTree_                          = {};
+    error_                               = nullptr;
+
     if (payloadSize == 0 || payload == nullptr) return true;
 
+    return payloadSize >= sizeof(uint32_t) && *(const uint32_t *)payload == FAM_V2_MAGIC
+        ? initV2(payload, payloadSize)
+        : initV1(payload);
+}
+
+bool FileAccessManifestParseResult::initV1(const BYTE *payload)
+{
     const BYTE *payloadCursor = payload;
 
     do
     {
-        debugFlag_ = ParseAndAdvancePointer<PCManifestDebugFlag>(payloadCursor);
+        ParseAndAdvancePointer<PCManifestDebugFlag>(payloadCursor);
         if (HasErrors()) continue;
 
-        injectionTimeoutFlag_ = ParseAndAdvancePointer<PCManifestInjectionTimeout>(payloadCursor);
+        ParseAndAdvancePointer<PCManifestInjectionTimeout>(payloadCursor);
         if (HasErrors()) continue;
 
-        // For now we just skip the list of processes to breakaway. TODO: a future implementation may consider these
-        // to determine whether to skip reporting accesses for them
-        manifestChildProcessesToBreakAwayFromJob_ = ParseAndAdvancePointer<PManifestChildProcessesToBreakAwayFromJob>(payloadCursor);
+        // the names of the processes to breakaway are matched where they are (see IsChildProcessToBreakAway)
+        PManifestChildProcessesToBreakAwayFromJob manifestChildProcessesToBreakAwayFromJob = ParseAndAdvancePointer<PManifestChildProcessesToBreakAwayFromJob>(payloadCursor);
         if (HasErrors()) continue;
 
-        for (uint32_t i = 0; i < manifestChildProcessesToBreakAwayFromJob_->Count ; i++)
+        numChildProcessesToBreakAwayFromJob_ = manifestChildProcessesToBreakAwayFromJob->Count;
+        childProcessesToBreakAwayFromJob_    = payloadCursor;
+        for (uint32_t i = 0; i < numChildProcessesToBreakAwayFromJob_; i++)
         {
             SkipOverCharArray(payloadCursor); // process name
         }
 
-        manifestTranslatePathsStrings_ = ParseAndAdvancePointer<PManifestTranslatePathsStrings>(payloadCursor);
+        PManifestTranslatePathsStrings manifestTranslatePathsStrings = ParseAndAdvancePointer<PManifestTranslatePathsStrings>(payloadCursor);
         if (HasErrors()) continue;
 
-        for (uint32_t i = 0; i < manifestTranslatePathsStrings_->Count; i++)
+        numTranslatePaths_ = manifestTranslatePathsStrings->Count;
+        translatePaths_    = payloadCursor;
+        for (uint32_t i = 0; i < numTranslatePaths_; i++)
         {
             SkipOverCharArray(payloadCursor); // 'from' path
             SkipOverCharArray(payloadCursor); // 'to' path
@@ -125,22 +148,29 @@ bool FileAccessManifestParseResult::init(const BYTE *payload, size_t payloadSize
 
         SkipOverCharArray(payloadCursor); // error log path
 
-        flags_ = ParseAndAdvancePointer<PCManifestFlags>(payloadCursor);
+        PCManifestFlags flags = ParseAndAdvancePointer<PCManifestFlags>(payloadCursor);
         if (HasErrors()) continue;
 
-        extraFlags_ = ParseAndAdvancePointer<PCManifestExtraFlags>(payloadCursor);
+        flags_ = static_cast<FileAccessManifestFlag>(flags->Flags);
+
+        ParseAndAdvancePointer<PCManifestExtraFlags>(payloadCursor);
         if (HasErrors()) continue;
 
-        pipId_ = ParseAndAdvancePointer<PCManifestPipId>(payloadCursor);
+        PCManifestPipId pipId = ParseAndAdvancePointer<PCManifestPipId>(payloadCursor);
         if (HasErrors()) continue;
 
-        report_ = ParseAndAdvancePointer<PCManifestReport>(payloadCursor);
+        pipId_ = pipId->PipId;
+
+        PCManifestReport report = ParseAndAdvancePointer<PCManifestReport>(payloadCursor);
         if (HasErrors()) continue;
 
-        dllBlock_ = ParseAndAdvancePointer<PCManifestDllBlock>(payloadCursor);
+        reportPath_       = report->Report.ReportPath;
+        reportPathLength_ = report->Size;
+
+        ParseAndAdvancePointer<PCManifestDllBlock>(payloadCursor);
         if (HasErrors()) continue;
 
-        shim_ = ParseAndAdvancePointer<PCManifestSubstituteProcessExecutionShim>(payloadCursor);
+        ParseAndAdvancePointer<PCManifestSubstituteProcessExecutionShim>(payloadCursor);
         if (HasErrors()) continue;
         uint32_t shimPathLength = SkipOverCharArray(payloadCursor);  // SubstituteProcessExecutionShimPath
         if (shimPathLength > 0)
@@ -165,6 +195,287 @@ bool FileAccessManifestParseResult::init(const BYTE *payload, size_t payloadSize
     return !HasErrors();
 }
 
+static inline const ManifestV2Section& GetSection(const ManifestV2Header *header, ManifestV2SectionKind kind)
+{
+    return header->Sections[static_cast<uint32_t>(kind)];
+}
+
+// Only the header and the bounds of the sections are validated: the contents of the sections (e.g., the offsets of
+// the nodes) are trusted, the same way the offsets of the records of a v1 manifest are.
+bool FileAccessManifestParseResult::initV2(const BYTE *payload, size_t payloadSize)
+{
+#if __linux__
+    const ManifestV2Header *header = reinterpret_cast<const ManifestV2Header *>(payload);
+    const uint32_t numSections = static_cast<uint32_t>(ManifestV2SectionKind::NumSections);
+
+    do
+    {
+        if (payloadSize < offsetof(ManifestV2Header, Sections))
+        {
+            error_ = "The manifest header is truncated";
+            continue;
+        }
+
+        if (header->Version != FAM_V2_VERSION)
+        {
+            error_ = "Unsupported manifest version";
+            continue;
+        }
+
+        error_ = header->DebugFlag.CheckValid();
+        if (HasErrors()) continue;
+
+        // sections a newer version may append to the table are ignored
+        if (header->NumSections < numSections ||
+            offsetof(ManifestV2Header, Sections) + numSections * sizeof(ManifestV2Section) > payloadSize)
+        {
+            error_ = "The manifest section table is truncated";
+            continue;
+        }
+
+        for (uint32_t i = 0; i < numSections && !HasErrors(); i++)
+        {
+            const ManifestV2Section &section = header->Sections[i];
+            if (section.Offset % 8 != 0 || section.Offset > payloadSize || section.Size > payloadSize - section.Offset)
+            {
+                error_ = "A manifest section is misaligned or out of bounds";
+            }
+        }
+
+        if (HasErrors()) continue;
+
+        const ManifestV2Section &globalsSection = GetSection(header, ManifestV2SectionKind::Globals);
+        const ManifestV2Section &stringsSection = GetSection(header, ManifestV2SectionKind::Strings);
+        const ManifestV2Section &nodesSection   = GetSection(header, ManifestV2SectionKind::PolicyNodes);
+        const ManifestV2Section &slotsSection   = GetSection(header, ManifestV2SectionKind::PolicySlots);
+        const ManifestV2Section &recordsSection = GetSection(header, ManifestV2SectionKind::PolicyRecords);
+
+        if (globalsSection.Size < sizeof(ManifestV2Globals))
+        {
+            error_ = "The manifest globals are truncated";
+            continue;
+        }
+
+        const char *strings = reinterpret_cast<const char *>(payload + stringsSection.Offset);
+        if (stringsSection.Size == 0 || strings[stringsSection.Size - 1] != 0)
+        {
+            error_ = "The manifest strings are not null-terminated";
+            continue;
+        }
+
+        if (GetSection(header, ManifestV2SectionKind::BreakawayProcesses).Size % sizeof(uint32_t) != 0 ||
+            GetSection(header, ManifestV2SectionKind::TranslatePaths).Size % (2 * sizeof(uint32_t)) != 0 ||
+            slotsSection.Size % sizeof(uint32_t) != 0 ||
+            nodesSection.Size % sizeof(ManifestV2Node) != 0 ||
+            nodesSection.Size == 0)
+        {
+            error_ = "A manifest section has the wrong size";
+            continue;
+        }
+
+        uint32_t numNodes = nodesSection.Size / sizeof(ManifestV2Node);
+        if (recordsSection.Size != (size_t)numNodes * sizeof(ManifestRecord))
+        {
+            error_ = "The manifest must have a policy record per policy node";
+            continue;
+        }
+
+        const ManifestV2Globals *globals = reinterpret_cast<const ManifestV2Globals *>(payload + globalsSection.Offset);
+        if (globals->ReportPathOffset >= stringsSection.Size || globals->ReportPathLength >= stringsSection.Size - globals->ReportPathOffset)
+        {
+            error_ = "The manifest report path is out of bounds";
+            continue;
+        }
+
+        const ManifestV2Section &breakawaySection = GetSection(header, ManifestV2SectionKind::BreakawayProcesses);
+        const uint32_t *breakawayOffsets = reinterpret_cast<const uint32_t *>(payload + breakawaySection.Offset);
+        for (uint32_t i = 0; i < breakawaySection.Size / sizeof(uint32_t) && !HasErrors(); i++)
+        {
+            if (breakawayOffsets[i] >= stringsSection.Size)
+            {
+                error_ = "The name of a process to breakaway is out of bounds";
+            }
+        }
+
+        if (HasErrors()) continue;
+
+        const ManifestV2Section &translateSection = GetSection(header, ManifestV2SectionKind::TranslatePaths);
+        const uint32_t *translateOffsets = reinterpret_cast<const uint32_t *>(payload + translateSection.Offset);
+        for (uint32_t i = 0; i < translateSection.Size / sizeof(uint32_t) && !HasErrors(); i++)
+        {
+            if (translateOffsets[i] >= stringsSection.Size)
+            {
+                error_ = "A path to translate is out of bounds";
+            }
+        }
+
+        if (HasErrors()) continue;
+
+        version_                             = header->Version;
+        numChildProcessesToBreakAwayFromJob_ = breakawaySection.Size / sizeof(uint32_t);
+        childProcessesToBreakAwayFromJob_    = reinterpret_cast<const BYTE *>(breakawayOffsets);
+        numTranslatePaths_                   = translateSection.Size / (2 * sizeof(uint32_t));
+        translatePaths_                      = reinterpret_cast<const BYTE *>(translateOffsets);
+        flags_                               = static_cast<FileAccessManifestFlag>(globals->Flags);
+        pipId_                               = globals->PipId;
+        reportPath_                          = strings + globals->ReportPathOffset;
+        reportPathLength_                    = globals->ReportPathLength;
+        root_                                = reinterpret_cast<PCManifestRecord>(payload + recordsSection.Offset);
+
+        policyTree_.Nodes       = reinterpret_cast<const ManifestV2Node *>(payload + nodesSection.Offset);
+        policyTree_.NumNodes    = numNodes;
+        policyTree_.Slots       = reinterpret_cast<const uint32_t *>(payload + slotsSection.Offset);
+        policyTree_.NumSlots    = slotsSection.Size / sizeof(uint32_t);
+        policyTree_.Records     = root_;
+        policyTree_.Strings     = strings;
+        policyTree_.StringsSize = stringsSection.Size;
+
+        error_ = root_->CheckValid();
+    } while(false);
+#else
+    error_ = "Manifests with the Linux-native layout are only supported on Linux";
+#endif
+
+    return !HasErrors();
+}
+
+// Whether the 'length' UTF-16 code units in 'chars' spell the null-terminated UTF-8 string 'str'
+static bool EqualsUtf16(const char16_t *chars, uint32_t length, const char *str)
+{
+    const unsigned char *cursor = reinterpret_cast<const unsigned char *>(str);
+    uint32_t i = 0;
+    while (*cursor != 0)
+    {
+        uint32_t codePoint;
+        int numContinuationBytes;
+        if      (*cursor < 0x80)  { codePoint = *cursor;        numContinuationBytes = 0; }
+        else if (*cursor >= 0xF0) { codePoint = *cursor & 0x07; numContinuationBytes = 3; }
+        else if (*cursor >= 0xE0) { codePoint = *cursor & 0x0F; numContinuationBytes = 2; }
+        else                      { codePoint = *cursor & 0x1F; numContinuationBytes = 1; }
+
+        for (cursor++; numContinuationBytes > 0; numContinuationBytes--, cursor++)
+        {
+            // also stops at the terminating null of a truncated sequence
+            if ((*cursor & 0xC0) != 0x80) return false;
+            codePoint = (codePoint << 6) | (*cursor & 0x3F);
+        }
+
+        if (codePoint >= 0x10000)
+        {
+            codePoint -= 0x10000;
+            if (length - i < 2 || chars[i] != 0xD800 + (codePoint >> 10) || chars[i + 1] != 0xDC00 + (codePoint & 0x3FF)) return false;
+            i += 2;
+        }
+        else
+        {
+            if (i == length || chars[i] != codePoint) return false;
+            i++;
+        }
+    }
+
+    return i == length;
+}
+
+// Copies the 'length' UTF-16 code units in 'chars' into 'buffer' (of 'size' bytes) as a null-terminated UTF-8 string;
+// returns false when it does not fit (an unpaired surrogate is copied as U+FFFD)
+static bool CopyAsUtf8(const char16_t *chars, uint32_t length, char *buffer, size_t size)
+{
+    size_t numWritten = 0;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        uint32_t codePoint = chars[i];
+        if (codePoint >= 0xD800 && codePoint < 0xE000)
+        {
+            bool isPair = codePoint < 0xDC00 && i + 1 < length && chars[i + 1] >= 0xDC00 && chars[i + 1] < 0xE000;
+            codePoint = isPair ? 0x10000 + ((codePoint - 0xD800) << 10) + (chars[++i] - 0xDC00) : 0xFFFD;
+        }
+
+        int numBytes = codePoint < 0x80 ? 1 : codePoint < 0x800 ? 2 : codePoint < 0x10000 ? 3 : 4;
+        if (size - numWritten <= (size_t)numBytes) return false;
+
+        switch (numBytes)
+        {
+            case 1:
+                buffer[numWritten++] = (char)codePoint;
+                break;
+            case 2:
+                buffer[numWritten++] = (char)(0xC0 | (codePoint >> 6));
+                buffer[numWritten++] = (char)(0x80 | (codePoint & 0x3F));
+                break;
+            case 3:
+                buffer[numWritten++] = (char)(0xE0 | (codePoint >> 12));
+                buffer[numWritten++] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+                buffer[numWritten++] = (char)(0x80 | (codePoint & 0x3F));
+                break;
+            default:
+                buffer[numWritten++] = (char)(0xF0 | (codePoint >> 18));
+                buffer[numWritten++] = (char)(0x80 | ((codePoint >> 12) & 0x3F));
+                buffer[numWritten++] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+                buffer[numWritten++] = (char)(0x80 | (codePoint & 0x3F));
+                break;
+        }
+    }
+
+    buffer[numWritten] = 0;
+    return true;
+}
+
+bool FileAccessManifestParseResult::GetTranslatePath(uint32_t index, char *from, char *to, size_t size) const
+{
+    if (index >= numTranslatePaths_ || size == 0)
+    {
+        return false;
+    }
+
+    if (version_ >= FAM_V2_VERSION)
+    {
+        const uint32_t *offsets = reinterpret_cast<const uint32_t *>(translatePaths_) + 2 * index;
+        const char *paths[] = { policyTree_.Strings + offsets[0], policyTree_.Strings + offsets[1] };
+        char *buffers[] = { from, to };
+        for (int i = 0; i < 2; i++)
+        {
+            size_t length = strlen(paths[i]);
+            if (length >= size) return false;
+            memcpy(buffers[i], paths[i], length + 1);
+        }
+
+        return true;
+    }
+
+    const BYTE *cursor = translatePaths_;
+    for (uint32_t i = 0; i < 2 * index; i++)
+    {
+        SkipOverCharArray(cursor);
+    }
+
+    const char16_t *fromChars = reinterpret_cast<const char16_t *>(cursor + sizeof(uint32_t));
+    uint32_t fromLength = SkipOverCharArray(cursor);
+    const char16_t *toChars = reinterpret_cast<const char16_t *>(cursor + sizeof(uint32_t));
+    uint32_t toLength = SkipOverCharArray(cursor);
+    return CopyAsUtf8(fromChars, fromLength, from, size) && CopyAsUtf8(toChars, toLength, to, size);
+}
+
+bool FileAccessManifestParseResult::IsChildProcessToBreakAway(const char *processName) const
+{
+    const BYTE *cursor = childProcessesToBreakAwayFromJob_;
+    for (uint32_t i = 0; i < numChildProcessesToBreakAwayFromJob_; i++)
+    {
+        if (version_ >= FAM_V2_VERSION)
+        {
+            uint32_t offset = reinterpret_cast<const uint32_t *>(childProcessesToBreakAwayFromJob_)[i];
+            if (strcmp(policyTree_.Strings + offset, processName) == 0) return true;
+        }
+        else
+        {
+            const char16_t *chars = reinterpret_cast<const char16_t *>(cursor + sizeof(uint32_t));
+            uint32_t length = SkipOverCharArray(cursor);
+            if (EqualsUtf16(chars, length, processName)) return true;
+        }
+    }
+
+    return false;
+}
+
 // Debugging helper
 void FileAccessManifestParseResult::PrintManifestTree(PCManifestRecord node,
                                                       const int indent,
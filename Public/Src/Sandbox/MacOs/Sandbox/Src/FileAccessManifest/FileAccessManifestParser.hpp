@@ -6,22 +6,98 @@
 
 #include "FileAccessHelpers.h"
 
+// -----------------------------------------------------------------------------
+// Linux-native layout (version 2) of a file access manifest
+//
+// CODESYNC: FileAccessManifest.cs (WriteLinuxNativeSections)
+//
+// A v2 manifest starts with a header (whose magic number is never the first word of a v1 manifest, i.e., a debug
+// flag) followed by a table with the offset and size of every section, so any section is reached without parsing
+// the ones before it.  All the sections are 8-byte aligned.  Strings are UTF-8, null-terminated, deduplicated, and
+// live in the Strings section (which starts with the empty string), where they are referred to by their offset.
+//
+// The policy tree is stored the way PolicyIndex lays it out in memory (which can then be used in place):
+//   - PolicyNodes:   the nodes in breadth-first order (the root, i.e., the unix root sentinel, first), each with
+//                    the hash of its partial path (see PolicyIndex::HashComponent) and where its children are,
+//   - PolicySlots:   the children of every node, in an open-addressed table whose size is a power of 2,
+//   - PolicyRecords: a record per node (in the same order), with the node's policies and no buckets.
+// -----------------------------------------------------------------------------
+
+#define FAM_V2_MAGIC    0x324D4146 // "FAM2"
+#define FAM_V2_VERSION  2
+
+enum class ManifestV2SectionKind : uint32_t
+{
+    Globals            = 0,
+    Strings            = 1,
+    BreakawayProcesses = 2, // offsets (into Strings) of process names
+    TranslatePaths     = 3, // pairs of offsets (into Strings) of 'from' and 'to' paths
+    PolicyNodes        = 4,
+    PolicySlots        = 5,
+    PolicyRecords      = 6,
+    NumSections        = 7
+};
+
+struct ManifestV2Section
+{
+    uint32_t Offset;
+    uint32_t Size;
+};
+
+struct ManifestV2Header
+{
+    uint32_t Magic;
+    uint32_t Version;
+    ManifestDebugFlag DebugFlag;
+    uint32_t NumSections;
+    ManifestV2Section Sections[ANYSIZE_ARRAY];
+};
+
+struct ManifestV2Globals
+{
+    uint32_t Flags;
+    uint32_t ExtraFlags;
+    uint64_t PipId;
+    uint32_t ReportPathOffset;
+    uint32_t ReportPathLength;
+};
+
+struct ManifestV2Node
+{
+    uint32_t Hash;
+    uint32_t PathOffset; // into Strings
+    uint32_t FirstSlot;
+    uint32_t NumSlots;   // 0 for a leaf
+};
+
+/*! The policy tree of a v2 manifest */
+struct ManifestV2PolicyTree
+{
+    const ManifestV2Node *Nodes;
+    uint32_t NumNodes;
+    const uint32_t *Slots;
+    uint32_t NumSlots;
+    PCManifestRecord Records;
+    const char *Strings;
+    uint32_t StringsSize;
+};
+
 struct FileAccessManifestParseResult
 {
 
 private:
 
-    PCManifestDebugFlag debugFlag_;
-    PCManifestInjectionTimeout injectionTimeoutFlag_;
-    PManifestChildProcessesToBreakAwayFromJob manifestChildProcessesToBreakAwayFromJob_;
-    PManifestTranslatePathsStrings manifestTranslatePathsStrings_;
-    PCManifestFlags flags_;
-    PCManifestExtraFlags extraFlags_;
-    PCManifestPipId pipId_;
-    PCManifestReport report_;
-    PCManifestDllBlock dllBlock_;
-    PCManifestSubstituteProcessExecutionShim shim_;
+    uint32_t version_;
+    uint32_t numChildProcessesToBreakAwayFromJob_;
+    const BYTE *childProcessesToBreakAwayFromJob_; // v1: the names (as char arrays); v2: the offsets of the names
+    uint32_t numTranslatePaths_;
+    const BYTE *translatePaths_;                   // v1: the 'from' and 'to' paths (as char arrays); v2: their offsets
+    FileAccessManifestFlag flags_;
+    uint64_t pipId_;
+    const char *reportPath_;
+    int reportPathLength_;
     PCManifestRecord root_;
+    ManifestV2PolicyTree policyTree_;
     const char *error_;
 
     template <class T> T Parse(const BYTE *&payload)
@@ -38,6 +114,9 @@ private:
         return result;
     }
 
+    bool initV1(const BYTE *payload);
+    bool initV2(const BYTE *payload, size_t payloadSize);
+
 public:
 
     FileAccessManifestParseResult() {}
@@ -47,15 +126,36 @@ public:
     inline bool IsValid() const                         { return error_ == nullptr; }
     inline bool HasErrors() const                       { return !IsValid(); }
     inline const char* Error() const                    { return error_; }
+
+    /*! Version of the layout of the manifest: 1 (the layout shared with Windows) or 2 (FAM_V2_VERSION) */
+    inline uint32_t GetVersion() const                  { return version_; }
+
+    // The root of a v2 manifest is the unix root sentinel
     inline PCManifestRecord GetManifestRootNode() const { return root_; }
-    inline PCManifestRecord GetUnixRootNode() const     { return root_->BucketCount > 0 ? root_->GetChildRecord(0) : root_; }
-    inline PCManifestPipId GetPipId() const             { return pipId_; }
-    inline FileAccessManifestFlag GetFamFlags() const   { return static_cast<FileAccessManifestFlag>(flags_->Flags); }
-    inline bool AllowChildProcessesToBreakAway() const  { return manifestChildProcessesToBreakAwayFromJob_->Count > 0; }
+    inline PCManifestRecord GetUnixRootNode() const     { return version_ >= FAM_V2_VERSION || root_->BucketCount == 0 ? root_ : root_->GetChildRecord(0); }
+
+    /*! The policy tree of a v2 manifest, or nullptr for a v1 manifest (whose tree is made of linked records) */
+    inline const ManifestV2PolicyTree* GetPolicyTree() const { return version_ >= FAM_V2_VERSION ? &policyTree_ : nullptr; }
+
+    inline uint64_t GetPipId() const                    { return pipId_; }
+    inline FileAccessManifestFlag GetFamFlags() const   { return flags_; }
+    inline bool AllowChildProcessesToBreakAway() const  { return numChildProcessesToBreakAwayFromJob_ > 0; }
+
+    /*! Whether 'processName' (the UTF-8 file name of a program) names one of the child processes that break away from the sandbox */
+    bool IsChildProcessToBreakAway(const char *processName) const;
+
+    /*! Number of directory translations, i.e., pairs of a 'from' and a 'to' path (see DirectoryTranslator.cs) */
+    inline uint32_t GetNumTranslatePaths() const        { return numTranslatePaths_; }
+
+    /*!
+     * Copies the 'from' and 'to' paths of the directory translation at 'index' (as null-terminated UTF-8 strings) into 'from'
+     * and 'to', which are 'size' bytes each; returns false when either path does not fit.
+     */
+    bool GetTranslatePath(uint32_t index, char *from, char *to, size_t size) const;
     inline const char* GetReportsPath(int *length) const
     {
-        *length = report_->Size;
-        return report_->Report.ReportPath;
+        *length = reportPathLength_;
+        return reportPath_;
     }
     inline const char* GetProcessPath(int *length) const { return GetReportsPath(length); }
 
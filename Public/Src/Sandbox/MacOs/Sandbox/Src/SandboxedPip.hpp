@@ -96,7 +96,7 @@ public:
     pid_t getProcessId() const { return processId_; }
 
     /*! A unique identifier of this pip. */
-    pipid_t getPipId() const   { return fam_.GetPipId()->PipId; }
+    pipid_t getPipId() const   { return fam_.GetPipId(); }
 
     /*! File access manifest record for this pip (to be used for checking file accesses) */
     PCManifestRecord getManifestRecord() const    { return fam_.GetUnixRootNode(); }
@@ -172,6 +172,8 @@ public:
     bool IndicateUntracked() const { return ((m_policy & FileAccessPolicy_AllowAll) == FileAccessPolicy_AllowAll) && ((m_policy & FileAccessPolicy_ReportAccess) == 0); }
     bool TreatDirectorySymlinkAsDirectory() const { return (m_policy & FileAccessPolicy_TreatDirectorySymlinkAsDirectory) != 0; }
     DWORD GetPathId() const { return m_policySearchCursor.IsValid() ? m_policySearchCursor.Record->GetPathId() : 0; }
+    // Path id of the manifest record for exactly this path; 0 if the search stopped at an ancestor (or the cursor is invalid).
+    DWORD GetExactPathId() const { return m_policySearchCursor.SearchWasTruncated ? 0 : GetPathId(); }
     FileAccessPolicy GetPolicy() const { return m_policy; }
     USN GetExpectedUsn() const { return m_policySearchCursor.GetExpectedUsn(); }
     // Indicates if this policy is invalid (iff Initialize did not complete successfully or has not been called).
@@ -13,6 +13,11 @@ namespace BuildXL.Interop
         /// </summary>
         public const string BuildXLInteropLibMacOS = "libBuildXLInterop";
 
+        /// <summary>
+        /// BuildXL host-side library for the Linux sandbox
+        /// </summary>
+        public const string BuildXLHostLibLinux = "libBxlHost";
+
         /// <summary>
         /// Standard C Library
         /// </summary>
@@ -0,0 +1,66 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+using System;
+using System.Runtime.InteropServices;
+
+namespace BuildXL.Interop.Unix
+{
+    /// <summary>
+    /// Interop calls into the host side of the shared memory access dedup table of the Linux sandbox
+    /// (see Public/Src/Sandbox/Linux/AccessDedupTable.hpp).
+    /// </summary>
+    /// <remarks>
+    /// A table is created by the host for each pip; all the processes of the pip's process tree
+    /// map it and consult it to avoid sending access reports that would not tell the host anything new.
+    /// </remarks>
+    public static class AccessDedupTable
+    {
+        /// <summary>
+        /// Counters of a table
+        /// </summary>
+        public struct Counters
+        {
+            /// <summary>Number of reports that were not sent because their accesses had already been reported</summary>
+            public ulong Hits;
+
+            /// <summary>Number of reports that were sent because not all of their accesses had been reported</summary>
+            public ulong Misses;
+
+            /// <summary>Number of sent reports whose accesses could not be recorded because the table was full</summary>
+            public ulong Overflows;
+
+            /// <summary>Number of distinct paths in the table</summary>
+            public ulong NumEntries;
+
+            /// <inheritdoc />
+            public override string ToString() => $"hits: {Hits}, misses: {Misses}, overflows: {Overflows}, entries: {NumEntries}";
+        }
+
+        /// <summary>
+        /// Creates a table backed by a new file at <paramref name="path"/> (typically in /dev/shm)
+        /// with <paramref name="capacity"/> slots (must be a power of 2; 0 means default).
+        /// Returns <see cref="IntPtr.Zero"/> on error.
+        /// </summary>
+        [DllImport(Libraries.BuildXLHostLibLinux, SetLastError = true, EntryPoint = "BxlAccessDedupTable_Create")]
+        public static extern IntPtr Create([MarshalAs(UnmanagedType.LPStr)] string path, ulong capacity);
+
+        /// <summary>
+        /// Returns the counters of the table (summed up over all the processes that have used it).
+        /// </summary>
+        public static Counters GetCounters(IntPtr table)
+        {
+            GetCounters(table, out var hits, out var misses, out var overflows, out var numEntries);
+            return new Counters { Hits = hits, Misses = misses, Overflows = overflows, NumEntries = numEntries };
+        }
+
+        [DllImport(Libraries.BuildXLHostLibLinux, EntryPoint = "BxlAccessDedupTable_GetCounters")]
+        private static extern void GetCounters(IntPtr table, out ulong hits, out ulong misses, out ulong overflows, out ulong numEntries);
+
+        /// <summary>
+        /// Unmaps the table (the backing file is not deleted).
+        /// </summary>
+        [DllImport(Libraries.BuildXLHostLibLinux, EntryPoint = "BxlAccessDedupTable_Dispose")]
+        public static extern void Dispose(IntPtr table);
+    }
+}
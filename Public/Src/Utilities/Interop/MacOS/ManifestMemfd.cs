@@ -0,0 +1,32 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+using System.Runtime.InteropServices;
+
+namespace BuildXL.Interop.Unix
+{
+    /// <summary>
+    /// Interop calls into the host side of the memfds that file access manifests are shared through with the
+    /// processes of the Linux sandbox (see Public/Src/Sandbox/Linux/Host/ManifestMemfdInterop.cpp).
+    /// </summary>
+    /// <remarks>
+    /// A memfd is created by the host for each pip and kept open until the pip is done; every process of the pip
+    /// opens it through /proc/&lt;host pid&gt;/fd/&lt;memfd&gt; and maps it, instead of reading and copying the
+    /// manifest's file (which the processes still fall back to).
+    /// </remarks>
+    public static class ManifestMemfd
+    {
+        /// <summary>
+        /// Creates a memfd named <paramref name="name"/> holding the first <paramref name="length"/> bytes of
+        /// <paramref name="payload"/>, sealed against any further change.  Returns the descriptor, or -1 on error.
+        /// </summary>
+        [DllImport(Libraries.BuildXLHostLibLinux, SetLastError = true, EntryPoint = "BxlManifestMemfd_Create")]
+        public static extern int Create([MarshalAs(UnmanagedType.LPStr)] string name, byte[] payload, ulong length);
+
+        /// <summary>
+        /// Closes the descriptor of a memfd (the memfd goes away once no process maps it any more).
+        /// </summary>
+        [DllImport(Libraries.BuildXLHostLibLinux, EntryPoint = "BxlManifestMemfd_Dispose")]
+        public static extern void Dispose(int fd);
+    }
+}
@@ -0,0 +1,100 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+using System;
+using System.Runtime.InteropServices;
+
+namespace BuildXL.Interop.Unix
+{
+    /// <summary>
+    /// Interop calls into the host side of the shared memory process trees of the Linux sandbox
+    /// (see Public/Src/Sandbox/Linux/ProcessTree.hpp and Public/Src/Sandbox/Linux/Host/ProcessTreeMonitor.hpp).
+    /// </summary>
+    /// <remarks>
+    /// A tree is created by the host for each pip, with the pip's root process registered; the processes of
+    /// the pip register their children and mark themselves exited in it.  A monitor, shared by all the pips,
+    /// marks exited the processes that are gone without having done so (e.g., because they were killed) and
+    /// notifies the host as soon as the last process of a tree has exited.
+    /// </remarks>
+    public static class ProcessTree
+    {
+        /// <summary>
+        /// Counters of a tree
+        /// </summary>
+        public struct Counters
+        {
+            /// <summary>Number of processes that have not exited yet</summary>
+            public int NumActive;
+
+            /// <summary>Number of processes registered so far</summary>
+            public ulong NumProcesses;
+
+            /// <summary>Whether some processes could not be registered because the tree was full</summary>
+            public bool Overflowed;
+
+            /// <inheritdoc />
+            public override string ToString() => $"active: {NumActive}, processes: {NumProcesses}, overflowed: {Overflowed}";
+        }
+
+        /// <summary>
+        /// Called on the monitor's thread once every process of tree <paramref name="treeId"/> has exited.
+        /// </summary>
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        public delegate void TreeCompletedCallback(long treeId);
+
+        /// <summary>
+        /// Creates a tree backed by a new file at <paramref name="path"/> (typically in /dev/shm) that can hold up
+        /// to <paramref name="capacity"/> processes (0 means default), with <paramref name="rootPid"/> registered.
+        /// Returns <see cref="IntPtr.Zero"/> on error.
+        /// </summary>
+        [DllImport(Libraries.BuildXLHostLibLinux, SetLastError = true, EntryPoint = "BxlProcessTree_Create")]
+        public static extern IntPtr Create([MarshalAs(UnmanagedType.LPStr)] string path, ulong capacity, int rootPid);
+
+        /// <summary>
+        /// Returns the counters of the tree.
+        /// </summary>
+        public static Counters GetCounters(IntPtr tree)
+        {
+            GetCounters(tree, out var numActive, out var numProcesses, out var overflowed);
+            return new Counters { NumActive = numActive, NumProcesses = numProcesses, Overflowed = overflowed };
+        }
+
+        [DllImport(Libraries.BuildXLHostLibLinux, EntryPoint = "BxlProcessTree_GetCounters")]
+        private static extern void GetCounters(IntPtr tree, out int numActive, out ulong numProcesses, [MarshalAs(UnmanagedType.I1)] out bool overflowed);
+
+        /// <summary>
+        /// Unmaps the tree (the backing file is not deleted).  The tree must not be watched by a monitor anymore.
+        /// </summary>
+        [DllImport(Libraries.BuildXLHostLibLinux, EntryPoint = "BxlProcessTree_Dispose")]
+        public static extern void Dispose(IntPtr tree);
+
+        /// <summary>
+        /// Creates a monitor, which runs on its own native thread.  The callback must be kept alive until
+        /// the monitor is disposed.  Returns <see cref="IntPtr.Zero"/> on error.
+        /// </summary>
+        [DllImport(Libraries.BuildXLHostLibLinux, EntryPoint = "BxlProcessTreeMonitor_Create")]
+        public static extern IntPtr CreateMonitor([MarshalAs(UnmanagedType.FunctionPtr)] TreeCompletedCallback onCompleted);
+
+        /// <summary>
+        /// Starts watching <paramref name="tree"/> as tree <paramref name="treeId"/>.  Once the tree is reported completed,
+        /// the monitor does not use it anymore; otherwise <see cref="RemoveTree"/> must be called before disposing it.
+        /// </summary>
+        [DllImport(Libraries.BuildXLHostLibLinux, SetLastError = true, EntryPoint = "BxlProcessTreeMonitor_AddTree")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool AddTree(IntPtr monitor, long treeId, IntPtr tree);
+
+        /// <summary>
+        /// Stops watching a tree; no <see cref="TreeCompletedCallback"/> is made for it once this returns.
+        /// Returns false if the monitor was not watching the tree (e.g., because it has completed).
+        /// </summary>
+        [DllImport(Libraries.BuildXLHostLibLinux, EntryPoint = "BxlProcessTreeMonitor_RemoveTree")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool RemoveTree(IntPtr monitor, long treeId);
+
+        /// <summary>
+        /// Stops the monitor's thread (without notifying about the trees still being watched).
+        /// </summary>
+        [DllImport(Libraries.BuildXLHostLibLinux, EntryPoint = "BxlProcessTreeMonitor_Dispose")]
+        public static extern void DisposeMonitor(IntPtr monitor);
+    }
+}
@@ -0,0 +1,128 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+using System;
+using System.Runtime.InteropServices;
+
+namespace BuildXL.Interop.Unix
+{
+    /// <summary>
+    /// Interop calls into the native multi-pip report reader of the Linux sandbox host
+    /// (see Public/Src/Sandbox/Linux/Host/ReportReader.hpp).
+    /// </summary>
+    /// <remarks>
+    /// A reader multiplexes the report FIFOs ("channels") of many pips on a small pool of native
+    /// worker threads, decodes the reports natively, and hands them over in batches.
+    /// </remarks>
+    public static class ReportReader
+    {
+        /// <summary>
+        /// A decoded access report.  <see cref="Path"/> points to <see cref="PathLength"/> bytes of UTF-8
+        /// (not 0-terminated) that are only valid for the duration of a <see cref="ReportBatchCallback"/>.
+        /// </summary>
+        /// <remarks>
+        /// CODESYNC: Public/Src/Sandbox/Linux/Host/ReportReader.hpp
+        /// </remarks>
+        [StructLayout(LayoutKind.Sequential)]
+        public struct ReportEntry
+        {
+            /// <nodoc />
+            public ushort Operation;
+
+            /// <nodoc />
+            public byte Flags;
+
+            /// <nodoc />
+            public byte Reserved;
+
+            /// <nodoc />
+            public int Pid;
+
+            /// <nodoc />
+            public uint RequestedAccess;
+
+            /// <nodoc />
+            public uint Status;
+
+            /// <nodoc />
+            public uint Error;
+
+            /// <nodoc />
+            public uint PathLength;
+
+            /// <summary>
+            /// Id of the manifest record (the value of its <c>AbsolutePath</c>) that matched the reported path exactly, or 0 when the
+            /// policy of the path came from a record of one of its ancestors.
+            /// </summary>
+            public uint PathId;
+
+            /// <nodoc />
+            public IntPtr Path;
+        }
+
+        /// <summary>
+        /// Called on a native worker thread with <paramref name="numEntries"/> reports (an array of <see cref="ReportEntry"/>)
+        /// received through channel <paramref name="channelId"/>.  Calls for the same channel are never concurrent and are
+        /// made in the order in which the reports were received.
+        /// </summary>
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        public delegate void ReportBatchCallback(long channelId, IntPtr entries, int numEntries);
+
+        /// <summary>
+        /// Called on a native worker thread once channel <paramref name="channelId"/> has been closed (after
+        /// <see cref="CloseChannelWriter"/> was called and every sandboxed process closed the FIFO).
+        /// <paramref name="error"/> is 0 or the errno of a failed read; <paramref name="numMalformed"/> and
+        /// <paramref name="numIncomplete"/> count the reports that were dropped because they could not be decoded
+        /// or because only some of their fragments were received; <paramref name="numSpilled"/> is the number of writes
+        /// that were read from the channel's overflow journals.
+        /// </summary>
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        public delegate void ChannelClosedCallback(long channelId, int error, int numMalformed, int numIncomplete, int numSpilled);
+
+        /// <summary>
+        /// Creates a reader with <paramref name="numWorkers"/> worker threads (0 means default).
+        /// The callbacks must be kept alive until the reader is disposed.
+        /// Returns <see cref="IntPtr.Zero"/> on error.
+        /// </summary>
+        [DllImport(Libraries.BuildXLHostLibLinux, EntryPoint = "BxlReportReader_Create")]
+        public static extern IntPtr Create(
+            int numWorkers,
+            [MarshalAs(UnmanagedType.FunctionPtr)] ReportBatchCallback onBatch,
+            [MarshalAs(UnmanagedType.FunctionPtr)] ChannelClosedCallback onClosed);
+
+        /// <summary>
+        /// Starts reading from the (existing) FIFO at <paramref name="fifoPath"/> as channel <paramref name="channelId"/>.
+        /// </summary>
+        /// <remarks>
+        /// When <paramref name="buildAccessSet"/> is set, the file access reports of the channel are not handed over as they are read;
+        /// instead, they are folded into a set with one entry per path (sorted by path), which is handed over as the last batch of
+        /// the channel, right before <see cref="ChannelClosedCallback"/> is called.  Process start and exit reports are still
+        /// handed over as they are read.
+        ///
+        /// <paramref name="journalDirectory"/> is the directory of the overflow journals of the channel (null if the sandboxed processes
+        /// do not spill); the journals are read once the FIFO has been closed, before <see cref="ChannelClosedCallback"/> is called.
+        /// </remarks>
+        [DllImport(Libraries.BuildXLHostLibLinux, SetLastError = true, EntryPoint = "BxlReportReader_AddChannel")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool AddChannel(
+            IntPtr reader,
+            long channelId,
+            [MarshalAs(UnmanagedType.LPStr)] string fifoPath,
+            [MarshalAs(UnmanagedType.I1)] bool buildAccessSet,
+            [MarshalAs(UnmanagedType.LPStr)] string journalDirectory);
+
+        /// <summary>
+        /// Closes the reader's own write end of a channel's FIFO, so that the channel gets closed once all the
+        /// sandboxed processes have closed theirs.
+        /// </summary>
+        [DllImport(Libraries.BuildXLHostLibLinux, EntryPoint = "BxlReportReader_CloseChannelWriter")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool CloseChannelWriter(IntPtr reader, long channelId);
+
+        /// <summary>
+        /// Stops the worker threads and closes all the channels (without notifying about it).
+        /// </summary>
+        [DllImport(Libraries.BuildXLHostLibLinux, EntryPoint = "BxlReportReader_Dispose")]
+        public static extern void Dispose(IntPtr reader);
+    }
+}
@@ -0,0 +1,60 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+using System;
+using System.Runtime.InteropServices;
+
+namespace BuildXL.Interop.Unix
+{
+    /// <summary>
+    /// Interop calls into the consumer side of the shared memory report ring of the Linux sandbox
+    /// (see Public/Src/Sandbox/Linux/ReportRing.hpp).
+    /// </summary>
+    /// <remarks>
+    /// A ring is created by the host for each pip; all the processes of the pip's process tree
+    /// map it and write their access reports into it.  There must be only one reader per ring.
+    /// </remarks>
+    public static class ReportRing
+    {
+        /// <summary>
+        /// Maximum length of a single record (a record holds one access report, whose path is at most PATH_MAX bytes long)
+        /// </summary>
+        public const int MaxRecordLength = 8192;
+
+        /// <summary>
+        /// Creates a ring backed by a new file at <paramref name="path"/> (typically in /dev/shm)
+        /// with a data area of <paramref name="capacity"/> bytes (must be a power of 2; 0 means default).
+        /// Returns <see cref="IntPtr.Zero"/> on error.
+        /// </summary>
+        [DllImport(Libraries.BuildXLHostLibLinux, SetLastError = true, EntryPoint = "BxlReportRing_Create")]
+        public static extern IntPtr Create([MarshalAs(UnmanagedType.LPStr)] string path, ulong capacity);
+
+        /// <summary>
+        /// Reads the next record into <paramref name="buffer"/>, waiting for at most <paramref name="timeoutMs"/>
+        /// milliseconds for a record to become available.
+        /// Returns the length of the record, 0 if no record was available, or -1 if the record did not fit into the buffer.
+        /// A record left uncommitted by a producer that has since died is dropped instead of being waited for.
+        /// </summary>
+        [DllImport(Libraries.BuildXLHostLibLinux, EntryPoint = "BxlReportRing_Read")]
+        public static extern int Read(IntPtr ring, byte[] buffer, int bufferSize, int timeoutMs);
+
+        /// <summary>
+        /// Whether every record reserved by a producer has been read.
+        /// </summary>
+        [DllImport(Libraries.BuildXLHostLibLinux, EntryPoint = "BxlReportRing_IsDrained")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool IsDrained(IntPtr ring);
+
+        /// <summary>
+        /// Wakes up the reader if it is currently blocked in <see cref="Read"/>.
+        /// </summary>
+        [DllImport(Libraries.BuildXLHostLibLinux, EntryPoint = "BxlReportRing_WakeConsumer")]
+        public static extern void WakeConsumer(IntPtr ring);
+
+        /// <summary>
+        /// Unmaps the ring (the backing file is not deleted).
+        /// </summary>
+        [DllImport(Libraries.BuildXLHostLibLinux, EntryPoint = "BxlReportRing_Dispose")]
+        public static extern void Dispose(IntPtr ring);
+    }
+}